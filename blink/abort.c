@@ -24,7 +24,7 @@
 bool g_exitdontabort;
 
 void Abort(void) {
-#ifndef NDEBUG
+#if STATISTICS
   if (FLAG_statistics) {
     PrintStats();
   }
@@ -177,10 +177,10 @@ void OpIncEvqp(P) {
 void OpDecEvqp(P) {
   AluEvqp(A, kAlu[ALU_DEC]);
   if (IsMakingPath(m) && !Lock(rde)) {
-    STATISTIC(++alu_ops);
+    STATISTIC(++g_stats->alu_ops);
     switch (GetNeededFlags(m, m->ip, ZF | SF | OF | AF | PF)) {
       case 0:
-        STATISTIC(++alu_unflagged);
+        STATISTIC(++g_stats->alu_unflagged);
         Jitter(A,
                "B"     // res0 = GetRegOrMem(RexbRm)
                "t"     // arg0 = res0
@@ -189,7 +189,7 @@ void OpDecEvqp(P) {
                JustDec);
         break;
       case ZF:
-        STATISTIC(++alu_simplified);
+        STATISTIC(++g_stats->alu_simplified);
         Jitter(A,
                "B"      // res0 = GetRegOrMem(RexbRm)
                "s0a1="  // arg1 = machine
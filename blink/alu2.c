@@ -171,7 +171,7 @@ void OpAluw(P) {
     }
   }
   if (IsMakingPath(m) && !Lock(rde)) {
-    STATISTIC(++alu_ops);
+    STATISTIC(++g_stats->alu_ops);
     flags = GetNeededFlags(m, m->ip, CF | ZF | SF | OF | AF | PF);
     if (t == ALU_XOR &&          //
         RegLog2(rde) >= 2 &&     //
@@ -193,7 +193,7 @@ void OpAluw(P) {
       LoadAluArgs(A);
       switch (flags) {
         case 0:
-          STATISTIC(++alu_unflagged);
+          STATISTIC(++g_stats->alu_unflagged);
           if (GetFlagDeps(rde)) Jitter(A, "q");  // arg0 = machine
           Jitter(A,
                  "m"     // call micro-op
@@ -201,7 +201,7 @@ void OpAluw(P) {
                  kJustAlu[t]);
           break;
         CASE_ALU_FAST:
-          STATISTIC(++alu_simplified);
+          STATISTIC(++g_stats->alu_simplified);
           Jitter(A,
                  "q"     // arg0 = machine
                  "m"     // call micro-op
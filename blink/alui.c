@@ -28,11 +28,11 @@
 static void AluiRo(P, const aluop_f ops[4], const aluop_f fast[4]) {
   ops[RegLog2(rde)](m, ReadRegisterOrMemoryBW(rde, GetModrmReadBW(A)), uimm0);
   if (IsMakingPath(m)) {
-    STATISTIC(++alu_ops);
+    STATISTIC(++g_stats->alu_ops);
     switch (GetNeededFlags(m, m->ip, CF | ZF | SF | OF | AF | PF)) {
       case 0:
       CASE_ALU_FAST:
-        STATISTIC(++alu_simplified);
+        STATISTIC(++g_stats->alu_simplified);
         Jitter(A,
                "B"      // res0 = GetRegOrMem(RexbRm)
                "a2i"    // arg2 = uimm0
@@ -57,7 +57,7 @@ static void AluiRo(P, const aluop_f ops[4], const aluop_f fast[4]) {
 static void AluiUnlocked(P, u8 *p, aluop_f op) {
   WriteRegisterOrMemoryBW(rde, p, op(m, ReadRegisterOrMemoryBW(rde, p), uimm0));
   if (IsMakingPath(m)) {
-    STATISTIC(++alu_ops);
+    STATISTIC(++g_stats->alu_ops);
     Jitter(A,
            "B"      // res0 = GetRegOrMem(RexbRm)
            "r0a1="  // arg1 = res0
@@ -65,7 +65,7 @@ static void AluiUnlocked(P, u8 *p, aluop_f op) {
            uimm0);
     switch (GetNeededFlags(m, m->ip, CF | ZF | SF | OF | AF | PF)) {
       case 0:
-        STATISTIC(++alu_unflagged);
+        STATISTIC(++g_stats->alu_unflagged);
         if (GetFlagDeps(rde)) {
           Jitter(A, "q");  // arg0 = sav0 (machine)
         }
@@ -75,7 +75,7 @@ static void AluiUnlocked(P, u8 *p, aluop_f op) {
                kJustAlu[ModrmReg(rde)]);
         break;
       CASE_ALU_FAST:
-        STATISTIC(++alu_simplified);
+        STATISTIC(++g_stats->alu_simplified);
         Jitter(A,
                "q"     // arg0 = sav0 (machine)
                "m"     // call micro-op
@@ -37,6 +37,12 @@
    : sizeof(*(ptr)) == 4 ? FetchAdd32((u32 *)(ptr), delta) \
                          : FetchAddAbort())
 
+#define atomic_fetch_or_explicit(ptr, bits, order) \
+  (sizeof(*(ptr)) == 8 ? FetchOr64((u64 *)(ptr), bits) : FetchAddAbort())
+
+#define atomic_fetch_and_explicit(ptr, bits, order) \
+  (sizeof(*(ptr)) == 8 ? FetchAnd64((u64 *)(ptr), bits) : FetchAddAbort())
+
 static inline u64 Exchange64(u64 *ptr, u64 val) {
   u64 tmp = *ptr;
   *ptr = val;
@@ -73,6 +79,18 @@ static inline u32 FetchAdd32(u32 *ptr, u32 val) {
   return res;
 }
 
+static inline u64 FetchOr64(u64 *ptr, u64 bits) {
+  u64 res = *ptr;
+  *ptr |= bits;
+  return res;
+}
+
+static inline u64 FetchAnd64(u64 *ptr, u64 bits) {
+  u64 res = *ptr;
+  *ptr &= bits;
+  return res;
+}
+
 static inline u32 FetchAddAbort(void) {
   volatile u32 x = 0;
   return 1 / x;
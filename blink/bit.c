@@ -16,7 +16,9 @@
 │ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
 │ PERFORMANCE OF THIS SOFTWARE.                                                │
 ╚─────────────────────────────────────────────────────────────────────────────*/
+#include "blink/atomic.h"
 #include "blink/bus.h"
+#include "blink/endian.h"
 #include "blink/flags.h"
 #include "blink/machine.h"
 #include "blink/modrm.h"
@@ -34,6 +36,68 @@ static u64 Btc(u64 x, u64 y) {
   return (x & ~y) | (~x & y);
 }
 
+// performs locked bts/btr/btc on naturally aligned memory using the
+// host's atomic fetch instructions, which avoids taking the bus lock
+static bool LockBitAtomic(P, u8 *p, int op, unsigned w, u64 y) {
+  u64 x, v;
+  switch (w) {
+#if CAN_64BIT
+    case 3:
+      if ((uintptr_t)p & 7) return false;
+      v = Little64(y);
+      switch (op) {
+        case 5:
+          x = atomic_fetch_or((_Atomic(u64) *)p, v);
+          break;
+        case 6:
+          x = atomic_fetch_and((_Atomic(u64) *)p, ~v);
+          break;
+        default:
+          x = atomic_fetch_xor((_Atomic(u64) *)p, v);
+          break;
+      }
+      x = Little64(x);
+      break;
+#endif
+    case 2:
+      if ((uintptr_t)p & 3) return false;
+      v = Little32(y);
+      switch (op) {
+        case 5:
+          x = atomic_fetch_or((_Atomic(u32) *)p, v);
+          break;
+        case 6:
+          x = atomic_fetch_and((_Atomic(u32) *)p, ~v);
+          break;
+        default:
+          x = atomic_fetch_xor((_Atomic(u32) *)p, v);
+          break;
+      }
+      x = Little32(x);
+      break;
+    case 1:
+      if ((uintptr_t)p & 1) return false;
+      v = Little16(y);
+      switch (op) {
+        case 5:
+          x = atomic_fetch_or((_Atomic(u16) *)p, v);
+          break;
+        case 6:
+          x = atomic_fetch_and((_Atomic(u16) *)p, ~v);
+          break;
+        default:
+          x = atomic_fetch_xor((_Atomic(u16) *)p, v);
+          break;
+      }
+      x = Little16(x);
+      break;
+    default:
+      return false;
+  }
+  m->flags = SetFlag(m->flags, FLAGS_CF, !!(y & x));
+  return true;
+}
+
 void OpBit(P) {
   u8 *p;
   int op;
@@ -59,9 +123,13 @@ void OpBit(P) {
     v = MaskAddress(Eamode(rde), ComputeAddress(A) + bitdisp);
     p = ReserveAddress(m, v, 1 << w, op != 4);
   }
-  if (Lock(rde)) LockBus(p);
   y = 1;
   y <<= bit;
+  if (Lock(rde) && op >= 5 && !IsModrmRegister(rde) &&
+      LockBitAtomic(A, p, op, w, y)) {
+    return;
+  }
+  if (Lock(rde)) LockBus(p);
   if (Lock(rde)) {
     x = ReadMemoryUnlocked(rde, p);
   } else {
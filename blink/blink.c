@@ -45,6 +45,7 @@
 #include "blink/stats.h"
 #include "blink/syscall.h"
 #include "blink/thread.h"
+#include "blink/tmpfs.h"
 #include "blink/tunables.h"
 #include "blink/util.h"
 #include "blink/vfs.h"
@@ -90,7 +91,7 @@ Toolchain: " BUILD_TOOLCHAIN "\n\
 Revision: #" BLINK_COMMITS " " BLINK_GITSHA "\n\
 Config: ./configure MODE=" BUILD_MODE " " CONFIG_ARGUMENTS "\n"
 
-#define OPTS "hvjemZs0L:C:"
+#define OPTS "hvjemZs0L:C:F:f:"
 
 _Alignas(1) static const char USAGE[] =
     " [-" OPTS "] PROG [ARGS...]\n"
@@ -115,14 +116,20 @@ _Alignas(1) static const char USAGE[] =
 #if !defined(DISABLE_OVERLAYS) || !defined(DISABLE_VFS)
     "  -C PATH              sets chroot dir or overlay spec [default \":o\"]\n"
 #endif
+#ifdef HAVE_FORK
+    "  -F PATH              fork server socket (snapshot at first read of -f)\n"
+    "  -f FD                fork snapshot at first read of FD [default 0]\n"
+#endif
 #if !defined(DISABLE_OVERLAYS) || !defined(NDEBUG)
     "Environment:\n"
 #endif
 #ifndef DISABLE_OVERLAYS
     "  $BLINK_OVERLAYS      file system roots [default \":o\"]\n"
+    "                       +DIR as first root is a writable upper layer\n"
 #endif
 #ifndef DISABLE_VFS
-    "  $BLINK_PREFIX        file system root [default \"/\"]\n"
+    "  $BLINK_PREFIX        file system root or image [default \"/\"]\n"
+    "  $BLINK_TMPFS         colon separated tmpfs mount points, e.g. /tmp\n"
 #endif
 #ifndef NDEBUG
 
@@ -202,6 +209,22 @@ static void ProgramLimit(struct System *s, int hresource, int gresource) {
   }
 }
 
+#ifdef HAVE_JIT
+// Hashes guest page for the jit. Since this may be called while the
+// jit lock is held, and munmap() holds mmap_lock while it waits for
+// the jit lock, a page is just reported untrusted rather than waiting.
+static u64 HashJitPageMemory(void *system, i64 virt) {
+  u8 *p;
+  long n;
+  u64 hash = 0;
+  struct System *s = (struct System *)system;
+  if (pthread_rwlock_tryrdlock(&s->mmap_lock)) return 0;
+  if ((p = GetExecutablePage(s, virt, &n))) hash = HashJitPage(p, n);
+  RWUNLOCK(&s->mmap_lock);
+  return hash;
+}
+#endif
+
 static int Exec(char *execfn, char *prog, char **argv, char **envp) {
   int i;
   sigset_t oldmask;
@@ -223,6 +246,8 @@ static int Exec(char *execfn, char *prog, char **argv, char **envp) {
   } else {
 #ifdef HAVE_JIT
     DisableJit(&old->system->jit);  // unmapping exec pages is slow
+    if (IsMakingPath(old)) AbandonPath(old);
+    HashJitPages(&old->system->jit, HashJitPageMemory, old->system);
 #endif
     unassert(!m->sysdepth);
     unassert(!m->pagelocks.i);
@@ -234,8 +259,13 @@ static int Exec(char *execfn, char *prog, char **argv, char **envp) {
     }
     memcpy(m->system->rlim, old->system->rlim, sizeof(old->system->rlim));
     LoadProgram(m, execfn, prog, argv, envp, NULL);
-    m->system->fds.list = old->system->fds.list;
-    old->system->fds.list = 0;
+#ifdef HAVE_JIT
+    // inherit jit memory, and paths for code that's mapped identically
+    SwapJit(&m->system->jit, &old->system->jit);
+    m->system->ender = old->system->ender;
+    RevalidateJitPages(&m->system->jit, HashJitPageMemory, m->system);
+#endif
+    TransferFds(&m->system->fds, &old->system->fds);
     // releasing the execve() lock must come after unlocking fds
     memcpy(&oldmask, &old->system->exec_sigmask, sizeof(oldmask));
     UNLOCK(&old->system->exec_lock);
@@ -263,6 +293,19 @@ _Noreturn static void PrintVersion(void) {
   exit(0);
 }
 
+#ifdef HAVE_FORK
+// parses the -f argument, returning -1 unless it's a guest fd number
+static int ParseForkServerFd(const char *s) {
+  int fd;
+  if (!*s) return -1;
+  for (fd = 0; *s; ++s) {
+    if (!('0' <= *s && *s <= '9')) return -1;
+    if ((fd = fd * 10 + (*s - '0')) >= kMinBlinkFd) return -1;
+  }
+  return fd;
+}
+#endif
+
 static void GetOpts(int argc, char *argv[]) {
   int opt;
   FLAG_nolinear = !CanHaveLinearMemory();
@@ -272,6 +315,7 @@ static void GetOpts(int argc, char *argv[]) {
 #endif
 #ifndef DISABLE_VFS
   FLAG_prefix = getenv("BLINK_PREFIX");
+  FLAG_tmpfs = getenv("BLINK_TMPFS");
 #endif
 #if LOG_ENABLED
   FLAG_logpath = getenv("BLINK_LOG_FILENAME");
@@ -313,6 +357,23 @@ static void GetOpts(int argc, char *argv[]) {
 #else
         WriteErrorString(
             "error: overlays and vfs support were both disabled\n");
+#endif
+        break;
+      case 'F':
+#ifdef HAVE_FORK
+        FLAG_forkserver = optarg_;
+#else
+        WriteErrorString("error: fork support was disabled\n");
+#endif
+        break;
+      case 'f':
+#ifdef HAVE_FORK
+        if ((FLAG_forkserverfd = ParseForkServerFd(optarg_)) == -1) {
+          WriteErrorString("error: -f wants a file descriptor number\n");
+          exit(48);
+        }
+#else
+        WriteErrorString("error: fork support was disabled\n");
 #endif
         break;
       case 'v':
@@ -391,6 +452,10 @@ int main(int argc, char *argv[]) {
     WriteErrorString("error: vfs initialization failed\n");
     exit(1);
   }
+  if (FLAG_tmpfs && TmpfsMountPoints(FLAG_tmpfs)) {
+    WriteErrorString("error: bad $BLINK_TMPFS; see log for details\n");
+    exit(1);
+  }
 #endif
   HandleSigs();
   InitBus();
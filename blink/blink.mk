@@ -66,22 +66,22 @@ o/tiny/x86_64/blink/syscall.o: private CFLAGS += -fpie
 o/tiny/x86_64-gcc49/blink/syscall.o: private CFLAGS += -fpie
 o/tiny/aarch64/blink/syscall.o: private CFLAGS += -fpie
 
-o/$(MODE)/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_OBJS)))
-o/$(MODE)/i486/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/i486/%.o)))
-o/$(MODE)/m68k/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/m68k/%.o)))
-o/$(MODE)/x86_64/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/x86_64/%.o)))
-o/$(MODE)/x86_64-gcc49/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/x86_64-gcc49/%.o)))
-o/$(MODE)/arm/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/arm/%.o)))
-o/$(MODE)/aarch64/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/aarch64/%.o)))
-o/$(MODE)/riscv64/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/riscv64/%.o)))
-o/$(MODE)/mips/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/mips/%.o)))
-o/$(MODE)/mipsel/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/mipsel/%.o)))
-o/$(MODE)/mips64/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/mips64/%.o)))
-o/$(MODE)/mips64el/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/mips64el/%.o)))
-o/$(MODE)/s390x/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/s390x/%.o)))
-o/$(MODE)/microblaze/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/microblaze/%.o)))
-o/$(MODE)/powerpc/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/powerpc/%.o)))
-o/$(MODE)/powerpc64le/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o,$(BLINK_SRCS:%.c=o/$(MODE)/powerpc64le/%.o)))
+o/$(MODE)/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_OBJS)))
+o/$(MODE)/i486/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/i486/%.o)))
+o/$(MODE)/m68k/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/m68k/%.o)))
+o/$(MODE)/x86_64/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/x86_64/%.o)))
+o/$(MODE)/x86_64-gcc49/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/x86_64-gcc49/%.o)))
+o/$(MODE)/arm/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/arm/%.o)))
+o/$(MODE)/aarch64/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/aarch64/%.o)))
+o/$(MODE)/riscv64/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/riscv64/%.o)))
+o/$(MODE)/mips/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/mips/%.o)))
+o/$(MODE)/mipsel/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/mipsel/%.o)))
+o/$(MODE)/mips64/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/mips64/%.o)))
+o/$(MODE)/mips64el/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/mips64el/%.o)))
+o/$(MODE)/s390x/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/s390x/%.o)))
+o/$(MODE)/microblaze/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/microblaze/%.o)))
+o/$(MODE)/powerpc/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/powerpc/%.o)))
+o/$(MODE)/powerpc64le/blink/blink.a: $(filter-out %/blink.o,$(filter-out %/blinkenlights.o %/blinkpack.o,$(BLINK_SRCS:%.c=o/$(MODE)/powerpc64le/%.o)))
 
 o/$(MODE)/blink/blink: o/$(MODE)/blink/blink.o o/$(MODE)/blink/blink.a
 	$(CC) $(LDFLAGS) $(TARGET_ARCH) $^ $(LOADLIBES) $(LDLIBS) -o $@
@@ -154,7 +154,12 @@ o/$(MODE)/powerpc64le/blink/blinkenlights: o/$(MODE)/powerpc64le/blink/blinkenli
 o/$(MODE)/blink/oneoff.com: o/$(MODE)/blink/oneoff.o o/$(MODE)/blink/blink.a
 	$(CC) $(LDFLAGS) $(TARGET_ARCH) $^ $(LOADLIBES) $(LDLIBS) -o $@
 
+# makes read-only filesystem images for packfs
+o/$(MODE)/blink/blinkpack: o/$(MODE)/blink/blinkpack.o o/$(MODE)/blink/blink.a
+	$(CC) $(LDFLAGS) $(TARGET_ARCH) $^ $(LOADLIBES) $(LDLIBS) -o $@
+
 o/$(MODE)/blink:				\
 		o/$(MODE)/blink/blinkenlights	\
 		o/$(MODE)/blink/blink		\
+		o/$(MODE)/blink/blinkpack	\
 		$(BLINK_HDRS:%=o/$(MODE)/%.ok)
@@ -76,6 +76,7 @@
 #include "blink/syscall.h"
 #include "blink/thompike.h"
 #include "blink/timespec.h"
+#include "blink/tmpfs.h"
 #include "blink/tsan.h"
 #include "blink/types.h"
 #include "blink/util.h"
@@ -1765,7 +1766,9 @@ static void DrawMaps(struct Panel *p) {
   int i;
   char *p1, *p2;
   if (p->top == p->bottom) return;
+  RDLOCK(&m->system->mmap_lock);
   p1 = FormatPml4t(m);
+  RWUNLOCK(&m->system->mmap_lock);
   for (i = 0; p1; ++i, p1 = p2) {
     if ((p2 = strchr(p1, '\n'))) *p2++ = '\0';
     if (i >= mapsstart) {
@@ -2061,8 +2064,8 @@ static void AddHistory(const char *ansi, size_t size) {
   r->origsize = size;
   r->data = Deflate(ansi, size, &r->compsize);
   ++g_history.index;
-  STATISTIC(AVERAGE(redraw_compressed_bytes, r->compsize));
-  STATISTIC(AVERAGE(redraw_uncompressed_bytes, r->origsize));
+  STATISTIC(AVERAGE(g_stats->redraw_compressed_bytes, r->compsize));
+  STATISTIC(AVERAGE(g_stats->redraw_uncompressed_bytes, r->origsize));
 }
 
 static void RewindHistory(int delta) {
@@ -2178,7 +2181,7 @@ void Redraw(bool force) {
   END_NO_PAGE_FAULTS;
   end_draw = GetTime();
   (void)end_draw;
-  STATISTIC(AVERAGE(redraw_latency_us,
+  STATISTIC(AVERAGE(g_stats->redraw_latency_us,
                     ToMicroseconds(SubtractTime(end_draw, start_draw))));
   if (force || PreventBufferbloat()) {
     HandleEpipe(UninterruptibleWrite(ttyout, ansi, size));
@@ -3465,6 +3468,7 @@ static void GetOpts(int argc, char *argv[]) {
 #endif
 #ifndef DISABLE_VFS
   FLAG_prefix = getenv("BLINK_PREFIX");
+  FLAG_tmpfs = getenv("BLINK_TMPFS");
 #endif
   while ((opt = GetOpt(argc, argv, "0hjmvVtrzRNsZb:Hw:L:C:B:")) != -1) {
     switch (opt) {
@@ -3704,6 +3708,10 @@ int main(int argc, char *argv[]) {
     WriteErrorString("error: vfs initialization failed\n");
     exit(1);
   }
+  if (FLAG_tmpfs && TmpfsMountPoints(FLAG_tmpfs)) {
+    WriteErrorString("error: bad $BLINK_TMPFS; see log for details\n");
+    exit(1);
+  }
 #endif
 #ifdef HAVE_JIT
   AddPath_StartOp_Hook = AddPath_StartOp_Tui;
@@ -0,0 +1,467 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "blink/endian.h"
+#include "blink/macros.h"
+#include "blink/packfs.h"
+#include "blink/types.h"
+#include "blink/util.h"
+#include "blink/vfs.h"
+
+/**
+ * @fileoverview Packed Filesystem Image Builder.
+ *
+ * Turns a host directory into an image which blink can mount with the
+ * packfs filesystem, e.g. by pointing $BLINK_PREFIX at it. Directories
+ * that blink mounts other filesystems on are always present.
+ */
+
+#if defined(__APPLE__) || defined(__NetBSD__)
+#define st_mtim st_mtimespec
+#endif
+
+#define USAGE \
+  " [-a ALIGN] [-m NAME]... IMAGE DIRECTORY\n\
+Options:\n\
+  -a ALIGN             alignment of large files [default 4096]\n\
+  -m NAME              add empty directory NAME to root, e.g. tmp\n\
+  -h                   help\n"
+
+#define MAX_MOUNTS 16
+
+struct Inode {
+  u32 mode;
+  u32 uid;
+  u32 gid;
+  u32 nlink;
+  u64 size;
+  u64 offset;
+  i64 mtime;
+  u32 mtimensec;
+  u32 parent;
+  dev_t dev;
+  ino_t ino;
+  char *path;  // host path of file or directory, or null if made up
+  char *link;  // target of symbolic link
+};
+
+struct Dirent {
+  u32 ino;
+  char *name;
+};
+
+struct Link {
+  dev_t dev;
+  ino_t ino;
+  u32 inode;  // zero if slot is free
+};
+
+static u32 g_align = PACKFS_ALIGN;
+static int g_nmounts;
+static const char *g_mounts[MAX_MOUNTS];
+static struct Inode *g_inodes;
+static u32 g_ninodes, g_inodescap;
+static struct Dirent *g_dirents;
+static u32 g_ndirents, g_direntscap;
+static struct Link *g_links;
+static size_t g_nlinks, g_linkscap;
+
+static void Print(int fd, const char *s) {
+  (void)!write(fd, s, strlen(s));
+}
+
+_Noreturn static void PrintUsage(int argc, char *argv[], int rc, int fd) {
+  Print(fd, "Usage: ");
+  Print(fd, argc > 0 && argv[0] ? argv[0] : "blinkpack");
+  Print(fd, USAGE);
+  exit(rc);
+}
+
+_Noreturn static void Die(const char *thing, const char *reason) {
+  fprintf(stderr, "blinkpack: %s: %s\n", thing, reason);
+  exit(1);
+}
+
+static void *Grow(void *p, u32 *cap, size_t size) {
+  u32 n = *cap ? *cap * 2 : 64;
+  if (n <= *cap || !(p = realloc(p, n * size))) {
+    Die("grow", "out of memory");
+  }
+  *cap = n;
+  return p;
+}
+
+static char *Join(const char *dir, const char *name) {
+  char *path;
+  size_t n = strlen(dir), m = strlen(name);
+  if (!(path = (char *)malloc(n + 1 + m + 1))) Die(name, "out of memory");
+  memcpy(path, dir, n);
+  path[n] = '/';
+  memcpy(path + n + 1, name, m + 1);
+  return path;
+}
+
+static int CompareNames(const void *a, const void *b) {
+  return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// Finds inode previously packed for another hard link of the same file.
+static struct Link *FindLink(dev_t dev, ino_t ino) {
+  size_t i;
+  for (i = ((u64)dev * 0x9e3779b97f4a7c15 ^ (u64)ino) & (g_linkscap - 1);
+       g_links[i].inode; i = (i + 1) & (g_linkscap - 1)) {
+    if (g_links[i].dev == dev && g_links[i].ino == ino) break;
+  }
+  return g_links + i;
+}
+
+static void AddLink(dev_t dev, ino_t ino, u32 inode) {
+  size_t i, oldcap;
+  struct Link *old, *l;
+  if ((g_nlinks + 1) * 2 > g_linkscap) {
+    old = g_links;
+    oldcap = g_linkscap;
+    g_linkscap = oldcap ? oldcap * 2 : 64;
+    if (!(g_links = (struct Link *)calloc(g_linkscap, sizeof(*g_links)))) {
+      Die("links", "out of memory");
+    }
+    for (i = 0; i < oldcap; ++i) {
+      if (old[i].inode) *FindLink(old[i].dev, old[i].ino) = old[i];
+    }
+    free(old);
+  }
+  l = FindLink(dev, ino);
+  l->dev = dev;
+  l->ino = ino;
+  l->inode = inode;
+  ++g_nlinks;
+}
+
+static u32 AddInode(const char *path, const struct stat *st, u32 parent) {
+  u32 i;
+  ssize_t rc;
+  struct Inode *inode;
+  struct Link *link;
+  if (!S_ISDIR(st->st_mode) && st->st_nlink > 1 && g_nlinks &&
+      (link = FindLink(st->st_dev, st->st_ino))->inode) {
+    ++g_inodes[link->inode].nlink;
+    return link->inode;
+  }
+  if (g_ninodes == g_inodescap) {
+    g_inodes = (struct Inode *)Grow(g_inodes, &g_inodescap, sizeof(*g_inodes));
+  }
+  i = g_ninodes++;
+  inode = g_inodes + i;
+  memset(inode, 0, sizeof(*inode));
+  inode->mode = st->st_mode;
+  inode->uid = st->st_uid;
+  inode->gid = st->st_gid;
+  inode->nlink = S_ISDIR(st->st_mode) ? 2 : 1;
+  inode->mtime = st->st_mtim.tv_sec;
+  inode->mtimensec = st->st_mtim.tv_nsec;
+  inode->parent = parent;
+  inode->dev = st->st_dev;
+  inode->ino = st->st_ino;
+  if (path && !(inode->path = strdup(path))) Die(path, "out of memory");
+  if (S_ISREG(st->st_mode)) {
+    inode->size = st->st_size;
+  } else if (S_ISLNK(st->st_mode)) {
+    if (!(inode->link = (char *)malloc(VFS_PATH_MAX))) {
+      Die(path, "out of memory");
+    }
+    if ((rc = readlink(path, inode->link, VFS_PATH_MAX)) == -1) {
+      Die(path, strerror(errno));
+    }
+    if (rc == VFS_PATH_MAX) Die(path, "symlink target too long");
+    inode->size = rc;
+  }
+  if (!S_ISDIR(st->st_mode) && st->st_nlink > 1) {
+    AddLink(st->st_dev, st->st_ino, i);
+  }
+  return i;
+}
+
+static void AddDirent(u32 ino, const char *name) {
+  if (g_ndirents == g_direntscap) {
+    g_dirents =
+        (struct Dirent *)Grow(g_dirents, &g_direntscap, sizeof(*g_dirents));
+  }
+  g_dirents[g_ndirents].ino = ino;
+  if (!(g_dirents[g_ndirents].name = strdup(name))) {
+    Die(name, "out of memory");
+  }
+  ++g_ndirents;
+}
+
+// Appends entries of directory as a contiguous sorted run. Because new
+// directories are always appended to the inode table, visiting inodes
+// in order walks the whole tree breadth first.
+static void PackDirectory(u32 dir) {
+  DIR *d;
+  u32 ino;
+  size_t i, j;
+  char *path;
+  struct stat st;
+  struct dirent *e;
+  size_t n = 0, cap = 0;
+  char **names = NULL;
+  g_inodes[dir].offset = g_ndirents;
+  if (!g_inodes[dir].path) return;
+  if (!(d = opendir(g_inodes[dir].path))) {
+    Die(g_inodes[dir].path, strerror(errno));
+  }
+  while ((e = readdir(d))) {
+    if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+    if (strlen(e->d_name) >= VFS_NAME_MAX) Die(e->d_name, "name too long");
+    if (n == cap) {
+      cap = cap ? cap * 2 : 16;
+      if (!(names = (char **)realloc(names, cap * sizeof(*names)))) {
+        Die(e->d_name, "out of memory");
+      }
+    }
+    if (!(names[n++] = strdup(e->d_name))) Die(e->d_name, "out of memory");
+  }
+  closedir(d);
+  if (dir == PACKFS_ROOT_INO) {
+    for (i = 0; i < (size_t)g_nmounts; ++i) {
+      for (j = 0; j < n; ++j) {
+        if (!strcmp(names[j], g_mounts[i])) break;
+      }
+      if (j < n) continue;
+      if (n == cap) {
+        cap = cap ? cap * 2 : 16;
+        if (!(names = (char **)realloc(names, cap * sizeof(*names)))) {
+          Die(g_mounts[i], "out of memory");
+        }
+      }
+      if (!(names[n++] = strdup(g_mounts[i]))) {
+        Die(g_mounts[i], "out of memory");
+      }
+    }
+  }
+  qsort(names, n, sizeof(*names), CompareNames);
+  g_inodes[dir].size = n;
+  for (i = 0; i < n; ++i) {
+    path = Join(g_inodes[dir].path, names[i]);
+    if (lstat(path, &st) == -1) {
+      if (errno != ENOENT || dir != PACKFS_ROOT_INO) Die(path, strerror(errno));
+      // a mount point that the host directory lacks
+      free(path);
+      path = NULL;
+      st = (struct stat){0};
+      st.st_mode = S_IFDIR | 0755;
+      st.st_nlink = 2;
+      st.st_uid = g_inodes[dir].uid;
+      st.st_gid = g_inodes[dir].gid;
+      st.st_mtim.tv_sec = g_inodes[dir].mtime;
+      st.st_mtim.tv_nsec = g_inodes[dir].mtimensec;
+    }
+    ino = AddInode(path, &st, dir);
+    if (S_ISDIR(st.st_mode)) ++g_inodes[dir].nlink;
+    AddDirent(ino, names[i]);
+    free(names[i]);
+    free(path);
+  }
+  free(names);
+}
+
+// Assigns offsets to contents, where large files start and end on an
+// alignment boundary so packfs can map their pages from the image.
+static u64 Layout(u64 off) {
+  u32 i;
+  struct Inode *inode;
+  for (i = PACKFS_ROOT_INO; i < g_ninodes; ++i) {
+    inode = g_inodes + i;
+    if (S_ISREG(inode->mode) && inode->size >= g_align) {
+      inode->offset = off = ROUNDUP(off, (u64)g_align);
+      off = ROUNDUP(off + inode->size, (u64)g_align);
+    } else if (S_ISREG(inode->mode) || S_ISLNK(inode->mode)) {
+      inode->offset = off = ROUNDUP(off, 8);
+      off += inode->size;
+    }
+  }
+  return off;
+}
+
+static void Emit(FILE *f, const char *image, const void *p, size_t n) {
+  if (n && fwrite(p, 1, n, f) != n) Die(image, strerror(errno));
+}
+
+static void Pad(FILE *f, const char *image, u64 off) {
+  static const char zeroes[512];
+  long pos = ftell(f);
+  if (pos == -1) Die(image, strerror(errno));
+  while ((u64)pos < off) {
+    Emit(f, image, zeroes, MIN(sizeof(zeroes), off - pos));
+    pos += MIN(sizeof(zeroes), off - pos);
+  }
+}
+
+// Copies exactly as many bytes as were seen by lstat(), so a file that
+// changes while it's being packed can't corrupt the image.
+static void CopyFile(FILE *f, const char *image, struct Inode *inode) {
+  int fd;
+  ssize_t rc;
+  u64 got = 0;
+  static char buf[65536];
+  if ((fd = open(inode->path, O_RDONLY)) == -1) {
+    Die(inode->path, strerror(errno));
+  }
+  while (got < inode->size) {
+    rc = read(fd, buf, MIN(sizeof(buf), inode->size - got));
+    if (rc == -1) Die(inode->path, strerror(errno));
+    if (!rc) break;
+    Emit(f, image, buf, rc);
+    got += rc;
+  }
+  close(fd);
+  Pad(f, image, inode->offset + inode->size);
+}
+
+static void WriteImage(const char *image) {
+  FILE *f;
+  u32 i;
+  u64 off, names, size;
+  struct Inode *inode;
+  struct PackfsHeader hdr;
+  struct PackfsInode pi;
+  struct PackfsDirent pd;
+  off = ROUNDUP(sizeof(hdr), 8);
+  off += (u64)g_ninodes * sizeof(pi);
+  off += (u64)g_ndirents * sizeof(pd);
+  names = off;
+  for (i = 0; i < g_ndirents; ++i) {
+    off += strlen(g_dirents[i].name) + 1;
+  }
+  size = Layout(off);
+  if (!(f = fopen(image, "wb"))) Die(image, strerror(errno));
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, PACKFS_MAGIC, sizeof(hdr.magic));
+  Write32(hdr.version, PACKFS_VERSION);
+  Write32(hdr.align, g_align);
+  Write32(hdr.ninodes, g_ninodes);
+  Write32(hdr.ndirents, g_ndirents);
+  Write64(hdr.inodes, ROUNDUP(sizeof(hdr), 8));
+  Write64(hdr.dirents, ROUNDUP(sizeof(hdr), 8) + (u64)g_ninodes * sizeof(pi));
+  Write64(hdr.names, names);
+  Write64(hdr.size, size);
+  Emit(f, image, &hdr, sizeof(hdr));
+  Pad(f, image, ROUNDUP(sizeof(hdr), 8));
+  for (i = 0; i < g_ninodes; ++i) {
+    inode = g_inodes + i;
+    memset(&pi, 0, sizeof(pi));
+    if (i) {
+      Write32(pi.mode, inode->mode);
+      Write32(pi.uid, inode->uid);
+      Write32(pi.gid, inode->gid);
+      Write32(pi.nlink, inode->nlink);
+      Write64(pi.size, inode->size);
+      Write64(pi.offset, inode->offset);
+      Write64(pi.mtime, inode->mtime);
+      Write32(pi.mtimensec, inode->mtimensec);
+      Write32(pi.parent, inode->parent);
+    }
+    Emit(f, image, &pi, sizeof(pi));
+  }
+  for (off = names, i = 0; i < g_ndirents; ++i) {
+    Write32(pd.ino, g_dirents[i].ino);
+    Write32(pd.namelen, strlen(g_dirents[i].name));
+    Write64(pd.name, off);
+    Emit(f, image, &pd, sizeof(pd));
+    off += strlen(g_dirents[i].name) + 1;
+  }
+  for (i = 0; i < g_ndirents; ++i) {
+    Emit(f, image, g_dirents[i].name, strlen(g_dirents[i].name) + 1);
+  }
+  for (i = PACKFS_ROOT_INO; i < g_ninodes; ++i) {
+    inode = g_inodes + i;
+    if (S_ISREG(inode->mode)) {
+      Pad(f, image, inode->offset);
+      CopyFile(f, image, inode);
+    } else if (S_ISLNK(inode->mode)) {
+      Pad(f, image, inode->offset);
+      Emit(f, image, inode->link, inode->size);
+    }
+  }
+  Pad(f, image, size);
+  if (fclose(f)) Die(image, strerror(errno));
+}
+
+static void GetOpts(int argc, char *argv[]) {
+  int opt;
+  char *end;
+  unsigned long align;
+  g_mounts[g_nmounts++] = "dev";
+  g_mounts[g_nmounts++] = "proc";
+  g_mounts[g_nmounts++] = VFS_SYSTEM_ROOT_MOUNT + 1;
+  while ((opt = GetOpt(argc, argv, "a:m:h")) != -1) {
+    switch (opt) {
+      case 'a':
+        align = strtoul(optarg_, &end, 0);
+        if (*end || align < 8 || (align & (align - 1)) || align > 1u << 30) {
+          Die(optarg_, "alignment must be a power of two");
+        }
+        g_align = align;
+        break;
+      case 'm':
+        if (!*optarg_ || strchr(optarg_, '/') || !strcmp(optarg_, ".") ||
+            !strcmp(optarg_, "..") || strlen(optarg_) >= VFS_NAME_MAX) {
+          Die(optarg_, "mount point must be a name in the root directory");
+        }
+        if (g_nmounts == MAX_MOUNTS) Die(optarg_, "too many mount points");
+        g_mounts[g_nmounts++] = optarg_;
+        break;
+      case 'h':
+        PrintUsage(argc, argv, 0, 1);
+      default:
+        PrintUsage(argc, argv, 48, 2);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  u32 i;
+  struct stat st;
+  GetOpts(argc, argv);
+  if (argc - optind_ != 2) {
+    PrintUsage(argc, argv, 48, 2);
+  }
+  if (stat(argv[optind_ + 1], &st) == -1) {
+    Die(argv[optind_ + 1], strerror(errno));
+  }
+  if (!S_ISDIR(st.st_mode)) Die(argv[optind_ + 1], "not a directory");
+  AddInode("", &st, 0);  // inode zero is never referenced
+  AddInode(argv[optind_ + 1], &st, PACKFS_ROOT_INO);
+  for (i = PACKFS_ROOT_INO; i < g_ninodes; ++i) {
+    if (S_ISDIR(g_inodes[i].mode)) {
+      PackDirectory(i);
+    }
+  }
+  WriteImage(argv[optind_]);
+  return 0;
+}
@@ -65,7 +65,12 @@ int SysClose(struct Machine *m, i32 fildes) {
   struct Fd *fd;
   LOCK(&m->system->fds.lock);
   if ((fd = GetFd(&m->system->fds, fildes))) {
-    dll_remove(&m->system->fds.list, &fd->elem);
+    if (!fd->pinned) {
+      RemoveFd(&m->system->fds, fd);
+    } else {
+      fd = 0;
+      ebadf();
+    }
   }
   UNLOCK(&m->system->fds.lock);
   if (!fd) return -1;
@@ -79,8 +84,8 @@ void SysCloseExec(struct System *s) {
   for (fds = 0, e = dll_first(s->fds.list); e; e = e2) {
     fd = FD_CONTAINER(e);
     e2 = dll_next(s->fds.list, e);
-    if (fd->oflags & O_CLOEXEC) {
-      dll_remove(&s->fds.list, e);
+    if ((fd->oflags & O_CLOEXEC) && !fd->pinned) {
+      RemoveFd(&s->fds, fd);
       dll_make_last(&fds, e);
     }
   }
@@ -97,7 +102,7 @@ static int SysCloseRangeCloexec(struct Machine *m, u32 first, u32 last) {
   for (e = dll_first(m->system->fds.list); e;
        e = dll_next(m->system->fds.list, e)) {
     fd = FD_CONTAINER(e);
-    if (first <= (u32)fd->fildes && (u32)fd->fildes <= last) {
+    if (first <= (u32)fd->fildes && (u32)fd->fildes <= last && !fd->pinned) {
       if (~fd->oflags & O_CLOEXEC) {
         fd->oflags |= O_CLOEXEC;
         VfsFcntl(fd->fildes, F_SETFD, FD_CLOEXEC);
@@ -123,8 +128,8 @@ int SysCloseRange(struct Machine *m, u32 first, u32 last, u32 flags) {
   for (fds = 0, e = dll_first(m->system->fds.list); e; e = e2) {
     fd = FD_CONTAINER(e);
     e2 = dll_next(m->system->fds.list, e);
-    if (first <= (u32)fd->fildes && (u32)fd->fildes <= last) {
-      dll_remove(&m->system->fds.list, e);
+    if (first <= (u32)fd->fildes && (u32)fd->fildes <= last && !fd->pinned) {
+      RemoveFd(&m->system->fds, fd);
       dll_make_last(&fds, e);
     }
   }
@@ -20,13 +20,22 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "blink/errno.h"
 #include "blink/hostfs.h"
 #include "blink/log.h"
+#include "blink/macros.h"
+#include "blink/random.h"
 
 #ifndef DISABLE_VFS
 
+static const char *const kDevfsChrdevs[] = {
+    [DEVFS_NULL] = "null",
+    [DEVFS_ZERO] = "zero",
+    [DEVFS_URANDOM] = "urandom",
+};
+
 static int DevfsInit(const char *source, u64 flags, const void *data,
                      struct VfsDevice **device, struct VfsMount **mount) {
   int ret;
@@ -43,6 +52,132 @@ static int DevfsInit(const char *source, u64 flags, const void *data,
   return ret;
 }
 
+static int DevfsGetChrdev(struct VfsInfo *info) {
+  if (!info->data) return 0;
+  return ((struct HostfsInfo *)info->data)->chrdev;
+}
+
+// The host device is still opened, so stat(), poll(), etc. work as
+// before, but reading and writing the likes of /dev/zero won't need a
+// system call, nor the data to be copied more than once.
+static int DevfsOpen(struct VfsInfo *parent, const char *name, int flags,
+                     int mode, struct VfsInfo **output) {
+  int i;
+  if (HostfsOpen(parent, name, flags, mode, output) == -1) {
+    return -1;
+  }
+  if (S_ISCHR((*output)->mode) && parent->ino == parent->device->root->ino) {
+    for (i = DEVFS_NULL; i < ARRAYLEN(kDevfsChrdevs); ++i) {
+      if (!strcmp(name, kDevfsChrdevs[i])) {
+        VFS_LOGF("DevfsOpen: serving /dev/%s in-process", name);
+        ((struct HostfsInfo *)(*output)->data)->chrdev = i;
+        break;
+      }
+    }
+  }
+  return 0;
+}
+
+static ssize_t DevfsFill(int chrdev, void *buf, size_t size) {
+  if (chrdev == DEVFS_NULL) {
+    return 0;
+  } else if (chrdev == DEVFS_ZERO) {
+    memset(buf, 0, size);
+  } else {
+    GetFastRandom(buf, size);
+  }
+  return size;
+}
+
+static ssize_t DevfsFillv(int chrdev, const struct iovec *iov, int iovcnt) {
+  int i;
+  ssize_t rc;
+  for (rc = i = 0; i < iovcnt; ++i) {
+    rc += DevfsFill(chrdev, iov[i].iov_base, iov[i].iov_len);
+  }
+  return rc;
+}
+
+static ssize_t DevfsSize(const struct iovec *iov, int iovcnt) {
+  int i;
+  ssize_t rc;
+  for (rc = i = 0; i < iovcnt; ++i) {
+    rc += iov[i].iov_len;
+  }
+  return rc;
+}
+
+static ssize_t DevfsRead(struct VfsInfo *info, void *buf, size_t size) {
+  int chrdev;
+  if ((chrdev = DevfsGetChrdev(info))) {
+    return DevfsFill(chrdev, buf, size);
+  }
+  return HostfsRead(info, buf, size);
+}
+
+static ssize_t DevfsWrite(struct VfsInfo *info, const void *buf, size_t size) {
+  if (DevfsGetChrdev(info)) {
+    return size;
+  }
+  return HostfsWrite(info, buf, size);
+}
+
+static ssize_t DevfsPread(struct VfsInfo *info, void *buf, size_t size,
+                          off_t offset) {
+  int chrdev;
+  if ((chrdev = DevfsGetChrdev(info))) {
+    return DevfsFill(chrdev, buf, size);
+  }
+  return HostfsPread(info, buf, size, offset);
+}
+
+static ssize_t DevfsPwrite(struct VfsInfo *info, const void *buf, size_t size,
+                           off_t offset) {
+  if (DevfsGetChrdev(info)) {
+    return size;
+  }
+  return HostfsPwrite(info, buf, size, offset);
+}
+
+static ssize_t DevfsReadv(struct VfsInfo *info, const struct iovec *iov,
+                          int iovcnt) {
+  int chrdev;
+  if ((chrdev = DevfsGetChrdev(info))) {
+    return DevfsFillv(chrdev, iov, iovcnt);
+  }
+  return HostfsReadv(info, iov, iovcnt);
+}
+
+static ssize_t DevfsWritev(struct VfsInfo *info, const struct iovec *iov,
+                           int iovcnt) {
+  if (DevfsGetChrdev(info)) {
+    return DevfsSize(iov, iovcnt);
+  }
+  return HostfsWritev(info, iov, iovcnt);
+}
+
+static ssize_t DevfsPreadv(struct VfsInfo *info, const struct iovec *iov,
+                           int iovcnt, off_t offset) {
+  int chrdev;
+  if ((chrdev = DevfsGetChrdev(info))) {
+    return DevfsFillv(chrdev, iov, iovcnt);
+  }
+  return HostfsPreadv(info, iov, iovcnt, offset);
+}
+
+static ssize_t DevfsPwritev(struct VfsInfo *info, const struct iovec *iov,
+                            int iovcnt, off_t offset) {
+  if (DevfsGetChrdev(info)) {
+    return DevfsSize(iov, iovcnt);
+  }
+  return HostfsPwritev(info, iov, iovcnt, offset);
+}
+
+bool DevfsIsZero(struct VfsInfo *info) {
+  return info->device->ops == &g_devfs.ops &&
+         DevfsGetChrdev(info) == DEVFS_ZERO;
+}
+
 static int DevfsReadmountentry(struct VfsDevice *device, char **spec,
                                char **type, char **mntops) {
   *spec = strdup("none");
@@ -69,7 +204,7 @@ struct VfsSystem g_devfs = {.name = "devfs",
                                 .Readlink = HostfsReadlink,
                                 .Mkdir = HostfsMkdir,
                                 .Mkfifo = HostfsMkfifo,
-                                .Open = HostfsOpen,
+                                .Open = DevfsOpen,
                                 .Access = HostfsAccess,
                                 .Stat = HostfsStat,
                                 .Fstat = HostfsFstat,
@@ -80,17 +215,23 @@ struct VfsSystem g_devfs = {.name = "devfs",
                                 .Ftruncate = HostfsFtruncate,
                                 .Link = HostfsLink,
                                 .Unlink = HostfsUnlink,
-                                .Read = HostfsRead,
-                                .Write = HostfsWrite,
-                                .Pread = HostfsPread,
-                                .Pwrite = HostfsPwrite,
-                                .Readv = HostfsReadv,
-                                .Writev = HostfsWritev,
-                                .Preadv = HostfsPreadv,
-                                .Pwritev = HostfsPwritev,
+                                .Read = DevfsRead,
+                                .Write = DevfsWrite,
+                                .Pread = DevfsPread,
+                                .Pwrite = DevfsPwrite,
+                                .Readv = DevfsReadv,
+                                .Writev = DevfsWritev,
+                                .Preadv = DevfsPreadv,
+                                .Pwritev = DevfsPwritev,
                                 .Seek = HostfsSeek,
                                 .Fsync = HostfsFsync,
                                 .Fdatasync = HostfsFdatasync,
+#ifdef HAVE_FALLOCATE
+                                .Fallocate = HostfsFallocate,
+#endif
+#ifdef HAVE_POSIX_FADVISE
+                                .Fadvise = HostfsFadvise,
+#endif
                                 .Flock = HostfsFlock,
                                 .Fcntl = HostfsFcntl,
                                 .Ioctl = HostfsIoctl,
@@ -3,6 +3,13 @@
 
 #include "blink/vfs.h"
 
+// character devices devfs serves in-process rather than via the host
+#define DEVFS_NULL    1
+#define DEVFS_ZERO    2
+#define DEVFS_URANDOM 3
+
 extern struct VfsSystem g_devfs;
 
+bool DevfsIsZero(struct VfsInfo *);
+
 #endif  // BLINK_DEVFS_H_
@@ -68,6 +68,10 @@ long eoverflow(void) {
   return ReturnErrno(EOVERFLOW);
 }
 
+long efbig(void) {
+  return ReturnErrno(EFBIG);
+}
+
 long enfile(void) {
   return ReturnErrno(ENFILE);
 }
@@ -127,3 +131,23 @@ long exdev(void) {
 long enametoolong(void) {
   return ReturnErrno(ENAMETOOLONG);
 }
+
+long enospc(void) {
+  return ReturnErrno(ENOSPC);
+}
+
+long enotempty(void) {
+  return ReturnErrno(ENOTEMPTY);
+}
+
+long ebusy(void) {
+  return ReturnErrno(EBUSY);
+}
+
+long enxio(void) {
+  return ReturnErrno(ENXIO);
+}
+
+long erofs(void) {
+  return ReturnErrno(EROFS);
+}
@@ -5,6 +5,7 @@ long eagain(void);
 long ebadf(void);
 long efault(void);
 void *efault0(void);
+long efbig(void);
 long eintr(void);
 long einval(void);
 long enfile(void);
@@ -26,5 +27,10 @@ long eexist(void);
 long eloop(void);
 long exdev(void);
 long enametoolong(void);
+long enospc(void);
+long enotempty(void);
+long ebusy(void);
+long enxio(void);
+long erofs(void);
 
 #endif /* BLINK_ERRNO_H_ */
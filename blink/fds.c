@@ -38,12 +38,27 @@
 
 void InitFds(struct Fds *fds) {
   fds->list = 0;
+  fds->table = 0;
+  fds->tablesize = 0;
+  fds->count = 0;
   unassert(!pthread_mutex_init(&fds->lock, 0));
 }
 
+static bool GrowFds(struct Fds *fds, int fildes) {
+  int n;
+  struct Fd **p;
+  n = MAX(MAX(fds->tablesize * 2, fildes + 1), 64);
+  if (!(p = (struct Fd **)realloc(fds->table, n * sizeof(*p)))) return false;
+  memset(p + fds->tablesize, 0, (n - fds->tablesize) * sizeof(*p));
+  fds->table = p;
+  fds->tablesize = n;
+  return true;
+}
+
 struct Fd *AddFd(struct Fds *fds, int fildes, int oflags) {
   struct Fd *fd;
   if (fildes >= 0) {
+    if (fildes >= fds->tablesize && !GrowFds(fds, fildes)) return 0;
     if ((fd = (struct Fd *)calloc(1, sizeof(*fd)))) {
       dll_init(&fd->elem);
       fd->cb = &kFdCbHost;
@@ -51,6 +66,9 @@ struct Fd *AddFd(struct Fds *fds, int fildes, int oflags) {
       fd->oflags = oflags;
       unassert(!pthread_mutex_init(&fd->lock, 0));
       dll_make_first(&fds->list, &fd->elem);
+      fd->shadowed = fds->table[fildes];
+      fds->table[fildes] = fd;
+      ++fds->count;
     }
     return fd;
   } else {
@@ -59,10 +77,40 @@ struct Fd *AddFd(struct Fds *fds, int fildes, int oflags) {
   }
 }
 
+void RemoveFd(struct Fds *fds, struct Fd *fd) {
+  struct Fd **p;
+  dll_remove(&fds->list, &fd->elem);
+  // the slot goes back to whichever fd this one was shadowing, since a
+  // syscall like dup2() adds the new fd before removing the one it ends
+  for (p = fds->table + fd->fildes; *p; p = &(*p)->shadowed) {
+    if (*p == fd) {
+      *p = fd->shadowed;
+      break;
+    }
+  }
+  fd->shadowed = 0;
+  --fds->count;
+}
+
+// moves all open files into an empty table, e.g. for execve()
+void TransferFds(struct Fds *to, struct Fds *from) {
+  unassert(!to->list);
+  free(to->table);
+  to->list = from->list;
+  to->table = from->table;
+  to->tablesize = from->tablesize;
+  to->count = from->count;
+  from->list = 0;
+  from->table = 0;
+  from->tablesize = 0;
+  from->count = 0;
+}
+
 struct Fd *ForkFd(struct Fds *fds, struct Fd *fd, int fildes, int oflags) {
   struct Fd *fd2;
   if ((fd2 = AddFd(fds, fildes, oflags))) {
     if (fd) {
+      fd2->cb = fd->cb;
       fd2->path = fd->path ? strdup(fd->path) : 0;
       fd2->socktype = fd->socktype;
       fd2->norestart = fd->norestart;
@@ -73,20 +121,9 @@ struct Fd *ForkFd(struct Fds *fds, struct Fd *fd, int fildes, int oflags) {
 }
 
 struct Fd *GetFd(struct Fds *fds, int fildes) {
-  bool lru;
-  struct Dll *e;
-  if (fildes >= 0) {
-    lru = false;
-    for (e = dll_first(fds->list); e; e = dll_next(fds->list, e)) {
-      if (FD_CONTAINER(e)->fildes == fildes) {
-        if (lru) {
-          dll_remove(&fds->list, e);
-          dll_make_first(&fds->list, e);
-        }
-        return FD_CONTAINER(e);
-      }
-      lru = true;
-    }
+  struct Fd *fd;
+  if (0 <= fildes && fildes < fds->tablesize && (fd = fds->table[fildes])) {
+    return fd;
   }
   ebadf();
   return 0;
@@ -101,12 +138,7 @@ void UnlockFd(struct Fd *fd) {
 }
 
 int CountFds(struct Fds *fds) {
-  int n = 0;
-  struct Dll *e;
-  for (e = dll_first(fds->list); e; e = dll_next(fds->list, e)) {
-    ++n;
-  }
-  return n;
+  return fds->count;
 }
 
 void FreeFd(struct Fd *fd) {
@@ -121,10 +153,11 @@ void DestroyFds(struct Fds *fds) {
   struct Dll *e, *e2;
   for (e = dll_first(fds->list); e; e = e2) {
     e2 = dll_next(fds->list, e);
-    dll_remove(&fds->list, e);
+    RemoveFd(fds, FD_CONTAINER(e));
     FreeFd(FD_CONTAINER(e));
   }
   unassert(!fds->list);
+  free(fds->table);
   unassert(!pthread_mutex_destroy(&fds->lock));
 }
 
@@ -33,8 +33,10 @@ struct Fd {
   int oflags;      // host O_XXX constants
   int socktype;    // host SOCK_XXX constants
   bool norestart;  // is SO_RCVTIMEO in play?
+  bool pinned;     // registered with io_uring and hidden from guest
   DIR *dirstream;  // for getdents() lazilly
   struct Dll elem;
+  struct Fd *shadowed;  // older fd with the same fildes, e.g. in dup2()
   pthread_mutex_t_ lock;
   const struct FdCb *cb;
   char *path;
@@ -46,7 +48,10 @@ struct Fd {
 };
 
 struct Fds {
-  struct Dll *list;
+  struct Dll *list;    // every open fd, for iteration
+  struct Fd **table;   // index of list by fildes, for lookup
+  int tablesize;
+  int count;
   pthread_mutex_t_ lock;
 };
 
@@ -56,6 +61,8 @@ void InitFds(struct Fds *);
 struct Fd *AddFd(struct Fds *, int, int);
 struct Fd *ForkFd(struct Fds *, struct Fd *, int, int);
 struct Fd *GetFd(struct Fds *, int);
+void RemoveFd(struct Fds *, struct Fd *);
+void TransferFds(struct Fds *, struct Fds *);
 void LockFd(struct Fd *);
 void UnlockFd(struct Fd *);
 int CountFds(struct Fds *);
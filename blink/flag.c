@@ -29,6 +29,7 @@ bool FLAG_alsologtostderr;
 
 int FLAG_strace;
 int FLAG_vabits;
+int FLAG_forkserverfd;
 
 long FLAG_pagesize;
 
@@ -48,5 +49,7 @@ const char *FLAG_overlays;
 #endif
 #ifndef DISABLE_VFS
 const char *FLAG_prefix;
+const char *FLAG_tmpfs;
 #endif
 const char *FLAG_bios;
+const char *FLAG_forkserver;
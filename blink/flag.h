@@ -13,6 +13,7 @@ extern bool FLAG_alsologtostderr;
 
 extern int FLAG_strace;
 extern int FLAG_vabits;
+extern int FLAG_forkserverfd;
 
 extern long FLAG_pagesize;
 
@@ -28,6 +29,8 @@ extern u64 FLAG_dyninterpaddr;
 extern const char *FLAG_logpath;
 extern const char *FLAG_overlays;
 extern const char *FLAG_prefix;
+extern const char *FLAG_tmpfs;
 extern const char *FLAG_bios;
+extern const char *FLAG_forkserver;
 
 #endif /* BLINK_FLAG_H_ */
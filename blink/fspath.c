@@ -18,6 +18,7 @@
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "blink/fspath.h"
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -50,3 +51,37 @@ char *ExpandUser(const char *path) {
     return strdup(path);
   }
 }
+
+// Returns `path` made absolute relative to `cwd`, with "." and ".."
+// components and repeated slashes resolved lexically. Symbolic links
+// aren't consulted, so this is only suitable for describing things.
+char *AbsolutePath(const char *cwd, const char *path) {
+  char *z, *r, *w;
+  size_t n;
+  if (!(z = JoinPath(*path == '/' ? 0 : cwd, path))) return 0;
+  if (*z != '/') {
+    free(z);
+    errno = EINVAL;
+    return 0;
+  }
+  for (r = w = z; *r;) {
+    while (*r == '/') ++r;
+    for (n = 0; r[n] && r[n] != '/'; ++n) {
+    }
+    if (!n || (n == 1 && r[0] == '.')) {
+      r += n;
+    } else if (n == 2 && r[0] == '.' && r[1] == '.') {
+      while (w > z && *--w != '/') {
+      }
+      r += n;
+    } else {
+      *w++ = '/';
+      memmove(w, r, n);
+      w += n;
+      r += n;
+    }
+  }
+  if (w == z) *w++ = '/';
+  *w = 0;
+  return z;
+}
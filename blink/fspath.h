@@ -3,5 +3,6 @@
 
 char *JoinPath(const char *, const char *);
 char *ExpandUser(const char *);
+char *AbsolutePath(const char *, const char *);
 
 #endif /* BLINK_FSPATH_H_ */
@@ -136,7 +136,7 @@ bool FuseBranchTest(P) {
   Connect(A, m->ip + jlen + bdisp, false);
   FinishPath(m);
   m->path.skip = 1;
-  STATISTIC(++fused_branches);
+  STATISTIC(++g_stats->fused_branches);
   return true;
 #else
   return false;
@@ -334,7 +334,7 @@ bool FuseBranchCmp(P, bool imm) {
   Connect(A, m->ip + jlen + bdisp, false);
   FinishPath(m);
   m->path.skip = 1;
-  STATISTIC(++fused_branches);
+  STATISTIC(++g_stats->fused_branches);
   return true;
 #else
   return false;
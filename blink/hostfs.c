@@ -20,6 +20,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,19 +30,62 @@
 #include <sys/types.h>
 
 #include "blink/assert.h"
+#include "blink/atomic.h"
 #include "blink/errno.h"
 #include "blink/log.h"
 #include "blink/macros.h"
+#include "blink/packfs.h"
 #include "blink/syscall.h"
+#include "blink/thread.h"
+#include "blink/tmpfs.h"
+#include "blink/tunables.h"
 #include "blink/vfs.h"
 
 #ifndef DISABLE_VFS
 
+#ifdef O_PATH
+#define HOSTFS_DIRFD_FLAGS (O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)
+#else
+#define HOSTFS_DIRFD_FLAGS (O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)
+#endif
+
+#define HOSTFS_INFO_CONTAINER(e) DLL_CONTAINER(struct HostfsInfo, elem, e)
+
+#define kHostfsDirFdEvicting (INT_MIN / 2)
+
 struct HostfsDevice {
   const char *source;
   size_t sourcelen;
 };
 
+// Directories which are looked up under more than once get a host
+// handle of their own, so that operations on their entries become a
+// single *at() system call instead of resolving the whole host path.
+// The number of handles is bounded by evicting the oldest ones which
+// weren't used since the last sweep. Pinning needs no lock, so lookups
+// under a cached directory stay off the global mutex.
+static struct HostfsState {
+  pthread_once_t_ once;
+  pthread_mutex_t_ lock;
+  struct Dll *dirfds GUARDED_BY(lock);  // most recently cached first
+  int ndirfds GUARDED_BY(lock);
+} g_hostfsstate = {
+    PTHREAD_ONCE_INIT_,
+    PTHREAD_MUTEX_INITIALIZER_,
+};
+
+static void HostfsBeforeFork(void) {
+  LOCK(&g_hostfsstate.lock);
+}
+
+static void HostfsAfterFork(void) {
+  UNLOCK(&g_hostfsstate.lock);
+}
+
+static void HostfsSetup(void) {
+  unassert(!pthread_atfork(HostfsBeforeFork, HostfsAfterFork, HostfsAfterFork));
+}
+
 static u64 HostfsHash(u64 parent, const char *data, size_t size) {
   u64 hash;
   if (data == NULL) {
@@ -69,6 +113,7 @@ int HostfsInit(const char *source, u64 flags, const void *data,
   if (!S_ISDIR(st.st_mode)) {
     return enotdir();
   }
+  unassert(!pthread_once_(&g_hostfsstate.once, HostfsSetup));
   hostdevice = NULL;
   hostfsrootinfo = NULL;
   *device = NULL;
@@ -148,10 +193,24 @@ int HostfsReadmountentry(struct VfsDevice *device, char **spec, char **type,
 
 int HostfsFreeInfo(void *info) {
   struct HostfsInfo *hostfsinfo = (struct HostfsInfo *)info;
+  int dirfd;
   if (info == NULL) {
     return 0;
   }
   VFS_LOGF("HostfsFreeInfo(%p)", info);
+  if (atomic_load_explicit(&hostfsinfo->dirfd, memory_order_relaxed) != -1) {
+    // eviction may have raced us to it
+    LOCK(&g_hostfsstate.lock);
+    unassert(!atomic_load_explicit(&hostfsinfo->dirfdpins,
+                                   memory_order_relaxed));
+    if ((dirfd = atomic_load_explicit(&hostfsinfo->dirfd,
+                                      memory_order_relaxed)) != -1) {
+      dll_remove(&g_hostfsstate.dirfds, &hostfsinfo->elem);
+      --g_hostfsstate.ndirfds;
+    }
+    UNLOCK(&g_hostfsstate.lock);
+    if (dirfd != -1) unassert(!close(dirfd));
+  }
   if (S_ISDIR(hostfsinfo->mode)) {
     if (hostfsinfo->dirstream) {
       unassert(!closedir(hostfsinfo->dirstream));
@@ -192,6 +251,12 @@ int HostfsCreateInfo(struct HostfsInfo **output) {
   (*output)->mode = 0;
   (*output)->socketfamily = 0;
   (*output)->filefd = -1;
+  atomic_store_explicit(&(*output)->dirfd, -1, memory_order_relaxed);
+  atomic_store_explicit(&(*output)->dirfdpins, 0, memory_order_relaxed);
+  atomic_store_explicit(&(*output)->dirfduses, 0, memory_order_relaxed);
+  atomic_store_explicit(&(*output)->dirfdused, false, memory_order_relaxed);
+  (*output)->chrdev = 0;
+  dll_init(&(*output)->elem);
   (*output)->dirstream = NULL;
   (*output)->socketaddr = NULL;
   (*output)->socketaddrlen = 0;
@@ -209,6 +274,13 @@ static ssize_t HostfsGetHostPath(struct VfsInfo *info,
     efault();
     return -1;
   }
+  if (info->device->ops == &g_tmpfs.ops) {
+    return TmpfsGetHostPath(info, output);
+  }
+  if (info->device->ops == &g_packfs.ops) {
+    errno = ECONNREFUSED;  // images can't hold live sockets
+    return -1;
+  }
   hostfsdevice = (struct HostfsDevice *)info->device->data;
   if ((pathlen = VfsPathBuild(info, info->device->root, true, output)) == -1) {
     return -1;
@@ -229,85 +301,200 @@ static ssize_t HostfsGetHostPath(struct VfsInfo *info,
   return ret;
 }
 
+// Pins the handle cached on `hostinfo`, if it has one, so it can't be
+// evicted until HostfsPutDirFd(). No lock is needed: eviction claims an
+// unpinned handle by swinging its pin count negative, which makes us
+// back off, and clears dirfd before letting the count go back up.
+static int HostfsPinDirFd(struct HostfsInfo *hostinfo) {
+  int fd;
+  if (atomic_load_explicit(&hostinfo->dirfd, memory_order_relaxed) == -1) {
+    return -1;
+  }
+  if (atomic_fetch_add_explicit(&hostinfo->dirfdpins, 1,
+                                memory_order_acquire) >= 0 &&
+      (fd = atomic_load_explicit(&hostinfo->dirfd, memory_order_relaxed)) !=
+          -1) {
+    atomic_store_explicit(&hostinfo->dirfdused, true, memory_order_relaxed);
+    return fd;
+  }
+  atomic_fetch_add_explicit(&hostinfo->dirfdpins, -1, memory_order_release);
+  return -1;
+}
+
+// Releases a handle returned by HostfsGetOptimalDirFdName().
+static void HostfsPutDirFd(struct HostfsInfo *pinned) {
+  if (!pinned) return;
+  atomic_fetch_add_explicit(&pinned->dirfdpins, -1, memory_order_release);
+}
+
+// Picks a handle to close, giving those used since the last sweep a
+// second chance, since lookups don't reorder the list.
+// @assume g_hostfsstate.lock
+static int HostfsEvictDirFd(void) {
+  int fd, pins, pass;
+  struct Dll *e;
+  struct HostfsInfo *hostinfo;
+  for (pass = 0; pass < 2; ++pass) {
+    for (e = dll_last(g_hostfsstate.dirfds); e;
+         e = dll_prev(g_hostfsstate.dirfds, e)) {
+      hostinfo = HOSTFS_INFO_CONTAINER(e);
+      if (atomic_exchange_explicit(&hostinfo->dirfdused, false,
+                                   memory_order_relaxed)) {
+        continue;
+      }
+      pins = 0;
+      if (atomic_compare_exchange_strong_explicit(
+              &hostinfo->dirfdpins, &pins, kHostfsDirFdEvicting,
+              memory_order_acquire, memory_order_relaxed)) {
+        fd = atomic_load_explicit(&hostinfo->dirfd, memory_order_relaxed);
+        atomic_store_explicit(&hostinfo->dirfd, -1, memory_order_relaxed);
+        atomic_store_explicit(&hostinfo->dirfduses, 0, memory_order_relaxed);
+        atomic_fetch_add_explicit(&hostinfo->dirfdpins, -kHostfsDirFdEvicting,
+                                  memory_order_release);
+        dll_remove(&g_hostfsstate.dirfds, e);
+        --g_hostfsstate.ndirfds;
+        return fd;
+      }
+    }
+  }
+  return -1;
+}
+
+// Attaches a freshly opened handle to `dir` and pins it, unless another
+// thread raced us to it, in which case theirs is used instead.
+static int HostfsCacheDirFd(struct VfsInfo *dir, int fd,
+                            struct HostfsInfo **pinned) {
+  int dirfd, evicted = -1;
+  struct HostfsInfo *hostinfo;
+  hostinfo = (struct HostfsInfo *)dir->data;
+  LOCK(&g_hostfsstate.lock);
+  if (atomic_load_explicit(&hostinfo->dirfd, memory_order_relaxed) == -1) {
+    atomic_store_explicit(&hostinfo->dirfd, fd, memory_order_relaxed);
+    dll_make_first(&g_hostfsstate.dirfds, &hostinfo->elem);
+    fd = -1;
+  }
+  unassert((dirfd = HostfsPinDirFd(hostinfo)) != -1);
+  if (fd == -1 && ++g_hostfsstate.ndirfds > kHostfsDirFds) {
+    evicted = HostfsEvictDirFd();
+  }
+  UNLOCK(&g_hostfsstate.lock);
+  if (fd != -1) unassert(!close(fd));
+  if (evicted != -1) unassert(!close(evicted));
+  *pinned = hostinfo;
+  return dirfd;
+}
+
+static ssize_t HostfsAppendName(char hostpath[VFS_PATH_MAX], ssize_t len,
+                                const char *name) {
+  size_t namelen;
+  namelen = strlen(name);
+  if (namelen && len && hostpath[len - 1] != '/') {
+    if (len + 1 >= VFS_PATH_MAX) {
+      return enametoolong();
+    }
+    hostpath[len++] = '/';
+  }
+  if (len + namelen >= VFS_PATH_MAX) {
+    return enametoolong();
+  }
+  memcpy(hostpath + len, name, namelen + 1);
+  return len + namelen;
+}
+
+// Finds a host directory handle and a path relative to it, for `name`
+// inside `dir`. The handle is the one `dir` was opened with, or the one
+// cached on `dir` or its nearest ancestor, falling back to an absolute
+// path. A cached handle is pinned, and `*pinned` is set to its owner so
+// it can be passed to HostfsPutDirFd(); otherwise `*pinned` is NULL.
 static ssize_t HostfsGetOptimalDirFdName(struct VfsInfo *dir, const char *name,
                                          int *hostfd,
+                                         struct HostfsInfo **pinned,
                                          char hostpath[VFS_PATH_MAX]) {
   struct VfsInfo *currentdir;
+  struct HostfsInfo *hostinfo;
   struct HostfsDevice *hostdevice;
-  int ret = -1;
-  ssize_t len1, len2;
-  VFS_LOGF("HostfsGetOptimalDirFdName(%p, \"%s\", %p, %p)", dir, name, hostfd,
-           hostpath);
+  bool wantdirfd, owndirfd;
+  ssize_t len;
+  int fd;
+  VFS_LOGF("HostfsGetOptimalDirFdName(%p, \"%s\", %p, %p, %p)", dir, name,
+           hostfd, pinned, hostpath);
+  *pinned = NULL;
   if (!S_ISDIR(dir->mode)) {
     enotdir();
     return -1;
   }
-  currentdir = dir;
   if (!strcmp(name, "/")) {
     name = ".";
   }
-  while (currentdir && currentdir->dev == dir->dev) {
-    if (currentdir->data &&
-        ((struct HostfsInfo *)currentdir->data)->filefd != -1) {
-      *hostfd = ((struct HostfsInfo *)currentdir->data)->filefd;
-      if (dir != currentdir) {
-        if ((len1 = VfsPathBuild(dir, currentdir, false, hostpath)) == -1) {
-          ret = -1;
-        }
-        len2 = strlen(name);
-        if (hostpath[len1 - 1] == '/') {
-          --len1;
-        }
-        if (len1 + 1 + len2 >= VFS_PATH_MAX) {
-          ret = enametoolong();
-        } else {
-          hostpath[len1] = '/';
-          memcpy(hostpath + len1 + 1, name, len2);
-          hostpath[len1 + 1 + len2] = '\0';
-          ret = len1 + 1 + len2;
-        }
+  *hostfd = AT_FDCWD;
+  owndirfd = false;
+  hostinfo = (struct HostfsInfo *)dir->data;
+  wantdirfd =
+      hostinfo && hostinfo->filefd == -1 &&
+      atomic_load_explicit(&hostinfo->dirfd, memory_order_relaxed) == -1 &&
+      atomic_fetch_add_explicit(&hostinfo->dirfduses, 1,
+                                memory_order_relaxed) > 0;
+  for (currentdir = dir; currentdir && currentdir->dev == dir->dev;
+       currentdir = currentdir->parent) {
+    if ((hostinfo = (struct HostfsInfo *)currentdir->data)) {
+      if (hostinfo->filefd != -1) {
+        *hostfd = hostinfo->filefd;
         break;
-      } else {
-        len1 = strlen(name);
-        if (len1 >= VFS_PATH_MAX) {
-          ret = enametoolong();
-        } else {
-          memcpy(hostpath, name, len1 + 1);
-          ret = len1;
-        }
+      }
+      if ((fd = HostfsPinDirFd(hostinfo)) != -1) {
+        *hostfd = fd;
+        *pinned = hostinfo;
+        owndirfd = currentdir == dir;
         break;
       }
     }
-    currentdir = currentdir->parent;
   }
-  if (ret == -1 && (!currentdir || currentdir->dev != dir->dev)) {
-    *hostfd = AT_FDCWD;
-    if ((len1 = VfsPathBuild(dir, dir->device->root, true, hostpath)) == -1) {
-      ret = -1;
+  if (*hostfd != AT_FDCWD) {
+    if (currentdir == dir) {
+      len = 0;
     } else {
-      len2 = strlen(name);
-      hostdevice = (struct HostfsDevice *)dir->device->data;
-      ret = hostdevice->sourcelen + len1 +
-            // add a slash if the host path doesn't end with one
-            ((len2 == 0) ? 0 : len2 + (hostpath[len1 - 1] != '/'));
-      if (ret + 1 >= VFS_PATH_MAX) {
-        ret = enametoolong();
+      len = VfsPathBuild(dir, currentdir, false, hostpath);
+    }
+  } else {
+    hostdevice = (struct HostfsDevice *)dir->device->data;
+    if ((len = VfsPathBuild(dir, dir->device->root, true, hostpath)) != -1) {
+      if (hostdevice->sourcelen + len >= VFS_PATH_MAX) {
+        len = enametoolong();
       } else {
-        memmove(hostpath + hostdevice->sourcelen, hostpath, len1);
+        memmove(hostpath + hostdevice->sourcelen, hostpath, len);
         memcpy(hostpath, hostdevice->source, hostdevice->sourcelen);
-        if (len2 != 0) {
-          if (hostpath[hostdevice->sourcelen + len1 - 1] != '/') {
-            hostpath[hostdevice->sourcelen + len1] = '/';
-            ++len1;
-          }
-          memcpy(hostpath + hostdevice->sourcelen + len1, name, len2 + 1);
-        }
-        hostpath[ret] = '\0';
+        len += hostdevice->sourcelen;
       }
     }
   }
-  VFS_LOGF("HostfsGetOptimalDirFdName: output=\"%s\"", hostpath);
-  return ret;
+  if (len == -1) {
+    HostfsPutDirFd(*pinned);
+    *pinned = NULL;
+    return -1;
+  }
+  hostpath[len] = '\0';
+  if (wantdirfd && len) {
+    VFS_LOGF("HostfsGetOptimalDirFdName: openat(%d, \"%s\")", *hostfd,
+             hostpath);
+    if ((fd = openat(*hostfd, hostpath, HOSTFS_DIRFD_FLAGS)) != -1) {
+      HostfsPutDirFd(*pinned);
+      *hostfd = HostfsCacheDirFd(dir, fd, pinned);
+      owndirfd = true;
+      len = 0;
+      hostpath[0] = '\0';
+    }
+  }
+  if (owndirfd && !*name) {
+    name = ".";  // unlike paths, a bare directory handle needs a name
+  }
+  if ((len = HostfsAppendName(hostpath, len, name)) == -1) {
+    HostfsPutDirFd(*pinned);
+    *pinned = NULL;
+    return -1;
+  }
+  VFS_LOGF("HostfsGetOptimalDirFdName: hostfd=%d, output=\"%s\"", *hostfd,
+           hostpath);
+  return len;
 }
 
 int HostfsFinddir(struct VfsInfo *parent, const char *name,
@@ -315,6 +502,7 @@ int HostfsFinddir(struct VfsInfo *parent, const char *name,
   struct HostfsInfo *outputinfo;
   struct stat st;
   int hostfd;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsFinddir(%p, \"%s\", %p)", parent, name, output);
   if (parent == NULL || name == NULL || output == NULL) {
@@ -327,15 +515,18 @@ int HostfsFinddir(struct VfsInfo *parent, const char *name,
   }
   *output = NULL;
   outputinfo = NULL;
-  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
   if (fstatat(hostfd, hostname, &st, AT_SYMLINK_NOFOLLOW) == -1) {
     VFS_LOGF("HostfsFinddir: fstatat(%d, \"%s\", %p, AT_SYMLINK_NOFOLLOW) "
              "failed (%d)",
              hostfd, hostname, &st, errno);
+    HostfsPutDirFd(pinned);
     goto cleananddie;
   }
+  HostfsPutDirFd(pinned);
   if (HostfsCreateInfo(&outputinfo) == -1) {
     goto cleananddie;
   }
@@ -368,29 +559,42 @@ cleananddie:
   return -1;
 }
 
+static ssize_t HostfsGetTraversalDirFd(struct VfsInfo *dir, int *hostfd,
+                                       struct HostfsInfo **pinned,
+                                       char hostpath[VFS_PATH_MAX]) {
+  ssize_t len;
+  if ((len = HostfsGetOptimalDirFdName(dir, "", hostfd, pinned, hostpath)) ==
+      -1) {
+    return -1;
+  }
+  if (len > 0 && hostpath[len - 1] != '/') {
+    if (len + 1 >= VFS_PATH_MAX) {
+      HostfsPutDirFd(*pinned);
+      return enametoolong();
+    }
+    hostpath[len] = '/';
+    ++len;
+  }
+  VFS_LOGF("HostfsTraverse: hostpath=\"%s\", hostfd=%d", hostpath, *hostfd);
+  return len;
+}
+
 int HostfsTraverse(struct VfsInfo **dir, const char **path,
                    struct VfsInfo *root) {
   char hostpath[VFS_PATH_MAX];
   struct VfsInfo *next, *original;
-  struct HostfsInfo *nexthost;
+  struct HostfsInfo *nexthost, *pinned;
   const char *currentpath = *path, *nextpath;
   struct stat st;
   ssize_t hostpathlen, currentnamelen;
+  int hostfd, depth;
   u32 currentdev;
-  int hostfd;
   VFS_LOGF("HostfsTraverse(%s, \"%s\", %p)", (*dir)->name, *path, root);
-  if ((hostpathlen = HostfsGetOptimalDirFdName(*dir, "", &hostfd, hostpath)) ==
-      -1) {
+  if ((hostpathlen =
+           HostfsGetTraversalDirFd(*dir, &hostfd, &pinned, hostpath)) == -1) {
     return -1;
   }
-  if (hostpathlen > 0 && hostpath[hostpathlen - 1] != '/') {
-    if (hostpathlen + 1 >= VFS_PATH_MAX) {
-      return enametoolong();
-    }
-    hostpath[hostpathlen] = '/';
-    ++hostpathlen;
-  }
-  VFS_LOGF("HostfsTraverse: hostpath=\"%s\", hostfd=%d", hostpath, hostfd);
+  depth = 0;
   original = *dir;
   next = NULL;
   nexthost = NULL;
@@ -415,18 +619,29 @@ int HostfsTraverse(struct VfsInfo **dir, const char **path,
         continue;
       }
       unassert(!VfsAcquireInfo((*dir)->parent, &next));
+      if (!depth) {
+        // leaving the directory hostpath is relative to
+        HostfsPutDirFd(pinned);
+        hostfd = AT_FDCWD;
+        pinned = NULL;
+      }
       unassert(!VfsFreeInfo(*dir));
       *dir = next;
       if (next->dev != currentdev) {
+        HostfsPutDirFd(pinned);
         *path = currentpath;
         return 0;
       }
-      if (hostpathlen > 0) {
+      if (depth) {
+        --depth;
         --hostpathlen;
         while (hostpathlen > 0 && hostpath[hostpathlen - 1] != '/') {
           --hostpathlen;
         }
         hostpath[hostpathlen] = '\0';
+      } else if ((hostpathlen = HostfsGetTraversalDirFd(
+                      *dir, &hostfd, &pinned, hostpath)) == -1) {
+        return -1;
       }
       continue;
     }
@@ -444,6 +659,7 @@ int HostfsTraverse(struct VfsInfo **dir, const char **path,
     VFS_LOGF("HostfsTraverse: fstatat(%d, \"%s\", %p, AT_SYMLINK_NOFOLLOW)",
              hostfd, hostpath, &st);
     if (fstatat(hostfd, hostpath, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+      HostfsPutDirFd(pinned);
       if (original != *dir) {
         *path = currentpath;
         return 0;
@@ -454,6 +670,7 @@ int HostfsTraverse(struct VfsInfo **dir, const char **path,
     hostpath[hostpathlen + currentnamelen] = '/';
     hostpath[hostpathlen + currentnamelen + 1] = '\0';
     hostpathlen += currentnamelen + 1;
+    ++depth;
     if (HostfsCreateInfo(&nexthost) == -1) {
       goto cleananddie;
     }
@@ -486,9 +703,11 @@ int HostfsTraverse(struct VfsInfo **dir, const char **path,
       break;
     }
   }
+  HostfsPutDirFd(pinned);
   *path = currentpath;
   return 0;
 cleananddie:
+  HostfsPutDirFd(pinned);
   while (original != *dir) {
     unassert(!VfsAcquireInfo((*dir)->parent, &next));
     unassert(!VfsFreeInfo(*dir));
@@ -558,23 +777,31 @@ cleananddie:
 }
 
 int HostfsMkdir(struct VfsInfo *parent, const char *name, mode_t mode) {
-  int hostfd;
+  int hostfd, ret;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsMkdir(%p, \"%s\", %d)", parent, name, mode);
-  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
-  return mkdirat(hostfd, hostname, mode);
+  ret = mkdirat(hostfd, hostname, mode);
+  HostfsPutDirFd(pinned);
+  return ret;
 }
 
 int HostfsMkfifo(struct VfsInfo *parent, const char *name, mode_t mode) {
-  int hostfd;
+  int hostfd, ret;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsMkfifo(%p, \"%s\", %d)", parent, name, mode);
-  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
-  return mkfifoat(hostfd, hostname, mode);
+  ret = mkfifoat(hostfd, hostname, mode);
+  HostfsPutDirFd(pinned);
+  return ret;
 }
 
 int HostfsOpen(struct VfsInfo *parent, const char *name, int flags, int mode,
@@ -582,6 +809,7 @@ int HostfsOpen(struct VfsInfo *parent, const char *name, int flags, int mode,
   struct HostfsInfo *outputinfo;
   struct stat st;
   int hostfd;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsOpen(%p, \"%s\", %d, %d, %p)", parent, name, flags, mode,
            output);
@@ -593,15 +821,18 @@ int HostfsOpen(struct VfsInfo *parent, const char *name, int flags, int mode,
   }
   *output = NULL;
   outputinfo = NULL;
-  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
   if (HostfsCreateInfo(&outputinfo) == -1) {
-    goto cleananddie;
+    HostfsPutDirFd(pinned);
+    return -1;
   }
   outputinfo->filefd = openat(hostfd, hostname, flags, mode);
   VFS_LOGF("HostfsOpen: openat(%d, \"%s\", %d, %d) -> %d, %s", hostfd, hostname,
            flags, mode, outputinfo->filefd, strerror(errno));
+  HostfsPutDirFd(pinned);
   if (outputinfo->filefd == -1) {
     goto cleananddie;
   }
@@ -636,24 +867,31 @@ cleananddie:
 
 int HostfsAccess(struct VfsInfo *parent, const char *name, mode_t mode,
                  int flags) {
-  int hostfd;
+  int hostfd, ret;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsAccess(%p, \"%s\", %d, %d)", parent, name, mode, flags);
-  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
-  return faccessat(hostfd, hostname, mode, flags);
+  ret = faccessat(hostfd, hostname, mode, flags);
+  HostfsPutDirFd(pinned);
+  return ret;
 }
 
 int HostfsStat(struct VfsInfo *parent, const char *name, struct stat *st,
                int flags) {
   int hostfd, ret;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsStat(%p, \"%s\", %p, %d)", parent, name, st, flags);
-  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
   ret = fstatat(hostfd, hostname, st, flags);
+  HostfsPutDirFd(pinned);
   if (ret != -1) {
     st->st_ino =
         HostfsHash(st->st_dev, (const char *)&st->st_ino, sizeof(st->st_ino));
@@ -681,13 +919,17 @@ int HostfsFstat(struct VfsInfo *info, struct stat *st) {
 
 int HostfsChmod(struct VfsInfo *parent, const char *name, mode_t mode,
                 int flags) {
-  int hostfd;
+  int hostfd, ret;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsChmod(%p, \"%s\", %d)", parent, name, mode);
-  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
-  return fchmodat(hostfd, hostname, mode, flags);
+  ret = fchmodat(hostfd, hostname, mode, flags);
+  HostfsPutDirFd(pinned);
+  return ret;
 }
 
 int HostfsFchmod(struct VfsInfo *info, mode_t mode) {
@@ -702,13 +944,17 @@ int HostfsFchmod(struct VfsInfo *info, mode_t mode) {
 
 int HostfsChown(struct VfsInfo *parent, const char *name, uid_t uid, gid_t gid,
                 int flags) {
-  int hostfd;
+  int hostfd, ret;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsChown(%p, \"%s\", %d, %d)", parent, name, uid, gid);
-  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
-  return fchownat(hostfd, hostname, uid, gid, flags);
+  ret = fchownat(hostfd, hostname, uid, gid, flags);
+  HostfsPutDirFd(pinned);
+  return ret;
 }
 
 int HostfsFchown(struct VfsInfo *info, uid_t uid, gid_t gid) {
@@ -746,29 +992,38 @@ int HostfsClose(struct VfsInfo *info) {
 
 int HostfsLink(struct VfsInfo *oldparent, const char *oldname,
                struct VfsInfo *newparent, const char *newname, int flags) {
-  int oldhostfd, newhostfd;
+  int oldhostfd, newhostfd, ret;
+  struct HostfsInfo *oldpinned, *newpinned;
   char oldhostname[VFS_PATH_MAX], newhostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsLink(%p, \"%s\", %p, \"%s\")", oldparent, oldname, newparent,
            newname);
-  if (HostfsGetOptimalDirFdName(oldparent, oldname, &oldhostfd, oldhostname) ==
-      -1) {
+  if (HostfsGetOptimalDirFdName(oldparent, oldname, &oldhostfd, &oldpinned,
+                                oldhostname) == -1) {
     return -1;
   }
-  if (HostfsGetOptimalDirFdName(newparent, newname, &newhostfd, newhostname) ==
-      -1) {
+  if (HostfsGetOptimalDirFdName(newparent, newname, &newhostfd, &newpinned,
+                                newhostname) == -1) {
+    HostfsPutDirFd(oldpinned);
     return -1;
   }
-  return linkat(oldhostfd, oldhostname, newhostfd, newhostname, flags);
+  ret = linkat(oldhostfd, oldhostname, newhostfd, newhostname, flags);
+  HostfsPutDirFd(newpinned);
+  HostfsPutDirFd(oldpinned);
+  return ret;
 }
 
 int HostfsUnlink(struct VfsInfo *parent, const char *name, int flags) {
-  int hostfd;
+  int hostfd, ret;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsUnlink(%p, \"%s\")", parent, name);
-  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(parent, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
-  return unlinkat(hostfd, hostname, flags);
+  ret = unlinkat(hostfd, hostname, flags);
+  HostfsPutDirFd(pinned);
+  return ret;
 }
 
 ssize_t HostfsRead(struct VfsInfo *info, void *buf, size_t size) {
@@ -890,6 +1145,30 @@ int HostfsFdatasync(struct VfsInfo *info) {
 #endif
 }
 
+#ifdef HAVE_FALLOCATE
+int HostfsFallocate(struct VfsInfo *info, int mode, off_t offset, off_t len) {
+  struct HostfsInfo *hostinfo;
+  VFS_LOGF("HostfsFallocate(%p, %d, %ld, %ld)", info, mode, offset, len);
+  if (info == NULL) {
+    return efault();
+  }
+  hostinfo = (struct HostfsInfo *)info->data;
+  return fallocate(hostinfo->filefd, mode, offset, len);
+}
+#endif
+
+#ifdef HAVE_POSIX_FADVISE
+int HostfsFadvise(struct VfsInfo *info, off_t offset, off_t len, int advice) {
+  struct HostfsInfo *hostinfo;
+  VFS_LOGF("HostfsFadvise(%p, %ld, %ld, %d)", info, offset, len, advice);
+  if (info == NULL) {
+    return EFAULT;
+  }
+  hostinfo = (struct HostfsInfo *)info->data;
+  return posix_fadvise(hostinfo->filefd, offset, len, advice);
+}
+#endif
+
 int HostfsFlock(struct VfsInfo *info, int operation) {
   struct HostfsInfo *hostinfo;
   VFS_LOGF("HostfsFlock(%p, %d)", info, operation);
@@ -996,6 +1275,7 @@ int HostfsDup(struct VfsInfo *info, struct VfsInfo **newinfo) {
     goto cleananddie;
   }
   newhostinfo->mode = hostinfo->mode;
+  newhostinfo->chrdev = hostinfo->chrdev;
   if (S_ISSOCK(hostinfo->mode) && hostinfo->socketaddr != NULL) {
     newhostinfo->socketaddr =
         (struct sockaddr *)malloc(hostinfo->socketaddrlen);
@@ -1053,6 +1333,7 @@ int HostfsDup3(struct VfsInfo *info, struct VfsInfo **newinfo, int flags) {
   if (newhostinfo->filefd == -1) {
     goto cleananddie;
   }
+  newhostinfo->chrdev = hostinfo->chrdev;
   if (VfsCreateInfo(newinfo) == -1) {
     goto cleananddie;
   }
@@ -1544,30 +1825,38 @@ int HostfsGetpeername(struct VfsInfo *info, struct sockaddr *addr,
 
 int HostfsRename(struct VfsInfo *oldinfo, const char *oldname,
                  struct VfsInfo *newinfo, const char *newname) {
-  int oldhostfd, newhostfd;
+  int oldhostfd, newhostfd, ret;
+  struct HostfsInfo *oldpinned, *newpinned;
   char oldhostname[VFS_PATH_MAX], newhostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsRename(%p, %s, %p, %s)", oldinfo, oldname, newinfo, newname);
-  if (HostfsGetOptimalDirFdName(oldinfo, oldname, &oldhostfd, oldhostname) ==
-      -1) {
+  if (HostfsGetOptimalDirFdName(oldinfo, oldname, &oldhostfd, &oldpinned,
+                                oldhostname) == -1) {
     return -1;
   }
-  if (HostfsGetOptimalDirFdName(newinfo, newname, &newhostfd, newhostname) ==
-      -1) {
-    unassert(!close(oldhostfd));
+  if (HostfsGetOptimalDirFdName(newinfo, newname, &newhostfd, &newpinned,
+                                newhostname) == -1) {
+    HostfsPutDirFd(oldpinned);
     return -1;
   }
-  return renameat(oldhostfd, oldhostname, newhostfd, newhostname);
+  ret = renameat(oldhostfd, oldhostname, newhostfd, newhostname);
+  HostfsPutDirFd(newpinned);
+  HostfsPutDirFd(oldpinned);
+  return ret;
 }
 
 int HostfsUtime(struct VfsInfo *info, const char *name,
                 const struct timespec times[2], int flags) {
-  int hostfd;
+  int hostfd, ret;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsUtime(%p, %s, %p, %d)", info, name, times, flags);
-  if (HostfsGetOptimalDirFdName(info, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(info, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
-  return utimensat(hostfd, hostname, times, flags);
+  ret = utimensat(hostfd, hostname, times, flags);
+  HostfsPutDirFd(pinned);
+  return ret;
 }
 
 int HostfsFutime(struct VfsInfo *info, const struct timespec times[2]) {
@@ -1584,13 +1873,17 @@ int HostfsFutime(struct VfsInfo *info, const struct timespec times[2]) {
 }
 
 int HostfsSymlink(const char *target, struct VfsInfo *info, const char *name) {
-  int hostfd;
+  int hostfd, ret;
+  struct HostfsInfo *pinned;
   char hostname[VFS_PATH_MAX];
   VFS_LOGF("HostfsSymlink(%s, %p, %s)", target, info, name);
-  if (HostfsGetOptimalDirFdName(info, name, &hostfd, hostname) == -1) {
+  if (HostfsGetOptimalDirFdName(info, name, &hostfd, &pinned, hostname) ==
+      -1) {
     return -1;
   }
-  return symlinkat(target, hostfd, hostname);
+  ret = symlinkat(target, hostfd, hostname);
+  HostfsPutDirFd(pinned);
+  return ret;
 }
 
 void *HostfsMmap(struct VfsInfo *info, void *addr, size_t len, int prot,
@@ -1971,6 +2264,12 @@ struct VfsSystem g_hostfs = {.name = "hostfs",
                                  .Seek = HostfsSeek,
                                  .Fsync = HostfsFsync,
                                  .Fdatasync = HostfsFdatasync,
+#ifdef HAVE_FALLOCATE
+                                 .Fallocate = HostfsFallocate,
+#endif
+#ifdef HAVE_POSIX_FADVISE
+                                 .Fadvise = HostfsFadvise,
+#endif
                                  .Flock = HostfsFlock,
                                  .Fcntl = HostfsFcntl,
                                  .Ioctl = HostfsIoctl,
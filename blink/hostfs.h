@@ -4,11 +4,19 @@
 #include <sys/types.h>
 #include <sys/un.h>
 
+#include "blink/atomic.h"
+#include "blink/dll.h"
 #include "blink/vfs.h"
 
 struct HostfsInfo {
   int mode;
   int filefd;
+  _Atomic(int) dirfd;       // cached handle of directory, or -1
+  _Atomic(int) dirfdpins;   // callers using dirfd, negative while evicting
+  _Atomic(int) dirfduses;   // lookups under directory before it had a dirfd
+  _Atomic(bool) dirfdused;  // pinned since the last eviction sweep
+  int chrdev;               // devfs device served in-process, e.g. DEVFS_ZERO
+  struct Dll elem;
   int socketfamily;
   union {
     DIR *dirstream;
@@ -54,6 +62,12 @@ ssize_t HostfsPwritev(struct VfsInfo *, const struct iovec *, int, off_t);
 off_t HostfsSeek(struct VfsInfo *, off_t, int);
 int HostfsFsync(struct VfsInfo *);
 int HostfsFdatasync(struct VfsInfo *);
+#ifdef HAVE_FALLOCATE
+int HostfsFallocate(struct VfsInfo *, int, off_t, off_t);
+#endif
+#ifdef HAVE_POSIX_FADVISE
+int HostfsFadvise(struct VfsInfo *, off_t, off_t, int);
+#endif
 int HostfsFlock(struct VfsInfo *, int);
 int HostfsFcntl(struct VfsInfo *, int, va_list);
 int HostfsIoctl(struct VfsInfo *, unsigned long, const void *);
@@ -121,5 +135,6 @@ int HostfsFexecve(struct VfsInfo *, char *const *, char *const *);
 int HostfsWrapFd(int fd, bool dodup, struct VfsInfo **output);
 
 extern struct VfsSystem g_hostfs;
+extern struct VfsDevice g_anondevice;
 
 #endif  // BLINK_HOSTFS_H_
@@ -131,6 +131,7 @@ static struct JitGlobals {
   pthread_mutex_t_ lock;
   _Atomic(long) prot;
   int freecount;
+  long brk;
   struct Dll *freeblocks;
 } g_jit = {
     PTHREAD_MUTEX_INITIALIZER_,
@@ -231,20 +232,20 @@ static void pthread_jit_write_protect_np_workaround(int enabled) {
 }
 
 static void *Calloc(size_t nmemb, size_t size) {
-  STATISTIC(++jit_callocs);
+  STATISTIC(++g_stats->jit_callocs);
   return calloc(nmemb, size);
 #define calloc please_use_Calloc
 }
 
 static void *Realloc(void *p, size_t n) {
-  STATISTIC(++jit_reallocs);
+  STATISTIC(++g_stats->jit_reallocs);
   return realloc(p, n);
 #define realloc please_use_Realloc
 }
 
 static void Free(void *ptr) {
   if (!ptr) return;
-  STATISTIC(++jit_frees);
+  STATISTIC(++g_stats->jit_frees);
   free(ptr);
 #define free please_use_Free
 }
@@ -253,11 +254,11 @@ static struct JitJump *NewJitJump(struct Dll **freejumps) {
   struct Dll *e;
   struct JitJump *jj;
   if ((e = dll_first(*freejumps))) {
-    STATISTIC(++jit_jump_alloc_freelist);
+    STATISTIC(++g_stats->jit_jump_alloc_freelist);
     dll_remove(freejumps, e);
     jj = JITJUMP_CONTAINER(e);
   } else if ((jj = (struct JitJump *)Calloc(1, sizeof(struct JitJump)))) {
-    STATISTIC(++jit_jump_alloc_system);
+    STATISTIC(++g_stats->jit_jump_alloc_system);
     dll_init(&jj->elem);
   }
   return jj;
@@ -377,11 +378,11 @@ static struct JitInts *NewInts(struct JitIntsAllocator *jia) {
   struct JitInts *ji;
   struct JitIntsSlab *slab;
   if (jia->i) {
-    STATISTIC(++jit_ints_alloc_freelist);
+    STATISTIC(++g_stats->jit_ints_alloc_freelist);
     return jia->p[--jia->i];
   }
   if ((e = dll_first(jia->slabs))) {
-    STATISTIC(++jit_ints_alloc_slab);
+    STATISTIC(++g_stats->jit_ints_alloc_slab);
     slab = JIASLAB_CONTAINER(e);
     if (slab->i < ARRAYLEN(slab->p)) {
       ji = slab->p + slab->i++;
@@ -391,7 +392,7 @@ static struct JitInts *NewInts(struct JitIntsAllocator *jia) {
     }
   }
   if ((slab = NewJitIntsSlab())) {
-    STATISTIC(++jit_ints_alloc_system);
+    STATISTIC(++g_stats->jit_ints_alloc_system);
     dll_make_first(&jia->slabs, &slab->elem);
     return slab->p + slab->i++;
   }
@@ -703,7 +704,7 @@ static void RetireJitBlock(struct Jit *jit, struct JitBlock *jb) {
   unassert(!jb->isprotected);
   unassert(dll_is_empty(jb->jumps));
   unassert(dll_is_empty(jb->staged));
-  STATISTIC(++jit_blocks_retired);
+  STATISTIC(++g_stats->jit_blocks_retired);
   dll_remove(&jit->blocks, &jb->elem);
   dll_remove(&jit->agedblocks, &jb->aged);
   jb->start = 0;
@@ -740,6 +741,19 @@ static void UnlockJit(struct Jit *jit) {
   }
 }
 
+// jit->edges_lock nests inside jit->lock, never the other way around
+static void LockJitEdges(struct Jit *jit) {
+  if (jit->threaded) {
+    LOCK(&jit->edges_lock);
+  }
+}
+
+static void UnlockJitEdges(struct Jit *jit) {
+  if (jit->threaded) {
+    UNLOCK(&jit->edges_lock);
+  }
+}
+
 /**
  * Initializes memory object for Just-In-Time (JIT) threader.
  *
@@ -766,15 +780,22 @@ int InitJit(struct Jit *jit, uintptr_t opt_staging_function) {
   InitEdges(&jit->redges);
   jit->staging = EncodeJitFunc(opt_staging_function);
   unassert(!pthread_mutex_init(&jit->lock, 0));
+  unassert(!pthread_mutex_init(&jit->edges_lock, 0));
   jit->hooks.n = n = RoundupTwoPow(kJitInitialHooks);
   unassert(virts = (_Atomic(uintptr_t) *)Calloc(n, sizeof(*virts)));
   unassert(funcs = (_Atomic(int) *)Calloc(n, sizeof(*funcs)));
   atomic_store_explicit(&jit->hooks.virts, virts, memory_order_relaxed);
   atomic_store_explicit(&jit->hooks.funcs, funcs, memory_order_relaxed);
-  for (brk = 0; (jb = InitJitBlock(jit, &brk));) {
+  // jit memory is carved into blocks only once per process; when the
+  // jit of a previous execve() image was destroyed, its blocks are in
+  // the global freelist already and will be picked up from there
+  LOCK(&g_jit.lock);
+  for (brk = g_jit.brk; (jb = InitJitBlock(jit, &brk));) {
     dll_make_last(&g_jit.freeblocks, &jb->elem);
     ++g_jit.freecount;
   }
+  g_jit.brk = brk;
+  UNLOCK(&g_jit.lock);
   JIT_LOGF("initialized jit %p", jit);
   return 0;
 }
@@ -808,11 +829,13 @@ int DestroyJit(struct Jit *jit) {
     FreeJitPage(JITPAGE_CONTAINER(e));
   }
   UnlockJit(jit);
+  unassert(!pthread_mutex_destroy(&jit->edges_lock));
   unassert(!pthread_mutex_destroy(&jit->lock));
   DestroyEdges(&jit->redges);
   DestroyEdges(&jit->edges);
   Free(jit->hooks.funcs);
   Free(jit->hooks.virts);
+  Free(jit->pending);
   return 0;
 }
 
@@ -828,6 +851,7 @@ int ShutdownJit(void) {
     --g_jit.freecount;
   }
   unassert(!g_jit.freecount);
+  g_jit.brk = 0;
   return 0;
 }
 
@@ -875,9 +899,9 @@ static struct JitPage *GetJitPage(struct Jit *jit, i64 addr) {
     jp = JITPAGE_CONTAINER(e);
     if (jp->page == page) {
       if (!lru) {
-        STATISTIC(++jit_pages_hits_1);
+        STATISTIC(++g_stats->jit_pages_hits_1);
       } else {
-        STATISTIC(++jit_pages_hits_2);
+        STATISTIC(++g_stats->jit_pages_hits_2);
         dll_remove(&jit->pages, e);
         dll_make_first(&jit->pages, e);
       }
@@ -1040,9 +1064,9 @@ static bool SetJitHookUnlocked(struct Jit *jit, u64 virt, int cas,
   oldfunc = atomic_load_explicit(funcs + spot, memory_order_relaxed);
   if (jit->staging) {
     if (func == jit->staging) {
-      STATISTIC(++jit_hooks_staged);
+      STATISTIC(++g_stats->jit_hooks_staged);
       if (key && oldfunc != jit->staging) {
-        STATISTIC(++jit_hooks_deleted);
+        STATISTIC(++g_stats->jit_hooks_deleted);
       }
     } else {
       if (key && cas && oldfunc != cas) {
@@ -1050,22 +1074,23 @@ static bool SetJitHookUnlocked(struct Jit *jit, u64 virt, int cas,
         // then some other thread must have won the race to install this
         return false;
       }
-      STATISTIC(--jit_hooks_staged);
+      STATISTIC(--g_stats->jit_hooks_staged);
       if (func) {
-        STATISTIC(++jit_hooks_installed);
+        STATISTIC(++g_stats->jit_hooks_installed);
       }
     }
   } else {
     if (key && oldfunc) {
-      STATISTIC(++jit_hooks_deleted);
+      STATISTIC(++g_stats->jit_hooks_deleted);
     }
     if (func) {
-      STATISTIC(++jit_hooks_installed);
+      STATISTIC(++g_stats->jit_hooks_installed);
     }
   }
   if (!key) {
     ++jit->hooks.i;
-    STATISTIC(jit_hash_elements = MAX(jit_hash_elements, jit->hooks.i));
+    STATISTIC(g_stats->jit_hash_elements =
+                  MAX(g_stats->jit_hash_elements, jit->hooks.i));
   }
   if (func && (jp = GetOrCreateJitPage(jit, virt))) {
     jp->bitset |= (u64)1 << ((virt & 4095) >> 6);
@@ -1085,20 +1110,13 @@ static bool SetJitHook(struct Jit *jit, u64 virt, int cas, intptr_t funcaddr) {
   return res;
 }
 
-/**
- * Retrieves native function for executing virtual address.
- *
- * @param jit is the System's Jit object
- * @param virt is the hash table key, or virtual address of path start
- * @return native function address, or 0 if it doesn't exist
- */
-uintptr_t GetJitHook(struct Jit *jit, u64 virt) {
+static uintptr_t LookupJitHook(struct Jit *jit, u64 virt) {
   int off;
   uintptr_t key, res;
   _Atomic(int) *funcs;
   _Atomic(uintptr_t) *virts;
   unsigned n, kgen, hash, spot, step;
-  COSTLY_STATISTIC(++jit_hash_lookups);
+  COSTLY_STATISTIC(++g_stats->jit_hash_lookups);
   hash = HASH(virt);
   do {
     kgen = atomic_load_explicit(&jit->keygen, memory_order_relaxed);
@@ -1116,14 +1134,14 @@ uintptr_t GetJitHook(struct Jit *jit, u64 virt) {
       if (!key) {
         return 0;
       }
-      COSTLY_STATISTIC(++jit_hash_collisions);
+      COSTLY_STATISTIC(++g_stats->jit_hash_collisions);
     }
   } while (ShallNotPass(kgen, &jit->keygen));
   return res;
 }
 
 // removes hook and edges for jit path and all paths that depend on it
-// @assume jit->lock
+// @assume jit->lock and jit->edges_lock
 static void DeleteJitPath(struct Jit *jit, i64 virt) {
   i64 dep;
   uintptr_t key;
@@ -1146,10 +1164,10 @@ static void DeleteJitPath(struct Jit *jit, i64 virt) {
       if (old) {
         atomic_store_explicit(funcs + spot, 0, memory_order_release);
         if (old == jit->staging) {
-          STATISTIC(--jit_hooks_staged);
+          STATISTIC(--g_stats->jit_hooks_staged);
         } else {
-          STATISTIC(--jit_hooks_installed);
-          STATISTIC(++jit_hooks_deleted);
+          STATISTIC(--g_stats->jit_hooks_installed);
+          STATISTIC(++g_stats->jit_hooks_deleted);
         }
       }
       break;
@@ -1171,13 +1189,13 @@ static void DeleteJitPath(struct Jit *jit, i64 virt) {
   }
 }
 
-// @assume jit->lock
+// @assume jit->lock and jit->edges_lock
 static void ResetJitPageHooks(struct Jit *jit, i64 page) {
   i64 virt;
   unsigned i, boff;
   struct JitPage *jp;
   if (!(jp = GetJitPage(jit, page))) return;
-  STATISTIC(AVERAGE(jit_page_average_bits, popcount(jp->bitset)));
+  STATISTIC(AVERAGE(g_stats->jit_page_average_bits, popcount(jp->bitset)));
   while (jp->bitset) {
     boff = bsr(jp->bitset);
     virt = page + boff * (4096 / 64);
@@ -1195,10 +1213,12 @@ static int ResetJitPageUnlocked(struct Jit *jit, i64 virt) {
   i64 page;
   unsigned gen;
   page = virt & -4096;
-  STATISTIC(++jit_page_resets);
+  STATISTIC(++g_stats->jit_page_resets);
   JIT_LOGF("resetting jit page %#" PRIx64, page);
   gen = BeginUpdate(&jit->pagegen);
+  LockJitEdges(jit);
   ResetJitPageHooks(jit, page);
+  UnlockJitEdges(jit);
   dll_make_first(&jit->freejumps, jit->jumps);
   jit->jumps = 0;
   EndUpdate(&jit->pagegen, gen);
@@ -1224,6 +1244,266 @@ int ResetJitPage(struct Jit *jit, i64 virt) {
   return res;
 }
 
+static u64 ReadJitTail(const u8 *p, long n) {
+  u64 x = 0;
+  while (n--) x = x << 8 | p[n];
+  return x;
+}
+
+/**
+ * Hashes content of memory page.
+ *
+ * @param n is number of bytes at `p` that can be read, which is less
+ *     than 4096 if the page extends past the end of a mapped file
+ * @return nonzero hash
+ */
+u64 HashJitPage(const u8 *p, long n) {
+  long i;
+  u64 h = n;
+  for (i = 0; i < n; i += 8) {
+    h = (h ^ (n - i >= 8 ? Read64(p + i) : ReadJitTail(p + i, n - i))) *
+        0x9e3779b97f4a7c15;
+    h ^= h >> 29;
+  }
+  return h | 1;
+}
+
+/**
+ * Records content hashes of memory pages that have JIT paths.
+ *
+ * This is intended to be called on the jit of an image that's about to
+ * be replaced by execve(), before its memory is unmapped, so the paths
+ * can be vetted later on by RevalidateJitPages().
+ *
+ * @param hashpage returns HashJitPage() of executable 4096-byte page,
+ *     or zero if its content shouldn't be trusted
+ * @return 0 on success
+ */
+int HashJitPages(struct Jit *jit, u64 hashpage(void *, i64), void *arg) {
+  struct Dll *e;
+  struct JitPage *jp;
+  LockJit(jit);
+  for (e = dll_first(jit->pages); e; e = dll_next(jit->pages, e)) {
+    jp = JITPAGE_CONTAINER(e);
+    // a page still awaiting validation from an earlier execve() might
+    // hold paths for different bytes, so hashing it now would be a lie
+    jp->hash = jp->hash ? 0 : hashpage(arg, jp->page);
+  }
+  UnlockJit(jit);
+  return 0;
+}
+
+// pages awaiting validation are kept in an open addressed set, which
+// is created by RevalidateJitPages() and only ever shrinks afterwards
+#define kJitPendingFree 0
+#define kJitPendingGone 2  // never equal to a key, since keys are odd
+
+static _Atomic(u64) *FindJitPending(struct Jit *jit, i64 page) {
+  u64 key;
+  unsigned i;
+  for (i = (u64)page >> 12;; ++i) {
+    i &= jit->npending - 1;
+    key = atomic_load_explicit(jit->pending + i, memory_order_acquire);
+    if (key == ((u64)page | 1)) return jit->pending + i;
+    if (key == kJitPendingFree) return 0;
+  }
+}
+
+static bool IsJitPagePending(struct Jit *jit, i64 page) {
+  return atomic_load_explicit(&jit->pendings, memory_order_acquire) &&
+         FindJitPending(jit, page);
+}
+
+// forgets that `page` needs validation, once it's validated or gone
+// @assume jit->lock
+static void ClearJitPending(struct Jit *jit, i64 page) {
+  struct JitPage *jp;
+  _Atomic(u64) *slot;
+  if (!jit->npending || !(slot = FindJitPending(jit, page))) return;
+  if ((jp = GetJitPage(jit, page)) && jp->hash) return;
+  atomic_store_explicit(slot, kJitPendingGone, memory_order_release);
+  atomic_store_explicit(
+      &jit->pendings,
+      atomic_load_explicit(&jit->pendings, memory_order_relaxed) - 1,
+      memory_order_release);
+}
+
+static bool PushJitPage(i64 **todo, long *n, long *cap, i64 page) {
+  i64 *p2;
+  if (*n == *cap) {
+    if (!(p2 = (i64 *)Realloc(*todo, (*cap * 2 + 8) * sizeof(*p2)))) {
+      return false;
+    }
+    *todo = p2;
+    *cap = *cap * 2 + 8;
+  }
+  (*todo)[(*n)++] = page;
+  return true;
+}
+
+// adds pending pages that paths on `page` jump into without a lookup
+// @assume jit->lock
+static bool AddJitPageTargets(struct Jit *jit, i64 page, i64 **todo,
+                              long *n, long *cap) {
+  int i, j;
+  u64 bits;
+  i64 virt, dst;
+  bool ok = true;
+  struct JitInts *dsts;
+  struct JitPage *jp, *jp2;
+  if (!(jp = GetJitPage(jit, page))) return true;
+  LockJitEdges(jit);
+  for (bits = jp->bitset; bits && ok; bits &= bits - 1) {
+    virt = page + bsf(bits) * (4096 / 64);
+    for (i = 0; i < 64 && ok; ++i) {
+      if (!(dsts = jit->edges.dst[GetEdge(&jit->edges, virt + i)])) continue;
+      for (j = 0; j < dsts->i && ok; ++j) {
+        dst = dsts->p[j] & -4096;
+        if (dst != page && (jp2 = GetJitPage(jit, dst)) && jp2->hash) {
+          ok = PushJitPage(todo, n, cap, dst);
+        }
+      }
+    }
+  }
+  UnlockJitEdges(jit);
+  return ok;
+}
+
+// Checks a page whose paths were inherited from the previous image.
+// Pages its paths jump into are checked too, since those jumps don't
+// go through GetJitHook(), and the pages only stop being pending once
+// all of them were checked, so other threads can't enter them early.
+static void ValidateJitPage(struct Jit *jit, i64 page) {
+  int kept = 0;
+  struct JitPage *jp;
+  i64 *todo = 0;
+  long i, n = 0, cap = 0;
+  LockJit(jit);
+  if (PushJitPage(&todo, &n, &cap, page)) {
+    for (i = 0; i < n; ++i) {
+      if (!(jp = GetJitPage(jit, todo[i])) || !jp->hash) continue;
+      if (jit->hashpage(jit->hashpagearg, todo[i]) == jp->hash) {
+        jp->hash = 0;
+        if (AddJitPageTargets(jit, todo[i], &todo, &n, &cap)) {
+          ++kept;
+          continue;
+        }
+      }
+      ResetJitPageUnlocked(jit, todo[i]);
+    }
+    for (i = 0; i < n; ++i) {
+      ClearJitPending(jit, todo[i]);
+    }
+  } else {
+    ResetJitPageUnlocked(jit, page);
+    ClearJitPending(jit, page);
+  }
+  UnlockJit(jit);
+  Free(todo);
+  JIT_LOGF("kept %d of %ld jit pages", kept, n);
+}
+
+/**
+ * Defers clearing JIT paths whose page content changed since the call
+ * to HashJitPages().
+ *
+ * Paths survive only if the same bytes are executable at the same
+ * address, e.g. when a shared object got mapped again by execve(), or
+ * by the dynamic linker later on. Since the latter doesn't happen until
+ * after execve() returns, each page is checked the first time one of
+ * its hooks is looked up.
+ *
+ * @param hashpage returns HashJitPage() of executable 4096-byte page,
+ *     or zero if its content shouldn't be trusted; it may be called
+ *     with the jit lock held by any thread
+ * @return number of pages awaiting validation
+ */
+int RevalidateJitPages(struct Jit *jit, u64 hashpage(void *, i64),
+                       void *arg) {
+  unsigned i, n, gen;
+  int pending = 0;
+  struct Dll *e, *e2;
+  struct JitPage *jp;
+  LockJit(jit);
+  jit->hashpage = hashpage;
+  jit->hashpagearg = arg;
+  Free(jit->pending);
+  for (n = 0, e = dll_first(jit->pages); e; e = dll_next(jit->pages, e)) ++n;
+  jit->npending = n = RoundupTwoPow(n * 2 + 1);
+  jit->pending = (_Atomic(u64) *)Calloc(n, sizeof(*jit->pending));
+  for (e = dll_first(jit->pages); e; e = e2) {
+    e2 = dll_next(jit->pages, e);
+    jp = JITPAGE_CONTAINER(e);
+    if (jp->hash && jit->pending) {
+      for (i = (u64)jp->page >> 12;; ++i) {
+        i &= n - 1;
+        if (!jit->pending[i]) {
+          jit->pending[i] = (u64)jp->page | 1;
+          break;
+        }
+      }
+      ++pending;
+    } else {
+      ResetJitPageUnlocked(jit, jp->page);
+    }
+  }
+  if (!jit->pending) jit->npending = 0;
+  atomic_store_explicit(&jit->pendings, pending, memory_order_release);
+  // staged paths and pending jumps are dropped, since their pages may
+  // not have been hashed; bumping the generation prevents publishing
+  gen = BeginUpdate(&jit->pagegen);
+  dll_make_first(&jit->freejumps, jit->jumps);
+  jit->jumps = 0;
+  EndUpdate(&jit->pagegen, gen);
+  UnlockJit(jit);
+  JIT_LOGF("deferred validation of %d jit pages", pending);
+  return pending;
+}
+
+/**
+ * Retrieves native function for executing virtual address.
+ *
+ * @param jit is the System's Jit object
+ * @param virt is the hash table key, or virtual address of path start
+ * @return native function address, or 0 if it doesn't exist
+ */
+uintptr_t GetJitHook(struct Jit *jit, u64 virt) {
+  uintptr_t res;
+  if ((res = LookupJitHook(jit, virt)) && IsJitPagePending(jit, virt & -4096)) {
+    ValidateJitPage(jit, virt & -4096);
+    res = LookupJitHook(jit, virt);
+  }
+  return res;
+}
+
+/**
+ * Exchanges the translated code of two JIT objects.
+ *
+ * This lets a new image inherit the JIT memory and hook tables of the
+ * previous one upon execve(). The mutexes and the disabled state stay
+ * with their objects. Neither object may be in use by other threads.
+ *
+ * @return 0 on success
+ */
+int SwapJit(struct Jit *a, struct Jit *b) {
+  bool disabled;
+  struct Jit t;
+  pthread_mutex_t_ lock, edges_lock;
+  memcpy(&t, a, sizeof(t));
+  memcpy(a, b, sizeof(*a));
+  memcpy(b, &t, sizeof(*b));
+  memcpy(&lock, &a->lock, sizeof(lock));
+  memcpy(&edges_lock, &a->edges_lock, sizeof(edges_lock));
+  memcpy(&a->lock, &b->lock, sizeof(lock));
+  memcpy(&a->edges_lock, &b->edges_lock, sizeof(edges_lock));
+  memcpy(&b->lock, &lock, sizeof(lock));
+  memcpy(&b->edges_lock, &edges_lock, sizeof(edges_lock));
+  disabled = atomic_load_explicit(&a->disabled, memory_order_relaxed);
+  atomic_store_explicit(&a->disabled, b->disabled, memory_order_relaxed);
+  atomic_store_explicit(&b->disabled, disabled, memory_order_relaxed);
+  return 0;
+}
+
 // @assume jit->lock
 static void ForceJitBlocksToRetire(struct Jit *jit) {
   int i;
@@ -1252,8 +1532,10 @@ static void ForceJitBlocksToRetire(struct Jit *jit) {
     }
   }
   jit->hooks.i = 0;
+  LockJitEdges(jit);
   ClearEdges(&jit->redges);
   ClearEdges(&jit->edges);
+  UnlockJitEdges(jit);
   EndUpdate(&jit->pagegen, pgen);
 }
 
@@ -1342,22 +1624,25 @@ struct JitBlock *StartJit(struct Jit *jit, i64 opt_virt) {
     if (jb) {
       dll_make_first(&jb->freejumps, jit->freejumps);
       jit->freejumps = 0;
+      // stage the hook while we still hold the lock, so that leasing a
+      // block only costs a single lock acquisition per generated path
+      jb->virt = opt_virt;
+      jb->pagegen = atomic_load_explicit(&jit->pagegen, memory_order_acquire);
+      if (jb->virt && jit->staging) {
+        unassert(SetJitHookUnlocked(jit, jb->virt, 0,
+                                    DecodeJitFunc(jit->staging)));
+      } else {
+        JIT_LOGF("marking jit block %p as protected due to manual mode", jb);
+        jb->isprotected = true;
+      }
     }
     UnlockJit(jit);
   } else {
     jb = 0;
   }
   if (jb) {
-    jb->virt = opt_virt;
     unassert(!(jb->start & (kJitAlign - 1)));
     unassert(jb->start == jb->index);
-    jb->pagegen = atomic_load_explicit(&jit->pagegen, memory_order_acquire);
-    if (jb->virt && jit->staging) {
-      unassert(SetJitHook(jit, jb->virt, 0, DecodeJitFunc(jit->staging)));
-    } else {
-      JIT_LOGF("marking jit block %p as protected due to manual mode", jb);
-      jb->isprotected = true;
-    }
     if (pthread_jit_write_protect_supported_np()) {
       pthread_jit_write_protect_np_workaround(false);
     }
@@ -1389,10 +1674,10 @@ inline bool AppendJit(struct JitBlock *jb, const void *data, long size) {
   }
 }
 
+// @assume jit->lock
 static struct Dll *GetJitJumps(struct Jit *jit, struct JitBlock *jb, u64 virt) {
   struct JitJump *jj;
   struct Dll *res, *rem, *e, *e2;
-  LockJit(jit);
   for (rem = res = 0, e = dll_first(jit->jumps); e; e = e2) {
     e2 = dll_next(jit->jumps, e);
     jj = JITJUMP_CONTAINER(e);
@@ -1404,7 +1689,6 @@ static struct Dll *GetJitJumps(struct Jit *jit, struct JitBlock *jb, u64 virt) {
       dll_make_first(&rem, e);
     }
   }
-  UnlockJit(jit);
   dll_make_first(&jb->freejumps, rem);
   return res;
 }
@@ -1420,8 +1704,8 @@ static void FixupJitJumps(struct JitBlock *jb, struct Dll *list,
   struct Dll *e;
   struct JitJump *jj;
   for (e = dll_first(list); e; e = dll_next(list, e)) {
-    STATISTIC(++jumps_applied);
-    STATISTIC(++path_connected_directly);
+    STATISTIC(++g_stats->jumps_applied);
+    STATISTIC(++g_stats->path_connected_directly);
     jj = JITJUMP_CONTAINER(e);
     u.q = 0;
     n = MakeJitJump(u.b, (uintptr_t)jj->code, addr + jj->addend);
@@ -1444,12 +1728,14 @@ static void FixupJitJumps(struct JitBlock *jb, struct Dll *list,
   dll_make_first(&jb->freejumps, list);
 }
 
-static bool UpdateJitHook(struct Jit *jit, struct JitBlock *jb, u64 virt,
-                          uintptr_t funcaddr) {
+// publishes hook and links any jumps that were waiting on this path
+// @assume jit->lock
+static bool UpdateJitHookUnlocked(struct Jit *jit, struct JitBlock *jb,
+                                  u64 virt, uintptr_t funcaddr) {
   struct Dll *jumps;
   unassert(funcaddr);
   jumps = GetJitJumps(jit, jb, virt);
-  if (SetJitHook(jit, virt, jit->staging, funcaddr)) {
+  if (SetJitHookUnlocked(jit, virt, jit->staging, funcaddr)) {
     FixupJitJumps(jb, jumps, funcaddr);
     return true;
   } else {
@@ -1458,6 +1744,15 @@ static bool UpdateJitHook(struct Jit *jit, struct JitBlock *jb, u64 virt,
   }
 }
 
+static bool UpdateJitHook(struct Jit *jit, struct JitBlock *jb, u64 virt,
+                          uintptr_t funcaddr) {
+  bool res;
+  LockJit(jit);
+  res = UpdateJitHookUnlocked(jit, jb, virt, funcaddr);
+  UnlockJit(jit);
+  return res;
+}
+
 static void AbandonJitHook(struct Jit *jit, u64 virt) {
   if (virt && jit->staging) {
     SetJitHook(jit, virt, 0, 0);
@@ -1541,11 +1836,16 @@ void ReinsertJitBlock_(struct Jit *jit, struct JitBlock *jb) {
 }
 
 // append our list of code fixups to jit system which may apply it later
+// @assume jit->lock
+static void CommitJitJumpsUnlocked(struct Jit *jit, struct JitBlock *jb) {
+  dll_make_first(&jit->jumps, jb->jumps);
+  jb->jumps = 0;
+}
+
 static void CommitJitJumps(struct Jit *jit, struct JitBlock *jb) {
   if (!dll_is_empty(jb->jumps)) {
     LockJit(jit);
-    dll_make_first(&jit->jumps, jb->jumps);
-    jb->jumps = 0;
+    CommitJitJumpsUnlocked(jit, jb);
     UnlockJit(jit);
   }
 }
@@ -1585,17 +1885,17 @@ bool RecordJitJump(struct JitBlock *jb, u64 virt, int addend) {
   jj->code = (u8 *)GetJitPc(jb);
   jj->addend = addend;
   dll_make_first(&jb->jumps, &jj->elem);
-  STATISTIC(++jumps_recorded);
+  STATISTIC(++g_stats->jumps_recorded);
   return true;
 }
 
-// @assume jit->lock
+// @assume jit->edges_lock
 static bool RecordJitEdgeImpl(struct Jit *jit, i64 src, i64 dst) {
   i64 visits[kJitDepth];
   if (src == dst) return false;
   visits[0] = src;
   if (IsCyclic(&jit->edges, visits, 1, dst)) {
-    STATISTIC(++jit_cycles_avoided);
+    STATISTIC(++g_stats->jit_cycles_avoided);
     return false;
   }
   if (!AddEdge(&jit->edges, src, dst)) {
@@ -1613,9 +1913,9 @@ static bool RecordJitEdgeImpl(struct Jit *jit, i64 src, i64 dst) {
  */
 bool RecordJitEdge(struct Jit *jit, i64 src, i64 dst) {
   bool res;
-  LockJit(jit);
+  LockJitEdges(jit);
   res = RecordJitEdgeImpl(jit, src, dst);
-  UnlockJit(jit);
+  UnlockJitEdges(jit);
   return res;
 }
 
@@ -1638,8 +1938,8 @@ static void DiscardGeneratedJitCode(struct JitBlock *jb) {
  *     case the caller should simply try again
  */
 bool FinishJit(struct Jit *jit, struct JitBlock *jb) {
-  bool ok;
   u8 *addr;
+  bool ok, locked;
   struct JitStage *js;
   unassert(jb->index > jb->start);
   unassert(jb->start >= jb->committed);
@@ -1652,6 +1952,7 @@ bool FinishJit(struct Jit *jit, struct JitBlock *jb) {
     unassert(AppendJitTrap(jb));
     unassert(jb->index <= kJitBlockSize);
   }
+  locked = false;
   if (jb->index <= kJitBlockSize) {
     // function code was generated successfully
     if (jb->virt) {
@@ -1661,10 +1962,15 @@ bool FinishJit(struct Jit *jit, struct JitBlock *jb) {
         // operating system permits us to use rwx memory
         addr = jb->addr + jb->start;
         sys_icache_invalidate(addr, jb->index - jb->start);
-        if (!UpdateJitHook(jit, jb, jb->virt, (uintptr_t)addr)) {
+        // publishing the hook, linking jumps, and giving the block back
+        // all happen within a single critical section
+        LockJit(jit);
+        if (!UpdateJitHookUnlocked(jit, jb, jb->virt, (uintptr_t)addr)) {
           // we lost race with another thread creating path at same addr
+          UnlockJit(jit);
           return AbandonJit(jit, jb);
         }
+        locked = true;
       } else if ((js = NewJitStage())) {
         // updating hook must be deferred until we've filled system page
         // with code and then change its permission: mprotect(rwx -> rx)
@@ -1677,19 +1983,23 @@ bool FinishJit(struct Jit *jit, struct JitBlock *jb) {
     } else {
       JIT_LOGF("finishing manual mode jit path in block %p", jb);
     }
-    CommitJitJumps(jit, jb);
+    if (locked) {
+      CommitJitJumpsUnlocked(jit, jb);
+    } else {
+      CommitJitJumps(jit, jb);
+    }
     // mark the generated jit memory as having been used
     // if there's only a tiny bit left we advance to end
     if (jb->index + kJitFit > kJitBlockSize) {
       JIT_LOGF("ending jit block %p due to pretty good fit", jb);
-      STATISTIC(AVERAGE(jit_average_block, jb->index));
+      STATISTIC(AVERAGE(g_stats->jit_average_block, jb->index));
       jb->index = kJitBlockSize;
     }
     jb->start = jb->index;
     ok = true;
   } else {
     // we ran out of jit memory in block while generating the function
-    STATISTIC(++path_ooms);
+    STATISTIC(++g_stats->path_ooms);
     AbandonJitJumps(jb);
     if (jb->index - jb->start < (kJitBlockSize >> 1)) {
       // we ran out of block space when trying to create a path that's
@@ -1711,8 +2021,10 @@ bool FinishJit(struct Jit *jit, struct JitBlock *jb) {
     ok = false;
   }
   unassert(jb->start == jb->index);
-  CommitJit_(jit, jb);
-  LockJit(jit);
+  if (!locked) {
+    CommitJit_(jit, jb);
+    LockJit(jit);
+  }
   ReinsertJitBlock_(jit, jb);
   if (jb->index >= kJitBlockSize) {
     dll_make_first(&jit->freejumps, jb->freejumps);
@@ -1733,7 +2045,7 @@ bool FinishJit(struct Jit *jit, struct JitBlock *jb) {
  */
 bool AbandonJit(struct Jit *jit, struct JitBlock *jb) {
   JIT_LOGF("abandoning jit path in block %p at %#" PRIx64, jb, jb->virt);
-  STATISTIC(++path_abandoned);
+  STATISTIC(++g_stats->path_abandoned);
   AbandonJitJumps(jb);
   AbandonJitHook(jit, jb->virt);
   DiscardGeneratedJitCode(jb);
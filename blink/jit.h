@@ -164,6 +164,7 @@ struct JitFreeds {
 
 struct JitPage {
   i64 page;
+  u64 hash;
   u64 bitset;
   struct Dll elem;
 };
@@ -205,7 +206,13 @@ struct Jit {
   struct Dll *jumps;
   struct Dll *freejumps;
   struct Dll *pages;
+  u64 (*hashpage)(void *, i64);
+  void *hashpagearg;
+  unsigned npending;
+  _Atomic(unsigned) pendings;
+  _Atomic(u64) *pending;
   pthread_mutex_t_ lock;
+  pthread_mutex_t_ edges_lock;
   _Alignas(kSemSize) _Atomic(unsigned) keygen;
   _Alignas(kSemSize) _Atomic(unsigned) pagegen;
 };
@@ -239,6 +246,10 @@ bool RecordJitJump(struct JitBlock *, u64, int);
 bool RecordJitEdge(struct Jit *, i64, i64);
 uintptr_t GetJitHook(struct Jit *, u64);
 int ResetJitPage(struct Jit *, i64);
+int SwapJit(struct Jit *, struct Jit *);
+u64 HashJitPage(const u8 *, long);
+int HashJitPages(struct Jit *, u64 (*)(void *, i64), void *);
+int RevalidateJitPages(struct Jit *, u64 (*)(void *, i64), void *);
 
 int CommitJit_(struct Jit *, struct JitBlock *);
 void ReinsertJitBlock_(struct Jit *, struct JitBlock *);
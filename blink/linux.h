@@ -105,6 +105,36 @@
 #define AT_SYMLINK_FOLLOW_LINUX   0x0400
 #define AT_NO_AUTOMOUNT_LINUX     0x0800
 #define AT_EMPTY_PATH_LINUX       0x1000
+#define AT_STATX_SYNC_TYPE_LINUX  0x6000
+
+#define STATX_TYPE_LINUX        0x0001
+#define STATX_MODE_LINUX        0x0002
+#define STATX_NLINK_LINUX       0x0004
+#define STATX_UID_LINUX         0x0008
+#define STATX_GID_LINUX         0x0010
+#define STATX_ATIME_LINUX       0x0020
+#define STATX_MTIME_LINUX       0x0040
+#define STATX_CTIME_LINUX       0x0080
+#define STATX_INO_LINUX         0x0100
+#define STATX_SIZE_LINUX        0x0200
+#define STATX_BLOCKS_LINUX      0x0400
+#define STATX_BASIC_STATS_LINUX 0x07ff
+#define STATX_RESERVED_LINUX    0x80000000u
+
+#define FALLOC_FL_KEEP_SIZE_LINUX      0x01
+#define FALLOC_FL_PUNCH_HOLE_LINUX     0x02
+#define FALLOC_FL_NO_HIDE_STALE_LINUX  0x04
+#define FALLOC_FL_COLLAPSE_RANGE_LINUX 0x08
+#define FALLOC_FL_ZERO_RANGE_LINUX     0x10
+#define FALLOC_FL_INSERT_RANGE_LINUX   0x20
+#define FALLOC_FL_UNSHARE_RANGE_LINUX  0x40
+
+#define POSIX_FADV_NORMAL_LINUX     0
+#define POSIX_FADV_RANDOM_LINUX     1
+#define POSIX_FADV_SEQUENTIAL_LINUX 2
+#define POSIX_FADV_WILLNEED_LINUX   3
+#define POSIX_FADV_DONTNEED_LINUX   4
+#define POSIX_FADV_NOREUSE_LINUX    5
 
 #define O_RDONLY_LINUX  0
 #define O_WRONLY_LINUX  1
@@ -159,6 +189,21 @@
 #define F_OWNER_PID_LINUX     1
 #define F_OWNER_PGRP_LINUX    2
 
+#define F_ADD_SEALS_LINUX         1033
+#define F_GET_SEALS_LINUX         1034
+#define F_SEAL_SEAL_LINUX         0x0001
+#define F_SEAL_SHRINK_LINUX       0x0002
+#define F_SEAL_GROW_LINUX         0x0004
+#define F_SEAL_WRITE_LINUX        0x0008
+#define F_SEAL_FUTURE_WRITE_LINUX 0x0010
+#define F_SEAL_EXEC_LINUX         0x0020
+
+#define MFD_CLOEXEC_LINUX       0x0001
+#define MFD_ALLOW_SEALING_LINUX 0x0002
+#define MFD_HUGETLB_LINUX       0x0004
+#define MFD_NOEXEC_SEAL_LINUX   0x0008
+#define MFD_EXEC_LINUX          0x0010
+
 #define SOCK_CLOEXEC_LINUX  O_CLOEXEC_LINUX
 #define SOCK_NONBLOCK_LINUX O_NDELAY_LINUX
 
@@ -838,6 +883,101 @@
 
 #define EPOLL_CLOEXEC_LINUX O_CLOEXEC_LINUX
 
+#define EFD_SEMAPHORE_LINUX 1
+#define EFD_CLOEXEC_LINUX   O_CLOEXEC_LINUX
+#define EFD_NONBLOCK_LINUX  O_NDELAY_LINUX
+
+#define TFD_CLOEXEC_LINUX             O_CLOEXEC_LINUX
+#define TFD_NONBLOCK_LINUX            O_NDELAY_LINUX
+#define TFD_TIMER_ABSTIME_LINUX       1
+#define TFD_TIMER_CANCEL_ON_SET_LINUX 2
+
+#define SFD_CLOEXEC_LINUX  O_CLOEXEC_LINUX
+#define SFD_NONBLOCK_LINUX O_NDELAY_LINUX
+
+#define SPLICE_F_MOVE_LINUX     1
+#define SPLICE_F_NONBLOCK_LINUX 2
+#define SPLICE_F_MORE_LINUX     4
+#define SPLICE_F_GIFT_LINUX     8
+
+#define IORING_SETUP_IOPOLL_LINUX        0x0001
+#define IORING_SETUP_SQPOLL_LINUX        0x0002
+#define IORING_SETUP_SQ_AFF_LINUX        0x0004
+#define IORING_SETUP_CQSIZE_LINUX        0x0008
+#define IORING_SETUP_CLAMP_LINUX         0x0010
+#define IORING_SETUP_ATTACH_WQ_LINUX     0x0020
+#define IORING_SETUP_R_DISABLED_LINUX    0x0040
+#define IORING_SETUP_SUBMIT_ALL_LINUX    0x0080
+#define IORING_SETUP_COOP_TASKRUN_LINUX  0x0100
+#define IORING_SETUP_TASKRUN_FLAG_LINUX  0x0200
+#define IORING_SETUP_SINGLE_ISSUER_LINUX 0x1000
+#define IORING_SETUP_DEFER_TASKRUN_LINUX 0x2000
+
+#define IORING_FEAT_SINGLE_MMAP_LINUX   0x0001
+#define IORING_FEAT_NODROP_LINUX        0x0002
+#define IORING_FEAT_SUBMIT_STABLE_LINUX 0x0004
+#define IORING_FEAT_RW_CUR_POS_LINUX    0x0008
+#define IORING_FEAT_EXT_ARG_LINUX       0x0100
+
+#define IORING_OFF_SQ_RING_LINUX 0x00000000
+#define IORING_OFF_CQ_RING_LINUX 0x08000000
+#define IORING_OFF_SQES_LINUX    0x10000000
+
+#define IORING_ENTER_GETEVENTS_LINUX 1
+#define IORING_ENTER_SQ_WAKEUP_LINUX 2
+#define IORING_ENTER_SQ_WAIT_LINUX   4
+#define IORING_ENTER_EXT_ARG_LINUX   8
+
+#define IORING_MAX_ENTRIES_LINUX    32768
+#define IORING_MAX_CQ_ENTRIES_LINUX 65536
+
+#define IOSQE_FIXED_FILE_LINUX       0x01
+#define IOSQE_IO_DRAIN_LINUX         0x02
+#define IOSQE_IO_LINK_LINUX          0x04
+#define IOSQE_IO_HARDLINK_LINUX      0x08
+#define IOSQE_ASYNC_LINUX            0x10
+#define IOSQE_BUFFER_SELECT_LINUX    0x20
+#define IOSQE_CQE_SKIP_SUCCESS_LINUX 0x40
+
+#define IORING_OP_NOP_LINUX            0
+#define IORING_OP_READV_LINUX          1
+#define IORING_OP_WRITEV_LINUX         2
+#define IORING_OP_FSYNC_LINUX          3
+#define IORING_OP_READ_FIXED_LINUX     4
+#define IORING_OP_WRITE_FIXED_LINUX    5
+#define IORING_OP_POLL_ADD_LINUX       6
+#define IORING_OP_POLL_REMOVE_LINUX    7
+#define IORING_OP_SENDMSG_LINUX        9
+#define IORING_OP_RECVMSG_LINUX        10
+#define IORING_OP_TIMEOUT_LINUX        11
+#define IORING_OP_TIMEOUT_REMOVE_LINUX 12
+#define IORING_OP_ACCEPT_LINUX         13
+#define IORING_OP_ASYNC_CANCEL_LINUX   14
+#define IORING_OP_CONNECT_LINUX        16
+#define IORING_OP_OPENAT_LINUX         18
+#define IORING_OP_CLOSE_LINUX          19
+#define IORING_OP_READ_LINUX           22
+#define IORING_OP_WRITE_LINUX          23
+#define IORING_OP_SEND_LINUX           26
+#define IORING_OP_RECV_LINUX           27
+#define IORING_OP_SHUTDOWN_LINUX       34
+#define IORING_OP_LAST_LINUX           35
+
+#define IORING_FSYNC_DATASYNC_LINUX   1
+#define IORING_TIMEOUT_ABS_LINUX      1
+#define IORING_TIMEOUT_REALTIME_LINUX 8
+
+#define IORING_REGISTER_BUFFERS_LINUX       0
+#define IORING_UNREGISTER_BUFFERS_LINUX     1
+#define IORING_REGISTER_FILES_LINUX         2
+#define IORING_UNREGISTER_FILES_LINUX       3
+#define IORING_REGISTER_EVENTFD_LINUX       4
+#define IORING_UNREGISTER_EVENTFD_LINUX     5
+#define IORING_REGISTER_FILES_UPDATE_LINUX  6
+#define IORING_REGISTER_EVENTFD_ASYNC_LINUX 7
+#define IORING_REGISTER_PROBE_LINUX         8
+#define IO_URING_OP_SUPPORTED_LINUX         1
+
 #define EPOLL_CTL_ADD_LINUX 1
 #define EPOLL_CTL_DEL_LINUX 2
 #define EPOLL_CTL_MOD_LINUX 3
@@ -987,11 +1127,74 @@ struct stat_linux {
   struct timespec_linux ctim;
 };
 
+struct statx_timestamp_linux {
+  u8 sec[8];
+  u8 nsec[4];
+  u8 pad_[4];
+};
+
+struct statx_linux {
+  u8 mask[4];         // STATX_XXX bits of fields which are filled in
+  u8 blksize[4];      // preferred i/o block size
+  u8 attributes[8];   // STATX_ATTR_XXX flags
+  u8 nlink[4];        // number of hard links
+  u8 uid[4];          // user id of owner
+  u8 gid[4];          // group id of owner
+  u8 mode[2];         // file type and mode
+  u8 pad0_[2];        //
+  u8 ino[8];          // inode number
+  u8 size[8];         // byte length of file
+  u8 blocks[8];       // number of 512-byte blocks allocated
+  u8 attributes_mask[8];
+  struct statx_timestamp_linux atime;
+  struct statx_timestamp_linux btime;
+  struct statx_timestamp_linux ctime;
+  struct statx_timestamp_linux mtime;
+  u8 rdev_major[4];
+  u8 rdev_minor[4];
+  u8 dev_major[4];
+  u8 dev_minor[4];
+  u8 mnt_id[8];
+  u8 dio_mem_align[4];
+  u8 dio_offset_align[4];
+  u8 spare_[96];
+};
+
 struct itimerval_linux {
   struct timeval_linux interval;
   struct timeval_linux value;
 };
 
+struct itimerspec_linux {
+  struct timespec_linux interval;
+  struct timespec_linux value;
+};
+
+struct signalfd_siginfo_linux {
+  u8 signo[4];
+  u8 errno_[4];
+  u8 code[4];
+  u8 pid[4];
+  u8 uid[4];
+  u8 fd[4];
+  u8 tid[4];
+  u8 band[4];
+  u8 overrun[4];
+  u8 trapno[4];
+  u8 status[4];
+  u8 int_[4];
+  u8 ptr[8];
+  u8 utime[8];
+  u8 stime[8];
+  u8 addr[8];
+  u8 addr_lsb[2];
+  u8 __pad2[2];
+  u8 syscall[4];
+  u8 call_addr[8];
+  u8 arch[4];
+  u8 __pad[28];
+};
+
 struct rusage_linux {
   struct timeval_linux utime;
   struct timeval_linux stime;
@@ -1278,6 +1481,93 @@ struct epoll_event_linux {
   u8 data[8];
 };
 
+struct io_sqring_offsets_linux {
+  u8 head[4];
+  u8 tail[4];
+  u8 ring_mask[4];
+  u8 ring_entries[4];
+  u8 flags[4];
+  u8 dropped[4];
+  u8 array[4];
+  u8 resv1[4];
+  u8 user_addr[8];
+};
+
+struct io_cqring_offsets_linux {
+  u8 head[4];
+  u8 tail[4];
+  u8 ring_mask[4];
+  u8 ring_entries[4];
+  u8 overflow[4];
+  u8 cqes[4];
+  u8 flags[4];
+  u8 resv1[4];
+  u8 user_addr[8];
+};
+
+struct io_uring_params_linux {
+  u8 sq_entries[4];
+  u8 cq_entries[4];
+  u8 flags[4];
+  u8 sq_thread_cpu[4];
+  u8 sq_thread_idle[4];
+  u8 features[4];
+  u8 wq_fd[4];
+  u8 resv[3][4];
+  struct io_sqring_offsets_linux sq_off;
+  struct io_cqring_offsets_linux cq_off;
+};
+
+struct io_uring_sqe_linux {
+  u8 opcode;
+  u8 flags;          // IOSQE_XXX
+  u8 ioprio[2];
+  u8 fd[4];          // i32
+  u8 off[8];         // u64 file offset, or addr2
+  u8 addr[8];        // u64 buffer, iovec, pathname, etc.
+  u8 len[4];         // u32 buffer size, iovec count, mode, etc.
+  u8 op_flags[4];    // u32 rw_flags, poll32_events, open_flags, etc.
+  u8 user_data[8];   // u64 copied into the completion
+  u8 buf_index[2];
+  u8 personality[2];
+  u8 file_index[4];
+  u8 addr3[8];
+  u8 pad_[8];
+};
+
+struct io_uring_cqe_linux {
+  u8 user_data[8];
+  u8 res[4];
+  u8 flags[4];
+};
+
+struct io_uring_getevents_arg_linux {
+  u8 sigmask[8];
+  u8 sigmask_sz[4];
+  u8 pad_[4];
+  u8 ts[8];
+};
+
+struct io_uring_files_update_linux {
+  u8 offset[4];
+  u8 resv[4];
+  u8 fds[8];
+};
+
+struct io_uring_probe_op_linux {
+  u8 op;
+  u8 resv;
+  u8 flags[2];
+  u8 resv2[4];
+};
+
+struct io_uring_probe_linux {
+  u8 last_op;
+  u8 ops_len;
+  u8 resv[2];
+  u8 resv2[3][4];
+};
+
 int sysinfo_linux(struct sysinfo_linux *);
 
 #endif /* BLINK_LINUX_H_ */
@@ -237,10 +237,53 @@ static void OpXchgZvqp(P) {
   WriteRegister(rde, RegRexbSrm(m, rde), x);
 }
 
+#if defined(__x86_64__) && !defined(__SANITIZE_UNDEFINED__)
+#define HAVE_CAS16
+static bool Cas16(u8 *p, u64 *a, u64 *d, u64 b, u64 c) {
+  bool ok;
+  asm volatile("lock cmpxchg16b\t%1\n\t"
+               "sete\t%0"
+               : "=q"(ok), "+m"(*(u8(*)[16])p), "+a"(*a), "+d"(*d)
+               : "b"(b), "c"(c)
+               : "memory");
+  return ok;
+}
+#elif defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HAVE_CAS16
+static bool Cas16(u8 *p, u64 *a, u64 *d, u64 b, u64 c) {
+  unsigned __int128 x, z;
+  x = (unsigned __int128)*d << 64 | *a;
+  z = __sync_val_compare_and_swap((unsigned __int128 *)p, x,
+                                  (unsigned __int128)c << 64 | b);
+  *a = z;
+  *d = z >> 64;
+  return z == x;
+}
+#endif
+
 static void OpCmpxchg8b(P) {
   uint8_t *p;
   uint32_t d, a;
   p = GetModrmRegisterXmmPointerRead8(A);
+#if CAN_64BIT
+  if (Lock(rde) && !((uintptr_t)p & 7)) {
+    u64 x;
+    x = Little64((u64)Read32(m->dx) << 32 | Read32(m->ax));
+    if (atomic_compare_exchange_strong_explicit(
+            (_Atomic(u64) *)p, &x,
+            Little64((u64)Read32(m->cx) << 32 | Read32(m->bx)),
+            memory_order_acq_rel, memory_order_acquire)) {
+      m->flags = SetFlag(m->flags, FLAGS_ZF, true);
+    } else {
+      m->flags = SetFlag(m->flags, FLAGS_ZF, false);
+      x = Little64(x);
+      Write32(m->ax, x);
+      Write32(m->dx, x >> 32);
+    }
+    return;
+  }
+#endif
   if (Lock(rde)) LockBus(p);
   a = Read32(p + 0);
   d = Read32(p + 4);
@@ -260,6 +303,21 @@ static void OpCmpxchg16b(P) {
   uint8_t *p;
   uint64_t d, a;
   p = GetModrmRegisterXmmPointerRead16(A);
+#ifdef HAVE_CAS16
+  if (Lock(rde) && !((uintptr_t)p & 15)) {
+    u64 a, d;
+    a = Read64(m->ax);
+    d = Read64(m->dx);
+    if (Cas16(p, &a, &d, Read64(m->bx), Read64(m->cx))) {
+      m->flags = SetFlag(m->flags, FLAGS_ZF, true);
+    } else {
+      m->flags = SetFlag(m->flags, FLAGS_ZF, false);
+      Write64(m->ax, a);
+      Write64(m->dx, d);
+    }
+    return;
+  }
+#endif
   if (Lock(rde)) LockBus(p);
   a = Read64(p + 0);
   d = Read64(p + 8);
@@ -434,7 +492,7 @@ void Connect(P, u64 pc, bool avoid_cycles) {
 #ifdef HAVE_JIT
   void *jump;
   uintptr_t f;
-  STATISTIC(++path_connected_total);
+  STATISTIC(++g_stats->path_connected_total);
   // 1. cyclic paths can block asynchronous sigs & deadlock exit
   // 2. we don't want to stitch together paths on separate pages
   if ((!avoid_cycles && m->path.start == pc) ||
@@ -444,9 +502,9 @@ void Connect(P, u64 pc, bool avoid_cycles) {
         f != (uintptr_t)JitlessDispatch) {
       // tail call into the other generated jit path function
       jump = (u8 *)f + GetPrologueSize();
-      STATISTIC(++path_connected_directly);
+      STATISTIC(++g_stats->path_connected_directly);
     } else {
-      STATISTIC(++path_connected_lazily);
+      STATISTIC(++g_stats->path_connected_lazily);
       // generate assembly to drop back into main interpreter
       // then apply an smc fixup later on, if dest is created
       if (!FLAG_noconnect) {
@@ -456,7 +514,7 @@ void Connect(P, u64 pc, bool avoid_cycles) {
     }
   } else {
     // generate assembly to drop back into main interpreter
-    STATISTIC(++path_connected_interpreter);
+    STATISTIC(++g_stats->path_connected_interpreter);
     jump = (void *)m->system->ender;
   }
   AppendJitJump(m->path.jb, jump);
@@ -468,12 +526,12 @@ static void AluRo(P, const aluop_f ops[4], const aluop_f fops[4]) {
                     ReadRegisterBW(rde, RegLog2(rde) ? RegRexrReg(m, rde)
                                                      : ByteRexrReg(m, rde)));
   if (IsMakingPath(m)) {
-    STATISTIC(++alu_ops);
+    STATISTIC(++g_stats->alu_ops);
     LoadAluArgs(A);
     switch (GetNeededFlags(m, m->ip, CF | ZF | SF | OF | AF | PF)) {
       case 0:
       CASE_ALU_FAST:
-        STATISTIC(++alu_simplified);
+        STATISTIC(++g_stats->alu_simplified);
         Jitter(A,
                "q"   // arg0 = sav0 (machine)
                "m",  // call micro-op
@@ -518,11 +576,11 @@ static void OpAluFlip(P) {
                   op(m, ReadRegisterBW(rde, q),
                      ReadRegisterOrMemoryBW(rde, GetModrmReadBW(A))));
   if (IsMakingPath(m)) {
-    STATISTIC(++alu_ops);
+    STATISTIC(++g_stats->alu_ops);
     LoadAluFlipArgs(A);
     switch (GetNeededFlags(m, m->ip, CF | ZF | SF | OF | AF | PF)) {
       case 0:
-        STATISTIC(++alu_unflagged);
+        STATISTIC(++g_stats->alu_unflagged);
         if (GetFlagDeps(rde)) Jitter(A, "q");  // arg0 = sav0 (machine)
         Jitter(A,
                "m"     // call micro-op
@@ -530,7 +588,7 @@ static void OpAluFlip(P) {
                kJustAlu[(Opcode(rde) & 070) >> 3]);
         break;
       CASE_ALU_FAST:
-        STATISTIC(++alu_simplified);
+        STATISTIC(++g_stats->alu_simplified);
         Jitter(A,
                "q"     // arg0 = sav0 (machine)
                "m"     // call micro-op
@@ -553,12 +611,12 @@ static void OpAluFlipCmp(P) {
   u8 *q = RegLog2(rde) ? RegRexrReg(m, rde) : ByteRexrReg(m, rde);
   op(m, ReadRegisterBW(rde, q), ReadRegisterOrMemoryBW(rde, GetModrmReadBW(A)));
   if (IsMakingPath(m)) {
-    STATISTIC(++alu_ops);
+    STATISTIC(++g_stats->alu_ops);
     LoadAluFlipArgs(A);
     switch (GetNeededFlags(m, m->ip, CF | ZF | SF | OF | AF | PF)) {
       case 0:
       CASE_ALU_FAST:
-        STATISTIC(++alu_simplified);
+        STATISTIC(++g_stats->alu_simplified);
         Jitter(A,
                "q"   // arg0 = sav0 (machine)
                "m",  // call micro-op
@@ -582,7 +640,7 @@ static void OpAluAxImm(P) {
     switch (GetNeededFlags(m, m->ip, CF | ZF | SF | OF | AF | PF)) {
       case 0:
       CASE_ALU_FAST:
-        STATISTIC(++alu_simplified);
+        STATISTIC(++g_stats->alu_simplified);
         Jitter(A,
                "G"      // res0 = %ax
                "r0a1="  // arg1 = res0
@@ -609,11 +667,11 @@ static void OpAluAxImm(P) {
 static void OpRoAxImm(P, const aluop_f ops[4], const aluop_f fops[4]) {
   ops[RegLog2(rde)](m, ReadRegisterBW(rde, m->ax), uimm0);
   if (IsMakingPath(m)) {
-    STATISTIC(++alu_ops);
+    STATISTIC(++g_stats->alu_ops);
     switch (GetNeededFlags(m, m->ip, CF | ZF | SF | OF | AF | PF)) {
       case 0:
       CASE_ALU_FAST:
-        STATISTIC(++alu_simplified);
+        STATISTIC(++g_stats->alu_simplified);
         Jitter(A,
                "G"      // r0 = GetReg(AX)
                "a2i"    // arg2 = uimm0
@@ -693,10 +751,10 @@ static void BsuwiConstant(P, u64 y) {
       case BSU_SHR:
       case BSU_SAL:
       case BSU_SAR:
-        STATISTIC(++alu_ops);
+        STATISTIC(++g_stats->alu_ops);
         if (!GetNeededFlags(m, m->ip, GetFlagClobbers(rde))) {
           if (Rexw(rde) && (y &= 63)) {
-            STATISTIC(++alu_unflagged);
+            STATISTIC(++g_stats->alu_unflagged);
             Jitter(A,
                    "B"     // res0 = GetRegOrMem(RexbRm)
                    "a3i"   // arg3 = shift amount
@@ -708,7 +766,7 @@ static void BsuwiConstant(P, u64 y) {
                    y, kJustBsu[ModrmReg(rde)]);
             return;
           } else if (!Osz(rde) && (y &= 31)) {
-            STATISTIC(++alu_unflagged);
+            STATISTIC(++g_stats->alu_unflagged);
             Jitter(A,
                    "B"     // res0 = GetRegOrMem(RexbRm)
                    "a3i"   // arg3 = shift amount
@@ -2097,7 +2155,7 @@ static bool CanJit(struct Machine *m) {
 void JitlessDispatch(P) {
   ASM_LOGF("decoding [%s] at address %" PRIx64, DescribeOp(m, GetPc(m)),
            GetPc(m));
-  COSTLY_STATISTIC(++instructions_dispatched);
+  COSTLY_STATISTIC(++g_stats->instructions_dispatched);
   LoadInstruction(m, GetPc(m));
   rde = m->xedd->op.rde;
   disp = m->xedd->op.disp;
@@ -2141,7 +2199,7 @@ static void GeneralDispatch(P) {
     // begin adding this op to the jit path
     unassert(opclass == kOpNormal || opclass == kOpBranching);
     ++m->path.elements;
-    STATISTIC(++path_elements);
+    STATISTIC(++g_stats->path_elements);
     AddPath_StartOp(A);
     jitpc = GetJitPc(m->path.jb);
     JIP_LOGF("adding [%s] from address %" PRIx64
@@ -2169,7 +2227,7 @@ static void GeneralDispatch(P) {
       // otherwise generate "one size fits all" assembly code
       AddPath(A);
       AddPath_EndOp(A);
-      STATISTIC(++path_elements_auto);
+      STATISTIC(++g_stats->path_elements_auto);
     }
     if (opclass == kOpBranching) {
       // branches, calls, and jumps always force end of path
@@ -2207,12 +2265,12 @@ void ExecuteInstruction(struct Machine *m) {
                  m->path.start, func, m->ip);
         FlushSkew(DISPATCH_NOTHING);
         AppendJitSetReg(m->path.jb, kJitArg0, kJitSav0);
-        STATISTIC(++path_spliced);
+        STATISTIC(++g_stats->path_spliced);
         if (RecordJitEdge(&m->system->jit, m->path.start, m->ip)) {
           dst = (u8 *)(uintptr_t)func + GetPrologueSize();
-          STATISTIC(++path_connected_directly);
+          STATISTIC(++g_stats->path_connected_directly);
         } else {
-          STATISTIC(++path_connected_interpreter);
+          STATISTIC(++g_stats->path_connected_interpreter);
           dst = (u8 *)m->system->ender;
         }
         AppendJitJump(m->path.jb, dst);
@@ -2239,7 +2297,7 @@ void Actor(struct Machine *mm) {
 #endif
   for (g_machine = mm, m = mm;;) {
 #ifndef __CYGWIN__
-    STATISTIC(++interps);
+    STATISTIC(++g_stats->interps);
 #endif
     if (!atomic_load_explicit(&m->attention, memory_order_acquire)) {
       ExecuteInstruction(m);
@@ -30,6 +30,7 @@
 
 #define kMaxThreadIds 32768
 #define kMinThreadId  262144
+#define kMaxSignalFds 8
 
 #define kInstructionBytes 40
 
@@ -174,9 +175,12 @@ struct PageLocks {
 struct FileMap {
   i64 virt;         // start address of map
   i64 size;         // bytes originally mapped
+  i64 filesz;       // bytes at start of map that exist in file
   u64 pages;        // population count of present
   i64 offset;       // file offset (-1 if descriptive)
-  char *path;       // duplicated (owned) pointer to filename
+  u64 dev;          // host device of file (0 if descriptive)
+  u64 ino;          // host inode of file (0 if descriptive)
+  char *path;       // duplicated (owned) absolute filename
   u64 *present;     // bitset of present pages in [virt,virt+size)
   struct Dll elem;  // see System::filemaps
 };
@@ -247,6 +251,20 @@ struct OpCache {
   u64 icache[512][kInstructionBytes / 8];
 };
 
+struct SignalSender {
+  int code;  // linux si_code
+  int pid;
+  u32 uid;
+};
+
+struct SignalFd {
+  bool used;
+  _Atomic(u64) mask;  // guest signals this signalfd accepts
+  _Atomic(int) wfd;   // [signalfds_lock] socket EnqueueSignal() pokes
+  dev_t dev;          // identifies the guest's end of the socketpair
+  ino_t ino;
+};
+
 struct System {
   struct XedMachineMode mode;
   bool dlab;
@@ -288,6 +306,8 @@ struct System {
   sigset_t exec_sigmask;
   struct sigaction_linux hands[64];
   u64 blinksigs;  // signals blink itself handles
+  struct SignalFd signalfds[kMaxSignalFds];  // [sig_lock] for mutation
+  _Atomic(bool) signalfds_lock;  // spin lock NotifySignalFds() can take
   struct rlimit_linux rlim[RLIM_NLIMITS_LINUX];
 #ifdef HAVE_THREADS
   pthread_cond_t machines_cond;
@@ -296,7 +316,8 @@ struct System {
   pthread_mutex_t pagelocks_lock;
   pthread_mutex_t exec_lock;
   pthread_mutex_t sig_lock;
-  pthread_mutex_t mmap_lock;
+  pthread_rwlock_t mmap_lock;  // guards page tables, filemaps, brk
+  pthread_rwlock_t rlim_lock;  // guards rlim[]
 #endif
   void (*onfilemap)(struct System *, struct FileMap *);
   void (*onsymbols)(struct System *);
@@ -404,6 +425,7 @@ struct Machine {                         //
   struct JitPath path;                   // under construction jit route
   _Atomicish(u64) signals;               // [attention] pending delivery
   _Atomicish(u64) sigmask;               // signals that've been blocked
+  struct SignalSender sigfrom[64];       // who sent the pending signals
   i64 bofram[2];                         // helps debug bootloading code
   i64 faultaddr;                         // used for tui error reporting
   struct System *system;                 //
@@ -530,6 +552,7 @@ void SetWriteAddr(struct Machine *, i64, u32);
 int SyncVirtual(struct System *, i64, i64, int);
 int ProtectVirtual(struct System *, i64, i64, int, bool);
 bool IsFullyMapped(struct System *, i64, i64);
+u8 *GetExecutablePage(struct System *, i64, long *);
 bool IsFullyUnmapped(struct System *, i64, i64);
 int GetProtection(u64);
 u64 SetProtection(int);
@@ -145,7 +145,7 @@ static bool RecordPageLock(struct Machine *m, i64 page, u8 *pslot) {
   m->pagelocks.p[m->pagelocks.i].pslot = pslot;
   m->pagelocks.p[m->pagelocks.i].sysdepth = m->sysdepth;
   ++m->pagelocks.i;
-  STATISTIC(++page_locks);
+  STATISTIC(++g_stats->page_locks);
   return true;
 }
 
@@ -191,10 +191,10 @@ u64 FindPageTableEntry(struct Machine *m, u64 page) {
   tlbkey = (page >> 12) & (ARRAYLEN(m->tlb) - 1);
   if (m->tlb[tlbkey].page == page &&
       ((entry = m->tlb[tlbkey].entry) & PAGE_V)) {
-    STATISTIC(++tlb_hits);
+    STATISTIC(++g_stats->tlb_hits);
     return entry;
   }
-  STATISTIC(++tlb_misses);
+  STATISTIC(++g_stats->tlb_misses);
   unassert(!(page & 4095));
   if (!(-0x800000000000 <= (i64)page && (i64)page < 0x800000000000)) {
     m->segvcode = SEGV_MAPERR_LINUX;
@@ -260,9 +260,32 @@ MapError:
   return (uintptr_t)efault0();
 }
 
+// translates virtual address using only the translation lookaside buffer
+// this is the fast path for memory operations when linear mode is disabled
+// it only succeeds for host-backed pages that are already in the tlb, and
+// writes to pages which might contain executable code aren't handled here
+// @return host pointer, or null if the caller should take the slow path
+static inline u8 *LookupTlb(struct Machine *m, i64 virt, u64 mask, u64 need) {
+  u64 entry;
+  struct MachineTlb *tlb;
+  if (atomic_load_explicit(&m->invalidated, memory_order_acquire)) return 0;
+  tlb = m->tlb + ((virt >> 12) & (ARRAYLEN(m->tlb) - 1));
+  if (tlb->page != (virt & -4096)) return 0;
+  entry = tlb->entry;
+  if ((entry & (PAGE_V | PAGE_HOST | mask)) != (PAGE_V | PAGE_HOST | need)) {
+    return 0;
+  }
+  if ((need & PAGE_RW) && !(entry & PAGE_XD)) return 0;
+  STATISTIC(++g_stats->tlb_hits);
+  return (u8 *)(uintptr_t)(entry & PAGE_TA) + (virt & 4095);
+}
+
 u8 *LookupAddress2(struct Machine *m, i64 virt, u64 mask, u64 need) {
   u8 *host;
   u64 entry;
+  if ((host = LookupTlb(m, virt, mask, need))) {
+    return host;
+  }
   if (m->mode.omode == XED_MODE_LONG ||
       (m->mode.genmode != XED_GEN_MODE_REAL && (m->system->cr0 & CR0_PG))) {
     if (!(entry = FindPageTableEntry(m, virt & -4096))) {
@@ -312,8 +335,12 @@ u8 *ResolveAddress(struct Machine *m, i64 v) {
   ThrowSegmentationFault(m, v);
 }
 
+// Returns true if [virt,virt+size) is mapped with `prot` access. The
+// page tables are walked with mmap_lock held for reading, so a system
+// call validating its buffers won't race a concurrent munmap().
 bool IsValidMemory(struct Machine *m, i64 virt, i64 size, int prot) {
   i64 p, pe;
+  bool ok;
   u64 pte, mask, need;
   size += virt & 4095;
   virt &= -4096;
@@ -332,16 +359,20 @@ bool IsValidMemory(struct Machine *m, i64 virt, i64 size, int prot) {
     mask |= PAGE_XD;
   }
   if (CheckedAdd(virt, size, &pe) == -1) return false;
-  for (p = virt; p < pe; p += 4096) {
+  RDLOCK(&m->system->mmap_lock);
+  for (ok = true, p = virt; p < pe; p += 4096) {
     if (!(pte = FindPageTableEntry(m, p))) {
-      return false;
+      ok = false;
+      break;
     }
     if ((pte & mask) != need) {
       errno = EFAULT;
-      return false;
+      ok = false;
+      break;
     }
   }
-  return true;
+  RWUNLOCK(&m->system->mmap_lock);
+  return ok;
 }
 
 int VirtualCopy(struct Machine *m, i64 v, char *r, u64 n, bool d) {
@@ -433,7 +464,7 @@ u8 *ReserveAddress(struct Machine *m, i64 v, size_t n, bool writable) {
       ThrowSegmentationFault(m, v);
     }
   }
-  STATISTIC(++page_overlaps);
+  STATISTIC(++g_stats->page_overlaps);
   unassert(n <= 4096);
   m->stashaddr = v;
   m->opcache->stashsize = n;
@@ -466,7 +497,7 @@ static u8 *AccessRam2(struct Machine *m, i64 v, size_t n, void *p[2], u8 *tmp,
     if (copy) memcpy(tmp, a, n);
     return tmp;
   }
-  STATISTIC(++page_overlaps);
+  STATISTIC(++g_stats->page_overlaps);
   k = 4096;
   k -= v & 4095;
   unassert(k <= 4096);
@@ -541,7 +572,7 @@ void *AddToFreeList(struct Machine *m, void *mem) {
   p = m->freelist.p;
   n = m->freelist.n + 1;
   if ((p = realloc(p, n * sizeof(*m->freelist.p)))) {
-    STATISTIC(++freelisted);
+    STATISTIC(++g_stats->freelisted);
     m->freelist.p = (void **)p;
     m->freelist.n = n;
     m->freelist.p[n - 1] = mem;
@@ -16,9 +16,12 @@
 │ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
 │ PERFORMANCE OF THIS SOFTWARE.                                                │
 ╚─────────────────────────────────────────────────────────────────────────────*/
+#include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "blink/assert.h"
@@ -29,6 +32,7 @@
 #include "blink/debug.h"
 #include "blink/errno.h"
 #include "blink/fds.h"
+#include "blink/fspath.h"
 #include "blink/jit.h"
 #include "blink/linux.h"
 #include "blink/log.h"
@@ -41,6 +45,7 @@
 #include "blink/timespec.h"
 #include "blink/types.h"
 #include "blink/util.h"
+#include "blink/vfs.h"
 #include "blink/x86.h"
 
 struct Allocator {
@@ -175,19 +180,27 @@ void CleanseMemory(struct System *s, size_t size) {
 
 int GetFileDescriptorLimit(struct System *s) {
   u64 lim;
-  LOCK(&s->mmap_lock);
+  RDLOCK(&s->rlim_lock);
   lim = Read64(s->rlim[RLIMIT_NOFILE_LINUX].cur);
-  UNLOCK(&s->mmap_lock);
+  RWUNLOCK(&s->rlim_lock);
   if (lim > INT_MAX) lim = INT_MAX;
   return lim;
 }
 
+static u64 GetAddressSpaceLimit(struct System *s) {
+  u64 lim;
+  RDLOCK(&s->rlim_lock);
+  lim = Read64(s->rlim[RLIMIT_AS_LINUX].cur);
+  RWUNLOCK(&s->rlim_lock);
+  return lim;
+}
+
 long GetMaxVss(struct System *s) {
-  return MIN(kMaxVirtual, Read64(s->rlim[RLIMIT_AS_LINUX].cur)) / 4096;
+  return MIN(kMaxVirtual, GetAddressSpaceLimit(s)) / 4096;
 }
 
 long GetMaxRss(struct System *s) {
-  return MIN(kMaxResident, Read64(s->rlim[RLIMIT_AS_LINUX].cur)) / 4096;
+  return MIN(kMaxResident, GetAddressSpaceLimit(s)) / 4096;
 }
 
 struct System *NewSystem(struct XedMachineMode mode) {
@@ -222,7 +235,8 @@ struct System *NewSystem(struct XedMachineMode mode) {
 #endif
   InitFds(&s->fds);
   unassert(!pthread_mutex_init(&s->sig_lock, 0));
-  unassert(!pthread_mutex_init(&s->mmap_lock, 0));
+  unassert(!pthread_rwlock_init(&s->mmap_lock, 0));
+  unassert(!pthread_rwlock_init(&s->rlim_lock, 0));
   unassert(!pthread_mutex_init(&s->exec_lock, 0));
   unassert(!pthread_cond_init(&s->machines_cond, 0));
   unassert(!pthread_mutex_init(&s->machines_lock, 0));
@@ -340,7 +354,8 @@ void FreeSystem(struct System *s) {
   unassert(!pthread_mutex_destroy(&s->pagelocks_lock));
   unassert(!pthread_cond_destroy(&s->pagelocks_cond));
   unassert(!pthread_mutex_destroy(&s->exec_lock));
-  unassert(!pthread_mutex_destroy(&s->mmap_lock));
+  unassert(!pthread_rwlock_destroy(&s->rlim_lock));
+  unassert(!pthread_rwlock_destroy(&s->mmap_lock));
   // TODO(jart): Figure out why sig_lock sometimes fails to destroy
   (void)pthread_mutex_destroy(&s->sig_lock);
   free(s->elf.interpreter);
@@ -506,14 +521,30 @@ void InvalidateSystem(struct System *s, bool tlb, bool icache) {
 
 struct FileMap *AddFileMap(struct System *s, i64 virt, i64 size,
                            const char *path, u64 offset) {
+  struct stat st;
   struct FileMap *fm;
   size_t pages, words;
+  char cwd[PATH_MAX];
   if (!path) return 0;
   if ((fm = (struct FileMap *)calloc(1, sizeof(struct FileMap)))) {
     fm->virt = virt;
     fm->size = size;
-    fm->path = strdup(path);
+    fm->filesz = size;
     fm->offset = offset;
+    if (*path == '[') {
+      fm->path = strdup(path);
+    } else {
+      // procfs needs to report the file the way it'd be named from any
+      // working directory, as well as its device and inode
+      if (*path == '/' || !VfsGetcwd(cwd, sizeof(cwd))) *cwd = 0;
+      if (!(fm->path = AbsolutePath(cwd, path))) {
+        fm->path = strdup(path);
+      }
+      if (!VfsStat(AT_FDCWD, path, &st, 0)) {
+        fm->dev = st.st_dev;
+        fm->ino = st.st_ino;
+      }
+    }
     pages = ROUNDUP(size, 4096) / 4096;
     words = ROUNDUP(pages, 64) / 64;
     if (fm->path && (fm->present = (u64 *)malloc(words * sizeof(u64)))) {
@@ -537,17 +568,27 @@ static void AddFileMapViaMap(struct System *s, i64 virt, i64 size, int fildes,
                              u64 offset) {
   char *path;
   struct Fd *fd;
+  struct stat st;
   struct FileMap *fm;
   LOCK(&s->fds.lock);
-  path = (fd = GetFd(&s->fds, fildes)) ? strdup(fd->path) : 0;
+  path = (fd = GetFd(&s->fds, fildes)) && fd->path ? strdup(fd->path) : 0;
   UNLOCK(&s->fds.lock);
   fm = AddFileMap(s, virt, size, path, offset);
   free(path);
+  if (fm && !VfsFstat(fildes, &st)) {
+    fm->dev = st.st_dev;
+    fm->ino = st.st_ino;
+    if (S_ISREG(st.st_mode)) {
+      fm->filesz = MAX(0, MIN(size, (i64)st.st_size - (i64)offset));
+    }
+  }
   if (fm && s->dis && s->onfilemap) {
     s->onfilemap(s, fm);
   }
 }
 
+// Returns file map owning the page at `virt`, or null if there's none.
+// The caller must hold mmap_lock, which may be held just for reading.
 struct FileMap *GetFileMap(struct System *s, i64 virt) {
   u64 i;
   struct Dll *e;
@@ -726,8 +767,8 @@ static void RemoveVirtual(struct System *s, i64 virt, i64 size,
         // when more than 512*4096 bytes are being unmapped, we
         // opportunistically unmap page directories too, if the
         // requested interval overlaps an entire page table. we
-        // guarantee safety because mmap_lock is held, which is
-        // required to create/remove (but not edit) the entries
+        // guarantee safety because mmap_lock is held for writing,
+        // which is required to create/remove (not edit) entries
         // therefore if we observed all entries are zero we can
         // say for certain it's safe to free. the only question
         // becomes readers like FindPageTableEntry() that still
@@ -1125,6 +1166,44 @@ bool IsFullyMapped(struct System *s, i64 virt, i64 size) {
   }
 }
 
+/**
+ * Returns host memory of read-only executable guest page.
+ *
+ * Unlike FindPageTableEntry() this has no side effects, i.e. pages
+ * aren't faulted in, locked, or counted. File mapped pages which were
+ * never accessed are returned too, since their content already exists.
+ *
+ * @param len receives number of bytes that can be read, which is less
+ *     than 4096 for the last page of a file mapping, since reading past
+ *     the end of a mapped file raises SIGBUS
+ * @return host address of page, or null if `virt` isn't mapped, is
+ *     writable, can't be executed, or hasn't been populated
+ */
+u8 *GetExecutablePage(struct System *s, i64 virt, long *len) {
+  u8 *mi;
+  u64 pt;
+  long level;
+  i64 skew;
+  struct FileMap *fm;
+  if (!(-0x800000000000 <= virt && virt < 0x800000000000)) return 0;
+  for (pt = s->cr3, level = 39; level >= 12; level -= 9) {
+    mi = GetPageAddress(s, pt, level == 39) + ((virt >> level) & 511) * 8;
+    pt = LoadPte(mi);
+    if (!(pt & PAGE_V)) return 0;
+  }
+  if ((pt & (PAGE_U | PAGE_RW | PAGE_XD)) != PAGE_U) return 0;
+  *len = 4096;
+  if ((pt & PAGE_FILE) && (fm = GetFileMap(s, virt & -4096))) {
+    if ((skew = (virt & -4096) - fm->virt) >= fm->filesz) return 0;
+    *len = MIN(4096, fm->filesz - skew);
+  }
+  if (pt & PAGE_RSRV) {
+    if ((pt & (PAGE_HOST | PAGE_MAP)) != (PAGE_HOST | PAGE_MAP)) return 0;
+    return (u8 *)(uintptr_t)(pt & PAGE_TA);
+  }
+  return GetPageAddress(s, pt, false);
+}
+
 bool IsFullyUnmapped(struct System *s, i64 virt, i64 size) {
   u8 *mi;
   i64 end;
@@ -18,8 +18,11 @@
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "blink/overlays.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -32,15 +35,131 @@
 #include "blink/fspath.h"
 #include "blink/likely.h"
 #include "blink/log.h"
+#include "blink/machine.h"
+#include "blink/map.h"
 #include "blink/syscall.h"
 #include "blink/thompike.h"
+#include "blink/thread.h"
+#include "blink/timespec.h"
+#include "blink/tunables.h"
+#include "blink/types.h"
 #include "blink/util.h"
 
+#if defined(__APPLE__) || defined(__NetBSD__)
+#define st_atim st_atimespec
+#define st_mtim st_mtimespec
+#endif
+
 #ifndef DISABLE_OVERLAYS
 
 #define UNREACHABLE "(unreachable)"
 
+// markers in the upper layer of a union, which are hidden from guests
+#define WHITEOUT ".wh."          // prefix of file that deletes lower name
+#define OPAQUE   ".wh..wh..opq"  // directory doesn't merge lower layers
+#define COPYUP   ".wh..wh..tmp"  // prefix of file being copied up
+
+// how an operation uses the path it's given
+enum {
+  kReads,            // only looks at file
+  kModifies,         // changes file, which must be copied up first
+  kCreates,          // creates name, which mustn't exist
+  kRemoves,          // removes name
+  kFollows = 0x100,  // last component symlink is followed
+};
+
+// overlay root directory, which is opened once by SetOverlays()
+struct OverlayRoot {
+  int fd;  // AT_FDCWD for the real root, or -1 if it couldn't be opened
+  u64 dev;
+  u64 ino;
+};
+
+// remembers that a path doesn't exist in an overlay root
+//
+// the negative lookup cache lives in shared memory, so it stays valid
+// across fork(). entries are seqlocked, so they can be read without a
+// lock; if `seq` is odd then the entry is being written. entries only
+// count if their `gen` matches the generation of the cache, which any
+// operation that creates, renames, or removes a file will increment.
+// since files can also change without blink knowing, e.g. when some
+// host program creates one, entries expire after kOverlayMissMs too.
+//
+// when there's a writable upper layer, the cache also remembers which
+// layer a path was found in, so that a layered lookup that hits costs
+// the same number of host system calls as a lookup in a single root.
+struct OverlayMiss {
+  _Atomic(u32) seq;
+  u32 gen;
+  u64 hash;
+  u64 dev;
+  u64 ino;
+  int err;
+  int layer;  // index of root that has path, or -1 if it doesn't exist
+  u32 mode;   // st_mode of path in layer, if it exists
+  struct timespec expires;
+  char path[192];
+};
+
+struct OverlayMisses {
+  _Atomic(u32) gen;
+  struct OverlayMiss p[kOverlayMisses];
+};
+
+// directory opened from union, which is keyed by host inode so that
+// any dup() of its file descriptor can be mapped back to guest path.
+// other files are tracked too if they were opened from a lower layer,
+// so that changing them through a file descriptor copies them up; if
+// such a file is removed from the union, its path becomes empty.
+struct UnionDirectory {
+  struct UnionDirectory *next;
+  u64 dev;
+  u64 ino;
+  bool isdir;
+  char path[];
+};
+
+struct UnionDirent {
+  u64 ino;
+  int type;
+  int layer;
+  bool whiteout;
+  char *name;
+};
+
+struct UnionListing {
+  long n;
+  long c;
+  struct UnionDirent *p;
+};
+
+// what OverlaysOpendir() returns, which either wraps a host directory
+// stream, or holds a snapshot of the merged listing of union directory
+struct OverlayStream {
+  DIR *dir;
+  int fd;
+  long pos;
+  char *path;
+  struct UnionListing list;
+  struct dirent ent;
+};
+
+struct UnionLookup {
+  int layer;      // index of root that has path, or -1 if it doesn't exist
+  int err;        // why path doesn't exist
+  bool whiteout;  // path was deleted from lower layers
+  u32 mode;       // st_mode of path in layer
+};
+
+static bool g_union;  // g_roots[0] is writable upper layer
+static u64 g_salt;    // keeps union lookups of different configs apart
 static char **g_overlays;
+static struct OverlayRoot *g_roots;
+static struct OverlayMisses *g_misses;
+static char g_cwd[PATH_MAX];  // guest working directory for union
+static _Atomic(u32) g_copyups;
+static struct UnionDirectory *g_dirs[kOverlayDirs];
+static pthread_mutex_t_ g_union_lock = PTHREAD_MUTEX_INITIALIZER_;
 
 static void FreeStrings(char **ss) {
   size_t i;
@@ -74,9 +193,1070 @@ static char **SplitString(const char *s, int c) {
   return r;
 }
 
+static void FreeRoots(struct OverlayRoot *roots) {
+  size_t i;
+  if (!roots) return;
+  for (i = 0; roots[i].fd != -2; ++i) {
+    if (roots[i].fd >= 0) {
+      unassert(!close(roots[i].fd));
+    }
+  }
+  free(roots);
+}
+
+static void FreeDirectories(void) {
+  size_t i;
+  struct UnionDirectory *d, *next;
+  LOCK(&g_union_lock);
+  for (i = 0; i < kOverlayDirs; ++i) {
+    for (d = g_dirs[i]; d; d = next) {
+      next = d->next;
+      free(d);
+    }
+    g_dirs[i] = 0;
+  }
+  UNLOCK(&g_union_lock);
+}
+
 static void FreeOverlays(void) {
   FreeStrings(g_overlays);
+  FreeRoots(g_roots);
+  FreeDirectories();
   g_overlays = 0;
+  g_roots = 0;
+  g_union = false;
+}
+
+// if we get these failures when opening a dirfd of a user supplied
+// overlay path, then it's definitely not a user error, and therefore
+// not safe to continue.
+static bool IsUnrecoverableErrno(void) {
+  return errno == EINTR || errno == EMFILE || errno == ENFILE;
+}
+
+static int OpenRoot(const char *path, struct OverlayRoot *root) {
+  int fd;
+  struct stat st;
+  if (!*path) {
+    root->fd = AT_FDCWD;
+    path = "/";
+  } else if ((fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0)) != -1) {
+    root->fd = fcntl(fd, F_DUPFD_CLOEXEC, kMinBlinkFd);
+    unassert(!close(fd));
+    if (root->fd == -1) return -1;
+  } else if (IsUnrecoverableErrno()) {
+    return -1;
+  } else {
+    LOGF("bad overlay %s: %s", path, DescribeHostErrno(errno));
+    root->fd = -1;
+    return 0;
+  }
+  if (!(root->fd == AT_FDCWD ? stat(path, &st) : fstat(root->fd, &st))) {
+    root->dev = st.st_dev;
+    root->ino = st.st_ino;
+  }
+  return 0;
+}
+
+static struct OverlayRoot *OpenRoots(char **paths) {
+  size_t i, n;
+  struct OverlayRoot *roots;
+  n = 0;
+  while (paths[n]) ++n;
+  if (!(roots = (struct OverlayRoot *)calloc(n + 1, sizeof(*roots)))) {
+    return 0;
+  }
+  for (i = 0; i < n; ++i) {
+    if (OpenRoot(paths[i], roots + i) == -1) {
+      roots[i].fd = -2;
+      FreeRoots(roots);
+      return 0;
+    }
+  }
+  roots[n].fd = -2;
+  return roots;
+}
+
+static void AllocateMisses(void) {
+  if (g_misses) return;
+  g_misses = (struct OverlayMisses *)AllocateBig(
+      sizeof(*g_misses), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS_,
+      -1, 0);
+}
+
+static u64 HashPath(const char *path) {
+  u64 h = 0xcbf29ce484222325;
+  while (*path) h = (h ^ (unsigned char)*path++) * 0x100000001b3;
+  return h;
+}
+
+static struct OverlayMiss *GetMissSlot(const struct OverlayRoot *root,
+                                       u64 hash) {
+  u64 key = hash ^ root->ino * 0x9e3779b97f4a7c15;
+  return g_misses->p + (key ^ key >> 32) % kOverlayMisses;
+}
+
+static u32 GetMissGeneration(void) {
+  if (!g_misses) return 0;
+  return atomic_load_explicit(&g_misses->gen, memory_order_acquire);
+}
+
+/**
+ * Invalidates negative lookups cached for overlays.
+ *
+ * This is called when a file is created, renamed, or removed.
+ */
+void InvalidateOverlays(void) {
+  if (!g_misses) return;
+  atomic_fetch_add_explicit(&g_misses->gen, 1, memory_order_acq_rel);
+}
+
+// looks up result of an earlier lookup of `path` in `root`
+static bool GetCachedLookup(const struct OverlayRoot *root, const char *path,
+                            u64 hash, struct OverlayMiss *m) {
+  u32 seq;
+  struct OverlayMiss *e;
+  if (!g_misses) return false;
+  e = GetMissSlot(root, hash);
+  seq = atomic_load_explicit(&e->seq, memory_order_acquire);
+  if (seq & 1) return false;
+  memcpy(m, e, sizeof(*m));
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(&e->seq, memory_order_relaxed) != seq) return false;
+  m->path[sizeof(m->path) - 1] = 0;
+  return m->gen == GetMissGeneration() && m->hash == hash &&
+         m->dev == root->dev && m->ino == root->ino &&
+         CompareTime(GetMonotonic(), m->expires) < 0 && !strcmp(m->path, path);
+}
+
+// records result of looking up `path` in `root`
+// @param gen is cache generation from before the lookup
+static void CacheLookup(const struct OverlayRoot *root, const char *path,
+                        u64 hash, u32 gen, int layer, u32 mode, int err) {
+  u32 seq;
+  size_t n;
+  struct OverlayMiss *e;
+  if (!g_misses) return;
+  if ((n = strlen(path)) >= sizeof(e->path)) return;
+  e = GetMissSlot(root, hash);
+  seq = atomic_load_explicit(&e->seq, memory_order_relaxed);
+  if (!(seq & 1) && atomic_compare_exchange_strong_explicit(
+                        &e->seq, &seq, seq + 1, memory_order_acquire,
+                        memory_order_relaxed)) {
+    e->gen = gen;
+    e->hash = hash;
+    e->dev = root->dev;
+    e->ino = root->ino;
+    e->err = err;
+    e->layer = layer;
+    e->mode = mode;
+    e->expires = AddTime(GetMonotonic(), FromMilliseconds(kOverlayMissMs));
+    memcpy(e->path, path, n + 1);
+    atomic_store_explicit(&e->seq, seq + 2, memory_order_release);
+  }
+}
+
+// returns true if `path` is known to not exist in overlay `root`
+static bool IsKnownMiss(const struct OverlayRoot *root, const char *path,
+                        u64 hash, int *err) {
+  struct OverlayMiss m;
+  if (!GetCachedLookup(root, path, hash, &m) || m.layer != -1) return false;
+  *err = m.err;
+  return true;
+}
+
+// records that `path` doesn't exist in overlay `root`, if that's true
+// @param gen is cache generation from before the failed lookup
+static void RememberMiss(const struct OverlayRoot *root, const char *path,
+                         const char *relpath, u64 hash, u32 gen) {
+  int olderr;
+  struct stat st;
+  if (!g_misses) return;
+  olderr = errno;
+  // the failed operation could have raised ENOENT or ENOTDIR for some
+  // reason other than the path not existing, e.g. rmdir() of a file
+  if (!fstatat(root->fd, relpath, &st, AT_SYMLINK_NOFOLLOW) ||
+      (errno != ENOENT && errno != ENOTDIR)) {
+    errno = olderr;
+    return;
+  }
+  CacheLookup(root, path, hash, gen, -1, 0, errno);
+  errno = olderr;
+}
+
+// returns path relative to overlay root for absolute guest path
+static const char *GetOverlayPath(size_t i, const char *path) {
+  if (!*g_overlays[i]) return path;
+  return !path[1] ? "." : path + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// copy-on-write union of a writable upper layer and read-only lowers
+//
+// when the first overlay is prefixed with `+` it becomes the upper
+// layer, and the remaining overlays are lower layers that are never
+// written. files are copied up lazily the first time they're opened
+// for writing or have their metadata changed. deleting a name that
+// exists in a lower layer leaves a `.wh.NAME` whiteout file in the
+// upper layer, and a directory that's created in place of a deleted
+// one gets an opaque marker, so lower layers aren't merged into it.
+// paths are resolved lexically, and only symbolic links in the last
+// component are followed across layers.
+
+// appends components of `s` to normalized path `buf` of length `*n`
+static int AppendComponents(char *buf, size_t *n, const char *s) {
+  size_t m;
+  const char *e;
+  for (; *s; s = e) {
+    while (*s == '/') ++s;
+    if (!*s) break;
+    for (e = s; *e && *e != '/'; ++e) {
+    }
+    m = e - s;
+    if (m == 1 && s[0] == '.') continue;
+    if (m == 2 && s[0] == '.' && s[1] == '.') {
+      while (*n && buf[--*n] != '/') {
+      }
+      continue;
+    }
+    if (*n + 1 + m + 1 > PATH_MAX) return enametoolong();
+    buf[(*n)++] = '/';
+    memcpy(buf + *n, s, m);
+    *n += m;
+  }
+  return 0;
+}
+
+// resolves `path` relative to absolute `base` without following links
+static int NormalizePath(const char *base, const char *path,
+                         char buf[PATH_MAX]) {
+  size_t n = 0;
+  if (*path != '/' && AppendComponents(buf, &n, base) == -1) return -1;
+  if (AppendComponents(buf, &n, path) == -1) return -1;
+  if (!n) buf[n++] = '/';
+  buf[n] = 0;
+  return 0;
+}
+
+// copies parent directory of normalized absolute `path` into `buf`
+static void GetParentPath(const char *path, char buf[PATH_MAX]) {
+  size_t n = strrchr(path, '/') - path;
+  if (!n) n = 1;
+  memcpy(buf, path, n);
+  buf[n] = 0;
+}
+
+// formats upper layer path of `name` in directory that contains `path`
+static int GetSiblingPath(const char *path, const char *name,
+                          char buf[PATH_MAX]) {
+  size_t n, m;
+  n = strrchr(path, '/') - path;
+  m = strlen(name);
+  if (n + m + 1 > PATH_MAX) return enametoolong();
+  if (n) {
+    memcpy(buf, path + 1, n);
+    buf[n - 1] = '/';
+  }
+  memcpy(buf + n, name, m + 1);
+  return 0;
+}
+
+// formats upper layer path of whiteout file for `path`
+static int GetWhiteoutPath(const char *path, char buf[PATH_MAX]) {
+  char name[NAME_MAX + sizeof(WHITEOUT)];
+  const char *base = strrchr(path, '/') + 1;
+  if (strlen(base) > NAME_MAX) return enametoolong();
+  stpcpy(stpcpy(name, WHITEOUT), base);
+  return GetSiblingPath(path, name, buf);
+}
+
+// formats host path of normalized absolute `path` in overlay `i`
+static int GetHostPath(size_t i, const char *path, char buf[PATH_MAX]) {
+  size_t n, m;
+  n = strlen(g_overlays[i]);
+  m = path[1] ? strlen(path) : 0;
+  if (n + m + 1 > PATH_MAX) return enametoolong();
+  memcpy(buf, g_overlays[i], n);
+  memcpy(buf + n, path, m);
+  buf[n + m] = 0;
+  if (!n && !m) strcpy(buf, "/");
+  return 0;
+}
+
+// returns true if lower layers are hidden at `path` by upper markers
+static bool IsHiddenFromLowers(const char *path, bool *whiteout) {
+  int fd;
+  size_t n;
+  struct stat st;
+  const char *s, *e;
+  char buf[PATH_MAX];
+  *whiteout = false;
+  fd = g_roots[0].fd;
+  for (n = 0, s = path + 1; *s; s = e + 1) {
+    for (e = s; *e && *e != '/'; ++e) {
+    }
+    if (n + sizeof(OPAQUE) + sizeof(WHITEOUT) + (e - s) > sizeof(buf)) {
+      return false;
+    }
+    memcpy(buf + n, OPAQUE, sizeof(OPAQUE));
+    if (!fstatat(fd, buf, &st, AT_SYMLINK_NOFOLLOW)) return true;
+    memcpy(buf + n, WHITEOUT, strlen(WHITEOUT));
+    memcpy(buf + n + strlen(WHITEOUT), s, e - s);
+    buf[n + strlen(WHITEOUT) + (e - s)] = 0;
+    if (!fstatat(fd, buf, &st, AT_SYMLINK_NOFOLLOW)) {
+      *whiteout = true;
+      return true;
+    }
+    if (!*e) break;
+    // markers can only exist further down if this directory does
+    memcpy(buf + n, s, e - s);
+    n += e - s;
+    buf[n] = 0;
+    if (fstatat(fd, buf, &st, 0) || !S_ISDIR(st.st_mode)) break;
+    buf[n++] = '/';
+  }
+  return false;
+}
+
+// returns index of first lower layer that has `path`, or -1
+static ssize_t FindLower(const char *path, int flags, struct stat *st) {
+  size_t i;
+  for (i = 1; g_overlays[i]; ++i) {
+    if (g_roots[i].fd == -1) continue;
+    if (!fstatat(g_roots[i].fd, GetOverlayPath(i, path), st, flags)) {
+      return i;
+    }
+    if (errno != ENOENT && errno != ENOTDIR) return -1;
+  }
+  errno = ENOENT;
+  return -1;
+}
+
+// returns true if `path` is visible in a lower layer of the union
+static bool HasLower(const char *path) {
+  bool whiteout;
+  struct stat st;
+  return !IsHiddenFromLowers(path, &whiteout) &&
+         FindLower(path, AT_SYMLINK_NOFOLLOW, &st) != -1;
+}
+
+// finds which layer of the union has normalized absolute `path`
+static int LookupUnion(const char *path, struct UnionLookup *lk) {
+  u32 gen;
+  u64 hash;
+  ssize_t i;
+  struct stat st;
+  struct OverlayMiss m;
+  hash = HashPath(path) ^ g_salt;
+  if (GetCachedLookup(g_roots, path, hash, &m)) {
+    lk->layer = m.layer < 0 ? -1 : m.layer;
+    lk->whiteout = m.layer == -2;
+    lk->err = m.err;
+    lk->mode = m.mode;
+    return 0;
+  }
+  gen = GetMissGeneration();
+  lk->layer = -1;
+  lk->err = ENOENT;
+  lk->whiteout = false;
+  lk->mode = 0;
+  if (!fstatat(g_roots[0].fd, GetOverlayPath(0, path), &st,
+               AT_SYMLINK_NOFOLLOW)) {
+    lk->layer = 0;
+    lk->mode = st.st_mode;
+  } else if (errno == ENOTDIR) {
+    // a file in the upper layer shadows a lower layer directory
+    lk->err = ENOTDIR;
+  } else if (errno != ENOENT) {
+    return -1;
+  } else if (!IsHiddenFromLowers(path, &lk->whiteout)) {
+    if ((i = FindLower(path, AT_SYMLINK_NOFOLLOW, &st)) != -1) {
+      lk->layer = i;
+      lk->mode = st.st_mode;
+    } else if (errno != ENOENT) {
+      return -1;
+    }
+  }
+  CacheLookup(g_roots, path, hash, gen, lk->whiteout ? -2 : lk->layer,
+              lk->mode, lk->err);
+  return 0;
+}
+
+// same as LookupUnion() but follows symbolic links in last component
+static int FollowUnion(char path[PATH_MAX], struct UnionLookup *lk) {
+  int i;
+  ssize_t rc;
+  char dir[PATH_MAX];
+  char buf[PATH_MAX];
+  for (i = 0;; ++i) {
+    if (LookupUnion(path, lk) == -1) return -1;
+    if (lk->layer == -1 || !S_ISLNK(lk->mode)) return 0;
+    if (i == 40) return eloop();
+    if ((rc = readlinkat(g_roots[lk->layer].fd,
+                         GetOverlayPath(lk->layer, path), buf,
+                         sizeof(buf) - 1)) == -1) {
+      return -1;
+    }
+    buf[rc] = 0;
+    GetParentPath(path, dir);
+    if (NormalizePath(dir, buf, path) == -1) return -1;
+  }
+}
+
+static int LookupOrFollowUnion(char path[PATH_MAX], struct UnionLookup *lk,
+                               bool follow) {
+  if ((follow ? FollowUnion(path, lk) : LookupUnion(path, lk)) == -1) {
+    return -1;
+  }
+  if (lk->layer == -1) {
+    errno = lk->err;
+    return -1;
+  }
+  return 0;
+}
+
+static u64 HashDirectory(u64 dev, u64 ino) {
+  u64 h = (dev * 0x9e3779b97f4a7c15) ^ ino;
+  return (h ^ h >> 32) % kOverlayDirs;
+}
+
+// remembers guest path of union directory or lower file open as `fd`
+static void TrackDirectory(int fd, const char *path) {
+  size_t n;
+  struct stat st;
+  struct UnionDirectory *d, **p;
+  if (fstat(fd, &st)) return;
+  n = strlen(path) + 1;
+  if (!(d = (struct UnionDirectory *)malloc(sizeof(*d) + n))) return;
+  d->dev = st.st_dev;
+  d->ino = st.st_ino;
+  d->isdir = S_ISDIR(st.st_mode);
+  memcpy(d->path, path, n);
+  LOCK(&g_union_lock);
+  for (p = g_dirs + HashDirectory(d->dev, d->ino); *p; p = &(*p)->next) {
+    if ((*p)->dev == d->dev && (*p)->ino == d->ino) {
+      d->next = (*p)->next;
+      free(*p);
+      *p = d;
+      UNLOCK(&g_union_lock);
+      return;
+    }
+  }
+  d->next = 0;
+  *p = d;
+  UNLOCK(&g_union_lock);
+}
+
+// looks up guest path of tracked file with inode `st`
+// @param buf receives path if not null
+static bool GetTrackedPath(const struct stat *st, char buf[PATH_MAX]) {
+  bool found;
+  struct UnionDirectory *d;
+  found = false;
+  LOCK(&g_union_lock);
+  for (d = g_dirs[HashDirectory(st->st_dev, st->st_ino)]; d; d = d->next) {
+    if (d->dev == st->st_dev && d->ino == st->st_ino) {
+      if (buf) strcpy(buf, d->path);
+      found = true;
+      break;
+    }
+  }
+  UNLOCK(&g_union_lock);
+  return found;
+}
+
+// looks up guest path of union directory open as `fd`
+// @param buf receives path if not null
+// @return true if `fd` is a directory in the union
+static bool GetDirectoryPath(int fd, char buf[PATH_MAX]) {
+  struct stat st;
+  if (fstat(fd, &st) || !S_ISDIR(st.st_mode)) return false;
+  return GetTrackedPath(&st, buf);
+}
+
+static bool IsPathUnder(const char *path, const char *dir, size_t n) {
+  return !strncmp(path, dir, n) && (!path[n] || path[n] == '/');
+}
+
+// updates tracked files after `src` was renamed or removed
+static void MoveDirectories(const char *src, const char *dst) {
+  size_t i, n, m, k;
+  struct UnionDirectory *d, *d2, **p;
+  n = strlen(src);
+  m = dst ? strlen(dst) : 0;
+  LOCK(&g_union_lock);
+  for (i = 0; i < kOverlayDirs; ++i) {
+    for (p = g_dirs + i; (d = *p);) {
+      if (!IsPathUnder(d->path, src, n)) {
+        p = &d->next;
+        continue;
+      }
+      if (!dst && !d->isdir) {
+        *d->path = 0;  // the lower file is still there but not in union
+        p = &d->next;
+        continue;
+      }
+      k = strlen(d->path + n);
+      if (dst && (d2 = (struct UnionDirectory *)malloc(sizeof(*d2) + m + k +
+                                                        1))) {
+        d2->dev = d->dev;
+        d2->ino = d->ino;
+        d2->isdir = d->isdir;
+        d2->next = d->next;
+        memcpy(d2->path, dst, m);
+        memcpy(d2->path + m, d->path + n, k + 1);
+        *p = d2;
+        p = &d2->next;
+      } else {
+        *p = d->next;
+      }
+      free(d);
+    }
+  }
+  UNLOCK(&g_union_lock);
+}
+
+// turns `path` relative to `dirfd` into absolute path within union
+// @return 1 on success, 0 if `dirfd` isn't a union directory, or -1
+static int GetUnionPath(int dirfd, const char *path, char buf[PATH_MAX]) {
+  char base[PATH_MAX];
+  if (*path == '/') {
+    *base = 0;
+  } else if (dirfd == AT_FDCWD) {
+    LOCK(&g_union_lock);
+    strcpy(base, g_cwd);
+    UNLOCK(&g_union_lock);
+  } else if (!GetDirectoryPath(dirfd, base)) {
+    return 0;
+  }
+  if (NormalizePath(base, path, buf) == -1) return -1;
+  return 1;
+}
+
+// sets guest working directory of union using host working directory
+static bool MapHostCwd(void) {
+  size_t i, n;
+  char buf[PATH_MAX];
+  if (!(getcwd)(buf, sizeof(buf))) return false;
+  for (i = 0; g_overlays[i]; ++i) {
+    if (!(n = strlen(g_overlays[i]))) continue;
+    if (IsPathUnder(buf, g_overlays[i], n)) {
+      strcpy(g_cwd, buf[n] ? buf + n : "/");
+      return true;
+    }
+  }
+  for (i = 0; g_overlays[i]; ++i) {
+    if (!*g_overlays[i]) {
+      strcpy(g_cwd, buf);
+      return true;
+    }
+  }
+  return false;
+}
+
+// copies ownership and timestamps of lower file to upper layer file
+static void CopyAttributes(const char *path, const struct stat *st) {
+  struct timespec ts[2];
+  ts[0] = st->st_atim;
+  ts[1] = st->st_mtim;
+  // these are best effort, since only root can give away files
+  (void)fchownat(g_roots[0].fd, path, st->st_uid, st->st_gid,
+                 AT_SYMLINK_NOFOLLOW);
+  (void)utimensat(g_roots[0].fd, path, ts, AT_SYMLINK_NOFOLLOW);
+}
+
+// creates directory `path` in upper layer, copying its lower mode
+static int CopyUpDirectory(const char *path) {
+  struct stat st;
+  if (FindLower(path, 0, &st) == -1) return -1;
+  if (!S_ISDIR(st.st_mode)) return enotdir();
+  if (mkdirat(g_roots[0].fd, path + 1, st.st_mode & 07777) == -1) {
+    return errno == EEXIST ? 0 : -1;
+  }
+  CopyAttributes(path + 1, &st);
+  InvalidateOverlays();
+  return 0;
+}
+
+// creates directories in upper layer that lead up to `path`
+static int CopyUpParents(const char *path) {
+  size_t n;
+  struct stat st;
+  char buf[PATH_MAX];
+  const char *e;
+  GetParentPath(path, buf);
+  if (!buf[1]) return 0;
+  if (!fstatat(g_roots[0].fd, buf + 1, &st, 0)) {
+    return S_ISDIR(st.st_mode) ? 0 : enotdir();
+  }
+  if (errno != ENOENT) return -1;
+  for (e = path + 1; (e = strchr(e, '/')); ++e) {
+    n = e - path;
+    memcpy(buf, path, n);
+    buf[n] = 0;
+    if (!fstatat(g_roots[0].fd, buf + 1, &st, 0)) {
+      if (!S_ISDIR(st.st_mode)) return enotdir();
+    } else if (errno != ENOENT || CopyUpDirectory(buf) == -1) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int CopyUpFile(int srcdirfd, const char *srcpath, const char *dstpath,
+                      const struct stat *st) {
+  char *buf;
+  ssize_t i, got, wrote;
+  int rc, srcfd, dstfd;
+  if (!(buf = (char *)malloc(kCopyUpChunk))) return -1;
+  if ((srcfd = openat(srcdirfd, srcpath, O_RDONLY | O_NOFOLLOW | O_CLOEXEC)) ==
+      -1) {
+    free(buf);
+    return -1;
+  }
+  if ((dstfd = openat(g_roots[0].fd, dstpath,
+                      O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                      st->st_mode & 07777)) == -1) {
+    unassert(!close(srcfd));
+    free(buf);
+    return -1;
+  }
+  for (rc = 0;;) {
+    if ((got = read(srcfd, buf, kCopyUpChunk)) <= 0) {
+      if (got == -1) rc = -1;
+      break;
+    }
+    for (i = 0; i < got; i += wrote) {
+      if ((wrote = write(dstfd, buf + i, got - i)) == -1) break;
+    }
+    if (i < got) {
+      rc = -1;
+      break;
+    }
+  }
+  if (close(dstfd)) rc = -1;
+  unassert(!close(srcfd));
+  free(buf);
+  return rc;
+}
+
+// copies `path` from lower layer to upper layer so it can be changed
+static int CopyUp(const char *path, const struct UnionLookup *lk) {
+  int rc;
+  ssize_t n;
+  int lowerfd;
+  struct stat st;
+  const char *lowerpath;
+  char name[sizeof(COPYUP) + 32];
+  char tmp[PATH_MAX], buf[PATH_MAX];
+  if (CopyUpParents(path) == -1) return -1;
+  lowerfd = g_roots[lk->layer].fd;
+  lowerpath = GetOverlayPath(lk->layer, path);
+  if (fstatat(lowerfd, lowerpath, &st, AT_SYMLINK_NOFOLLOW)) return -1;
+  if (S_ISDIR(st.st_mode)) return CopyUpDirectory(path);
+  // the file is copied under a temporary name and then renamed, so
+  // other processes never see the upper layer copy half finished.
+  snprintf(name, sizeof(name), "%s.%d.%u", COPYUP, (int)getpid(),
+           atomic_fetch_add_explicit(&g_copyups, 1, memory_order_relaxed));
+  if (GetSiblingPath(path, name, tmp) == -1) return -1;
+  if (S_ISREG(st.st_mode)) {
+    rc = CopyUpFile(lowerfd, lowerpath, tmp, &st);
+  } else if (S_ISLNK(st.st_mode)) {
+    if ((n = readlinkat(lowerfd, lowerpath, buf, sizeof(buf) - 1)) != -1) {
+      buf[n] = 0;
+      rc = symlinkat(buf, g_roots[0].fd, tmp);
+    } else {
+      rc = -1;
+    }
+  } else if (S_ISFIFO(st.st_mode)) {
+    rc = mkfifoat(g_roots[0].fd, tmp, st.st_mode & 07777);
+  } else {
+    rc = mknodat(g_roots[0].fd, tmp, st.st_mode, st.st_rdev);
+  }
+  if (rc != -1) {
+    CopyAttributes(tmp, &st);
+    rc = renameat(g_roots[0].fd, tmp, g_roots[0].fd, path + 1);
+  }
+  if (rc == -1) {
+    LOGF("overlay copy up of %s failed: %s", path,
+             DescribeHostErrno(errno));
+    (void)unlinkat(g_roots[0].fd, tmp, 0);
+  }
+  InvalidateOverlays();
+  return rc;
+}
+
+// hides `path` in lower layers by creating a whiteout file
+static int Whiteout(const char *path) {
+  int fd;
+  char buf[PATH_MAX];
+  if (CopyUpParents(path) == -1) return -1;
+  if (GetWhiteoutPath(path, buf) == -1) return -1;
+  if ((fd = openat(g_roots[0].fd, buf, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                   0600)) == -1) {
+    return -1;
+  }
+  unassert(!close(fd));
+  return 0;
+}
+
+// stops upper layer directory `path` from merging lower directories
+static int MakeOpaque(const char *path) {
+  int fd;
+  char buf[PATH_MAX];
+  if (strlen(path) + sizeof(OPAQUE) + 1 > sizeof(buf)) return enametoolong();
+  stpcpy(stpcpy(stpcpy(buf, path + 1), "/"), OPAQUE);
+  if ((fd = openat(g_roots[0].fd, buf, O_WRONLY | O_CREAT | O_CLOEXEC,
+                   0600)) == -1) {
+    return -1;
+  }
+  unassert(!close(fd));
+  return 0;
+}
+
+// readies upper layer for creating `path`, which mustn't exist yet
+//
+// if the parent directory is a symbolic link, then `path` is changed
+// so it points into the directory the link refers to.
+static int PrepareCreate(char path[PATH_MAX], struct UnionLookup *lk) {
+  size_t n, k;
+  char dir[PATH_MAX];
+  const char *name;
+  struct UnionLookup parent;
+  if (LookupUnion(path, lk) == -1) return -1;
+  if (lk->layer != -1) return eexist();
+  if (lk->err != ENOENT) {
+    errno = lk->err;
+    return -1;
+  }
+  GetParentPath(path, dir);
+  if (LookupOrFollowUnion(dir, &parent, true) == -1) return -1;
+  if (!S_ISDIR(parent.mode)) return enotdir();
+  name = strrchr(path, '/') + 1;
+  n = strlen(dir);
+  k = name - path - 1;
+  if (k ? n != k || memcmp(dir, path, k) : !!dir[1]) {
+    if (n + 1 + strlen(name) + 1 > PATH_MAX) return enametoolong();
+    memmove(path + n + !!dir[1], name, strlen(name) + 1);
+    memcpy(path, dir, n);
+    if (dir[1]) path[n] = '/';
+    if (LookupUnion(path, lk) == -1) return -1;
+    if (lk->layer != -1) return eexist();
+  }
+  if (CopyUpParents(path) == -1) return -1;
+  if (lk->whiteout) {
+    if (GetWhiteoutPath(path, dir) == -1) return -1;
+    if (unlinkat(g_roots[0].fd, dir, 0) == -1 && errno != ENOENT) return -1;
+    InvalidateOverlays();
+  }
+  lk->layer = 0;
+  return 0;
+}
+
+static void AddDirent(struct UnionListing *l, const char *name, u64 ino,
+                      int type, int layer, bool whiteout) {
+  long c;
+  char *s;
+  struct UnionDirent *p;
+  if (l->n == l->c) {
+    c = l->c ? l->c * 2 : 32;
+    if (!(p = (struct UnionDirent *)realloc(l->p, c * sizeof(*p)))) return;
+    l->p = p;
+    l->c = c;
+  }
+  if (!(s = strdup(name))) return;
+  p = l->p + l->n++;
+  p->ino = ino;
+  p->type = type;
+  p->layer = layer;
+  p->whiteout = whiteout;
+  p->name = s;
+}
+
+static void FreeListing(struct UnionListing *l) {
+  long i;
+  for (i = 0; i < l->n; ++i) {
+    free(l->p[i].name);
+  }
+  free(l->p);
+  l->n = 0;
+  l->c = 0;
+  l->p = 0;
+}
+
+static int CompareDirents(const void *a, const void *b) {
+  int c;
+  const struct UnionDirent *x = (const struct UnionDirent *)a;
+  const struct UnionDirent *y = (const struct UnionDirent *)b;
+  if ((c = strcmp(x->name, y->name))) return c;
+  if (x->layer != y->layer) return x->layer < y->layer ? -1 : 1;
+  return x->whiteout - y->whiteout;
+}
+
+// adds entries of directory `path` in layer `i` to listing
+static int ListLayer(size_t i, const char *path, struct UnionListing *l,
+                     bool *opaque) {
+  int fd, type;
+  DIR *dir;
+  bool whiteout;
+  const char *name;
+  struct dirent *ent;
+  if ((fd = openat(g_roots[i].fd, GetOverlayPath(i, path),
+                   O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1) {
+    return errno == ENOENT || errno == ENOTDIR ? 0 : -1;
+  }
+  if (!(dir = fdopendir(fd))) {
+    unassert(!close(fd));
+    return -1;
+  }
+  while ((ent = readdir(dir))) {
+    name = ent->d_name;
+    whiteout = false;
+    if (!i && !strncmp(name, WHITEOUT, strlen(WHITEOUT))) {
+      if (!strcmp(name, OPAQUE)) *opaque = true;
+      if (!strncmp(name + strlen(WHITEOUT), WHITEOUT, strlen(WHITEOUT))) {
+        continue;
+      }
+      name += strlen(WHITEOUT);
+      whiteout = true;
+    }
+#ifdef DT_UNKNOWN
+    type = ent->d_type;
+#else
+    type = 0;
+#endif
+    AddDirent(l, name, ent->d_ino, type, i, whiteout);
+  }
+  unassert(!closedir(dir));
+  return 0;
+}
+
+// lists merged contents of union directory `path`, sorted by name
+static int ListUnion(const char *path, struct UnionListing *l) {
+  size_t i;
+  long j, k;
+  bool opaque, whiteout;
+  opaque = false;
+  if (ListLayer(0, path, l, &opaque) == -1) goto OnFailure;
+  if (!opaque && !IsHiddenFromLowers(path, &whiteout)) {
+    for (i = 1; g_overlays[i]; ++i) {
+      if (g_roots[i].fd == -1) continue;
+      if (ListLayer(i, path, l, &opaque) == -1) goto OnFailure;
+    }
+  }
+  if (l->n) qsort(l->p, l->n, sizeof(*l->p), CompareDirents);
+  // keep entry from topmost layer, unless it's been whited out there
+  for (j = k = 0; j < l->n;) {
+    struct UnionDirent e = l->p[j];
+    for (++j; j < l->n && !strcmp(l->p[j].name, e.name); ++j) {
+      free(l->p[j].name);
+    }
+    if (e.whiteout) {
+      free(e.name);
+    } else {
+      l->p[k++] = e;
+    }
+  }
+  l->n = k;
+  return 0;
+OnFailure:
+  FreeListing(l);
+  return -1;
+}
+
+// returns 1 if union directory `path` is empty, 0 if not, or -1
+static int IsEmptyUnion(const char *path) {
+  long i;
+  int rc = 1;
+  struct UnionListing l = {0};
+  if (ListUnion(path, &l) == -1) return -1;
+  for (i = 0; i < l.n; ++i) {
+    if (strcmp(l.p[i].name, ".") && strcmp(l.p[i].name, "..")) {
+      rc = 0;
+      break;
+    }
+  }
+  FreeListing(&l);
+  return rc;
+}
+
+// removes whiteouts and markers from upper layer directory `path`
+static int RemoveMarkers(const char *path) {
+  int fd;
+  DIR *dir;
+  int rc = 0;
+  struct dirent *ent;
+  if ((fd = openat(g_roots[0].fd, GetOverlayPath(0, path),
+                   O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1) {
+    return -1;
+  }
+  if (!(dir = fdopendir(fd))) {
+    unassert(!close(fd));
+    return -1;
+  }
+  while ((ent = readdir(dir))) {
+    if (!strncmp(ent->d_name, WHITEOUT, strlen(WHITEOUT)) &&
+        unlinkat(fd, ent->d_name, 0) == -1) {
+      rc = -1;
+    }
+  }
+  unassert(!closedir(dir));
+  return rc;
+}
+
+static ssize_t UnionGeneric(char path[PATH_MAX], void *args,
+                            ssize_t fgenericat(int, const char *, void *),
+                            int how) {
+  ssize_t rc;
+  struct stat st;
+  struct UnionLookup lk;
+  switch (how & ~kFollows) {
+    case kReads:
+      if (LookupOrFollowUnion(path, &lk, how & kFollows) == -1) return -1;
+      break;
+    case kModifies:
+      if (LookupOrFollowUnion(path, &lk, how & kFollows) == -1) return -1;
+      if (lk.layer > 0) {
+        if (CopyUp(path, &lk) == -1) return -1;
+        lk.layer = 0;
+      }
+      break;
+    case kCreates:
+      if (PrepareCreate(path, &lk) == -1) return -1;
+      break;
+    default:
+      __builtin_unreachable();
+  }
+  rc = fgenericat(g_roots[lk.layer].fd, GetOverlayPath(lk.layer, path), args);
+  if (rc != -1 && (how & ~kFollows) == kCreates) {
+    // directories created where a lower one was deleted start empty
+    if (lk.whiteout &&
+        !fstatat(g_roots[0].fd, path + 1, &st, AT_SYMLINK_NOFOLLOW) &&
+        S_ISDIR(st.st_mode)) {
+      (void)MakeOpaque(path);
+    }
+    InvalidateOverlays();
+  }
+  return rc;
+}
+
+static int UnionOpen(char path[PATH_MAX], int flags, int mode) {
+  int fd;
+  bool writes;
+  struct UnionLookup lk;
+  writes = (flags & O_ACCMODE) != O_RDONLY || (flags & O_TRUNC);
+  if (((flags & O_NOFOLLOW) ? LookupUnion(path, &lk)
+                            : FollowUnion(path, &lk)) == -1) {
+    return -1;
+  }
+  if (lk.layer != -1) {
+    if ((flags & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL)) return eexist();
+    // only regular files are copied up, since writing to things like
+    // fifos and devices doesn't change anything in the file system.
+    if (writes && lk.layer > 0 && S_ISREG(lk.mode)) {
+      if (CopyUp(path, &lk) == -1) return -1;
+      lk.layer = 0;
+    }
+  } else if (flags & O_CREAT) {
+    if (PrepareCreate(path, &lk) == -1) return -1;
+  } else {
+    errno = lk.err;
+    return -1;
+  }
+  if ((fd = openat(g_roots[lk.layer].fd, GetOverlayPath(lk.layer, path), flags,
+                   mode)) == -1) {
+    return -1;
+  }
+  if (!lk.mode) InvalidateOverlays();
+  if (S_ISDIR(lk.mode) || lk.layer > 0) TrackDirectory(fd, path);
+  return fd;
+}
+
+static int UnionUnlink(const char *path, int flags) {
+  int rc;
+  bool lower;
+  struct UnionLookup lk;
+  if (LookupUnion(path, &lk) == -1) return -1;
+  if (lk.layer == -1) {
+    errno = lk.err;
+    return -1;
+  }
+  if (!path[1]) return ebusy();
+  if (flags & AT_REMOVEDIR) {
+    if (!S_ISDIR(lk.mode)) return enotdir();
+    if ((rc = IsEmptyUnion(path)) == -1) return -1;
+    if (!rc) return enotempty();
+  } else if (S_ISDIR(lk.mode)) {
+    return eisdir();
+  }
+  lower = lk.layer > 0 || HasLower(path);
+  if (!lk.layer) {
+    if (S_ISDIR(lk.mode) && RemoveMarkers(path) == -1) return -1;
+    if (unlinkat(g_roots[0].fd, path + 1, flags) == -1) return -1;
+  }
+  rc = lower ? Whiteout(path) : 0;
+  if (S_ISDIR(lk.mode) || lower) MoveDirectories(path, 0);
+  InvalidateOverlays();
+  return rc;
+}
+
+static int UnionRename(char src[PATH_MAX], char dst[PATH_MAX]) {
+  bool lower;
+  struct UnionLookup s, d;
+  if (LookupOrFollowUnion(src, &s, false) == -1) return -1;
+  if (!src[1]) return ebusy();
+  lower = s.layer > 0 || HasLower(src);
+  // like linux overlayfs without redirect_dir, merged directories can't
+  // be renamed, and programs like mv will fall back to copying instead
+  if (S_ISDIR(s.mode) && lower) return exdev();
+  if (!strcmp(src, dst)) return 0;
+  if (LookupUnion(dst, &d) == -1) return -1;
+  if (d.layer != -1) {
+    if (S_ISDIR(d.mode) && (d.layer > 0 || HasLower(dst))) return exdev();
+    if (CopyUpParents(dst) == -1) return -1;
+  } else if (PrepareCreate(dst, &d) == -1) {
+    return -1;
+  }
+  if (s.layer > 0 && CopyUp(src, &s) == -1) return -1;
+  if (renameat(g_roots[0].fd, src + 1, g_roots[0].fd, dst + 1) == -1) {
+    return -1;
+  }
+  if (S_ISDIR(s.mode) || lower) MoveDirectories(src, dst);
+  InvalidateOverlays();
+  return lower ? Whiteout(src) : 0;
+}
+
+static int UnionLink(char src[PATH_MAX], char dst[PATH_MAX], int flags) {
+  struct UnionLookup s, d;
+  if (LookupOrFollowUnion(src, &s, flags & AT_SYMLINK_FOLLOW) == -1) return -1;
+  if (S_ISDIR(s.mode)) return eperm();
+  if (PrepareCreate(dst, &d) == -1) return -1;
+  if (s.layer > 0 && CopyUp(src, &s) == -1) return -1;
+  if (linkat(g_roots[0].fd, src + 1, g_roots[0].fd, dst + 1, 0) == -1) {
+    return -1;
+  }
+  InvalidateOverlays();
+  return 0;
+}
+
+// gets union paths for two-path operation like rename() and link()
+// @return 1 on success, 0 if neither path is in the union, or -1
+static int GetUnionPaths(int srcdirfd, const char *srcpath, int dstdirfd,
+                         const char *dstpath, char src[PATH_MAX],
+                         char dst[PATH_MAX]) {
+  int rc, rc2;
+  if ((rc = GetUnionPath(srcdirfd, srcpath, src)) == -1) return -1;
+  if ((rc2 = GetUnionPath(dstdirfd, dstpath, dst)) == -1) return -1;
+  if (rc != rc2) return exdev();
+  return rc;
+}
+
+static void OverlaysBeforeFork(void) {
+  LOCK(&g_union_lock);
+}
+
+static void OverlaysAfterFork(void) {
+  UNLOCK(&g_union_lock);
 }
 
 // if the user only specified a single overlay, then we treat it as
@@ -89,11 +1269,22 @@ int SetOverlays(const char *config, bool cd_into_chroot) {
   size_t i, j;
   static int once;
   bool has_real_root;
+  bool has_upper;
+  struct OverlayRoot *roots;
   char *path, *path2, **paths;
   if (!config) return efault();
   if (!(paths = SplitString(config, ':'))) {
     return -1;
   }
+  has_upper = paths[0][0] == '+';
+  if (has_upper) {
+    memmove(paths[0], paths[0] + 1, strlen(paths[0]));
+    if (!paths[0][0] || (paths[0][0] == '/' && !paths[0][1])) {
+      LOGF("blink overlays upper layer can't be the real root");
+      FreeStrings(paths);
+      return einval();
+    }
+  }
   // normalize absolute paths at startup and
   // remove non-existent paths
   has_real_root = false;
@@ -101,7 +1292,14 @@ int SetOverlays(const char *config, bool cd_into_chroot) {
   do {
     path = paths[i++];
     if (path) {
-      if (!path[0] || (path[0] == '/' && !path[1])) {
+      if (path[0] == '+') {
+        LOGF("only the first blink overlay may be an upper layer");
+        for (; paths[i]; ++i) free(paths[i]);
+        free(path);
+        paths[j] = 0;
+        FreeStrings(paths);
+        return einval();
+      } else if (!path[0] || (path[0] == '/' && !path[1])) {
         path[0] = 0;
         has_real_root = true;
       } else {
@@ -110,7 +1308,17 @@ int SetOverlays(const char *config, bool cd_into_chroot) {
         path = path2;
         path2 = (char *)malloc(PATH_MAX + 1);
         if (!realpath(path, path2)) {
+          if (i == 1 && has_upper) {
+            LOGF("blink overlays upper layer %s: %s", path,
+                 DescribeHostErrno(errno));
+            for (; paths[i]; ++i) free(paths[i]);
+            free(path);
+            free(path2);
+            free(paths);
+            return einval();
+          }
           free(path);
+          free(path2);
           continue;
         }
         free(path);
@@ -124,38 +1332,62 @@ int SetOverlays(const char *config, bool cd_into_chroot) {
     FreeStrings(paths);
     return einval();
   }
-  if (!has_real_root && paths[1]) {
+  if (!has_real_root && !has_upper && paths[1]) {
     LOGF("if multiple overlays are specified, "
          "one of them must be empty string");
     FreeStrings(paths);
     return einval();
   }
-  if (cd_into_chroot && IsRestrictedRoot(paths)) {
+  if (cd_into_chroot && !has_upper && IsRestrictedRoot(paths)) {
     if (chdir(paths[0])) {
       LOGF("failed to cd into blink overlay: %s", DescribeHostErrno(errno));
       FreeStrings(paths);
       return -1;
     }
   }
+  if (!(roots = OpenRoots(paths))) {
+    FreeStrings(paths);
+    return -1;
+  }
+  if (has_upper && roots[0].fd < 0) {
+    FreeRoots(roots);
+    FreeStrings(paths);
+    return einval();
+  }
   if (!once) {
     atexit(FreeOverlays);
+    unassert(!pthread_atfork(OverlaysBeforeFork, OverlaysAfterFork,
+                             OverlaysAfterFork));
     once = 1;
   }
   FreeOverlays();
+  AllocateMisses();
+  InvalidateOverlays();
   g_overlays = paths;
+  g_roots = roots;
+  if ((g_union = has_upper)) {
+    g_salt = HashPath(config);
+    if (!MapHostCwd()) {
+      if (cd_into_chroot && chdir(paths[0])) {
+        LOGF("failed to cd into blink overlay: %s", DescribeHostErrno(errno));
+        return -1;
+      }
+      strcpy(g_cwd, "/");
+    }
+  }
   return 0;
 }
 
-// if we get these failures when opening a temporary dirfd of a user
-// supplied overlay path, then it's definitely not a user error, and
-// therefore not safe to continue.
-static bool IsUnrecoverableErrno(void) {
-  return errno == EINTR || errno == EMFILE || errno == ENFILE;
-}
-
 char *OverlaysGetcwd(char *output, size_t size) {
   size_t n, m;
   char *cwd, buf[PATH_MAX];
+  if (g_union) {
+    LOCK(&g_union_lock);
+    n = strlen(g_cwd);
+    if (n + 1 <= size) memcpy(output, g_cwd, n + 1);
+    UNLOCK(&g_union_lock);
+    return n + 1 <= size ? output : 0;
+  }
   if (!(cwd = (getcwd)(buf, sizeof(buf)))) return 0;
   n = strlen(cwd);
   if (IsRestrictedRoot(g_overlays)) {
@@ -182,11 +1414,28 @@ static int Chdir(const char *path) {
   return chdir(path);
 }
 
+static int UnionChdir(char path[PATH_MAX]) {
+  struct UnionLookup lk;
+  char buf[PATH_MAX];
+  if (LookupOrFollowUnion(path, &lk, true) == -1) return -1;
+  if (!S_ISDIR(lk.mode)) return enotdir();
+  if (GetHostPath(lk.layer, path, buf) == -1) return -1;
+  if (Chdir(buf) == -1) return -1;
+  LOCK(&g_union_lock);
+  strcpy(g_cwd, path);
+  UNLOCK(&g_union_lock);
+  return 0;
+}
+
 int OverlaysChdir(const char *path) {
   size_t n, m;
   char buf[PATH_MAX];
   if (!path) return efault();
   if (!path[0]) return enoent();
+  if (g_union) {
+    if (GetUnionPath(AT_FDCWD, path, buf) == -1) return -1;
+    return UnionChdir(buf);
+  }
   if (IsRestrictedRoot(g_overlays) && path[0] == '/') {
     if (!path[1]) {
       return Chdir(g_overlays[0]);
@@ -206,51 +1455,64 @@ int OverlaysChdir(const char *path) {
   return Chdir(path);
 }
 
+int OverlaysFchdir(int fd) {
+  char buf[PATH_MAX];
+  if (fchdir(fd) == -1) return -1;
+  if (g_union) {
+    if (GetDirectoryPath(fd, buf)) {
+      LOCK(&g_union_lock);
+      strcpy(g_cwd, buf);
+      UNLOCK(&g_union_lock);
+    } else {
+      LOCK(&g_union_lock);
+      MapHostCwd();
+      UNLOCK(&g_union_lock);
+    }
+  }
+  return 0;
+}
+
 int OverlaysOpen(int dirfd, const char *path, int flags, int mode) {
-  int fd;
+  u32 gen;
+  int fd, e;
   size_t i;
+  u64 hash;
   int err = -1;
+  bool creates;
+  char buf[PATH_MAX];
   if (!path) return efault();
   if (!*path) return enoent();
+  if (g_union) {
+    if ((e = GetUnionPath(dirfd, path, buf)) == -1) return -1;
+    if (e) return UnionOpen(buf, flags, mode);
+  }
+  creates = !!(flags & O_CREAT);
   if (path[0] != '/' && path[0]) {
-    return openat(dirfd, path, flags, mode);
+    fd = openat(dirfd, path, flags, mode);
+    if (creates && fd != -1) InvalidateOverlays();
+    return fd;
   }
+  hash = HashPath(path);
   for (i = 0; g_overlays[i]; ++i) {
-    if (!*g_overlays[i]) {
-      if ((fd = open(path, flags, mode)) != -1) {
-        return fd;
-      }
-      if (errno != ENOENT && errno != ENOTDIR) {
-        return -1;
-      }
-      if (err == -1) {
-        err = errno;
-      }
-    } else {
-      dirfd = open(g_overlays[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0);
-      if (dirfd == -1) {
-        if (IsUnrecoverableErrno()) {
-          return -1;
-        } else {
-          LOGF("bad overlay %s: %s", g_overlays[i], DescribeHostErrno(errno));
-          continue;
-        }
-      }
-      if ((fd = openat(dirfd, !path[1] ? "." : path + 1, flags, mode)) != -1) {
-        unassert(dup2(fd, dirfd) == dirfd);
-        if (flags & O_CLOEXEC) {
-          unassert(!fcntl(dirfd, F_SETFD, FD_CLOEXEC));
-        }
-        unassert(!close(fd));
-        return dirfd;
-      }
-      if (err == -1) {
-        err = errno;
-      }
-      unassert(!close(dirfd));
-      if (errno != ENOENT && errno != ENOTDIR) {
-        return -1;
-      }
+    if (g_roots[i].fd == -1) continue;
+    if (!creates && IsKnownMiss(g_roots + i, path, hash, &e)) {
+      if (err == -1) err = e;
+      continue;
+    }
+    gen = GetMissGeneration();
+    if ((fd = openat(g_roots[i].fd, GetOverlayPath(i, path), flags, mode)) !=
+        -1) {
+      if (creates) InvalidateOverlays();
+      return fd;
+    }
+    if (errno != ENOENT && errno != ENOTDIR) {
+      return -1;
+    }
+    if (err == -1) {
+      err = errno;
+    }
+    if (!creates) {
+      RememberMiss(g_roots + i, path, GetOverlayPath(i, path), hash, gen);
     }
   }
   unassert(err != -1);
@@ -258,49 +1520,54 @@ int OverlaysOpen(int dirfd, const char *path, int flags, int mode) {
   return -1;
 }
 
+// performs operation on the first overlay where `path` exists. if the
+// operation creates names then the negative lookup cache isn't used,
+// and it's invalidated when the operation succeeds. `how` says how the
+// operation uses `path`, which matters when there's an upper layer.
 static ssize_t OverlaysGeneric(int dirfd, const char *path, void *args,
-                               ssize_t fgenericat(int, const char *, void *)) {
+                               ssize_t fgenericat(int, const char *, void *),
+                               int how) {
   _Static_assert(sizeof(ssize_t) >= sizeof(int), "");
+  u32 gen;
+  int e;
   size_t i;
+  u64 hash;
   ssize_t rc;
   int err = -1;
+  bool mutates;
+  char buf[PATH_MAX];
   if (!path) return efault();
   if (!*path) return enoent();
+  if (g_union) {
+    if ((e = GetUnionPath(dirfd, path, buf)) == -1) return -1;
+    if (e) return UnionGeneric(buf, args, fgenericat, how);
+  }
+  mutates = (how & ~kFollows) >= kCreates;
   if (path[0] != '/' && path[0]) {
-    return fgenericat(dirfd, path, args);
+    rc = fgenericat(dirfd, path, args);
+    if (mutates && rc != -1) InvalidateOverlays();
+    return rc;
   }
+  hash = HashPath(path);
   for (i = 0; g_overlays[i]; ++i) {
-    if (!*g_overlays[i]) {
-      if ((rc = fgenericat(AT_FDCWD, path, args)) != -1) {
-        return rc;
-      }
-      if (err == -1) {
-        err = errno;
-      }
-      if (err != ENOENT && err != ENOTDIR) {
-        return -1;
-      }
-    } else {
-      dirfd = open(g_overlays[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0);
-      if (dirfd == -1) {
-        if (IsUnrecoverableErrno()) {
-          return -1;
-        } else {
-          LOGF("bad overlay %s: %s", g_overlays[i], DescribeHostErrno(errno));
-          continue;
-        }
-      }
-      if ((rc = fgenericat(dirfd, !path[1] ? "." : path + 1, args)) != -1) {
-        unassert(!close(dirfd));
-        return rc;
-      }
-      if (err == -1) {
-        err = errno;
-      }
-      unassert(!close(dirfd));
-      if (errno != ENOENT && errno != ENOTDIR) {
-        return -1;
-      }
+    if (g_roots[i].fd == -1) continue;
+    if (!mutates && IsKnownMiss(g_roots + i, path, hash, &e)) {
+      if (err == -1) err = e;
+      continue;
+    }
+    gen = GetMissGeneration();
+    if ((rc = fgenericat(g_roots[i].fd, GetOverlayPath(i, path), args)) != -1) {
+      if (mutates) InvalidateOverlays();
+      return rc;
+    }
+    if (err == -1) {
+      err = errno;
+    }
+    if (errno != ENOENT && errno != ENOTDIR) {
+      return -1;
+    }
+    if (!mutates) {
+      RememberMiss(g_roots + i, path, GetOverlayPath(i, path), hash, gen);
     }
   }
   unassert(err != -1);
@@ -308,6 +1575,32 @@ static ssize_t OverlaysGeneric(int dirfd, const char *path, void *args,
   return -1;
 }
 
+// performs operation on file descriptor. if it's a union file that was
+// opened from a lower layer, then the operation is performed on a copy
+// in the upper layer instead, since lower layers are never changed. it
+// fails with EROFS if `fd` is some other file of a lower layer.
+static int OverlaysFgeneric(int fd, void *args,
+                            ssize_t fgenericat(int, const char *, void *),
+                            int fgeneric(int, void *)) {
+  size_t i;
+  struct stat st;
+  char buf[PATH_MAX];
+  if (!g_union) return fgeneric(fd, args);
+  if (fstat(fd, &st) == -1) return -1;
+  if (GetTrackedPath(&st, buf)) {
+    if (!*buf) return erofs();
+    return UnionGeneric(buf, args, fgenericat, kModifies);
+  }
+  if (st.st_dev != g_roots[0].dev) {
+    for (i = 1; g_overlays[i]; ++i) {
+      if (g_roots[i].fd != -1 && g_roots[i].dev == st.st_dev) {
+        return erofs();
+      }
+    }
+  }
+  return fgeneric(fd, args);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 struct Stat {
@@ -322,7 +1615,8 @@ static ssize_t Stat(int dirfd, const char *path, void *vargs) {
 
 int OverlaysStat(int dirfd, const char *path, struct stat *st, int flags) {
   struct Stat args = {st, flags};
-  return OverlaysGeneric(dirfd, path, &args, Stat);
+  return OverlaysGeneric(dirfd, path, &args, Stat,
+                         kReads | (flags & AT_SYMLINK_NOFOLLOW ? 0 : kFollows));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -339,7 +1633,9 @@ static ssize_t Access(int dirfd, const char *path, void *vargs) {
 
 int OverlaysAccess(int dirfd, const char *path, mode_t mode, int flags) {
   struct Access args = {mode, flags};
-  return OverlaysGeneric(dirfd, path, &args, Access);
+  return OverlaysGeneric(
+      dirfd, path, &args, Access,
+      kReads | (flags & AT_SYMLINK_NOFOLLOW ? 0 : kFollows));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -354,8 +1650,14 @@ static ssize_t Unlink(int dirfd, const char *path, void *vargs) {
 }
 
 int OverlaysUnlink(int dirfd, const char *path, int flags) {
+  int rc;
+  char buf[PATH_MAX];
   struct Unlink args = {flags};
-  return OverlaysGeneric(dirfd, path, &args, Unlink);
+  if (g_union && path && *path) {
+    if ((rc = GetUnionPath(dirfd, path, buf)) == -1) return -1;
+    if (rc) return UnionUnlink(buf, flags);
+  }
+  return OverlaysGeneric(dirfd, path, &args, Unlink, kRemoves);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -371,7 +1673,7 @@ static ssize_t Mkdir(int dirfd, const char *path, void *vargs) {
 
 int OverlaysMkdir(int dirfd, const char *path, mode_t mode) {
   struct Mkdir args = {mode};
-  return OverlaysGeneric(dirfd, path, &args, Mkdir);
+  return OverlaysGeneric(dirfd, path, &args, Mkdir, kCreates);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -387,7 +1689,7 @@ static ssize_t Mkfifo(int dirfd, const char *path, void *vargs) {
 
 int OverlaysMkfifo(int dirfd, const char *path, mode_t mode) {
   struct Mkfifo args = {mode};
-  return OverlaysGeneric(dirfd, path, &args, Mkfifo);
+  return OverlaysGeneric(dirfd, path, &args, Mkfifo, kCreates);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -404,7 +1706,19 @@ static ssize_t Chmod(int dirfd, const char *path, void *vargs) {
 
 int OverlaysChmod(int dirfd, const char *path, mode_t mode, int flags) {
   struct Chmod args = {mode, flags};
-  return OverlaysGeneric(dirfd, path, &args, Chmod);
+  return OverlaysGeneric(
+      dirfd, path, &args, Chmod,
+      kModifies | (flags & AT_SYMLINK_NOFOLLOW ? 0 : kFollows));
+}
+
+static int Fchmod(int fd, void *vargs) {
+  struct Chmod *args = (struct Chmod *)vargs;
+  return fchmod(fd, args->mode);
+}
+
+int OverlaysFchmod(int fd, mode_t mode) {
+  struct Chmod args = {mode, 0};
+  return OverlaysFgeneric(fd, &args, Chmod, Fchmod);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -423,7 +1737,19 @@ static ssize_t Chown(int dirfd, const char *path, void *vargs) {
 int OverlaysChown(int dirfd, const char *path, uid_t uid, gid_t gid,
                   int flags) {
   struct Chown args = {uid, gid, flags};
-  return OverlaysGeneric(dirfd, path, &args, Chown);
+  return OverlaysGeneric(
+      dirfd, path, &args, Chown,
+      kModifies | (flags & AT_SYMLINK_NOFOLLOW ? 0 : kFollows));
+}
+
+static int Fchown(int fd, void *vargs) {
+  struct Chown *args = (struct Chown *)vargs;
+  return fchown(fd, args->uid, args->gid);
+}
+
+int OverlaysFchown(int fd, uid_t uid, gid_t gid) {
+  struct Chown args = {uid, gid, 0};
+  return OverlaysFgeneric(fd, &args, Chown, Fchown);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -439,7 +1765,7 @@ static ssize_t Symlink(int dirfd, const char *path, void *vargs) {
 
 int OverlaysSymlink(const char *target, int dirfd, const char *path) {
   struct Symlink args = {target};
-  return OverlaysGeneric(dirfd, path, &args, Symlink);
+  return OverlaysGeneric(dirfd, path, &args, Symlink, kCreates);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -456,7 +1782,7 @@ static ssize_t Readlink(int dirfd, const char *path, void *vargs) {
 
 ssize_t OverlaysReadlink(int dirfd, const char *path, char *buf, size_t size) {
   struct Readlink args = {buf, size};
-  return OverlaysGeneric(dirfd, path, &args, Readlink);
+  return OverlaysGeneric(dirfd, path, &args, Readlink, kReads);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -474,7 +1800,19 @@ static ssize_t Utime(int dirfd, const char *path, void *vargs) {
 int OverlaysUtime(int dirfd, const char *path, const struct timespec times[2],
                   int flags) {
   struct Utime args = {times, flags};
-  return OverlaysGeneric(dirfd, path, &args, Utime);
+  return OverlaysGeneric(
+      dirfd, path, &args, Utime,
+      kModifies | (flags & AT_SYMLINK_NOFOLLOW ? 0 : kFollows));
+}
+
+static int Futime(int fd, void *vargs) {
+  struct Utime *args = (struct Utime *)vargs;
+  return futimens(fd, args->times);
+}
+
+int OverlaysFutime(int fd, const struct timespec times[2]) {
+  struct Utime args = {times, 0};
+  return OverlaysFgeneric(fd, &args, Utime, Futime);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -487,69 +1825,39 @@ static ssize_t OverlaysGeneric2(int srcdirfd, const char *srcpath, int dstdirfd,
   int err = -1;
   ssize_t i, j;
   const char *sp, *dp;
-  int srccloseme, dstcloseme;
   if (!srcpath || !dstpath) return efault();
   if (!*srcpath || !*dstpath) return enoent();
   for (j = 0; j >= 0 && g_overlays[j]; ++j) {
     if (srcpath[0] != '/' && srcpath[0]) {
       j = -2;
       sp = srcpath;
-      srccloseme = -1;
-    } else if (!*g_overlays[j]) {
-      srcdirfd = AT_FDCWD;
-      srccloseme = -1;
-      sp = srcpath;
+    } else if (g_roots[j].fd == -1) {
+      continue;
     } else {
-      sp = !srcpath[1] ? "." : srcpath + 1;
-      srccloseme = srcdirfd =
-          open(g_overlays[j], O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0);
-      if (srcdirfd == -1) {
-        if (IsUnrecoverableErrno()) {
-          return -1;
-        } else {
-          LOGF("bad overlay %s: %s", g_overlays[j], DescribeHostErrno(errno));
-          continue;
-        }
-      }
+      srcdirfd = g_roots[j].fd;
+      sp = GetOverlayPath(j, srcpath);
     }
     for (i = 0; i >= 0 && g_overlays[i]; ++i) {
       if (dstpath[0] != '/' && dstpath[0]) {
         i = -2;
         dp = dstpath;
-        dstcloseme = -1;
-      } else if (!*g_overlays[i]) {
-        dstdirfd = AT_FDCWD;
-        dstcloseme = -1;
-        dp = dstpath;
+      } else if (g_roots[i].fd == -1) {
+        continue;
       } else {
-        dp = !dstpath[1] ? "." : dstpath + 1;
-        dstcloseme = dstdirfd =
-            open(g_overlays[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0);
-        if (dstdirfd == -1) {
-          if (IsUnrecoverableErrno()) {
-            if (srccloseme != -1) close(srccloseme);
-            return -1;
-          } else {
-            LOGF("bad overlay %s: %s", g_overlays[i], DescribeHostErrno(errno));
-            continue;
-          }
-        }
+        dstdirfd = g_roots[i].fd;
+        dp = GetOverlayPath(i, dstpath);
       }
       if ((rc = fgenericat(srcdirfd, sp, dstdirfd, dp, args)) != -1) {
-        if (dstcloseme != -1) close(dstcloseme);
-        if (srccloseme != -1) close(srccloseme);
+        InvalidateOverlays();
         return rc;
       }
       if (err == -1) {
         err = errno;
       }
-      if (dstcloseme != -1) close(dstcloseme);
       if (errno != ENOENT && errno != ENOTDIR) {
-        if (srccloseme != -1) close(srccloseme);
         return -1;
       }
     }
-    if (srccloseme != -1) close(srccloseme);
   }
   unassert(err != -1);
   errno = err;
@@ -565,6 +1873,15 @@ static ssize_t Rename(int srcdirfd, const char *srcpath, int dstdirfd,
 
 int OverlaysRename(int srcdirfd, const char *srcpath, int dstdirfd,
                    const char *dstpath) {
+  int rc;
+  char src[PATH_MAX], dst[PATH_MAX];
+  if (g_union && srcpath && dstpath && *srcpath && *dstpath) {
+    if ((rc = GetUnionPaths(srcdirfd, srcpath, dstdirfd, dstpath, src, dst)) ==
+        -1) {
+      return -1;
+    }
+    if (rc) return UnionRename(src, dst);
+  }
   return OverlaysGeneric2(srcdirfd, srcpath, dstdirfd, dstpath, 0, Rename);
 }
 
@@ -582,8 +1899,101 @@ static ssize_t Link(int srcdirfd, const char *srcpath, int dstdirfd,
 
 int OverlaysLink(int srcdirfd, const char *srcpath, int dstdirfd,
                  const char *dstpath, int flags) {
+  int rc;
   struct Link args = {flags};
+  char src[PATH_MAX], dst[PATH_MAX];
+  if (g_union && srcpath && dstpath && *srcpath && *dstpath) {
+    if ((rc = GetUnionPaths(srcdirfd, srcpath, dstdirfd, dstpath, src, dst)) ==
+        -1) {
+      return -1;
+    }
+    if (rc) return UnionLink(src, dst, flags);
+  }
   return OverlaysGeneric2(srcdirfd, srcpath, dstdirfd, dstpath, &args, Link);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Returns true if `fd` is a directory whose listing merges layers.
+ */
+bool IsMergedDirectory(int fd) {
+  return g_union && GetDirectoryPath(fd, 0);
+}
+
+DIR *OverlaysOpendir(int fd) {
+  struct OverlayStream *d;
+  char buf[PATH_MAX];
+  if (!(d = (struct OverlayStream *)calloc(1, sizeof(*d)))) return 0;
+  d->fd = fd;
+  if (g_union && GetDirectoryPath(fd, buf)) {
+    if (!(d->path = strdup(buf)) || ListUnion(buf, &d->list) == -1) {
+      free(d->path);
+      free(d);
+      return 0;
+    }
+  } else if (!(d->dir = fdopendir(fd))) {
+    free(d);
+    return 0;
+  }
+  return (DIR *)d;
+}
+
+struct dirent *OverlaysReaddir(DIR *dir) {
+  struct UnionDirent *e;
+  struct OverlayStream *d = (struct OverlayStream *)dir;
+  if (d->dir) return readdir(d->dir);
+  if (d->pos >= d->list.n) return 0;
+  e = d->list.p + d->pos++;
+  d->ent.d_ino = e->ino;
+#ifdef DT_UNKNOWN
+  d->ent.d_type = e->type;
+#endif
+  strncpy(d->ent.d_name, e->name, sizeof(d->ent.d_name) - 1);
+  return &d->ent;
+}
+
+void OverlaysRewinddir(DIR *dir) {
+  struct OverlayStream *d = (struct OverlayStream *)dir;
+  if (d->dir) {
+    rewinddir(d->dir);
+  } else {
+    // like the host, rewinding picks up changes made since opening
+    FreeListing(&d->list);
+    ListUnion(d->path, &d->list);
+    d->pos = 0;
+  }
+}
+
+#ifdef HAVE_SEEKDIR
+void OverlaysSeekdir(DIR *dir, long loc) {
+  struct OverlayStream *d = (struct OverlayStream *)dir;
+  if (d->dir) {
+    seekdir(d->dir, loc);
+  } else {
+    d->pos = loc;
+  }
+}
+
+long OverlaysTelldir(DIR *dir) {
+  struct OverlayStream *d = (struct OverlayStream *)dir;
+  if (d->dir) return telldir(d->dir);
+  return d->pos;
+}
+#endif
+
+int OverlaysClosedir(DIR *dir) {
+  int rc;
+  struct OverlayStream *d = (struct OverlayStream *)dir;
+  if (d->dir) {
+    rc = closedir(d->dir);
+  } else {
+    rc = close(d->fd);
+    FreeListing(&d->list);
+    free(d->path);
+  }
+  free(d);
+  return rc;
+}
+
 #endif /* DISABLE_OVERLAYS */
@@ -1,5 +1,6 @@
 #ifndef BLINK_OVERLAYS_H_
 #define BLINK_OVERLAYS_H_
+#include <dirent.h>
 #include <stdbool.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -8,8 +9,10 @@
 #define DEFAULT_OVERLAYS ":o"
 
 int OverlaysChdir(const char *);
+int OverlaysFchdir(int);
 int SetOverlays(const char *, bool);
 char *OverlaysGetcwd(char *, size_t);
+void InvalidateOverlays(void);
 int OverlaysUnlink(int, const char *, int);
 int OverlaysMkdir(int, const char *, mode_t);
 int OverlaysMkfifo(int, const char *, mode_t);
@@ -23,5 +26,15 @@ int OverlaysRename(int, const char *, int, const char *);
 ssize_t OverlaysReadlink(int, const char *, char *, size_t);
 int OverlaysLink(int, const char *, int, const char *, int);
 int OverlaysUtime(int, const char *, const struct timespec[2], int);
+int OverlaysFchmod(int, mode_t);
+int OverlaysFchown(int, uid_t, gid_t);
+int OverlaysFutime(int, const struct timespec[2]);
+bool IsMergedDirectory(int);
+DIR *OverlaysOpendir(int);
+struct dirent *OverlaysReaddir(DIR *);
+void OverlaysRewinddir(DIR *);
+void OverlaysSeekdir(DIR *, long);
+long OverlaysTelldir(DIR *);
+int OverlaysClosedir(DIR *);
 
 #endif /* BLINK_OVERLAYS_H_ */
@@ -0,0 +1,1232 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "blink/packfs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "blink/assert.h"
+#include "blink/atomic.h"
+#include "blink/endian.h"
+#include "blink/errno.h"
+#include "blink/flag.h"
+#include "blink/log.h"
+#include "blink/macros.h"
+#include "blink/thread.h"
+#include "blink/tunables.h"
+#include "blink/vfs.h"
+
+#if defined(__APPLE__) || defined(__NetBSD__)
+#define st_atim st_atimespec
+#define st_ctim st_ctimespec
+#define st_mtim st_mtimespec
+#endif
+
+#ifndef DISABLE_VFS
+
+// A packfs mount is a read-only image built ahead of time by blinkpack,
+// which is mapped into memory once, so that looking up paths, reading
+// files, and loading executables never touch the host filesystem.
+
+struct PackfsDevice {
+  int fd;
+  u8 *base;
+  u64 size;
+  u32 align;
+  u32 ninodes;
+  u32 ndirents;
+  const struct PackfsInode *inodes;
+  const struct PackfsDirent *dirents;
+  char *source;
+};
+
+// Open file description, which dup() shares. Since images can't change
+// nothing else is needed, and unlike tmpfs, the position isn't shared
+// with processes that fork.
+struct PackfsFile {
+  pthread_mutex_t_ lock;
+  _Atomic(u32) refs;
+  int flags;
+  u64 offset;  // file position, or directory stream position
+};
+
+struct PackfsInfo {
+  struct PackfsDevice *device;
+  u32 ino;
+  int fdflags;
+  struct PackfsFile *file;  // non-null if this is an open file
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const struct PackfsInode *PackfsInode(struct PackfsDevice *device,
+                                             u32 ino) {
+  return device->inodes + ino;
+}
+
+static u32 PackfsMode(struct PackfsDevice *device, u32 ino) {
+  return Read32(PackfsInode(device, ino)->mode);
+}
+
+static u64 PackfsSize(struct PackfsDevice *device, u32 ino) {
+  return Read64(PackfsInode(device, ino)->size);
+}
+
+static u64 PackfsOffset(struct PackfsDevice *device, u32 ino) {
+  return Read64(PackfsInode(device, ino)->offset);
+}
+
+static const char *PackfsName(struct PackfsDevice *device,
+                              const struct PackfsDirent *d) {
+  return (const char *)device->base + Read64(d->name);
+}
+
+// Checks the image can be trusted, so nothing else needs to.
+static bool PackfsVerify(struct PackfsDevice *device, u64 names) {
+  u32 i, mode, namelen;
+  u64 size, offset, name;
+  const char *s;
+  const struct PackfsDirent *d;
+  const struct PackfsInode *inode;
+  if (device->ninodes <= PACKFS_ROOT_INO ||
+      !S_ISDIR(PackfsMode(device, PACKFS_ROOT_INO))) {
+    return false;
+  }
+  for (i = PACKFS_ROOT_INO; i < device->ninodes; ++i) {
+    inode = device->inodes + i;
+    mode = Read32(inode->mode);
+    size = Read64(inode->size);
+    offset = Read64(inode->offset);
+    if (S_ISDIR(mode)) {
+      if (offset > device->ndirents || size > device->ndirents - offset ||
+          !Read32(inode->parent) || Read32(inode->parent) >= device->ninodes) {
+        return false;
+      }
+    } else if (S_ISREG(mode) || S_ISLNK(mode)) {
+      if (offset > device->size || size > device->size - offset) {
+        return false;
+      }
+    }
+  }
+  for (i = 0; i < device->ndirents; ++i) {
+    d = device->dirents + i;
+    name = Read64(d->name);
+    namelen = Read32(d->namelen);
+    if (!Read32(d->ino) || Read32(d->ino) >= device->ninodes ||
+        !namelen || namelen >= VFS_NAME_MAX || name < names ||
+        name >= device->size || namelen >= device->size - name) {
+      return false;
+    }
+    s = (const char *)device->base + name;
+    if (s[namelen] || memchr(s, '/', namelen) || !strcmp(s, ".") ||
+        !strcmp(s, "..")) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static struct PackfsDevice *PackfsLoad(const char *source) {
+  int fd;
+  struct stat st;
+  u64 inodes, dirents, names;
+  struct PackfsDevice *device;
+  const struct PackfsHeader *hdr;
+  if (!(device = (struct PackfsDevice *)calloc(1, sizeof(*device)))) {
+    enomem();
+    return NULL;
+  }
+  device->fd = -1;
+  device->base = (u8 *)MAP_FAILED;
+  if (!(device->source = strdup(source))) {
+    enomem();
+    goto cleananddie;
+  }
+  if ((fd = open(source, O_RDONLY | O_CLOEXEC)) == -1) goto cleananddie;
+  device->fd = fcntl(fd, F_DUPFD_CLOEXEC, kMinBlinkFd);
+  close(fd);
+  if (device->fd == -1) goto cleananddie;
+  if (fstat(device->fd, &st) == -1) goto cleananddie;
+  if (!S_ISREG(st.st_mode) || st.st_size < (off_t)sizeof(*hdr) ||
+      (u64)st.st_size != (size_t)st.st_size) {
+    einval();
+    goto cleananddie;
+  }
+  device->size = st.st_size;
+  device->base = (u8 *)mmap(NULL, device->size, PROT_READ, MAP_SHARED,
+                            device->fd, 0);
+  if (device->base == MAP_FAILED) goto cleananddie;
+  hdr = (const struct PackfsHeader *)device->base;
+  device->align = Read32(hdr->align);
+  device->ninodes = Read32(hdr->ninodes);
+  device->ndirents = Read32(hdr->ndirents);
+  inodes = Read64(hdr->inodes);
+  dirents = Read64(hdr->dirents);
+  names = Read64(hdr->names);
+  if (memcmp(hdr->magic, PACKFS_MAGIC, sizeof(hdr->magic)) ||
+      Read32(hdr->version) != PACKFS_VERSION ||
+      Read64(hdr->size) != device->size || !device->align ||
+      (device->align & (device->align - 1)) || inodes > device->size ||
+      device->ninodes > (device->size - inodes) / sizeof(struct PackfsInode) ||
+      dirents > device->size ||
+      device->ndirents >
+          (device->size - dirents) / sizeof(struct PackfsDirent) ||
+      names > device->size) {
+    einval();
+    goto cleananddie;
+  }
+  device->inodes = (const struct PackfsInode *)(device->base + inodes);
+  device->dirents = (const struct PackfsDirent *)(device->base + dirents);
+  if (!PackfsVerify(device, names)) {
+    einval();
+    goto cleananddie;
+  }
+  return device;
+cleananddie:
+  ERRF("failed to load packfs image %s: %s", source, strerror(errno));
+  if (device->base != MAP_FAILED) munmap(device->base, device->size);
+  if (device->fd != -1) close(device->fd);
+  free(device->source);
+  free(device);
+  return NULL;
+}
+
+// Binary searches the sorted entries of a directory.
+// @return inode number, or 0 if not found
+static u32 PackfsLookup(struct PackfsDevice *device, u32 dir,
+                        const char *name, size_t len) {
+  int c;
+  u32 namelen;
+  u64 lo, hi, mid;
+  const struct PackfsDirent *d;
+  lo = PackfsOffset(device, dir);
+  hi = lo + PackfsSize(device, dir);
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    d = device->dirents + mid;
+    namelen = Read32(d->namelen);
+    if (!(c = memcmp(name, PackfsName(device, d), MIN(len, namelen)))) {
+      c = (len > namelen) - (len < namelen);
+    }
+    if (!c) return Read32(d->ino);
+    if (c < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return 0;
+}
+
+static int PackfsCheckAccess(struct PackfsDevice *device, u32 ino, int want) {
+  uid_t uid;
+  const struct PackfsInode *inode = PackfsInode(device, ino);
+  int mode = Read32(inode->mode);
+  if (want & W_OK) return erofs();
+  if ((mode & want) == want) return 0;  // others are permitted
+  if (!(uid = geteuid())) {
+    if ((want & X_OK) && !S_ISDIR(mode) && !(mode & 0111)) return eacces();
+    return 0;
+  }
+  if (uid == Read32(inode->uid)) {
+    mode >>= 6;
+  } else if (getegid() == Read32(inode->gid)) {
+    mode >>= 3;
+  }
+  if ((mode & want) != want) return eacces();
+  return 0;
+}
+
+// Returns length of name handed over by the vfs, where an empty name,
+// "." or ".." mean the directory itself and trailing slashes mean the
+// name must be a directory.
+static ssize_t PackfsLeaf(const char *name, bool *isdir) {
+  size_t len = strlen(name);
+  *isdir = false;
+  while (len && name[len - 1] == '/') {
+    *isdir = true;
+    --len;
+  }
+  if (!len || (len == 1 && name[0] == '.') ||
+      (len == 2 && name[0] == '.' && name[1] == '.')) {
+    return 0;
+  }
+  if (len >= VFS_NAME_MAX) return enametoolong();
+  return len;
+}
+
+// Looks up name inside parent directory.
+// @return inode number, or 0 w/ errno
+static u32 PackfsFind(struct VfsInfo *parent, const char *name) {
+  u32 ino;
+  bool isdir;
+  ssize_t len;
+  struct PackfsInfo *dirinfo = (struct PackfsInfo *)parent->data;
+  struct PackfsDevice *device = dirinfo->device;
+  if ((len = PackfsLeaf(name, &isdir)) == -1) return 0;
+  if (!len) return dirinfo->ino;
+  if (!S_ISDIR(PackfsMode(device, dirinfo->ino))) {
+    enotdir();
+    return 0;
+  }
+  if (PackfsCheckAccess(device, dirinfo->ino, X_OK) == -1) return 0;
+  if (!(ino = PackfsLookup(device, dirinfo->ino, name, len))) {
+    enoent();
+    return 0;
+  }
+  if (isdir && !S_ISDIR(PackfsMode(device, ino))) {
+    enotdir();
+    return 0;
+  }
+  return ino;
+}
+
+static void PackfsFillStat(struct PackfsDevice *device, u32 ino, u64 dev,
+                           struct stat *st) {
+  const struct PackfsInode *inode = PackfsInode(device, ino);
+  memset(st, 0, sizeof(*st));
+  st->st_dev = dev;
+  st->st_ino = ino;
+  st->st_mode = Read32(inode->mode);
+  st->st_nlink = Read32(inode->nlink);
+  st->st_uid = Read32(inode->uid);
+  st->st_gid = Read32(inode->gid);
+  st->st_size = Read64(inode->size);
+  if (S_ISDIR(st->st_mode)) {
+    st->st_size *= sizeof(struct PackfsDirent);
+  }
+  st->st_blksize = device->align;
+  st->st_blocks = ROUNDUP(st->st_size, 512) / 512;
+  st->st_mtim.tv_sec = (i64)Read64(inode->mtime);
+  st->st_mtim.tv_nsec = Read32(inode->mtimensec);
+  st->st_atim = st->st_ctim = st->st_mtim;
+}
+
+// Creates an info for a node on the same device as `like`.
+static int PackfsNewInfo(struct VfsInfo *like, struct VfsInfo *parent,
+                         const char *name, size_t namelen, u32 ino,
+                         struct VfsInfo **output) {
+  struct PackfsInfo *packinfo;
+  *output = NULL;
+  if (!(packinfo = (struct PackfsInfo *)calloc(1, sizeof(*packinfo)))) {
+    return enomem();
+  }
+  packinfo->device = ((struct PackfsInfo *)like->data)->device;
+  packinfo->ino = ino;
+  if (VfsCreateInfo(output) == -1) {
+    free(packinfo);
+    return -1;
+  }
+  (*output)->data = packinfo;
+  unassert(!VfsAcquireDevice(like->device, &(*output)->device));
+  if (name) {
+    if (!((*output)->name = strndup(name, namelen))) {
+      unassert(!VfsFreeInfo(*output));
+      *output = NULL;
+      return enomem();
+    }
+    (*output)->namelen = namelen;
+  }
+  unassert(!VfsAcquireInfo(parent, &(*output)->parent));
+  (*output)->dev = like->dev;
+  (*output)->ino = ino;
+  (*output)->mode = PackfsMode(packinfo->device, ino);
+  return 0;
+}
+
+static struct PackfsInfo *PackfsGetFile(struct VfsInfo *info) {
+  struct PackfsInfo *packinfo;
+  if (info == NULL) {
+    efault();
+    return NULL;
+  }
+  packinfo = (struct PackfsInfo *)info->data;
+  if (!packinfo->file) {
+    ebadf();
+    return NULL;
+  }
+  return packinfo;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int PackfsInit(const char *source, u64 flags, const void *data,
+                      struct VfsDevice **device, struct VfsMount **mount) {
+  struct PackfsDevice *packdevice;
+  struct PackfsInfo *rootinfo = NULL;
+  *device = NULL;
+  *mount = NULL;
+  if (source == NULL) {
+    return efault();
+  }
+  if (!(packdevice = PackfsLoad(source))) {
+    return -1;
+  }
+  if (VfsCreateDevice(device) == -1) {
+    goto cleananddie;
+  }
+  (*device)->data = packdevice;
+  (*device)->ops = &g_packfs.ops;
+  if (!(*mount = (struct VfsMount *)calloc(1, sizeof(struct VfsMount)))) {
+    enomem();
+    goto cleananddie;
+  }
+  if (!(rootinfo = (struct PackfsInfo *)calloc(1, sizeof(*rootinfo)))) {
+    enomem();
+    goto cleananddie;
+  }
+  rootinfo->device = packdevice;
+  rootinfo->ino = PACKFS_ROOT_INO;
+  if (VfsCreateInfo(&(*mount)->root) == -1) {
+    goto cleananddie;
+  }
+  unassert(!VfsAcquireDevice(*device, &(*mount)->root->device));
+  (*mount)->root->data = rootinfo;
+  (*mount)->root->mode = PackfsMode(packdevice, PACKFS_ROOT_INO);
+  (*mount)->root->ino = PACKFS_ROOT_INO;
+  // Weak reference.
+  (*device)->root = (*mount)->root;
+  VFS_LOGF("Mounted a packfs device for %s", source);
+  return 0;
+cleananddie:
+  if (*device) {
+    unassert(!VfsFreeDevice(*device));
+  } else {
+    munmap(packdevice->base, packdevice->size);
+    close(packdevice->fd);
+    free(packdevice->source);
+    free(packdevice);
+  }
+  if (*mount) {
+    if ((*mount)->root) {
+      unassert(!VfsFreeInfo((*mount)->root));
+    } else {
+      free(rootinfo);
+    }
+    free(*mount);
+  }
+  return -1;
+}
+
+static int PackfsFreeInfo(void *data) {
+  struct PackfsFile *file;
+  struct PackfsInfo *packinfo = (struct PackfsInfo *)data;
+  if (!packinfo) return 0;
+  if ((file = packinfo->file) &&
+      atomic_fetch_sub_explicit(&file->refs, 1, memory_order_acq_rel) == 1) {
+    unassert(!pthread_mutex_destroy(&file->lock));
+    free(file);
+  }
+  free(packinfo);
+  return 0;
+}
+
+static int PackfsFreeDevice(void *data) {
+  struct PackfsDevice *device = (struct PackfsDevice *)data;
+  if (!device) return 0;
+  munmap(device->base, device->size);
+  close(device->fd);
+  free(device->source);
+  free(device);
+  return 0;
+}
+
+static int PackfsReadmountentry(struct VfsDevice *device, char **spec,
+                                char **type, char **mntops) {
+  struct PackfsDevice *packdevice = (struct PackfsDevice *)device->data;
+  if (!(*spec = strdup(packdevice->source))) {
+    return enomem();
+  }
+  if (!(*type = strdup("packfs"))) {
+    free(*spec);
+    return enomem();
+  }
+  if (!(*mntops = strdup("ro"))) {
+    free(*type);
+    free(*spec);
+    return enomem();
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int PackfsFinddir(struct VfsInfo *parent, const char *name,
+                         struct VfsInfo **output) {
+  u32 ino;
+  bool isdir;
+  ssize_t len;
+  VFS_LOGF("PackfsFinddir(%p, \"%s\", %p)", parent, name, output);
+  if (parent == NULL || name == NULL || output == NULL) {
+    return efault();
+  }
+  if ((len = PackfsLeaf(name, &isdir)) == -1) return -1;
+  if (!len) {
+    unassert(!VfsAcquireInfo(parent, output));
+    return 0;
+  }
+  if (!(ino = PackfsFind(parent, name))) return -1;
+  return PackfsNewInfo(parent, parent, name, len, ino, output);
+}
+
+static ssize_t PackfsReadlink(struct VfsInfo *info, char **output) {
+  u64 size;
+  struct PackfsInfo *packinfo;
+  struct PackfsDevice *device;
+  if (info == NULL || output == NULL) {
+    return efault();
+  }
+  packinfo = (struct PackfsInfo *)info->data;
+  device = packinfo->device;
+  if (!S_ISLNK(PackfsMode(device, packinfo->ino))) {
+    return einval();
+  }
+  size = PackfsSize(device, packinfo->ino);
+  if (!(*output = (char *)malloc(size + 1))) {
+    return enomem();
+  }
+  memcpy(*output, device->base + PackfsOffset(device, packinfo->ino), size);
+  (*output)[size] = '\0';
+  return size;
+}
+
+// Linux reports EEXIST rather than EROFS when the name exists, which
+// VfsInit() relies upon to mount /dev and /proc on top of the image.
+static int PackfsMkdir(struct VfsInfo *parent, const char *name, mode_t mode) {
+  if (parent == NULL || name == NULL) {
+    return efault();
+  }
+  if (PackfsFind(parent, name)) {
+    return eexist();
+  }
+  if (errno != ENOENT) {
+    return -1;
+  }
+  return erofs();
+}
+
+static int PackfsMkfifo(struct VfsInfo *parent, const char *name,
+                        mode_t mode) {
+  return PackfsMkdir(parent, name, mode);
+}
+
+static int PackfsOpen(struct VfsInfo *parent, const char *name, int flags,
+                      int mode, struct VfsInfo **output) {
+  u32 ino, filemode;
+  ssize_t len;
+  bool isdir;
+  struct PackfsFile *file;
+  struct PackfsInfo *dirinfo;
+  struct PackfsDevice *device;
+  VFS_LOGF("PackfsOpen(%p, \"%s\", %d, %o, %p)", parent, name, flags, mode,
+           output);
+  if (parent == NULL || name == NULL || output == NULL) {
+    return efault();
+  }
+  if ((len = PackfsLeaf(name, &isdir)) == -1) return -1;
+  dirinfo = (struct PackfsInfo *)parent->data;
+  device = dirinfo->device;
+  if (!(ino = PackfsFind(parent, name))) {
+    if (errno == ENOENT && (flags & O_CREAT)) return erofs();
+    return -1;
+  }
+  if ((flags & O_CREAT) && (flags & O_EXCL)) {
+    return eexist();
+  }
+  filemode = PackfsMode(device, ino);
+  if (S_ISLNK(filemode)) {
+    return eloop();
+  }
+  if ((flags & O_DIRECTORY) && !S_ISDIR(filemode)) {
+    return enotdir();
+  }
+  if (S_ISDIR(filemode) &&
+      ((flags & O_ACCMODE) != O_RDONLY || (flags & (O_CREAT | O_TRUNC)))) {
+    return eisdir();
+  }
+  if (!S_ISDIR(filemode) && !S_ISREG(filemode)) {
+    return enxio();
+  }
+  if ((flags & O_ACCMODE) != O_RDONLY || (flags & O_TRUNC)) {
+    return erofs();
+  }
+  if (PackfsCheckAccess(device, ino, R_OK) == -1) {
+    return -1;
+  }
+  if (!(file = (struct PackfsFile *)calloc(1, sizeof(*file)))) {
+    return enomem();
+  }
+  unassert(!pthread_mutex_init(&file->lock, NULL));
+  file->refs = 1;
+  file->flags = flags & (O_ACCMODE | O_APPEND | O_NONBLOCK | O_DIRECTORY);
+  if (len) {
+    if (PackfsNewInfo(parent, parent, name, len, ino, output) == -1) {
+      goto cleananddie;
+    }
+  } else {
+    if (PackfsNewInfo(parent, parent->parent, parent->name, parent->namelen,
+                      ino, output) == -1) {
+      goto cleananddie;
+    }
+  }
+  ((struct PackfsInfo *)(*output)->data)->file = file;
+  return 0;
+cleananddie:
+  unassert(!pthread_mutex_destroy(&file->lock));
+  free(file);
+  return -1;
+}
+
+static int PackfsAccess(struct VfsInfo *parent, const char *name, mode_t mode,
+                        int flags) {
+  u32 ino;
+  if (parent == NULL || name == NULL) {
+    return efault();
+  }
+  if (!(ino = PackfsFind(parent, name))) return -1;
+  return PackfsCheckAccess(((struct PackfsInfo *)parent->data)->device, ino,
+                           mode & (R_OK | W_OK | X_OK));
+}
+
+static int PackfsStat(struct VfsInfo *parent, const char *name,
+                      struct stat *st, int flags) {
+  u32 ino;
+  if (parent == NULL || name == NULL || st == NULL) {
+    return efault();
+  }
+  if (!(ino = PackfsFind(parent, name))) return -1;
+  PackfsFillStat(((struct PackfsInfo *)parent->data)->device, ino,
+                 parent->dev, st);
+  return 0;
+}
+
+static int PackfsFstat(struct VfsInfo *info, struct stat *st) {
+  struct PackfsInfo *packinfo;
+  if (info == NULL || st == NULL) {
+    return efault();
+  }
+  packinfo = (struct PackfsInfo *)info->data;
+  PackfsFillStat(packinfo->device, packinfo->ino, info->dev, st);
+  return 0;
+}
+
+static int PackfsChmod(struct VfsInfo *parent, const char *name, mode_t mode,
+                       int flags) {
+  if (parent == NULL || name == NULL) {
+    return efault();
+  }
+  if (!PackfsFind(parent, name)) return -1;
+  return erofs();
+}
+
+static int PackfsFchmod(struct VfsInfo *info, mode_t mode) {
+  if (info == NULL) {
+    return efault();
+  }
+  return erofs();
+}
+
+static int PackfsChown(struct VfsInfo *parent, const char *name, uid_t uid,
+                       gid_t gid, int flags) {
+  return PackfsChmod(parent, name, 0, flags);
+}
+
+static int PackfsFchown(struct VfsInfo *info, uid_t uid, gid_t gid) {
+  return PackfsFchmod(info, 0);
+}
+
+static int PackfsFtruncate(struct VfsInfo *info, off_t length) {
+  if (!PackfsGetFile(info)) return -1;
+  if (S_ISDIR(info->mode)) return eisdir();
+  return einval();  // not open for writing
+}
+
+static int PackfsClose(struct VfsInfo *info) {
+  if (info == NULL) {
+    return efault();
+  }
+  return 0;
+}
+
+static int PackfsLink(struct VfsInfo *oldparent, const char *oldname,
+                      struct VfsInfo *newparent, const char *newname,
+                      int flags) {
+  if (oldparent == NULL || oldname == NULL || newparent == NULL ||
+      newname == NULL) {
+    return efault();
+  }
+  return erofs();
+}
+
+static int PackfsUnlink(struct VfsInfo *parent, const char *name, int flags) {
+  return PackfsChmod(parent, name, 0, flags);
+}
+
+static ssize_t PackfsTransfer(struct VfsInfo *info, const struct iovec *iov,
+                              int iovcnt, off_t offset) {
+  int i;
+  u64 pos, size, data;
+  size_t n;
+  ssize_t total;
+  struct PackfsFile *file;
+  struct PackfsInfo *packinfo;
+  struct PackfsDevice *device;
+  if (!(packinfo = PackfsGetFile(info))) return -1;
+  if (iovcnt && iov == NULL) {
+    return efault();
+  }
+  if (iovcnt < 0) {
+    return einval();
+  }
+  if (S_ISDIR(info->mode)) {
+    return eisdir();
+  }
+  device = packinfo->device;
+  file = packinfo->file;
+  size = PackfsSize(device, packinfo->ino);
+  data = PackfsOffset(device, packinfo->ino);
+  if (offset == -1) LOCK(&file->lock);
+  pos = offset == -1 ? file->offset : (u64)offset;
+  for (total = i = 0; i < iovcnt && pos < size; ++i) {
+    n = MIN(iov[i].iov_len, size - pos);
+    memcpy(iov[i].iov_base, device->base + data + pos, n);
+    pos += n;
+    total += n;
+  }
+  if (offset == -1) {
+    file->offset = pos;
+    UNLOCK(&file->lock);
+  }
+  return total;
+}
+
+static ssize_t PackfsRead(struct VfsInfo *info, void *buf, size_t size) {
+  struct iovec iov = {buf, size};
+  return PackfsTransfer(info, &iov, 1, -1);
+}
+
+static ssize_t PackfsWrite(struct VfsInfo *info, const void *buf,
+                           size_t size) {
+  if (!PackfsGetFile(info)) return -1;
+  return ebadf();  // not open for writing
+}
+
+static ssize_t PackfsPread(struct VfsInfo *info, void *buf, size_t size,
+                           off_t offset) {
+  struct iovec iov = {buf, size};
+  if (offset < 0) return einval();
+  return PackfsTransfer(info, &iov, 1, offset);
+}
+
+static ssize_t PackfsPwrite(struct VfsInfo *info, const void *buf, size_t size,
+                            off_t offset) {
+  return PackfsWrite(info, buf, size);
+}
+
+static ssize_t PackfsReadv(struct VfsInfo *info, const struct iovec *iov,
+                           int iovcnt) {
+  return PackfsTransfer(info, iov, iovcnt, -1);
+}
+
+static ssize_t PackfsWritev(struct VfsInfo *info, const struct iovec *iov,
+                            int iovcnt) {
+  return PackfsWrite(info, NULL, 0);
+}
+
+static ssize_t PackfsPreadv(struct VfsInfo *info, const struct iovec *iov,
+                            int iovcnt, off_t offset) {
+  if (offset < 0) return einval();
+  return PackfsTransfer(info, iov, iovcnt, offset);
+}
+
+static ssize_t PackfsPwritev(struct VfsInfo *info, const struct iovec *iov,
+                             int iovcnt, off_t offset) {
+  return PackfsWrite(info, NULL, 0);
+}
+
+static off_t PackfsSeek(struct VfsInfo *info, off_t offset, int whence) {
+  i64 base;
+  off_t rc;
+  u64 size;
+  struct PackfsFile *file;
+  struct PackfsInfo *packinfo;
+  if (!(packinfo = PackfsGetFile(info))) return -1;
+  file = packinfo->file;
+  size = PackfsSize(packinfo->device, packinfo->ino);
+  LOCK(&file->lock);
+  switch (whence) {
+    case SEEK_SET:
+      base = 0;
+      break;
+    case SEEK_CUR:
+      base = file->offset;
+      break;
+    case SEEK_END:
+      base = size;
+      break;
+#ifdef SEEK_DATA
+    case SEEK_DATA:
+    case SEEK_HOLE:
+      if (offset < 0 || (u64)offset >= size) {
+        UNLOCK(&file->lock);
+        return enxio();
+      }
+      base = 0;
+      if (whence == SEEK_HOLE) offset = size;
+      break;
+#endif
+    default:
+      UNLOCK(&file->lock);
+      return einval();
+  }
+  if ((offset > 0 && base > INT64_MAX - offset) || base + offset < 0) {
+    rc = einval();
+  } else {
+    rc = file->offset = base + offset;
+  }
+  UNLOCK(&file->lock);
+  return rc;
+}
+
+static int PackfsFsync(struct VfsInfo *info) {
+  if (!PackfsGetFile(info)) return -1;
+  return 0;
+}
+
+#ifdef HAVE_FALLOCATE
+static int PackfsFallocate(struct VfsInfo *info, int mode, off_t offset,
+                           off_t len) {
+  if (!PackfsGetFile(info)) return -1;
+  return ebadf();  // not open for writing
+}
+#endif
+
+#ifdef HAVE_POSIX_FADVISE
+static int PackfsFadvise(struct VfsInfo *info, off_t offset, off_t len,
+                         int advice) {
+  if (!PackfsGetFile(info)) return -1;
+  return 0;
+}
+#endif
+
+// Nothing can ever write to an image, so advisory locks can't protect
+// anything, and they're reported as granted unless a write lock is
+// requested, which would need a file that's open for writing.
+static int PackfsFlock(struct VfsInfo *info, int operation) {
+  if (!PackfsGetFile(info)) return -1;
+  return 0;
+}
+
+static int PackfsFcntl(struct VfsInfo *info, int cmd, va_list args) {
+  int rc, flags;
+  struct flock *lock;
+  struct PackfsFile *file;
+  struct PackfsInfo *packinfo;
+  if (!(packinfo = PackfsGetFile(info))) return -1;
+  file = packinfo->file;
+  if (cmd == F_GETFD) {
+    return packinfo->fdflags;
+  } else if (cmd == F_SETFD) {
+    packinfo->fdflags = va_arg(args, int);
+    return 0;
+  } else if (cmd == F_GETFL) {
+    LOCK(&file->lock);
+    rc = file->flags;
+    UNLOCK(&file->lock);
+    return rc;
+  } else if (cmd == F_SETFL) {
+    flags = va_arg(args, int) & (O_APPEND | O_NONBLOCK);
+    LOCK(&file->lock);
+    file->flags = (file->flags & ~(O_APPEND | O_NONBLOCK)) | flags;
+    UNLOCK(&file->lock);
+    return 0;
+  } else if (cmd == F_SETLK || cmd == F_SETLKW || cmd == F_GETLK) {
+    lock = va_arg(args, struct flock *);
+    if (cmd == F_GETLK) {
+      lock->l_type = F_UNLCK;
+    } else if (lock->l_type == F_WRLCK) {
+      return ebadf();
+    }
+    return 0;
+  } else {
+    return einval();
+  }
+}
+
+static int PackfsDup(struct VfsInfo *info, struct VfsInfo **newinfo) {
+  struct PackfsInfo *packinfo, *newpackinfo;
+  if (info == NULL || newinfo == NULL) {
+    return efault();
+  }
+  packinfo = (struct PackfsInfo *)info->data;
+  if (PackfsNewInfo(info, info->parent, info->name, info->namelen,
+                    packinfo->ino, newinfo) == -1) {
+    return -1;
+  }
+  newpackinfo = (struct PackfsInfo *)(*newinfo)->data;
+  if ((newpackinfo->file = packinfo->file)) {
+    atomic_fetch_add_explicit(&newpackinfo->file->refs, 1,
+                              memory_order_relaxed);
+  }
+  return 0;
+}
+
+#ifdef HAVE_DUP3
+static int PackfsDup3(struct VfsInfo *info, struct VfsInfo **newinfo,
+                      int flags) {
+  if (PackfsDup(info, newinfo) == -1) return -1;
+  if (flags & O_CLOEXEC) {
+    ((struct PackfsInfo *)(*newinfo)->data)->fdflags = FD_CLOEXEC;
+  }
+  return 0;
+}
+#endif
+
+// Files in memory never block.
+static int PackfsPoll(struct VfsInfo **infos, struct pollfd *fds, nfds_t nfds,
+                      int timeout) {
+  nfds_t i;
+  int rc = 0;
+  for (i = 0; i < nfds; ++i) {
+    fds[i].revents = fds[i].events & (POLLIN | POLLRDNORM);
+    rc += !!fds[i].revents;
+  }
+  return rc;
+}
+
+static int PackfsOpendir(struct VfsInfo *info, struct VfsInfo **output) {
+  if (info == NULL || output == NULL) {
+    return efault();
+  }
+  if (!S_ISDIR(info->mode)) {
+    return enotdir();
+  }
+  if (!((struct PackfsInfo *)info->data)->file) {
+    return ebadf();
+  }
+  unassert(!VfsAcquireInfo(info, output));
+  return 0;
+}
+
+#ifdef HAVE_SEEKDIR
+static void PackfsSeekdir(struct VfsInfo *info, long loc) {
+  struct PackfsFile *file = ((struct PackfsInfo *)info->data)->file;
+  LOCK(&file->lock);
+  file->offset = loc;
+  UNLOCK(&file->lock);
+}
+
+static long PackfsTelldir(struct VfsInfo *info) {
+  long rc;
+  struct PackfsFile *file = ((struct PackfsInfo *)info->data)->file;
+  LOCK(&file->lock);
+  rc = file->offset;
+  UNLOCK(&file->lock);
+  return rc;
+}
+#endif
+
+static u8 PackfsDirentType(u32 mode) {
+  switch (mode & S_IFMT) {
+    case S_IFDIR:
+      return DT_DIR;
+    case S_IFREG:
+      return DT_REG;
+    case S_IFLNK:
+      return DT_LNK;
+    case S_IFIFO:
+      return DT_FIFO;
+    case S_IFSOCK:
+      return DT_SOCK;
+    case S_IFCHR:
+      return DT_CHR;
+    case S_IFBLK:
+      return DT_BLK;
+    default:
+      return DT_UNKNOWN;
+  }
+}
+
+// Directory stream positions 0 and 1 are "." and "..", after which
+// position n is the entry at index n - 2 of the directory.
+static struct dirent *PackfsReaddir(struct VfsInfo *info) {
+  static _Thread_local char buf[sizeof(struct dirent) + VFS_NAME_MAX];
+  u64 pos;
+  u32 ino;
+  const char *name;
+  struct PackfsFile *file;
+  struct PackfsInfo *packinfo;
+  struct PackfsDevice *device;
+  const struct PackfsDirent *d;
+  struct dirent *de = (struct dirent *)buf;
+  if (info == NULL) {
+    efault();
+    return NULL;
+  }
+  packinfo = (struct PackfsInfo *)info->data;
+  device = packinfo->device;
+  file = packinfo->file;
+  LOCK(&file->lock);
+  pos = file->offset;
+  if (pos == 0) {
+    ino = packinfo->ino;
+    name = ".";
+  } else if (pos == 1) {
+    ino = Read32(PackfsInode(device, packinfo->ino)->parent);
+    name = "..";
+  } else if (pos - 2 < PackfsSize(device, packinfo->ino)) {
+    d = device->dirents + PackfsOffset(device, packinfo->ino) + (pos - 2);
+    ino = Read32(d->ino);
+    name = PackfsName(device, d);
+  } else {
+    UNLOCK(&file->lock);
+    return NULL;
+  }
+  de->d_ino = ino;
+  de->d_type = PackfsDirentType(PackfsMode(device, ino));
+  strcpy(de->d_name, name);
+  file->offset = pos + 1;
+  UNLOCK(&file->lock);
+  return de;
+}
+
+static void PackfsRewinddir(struct VfsInfo *info) {
+  struct PackfsFile *file = ((struct PackfsInfo *)info->data)->file;
+  LOCK(&file->lock);
+  file->offset = 0;
+  UNLOCK(&file->lock);
+}
+
+static int PackfsClosedir(struct VfsInfo *info) {
+  if (info == NULL) {
+    return efault();
+  }
+  unassert(!VfsFreeInfo(info));
+  return 0;
+}
+
+static int PackfsBind(struct VfsInfo *info, const struct sockaddr *addr,
+                      socklen_t addrlen) {
+  if (info == NULL) {
+    return efault();
+  }
+  return erofs();
+}
+
+static int PackfsRename(struct VfsInfo *oldparent, const char *oldname,
+                        struct VfsInfo *newparent, const char *newname) {
+  return PackfsLink(oldparent, oldname, newparent, newname, 0);
+}
+
+static int PackfsUtime(struct VfsInfo *parent, const char *name,
+                       const struct timespec times[2], int flags) {
+  return PackfsChmod(parent, name, 0, flags);
+}
+
+static int PackfsFutime(struct VfsInfo *info,
+                        const struct timespec times[2]) {
+  return PackfsFchmod(info, 0);
+}
+
+static int PackfsSymlink(const char *target, struct VfsInfo *parent,
+                         const char *name) {
+  if (target == NULL) {
+    return efault();
+  }
+  return PackfsMkdir(parent, name, 0);
+}
+
+// Mappings of large files come straight from the page cache of the
+// image, since blinkpack aligns their contents and pads the last page
+// with zeroes. Anything else is copied into anonymous memory instead,
+// which is equivalent because the image can't change.
+static void *PackfsMmap(struct VfsInfo *info, void *addr, size_t len, int prot,
+                        int flags, off_t offset) {
+  u8 *base;
+  size_t avail;
+  u64 size, data, pagesize;
+  struct PackfsInfo *packinfo;
+  struct PackfsDevice *device;
+  if (!(packinfo = PackfsGetFile(info))) return MAP_FAILED;
+  if (offset < 0 || !len) {
+    einval();
+    return MAP_FAILED;
+  }
+  device = packinfo->device;
+  if (!S_ISREG(PackfsMode(device, packinfo->ino))) {
+    enodev();
+    return MAP_FAILED;
+  }
+  if ((flags & MAP_SHARED) && (prot & PROT_WRITE)) {
+    eacces();
+    return MAP_FAILED;
+  }
+  pagesize = FLAG_pagesize;
+  size = PackfsSize(device, packinfo->ino);
+  data = PackfsOffset(device, packinfo->ino);
+  avail = (u64)offset < size ? MIN(len, size - offset) : 0;
+  if (avail && size >= device->align && !(device->align % pagesize) &&
+      !((data + offset) % pagesize)) {
+    base = (u8 *)mmap(addr, len, prot,
+                      (flags & ~(MAP_SHARED | MAP_PRIVATE)) | MAP_PRIVATE |
+                          MAP_ANONYMOUS,
+                      -1, 0);
+    if (base == MAP_FAILED) return MAP_FAILED;
+    if (mmap(base, avail, prot,
+             MAP_FIXED | (flags & (MAP_SHARED | MAP_PRIVATE)), device->fd,
+             data + offset) == MAP_FAILED) {
+      munmap(base, len);
+      return MAP_FAILED;
+    }
+  } else {
+    base = (u8 *)mmap(addr, len, prot | PROT_WRITE,
+                      (flags & ~(MAP_SHARED | MAP_PRIVATE)) | MAP_PRIVATE |
+                          MAP_ANONYMOUS,
+                      -1, 0);
+    if (base == MAP_FAILED) return MAP_FAILED;
+    memcpy(base, device->base + data + offset, avail);
+    if (!(prot & PROT_WRITE) && mprotect(base, len, prot) == -1) {
+      munmap(base, len);
+      return MAP_FAILED;
+    }
+  }
+  return base;
+}
+
+static int PackfsMunmap(struct VfsInfo *info, void *addr, size_t len) {
+  return 0;
+}
+
+static int PackfsMprotect(struct VfsInfo *info, void *addr, size_t len,
+                          int prot) {
+  return 0;
+}
+
+static int PackfsMsync(struct VfsInfo *info, void *addr, size_t len,
+                       int flags) {
+  return 0;
+}
+
+struct VfsSystem g_packfs = {.name = "packfs",
+                             .nodev = false,
+                             .ops = {
+                                 .Init = PackfsInit,
+                                 .Freeinfo = PackfsFreeInfo,
+                                 .Freedevice = PackfsFreeDevice,
+                                 .Readmountentry = PackfsReadmountentry,
+                                 .Finddir = PackfsFinddir,
+                                 .Traverse = NULL,
+                                 .Readlink = PackfsReadlink,
+                                 .Mkdir = PackfsMkdir,
+                                 .Mkfifo = PackfsMkfifo,
+                                 .Open = PackfsOpen,
+                                 .Access = PackfsAccess,
+                                 .Stat = PackfsStat,
+                                 .Fstat = PackfsFstat,
+                                 .Chmod = PackfsChmod,
+                                 .Fchmod = PackfsFchmod,
+                                 .Chown = PackfsChown,
+                                 .Fchown = PackfsFchown,
+                                 .Ftruncate = PackfsFtruncate,
+                                 .Close = PackfsClose,
+                                 .Link = PackfsLink,
+                                 .Unlink = PackfsUnlink,
+                                 .Read = PackfsRead,
+                                 .Write = PackfsWrite,
+                                 .Pread = PackfsPread,
+                                 .Pwrite = PackfsPwrite,
+                                 .Readv = PackfsReadv,
+                                 .Writev = PackfsWritev,
+                                 .Preadv = PackfsPreadv,
+                                 .Pwritev = PackfsPwritev,
+                                 .Seek = PackfsSeek,
+                                 .Fsync = PackfsFsync,
+                                 .Fdatasync = PackfsFsync,
+#ifdef HAVE_FALLOCATE
+                                 .Fallocate = PackfsFallocate,
+#endif
+#ifdef HAVE_POSIX_FADVISE
+                                 .Fadvise = PackfsFadvise,
+#endif
+                                 .Flock = PackfsFlock,
+                                 .Fcntl = PackfsFcntl,
+                                 .Ioctl = NULL,
+                                 .Dup = PackfsDup,
+#ifdef HAVE_DUP3
+                                 .Dup3 = PackfsDup3,
+#endif
+                                 .Poll = PackfsPoll,
+                                 .Opendir = PackfsOpendir,
+#ifdef HAVE_SEEKDIR
+                                 .Seekdir = PackfsSeekdir,
+                                 .Telldir = PackfsTelldir,
+#endif
+                                 .Readdir = PackfsReaddir,
+                                 .Rewinddir = PackfsRewinddir,
+                                 .Closedir = PackfsClosedir,
+                                 .Bind = PackfsBind,
+                                 .Connect = NULL,
+                                 .Connectunix = NULL,
+                                 .Accept = NULL,
+                                 .Listen = NULL,
+                                 .Shutdown = NULL,
+                                 .Recvmsg = NULL,
+                                 .Sendmsg = NULL,
+                                 .Recvmsgunix = NULL,
+                                 .Sendmsgunix = NULL,
+                                 .Getsockopt = NULL,
+                                 .Setsockopt = NULL,
+                                 .Getsockname = NULL,
+                                 .Getpeername = NULL,
+                                 .Rename = PackfsRename,
+                                 .Utime = PackfsUtime,
+                                 .Futime = PackfsFutime,
+                                 .Symlink = PackfsSymlink,
+                                 .Mmap = PackfsMmap,
+                                 .Munmap = PackfsMunmap,
+                                 .Mprotect = PackfsMprotect,
+                                 .Msync = PackfsMsync,
+                                 .Pipe = NULL,
+#ifdef HAVE_PIPE2
+                                 .Pipe2 = NULL,
+#endif
+                                 .Socket = NULL,
+                                 .Socketpair = NULL,
+                                 .Tcgetattr = NULL,
+                                 .Tcsetattr = NULL,
+                                 .Tcflush = NULL,
+                                 .Tcdrain = NULL,
+                                 .Tcsendbreak = NULL,
+                                 .Tcflow = NULL,
+                                 .Tcgetsid = NULL,
+                                 .Tcgetpgrp = NULL,
+                                 .Tcsetpgrp = NULL,
+#ifdef HAVE_SOCKATMARK
+                                 .Sockatmark = NULL,
+#endif
+                                 .Fexecve = NULL,
+                             }};
+
+#endif /* DISABLE_VFS */
@@ -0,0 +1,56 @@
+#ifndef BLINK_PACKFS_H_
+#define BLINK_PACKFS_H_
+
+#include "blink/types.h"
+#include "blink/vfs.h"
+
+/**
+ * @fileoverview Packed Filesystem Image Format.
+ *
+ * An image is a header, followed by an inode table, a directory entry
+ * table, a string table of names, and then file contents. Integers are
+ * little endian and offsets are relative to the start of the image.
+ * Each directory owns a contiguous run of directory entries which are
+ * sorted by name, so lookups are a binary search on the mapped image.
+ * Contents of files at least `align` bytes in size start on an `align`
+ * boundary, so they can be mapped into memory directly from the image.
+ */
+
+#define PACKFS_MAGIC    "BLINKPK1"
+#define PACKFS_VERSION  1
+#define PACKFS_ALIGN    4096
+#define PACKFS_ROOT_INO 1
+
+struct PackfsHeader {
+  u8 magic[8];     // PACKFS_MAGIC
+  u8 version[4];   // PACKFS_VERSION
+  u8 align[4];     // alignment of large file contents
+  u8 ninodes[4];   // including the unused inode zero
+  u8 ndirents[4];  //
+  u8 inodes[8];    // offset of inode table
+  u8 dirents[8];   // offset of directory entry table
+  u8 names[8];     // offset of string table
+  u8 size[8];      // size of image
+};
+
+struct PackfsInode {
+  u8 mode[4];       //
+  u8 uid[4];        //
+  u8 gid[4];        //
+  u8 nlink[4];      //
+  u8 size[8];       // bytes, or number of entries for directories
+  u8 offset[8];     // offset of contents, or first entry for directories
+  u8 mtime[8];      // seconds since epoch, signed
+  u8 mtimensec[4];  //
+  u8 parent[4];     // directories only
+};
+
+struct PackfsDirent {
+  u8 ino[4];      //
+  u8 namelen[4];  //
+  u8 name[8];     // offset of nul terminated name
+};
+
+extern struct VfsSystem g_packfs;
+
+#endif  // BLINK_PACKFS_H_
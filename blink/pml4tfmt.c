@@ -206,6 +206,8 @@ static u8 *GetPt(struct Machine *m, u64 entry, bool is_cr3) {
   return GetPageAddress(m->system, entry, is_cr3);
 }
 
+// Describes guest memory mappings. The caller should hold mmap_lock,
+// for reading or writing, unless all the other threads are stopped.
 char *FormatPml4t(struct Machine *m) {
   _Thread_local static char b[BYTES];
   u8 *pd[4];
@@ -21,18 +21,33 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
 #include "blink/atomic.h"
+#include "blink/bus.h"
+#include "blink/endian.h"
 #include "blink/errno.h"
+#include "blink/flag.h"
+#include "blink/linux.h"
 #include "blink/log.h"
 #include "blink/machine.h"
+#include "blink/macros.h"
+#include "blink/stats.h"
+#include "blink/thread.h"
 #include "blink/timespec.h"
 #include "blink/vfs.h"
+#include "blink/x86.h"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
+#ifdef HAVE_SYS_SYSMACROS_H
+#include <sys/sysmacros.h>
+#endif
+
 #ifdef __CYGWIN__
 #include <windows.h>
 #include <winternl.h>
@@ -49,6 +64,8 @@
 #define PROCFS_NAME_MAX 16
 #define PROCFS_READ_LEN 4096
 #define PROCFS_DELETED  " (deleted)"
+#define PROCFS_VIRT_END ((i64)1 << 48)
+#define PROCFS_PATH_COL 73
 
 struct ProcfsInfo {
   u64 ino;
@@ -71,7 +88,7 @@ struct ProcfsInfo {
 
 struct ProcfsOpenFile {
   pthread_mutex_t_ lock;
-  size_t index;
+  u64 index;  // record cursor, or next guest address for maps
   off_t offset;
   int openflags;
   size_t readbufstart;
@@ -88,6 +105,21 @@ struct ProcfsDevice {
   struct timespec mounttime;
 };
 
+struct ProcfsVma {
+  i64 start;           // 48-bit address of first page
+  i64 end;             // 48-bit address after last page
+  u64 key;             // protection bits shared by all pages
+  i64 offset;          // file offset of start, or -1 if anonymous
+  struct FileMap *fm;  // filemap owning pages, if any
+  long resident;       // pages the host says are in memory
+  long anonymous;      // resident pages not backed by a file
+};
+
+struct ProcfsRun {
+  uintptr_t addr;  // host address of run of host mapped pages
+  size_t size;     // bytes in run
+};
+
 enum {
   PROCFS_NULL_INO,
   PROCFS_ROOT_INO,
@@ -97,6 +129,7 @@ enum {
   PROCFS_SELF_INO,
   PROCFS_SYS_INO,
   PROCFS_UPTIME_INO,
+  PROCFS_BLINK_INO,
 
   PROCFS_FIRST_PID_INO
 };
@@ -109,16 +142,32 @@ enum {
   PROCFS_SELF_TYPE,
   PROCFS_SYS_TYPE,
   PROCFS_UPTIME_TYPE,
+  PROCFS_BLINK_TYPE,
 
   PROCFS_PIDDIR_TYPE,
   PROCFS_PIDDIR_EXE_TYPE,
   PROCFS_PIDDIR_CWD_TYPE,
   PROCFS_PIDDIR_ROOT_TYPE,
   PROCFS_PIDDIR_MOUNTS_TYPE,
+  PROCFS_PIDDIR_MAPS_TYPE,
+  PROCFS_PIDDIR_SMAPS_TYPE,
+  PROCFS_PIDDIR_STAT_TYPE,
+  PROCFS_PIDDIR_STATUS_TYPE,
   PROCFS_PIDDIR_FDDIR_TYPE,
-  PROCFS_PIDDIR_LAST_TYPE = PROCFS_PIDDIR_FDDIR_TYPE
+  PROCFS_PIDDIR_LAST_TYPE = PROCFS_PIDDIR_FDDIR_TYPE,
+
+  PROCFS_BLINK_STATS_TYPE,
+  PROCFS_BLINK_JIT_TYPE,
+  PROCFS_BLINK_SYSCALLS_TYPE,
+  PROCFS_BLINK_LAST_TYPE = PROCFS_BLINK_SYSCALLS_TYPE
 };
 
+// Files in /proc/blink are numbered after those of the single piddir.
+#define PROCFS_FIRST_BLINK_INO \
+  (PROCFS_FIRST_PID_INO + PROCFS_PIDDIR_LAST_TYPE - PROCFS_PIDDIR_TYPE + 1)
+#define PROCFS_BLINK_FILE_INO(type) \
+  (PROCFS_FIRST_BLINK_INO + (type)-PROCFS_BLINK_STATS_TYPE)
+
 static int ProcfsRootReaddir(struct VfsInfo *, struct dirent *);
 static ssize_t ProcfsSelfReadlink(struct VfsInfo *, char **);
 static ssize_t ProcfsToSelfReadlink(struct VfsInfo *, char **);
@@ -131,6 +180,13 @@ static ssize_t ProcfsPiddirExeReadlink(struct VfsInfo *, char **);
 static ssize_t ProcfsPiddirCwdReadlink(struct VfsInfo *, char **);
 static ssize_t ProcfsPiddirRootReadlink(struct VfsInfo *, char **);
 static int ProcfsPiddirMountsRead(struct VfsInfo *, struct ProcfsOpenFile *);
+static int ProcfsPiddirMapsRead(struct VfsInfo *, struct ProcfsOpenFile *);
+static int ProcfsPiddirSmapsRead(struct VfsInfo *, struct ProcfsOpenFile *);
+static int ProcfsPiddirStatRead(struct VfsInfo *, struct ProcfsOpenFile *);
+static int ProcfsPiddirStatusRead(struct VfsInfo *, struct ProcfsOpenFile *);
+
+static int ProcfsBlinkReaddir(struct VfsInfo *, struct dirent *);
+static int ProcfsBlinkRead(struct VfsInfo *, struct ProcfsOpenFile *);
 
 static struct ProcfsInfo g_defaultinfos[] = {
     [PROCFS_ROOT_INO] = {PROCFS_ROOT_INO, S_IFDIR | 0555, 0, 0,
@@ -152,6 +208,21 @@ static struct ProcfsInfo g_defaultinfos[] = {
     [PROCFS_UPTIME_INO] = {PROCFS_UPTIME_INO, S_IFREG | 0444, 0, 0,
                            PROCFS_UPTIME_TYPE, "uptime",
                            .read = ProcfsUptimeRead},
+    [PROCFS_BLINK_INO] = {PROCFS_BLINK_INO, S_IFDIR | 0555, 0, 0,
+                          PROCFS_BLINK_TYPE, "blink",
+                          .readdir = ProcfsBlinkReaddir},
+};
+
+static struct ProcfsInfo g_blinkinfos[] = {
+    [PROCFS_BLINK_STATS_TYPE - PROCFS_BLINK_STATS_TYPE] =
+        {PROCFS_BLINK_FILE_INO(PROCFS_BLINK_STATS_TYPE), S_IFREG | 0444, 0, 0,
+         PROCFS_BLINK_STATS_TYPE, "stats", .read = ProcfsBlinkRead},
+    [PROCFS_BLINK_JIT_TYPE - PROCFS_BLINK_STATS_TYPE] =
+        {PROCFS_BLINK_FILE_INO(PROCFS_BLINK_JIT_TYPE), S_IFREG | 0444, 0, 0,
+         PROCFS_BLINK_JIT_TYPE, "jit", .read = ProcfsBlinkRead},
+    [PROCFS_BLINK_SYSCALLS_TYPE - PROCFS_BLINK_STATS_TYPE] =
+        {PROCFS_BLINK_FILE_INO(PROCFS_BLINK_SYSCALLS_TYPE), S_IFREG | 0444, 0,
+         0, PROCFS_BLINK_SYSCALLS_TYPE, "syscalls", .read = ProcfsBlinkRead},
 };
 
 static struct ProcfsInfo g_piddirinfos[] = {
@@ -171,6 +242,20 @@ static struct ProcfsInfo g_piddirinfos[] = {
         PROCFS_PIDDIR_TYPE] = {0, S_IFREG | 0444, 0, 0,
                                PROCFS_PIDDIR_MOUNTS_TYPE, "mounts",
                                .read = ProcfsPiddirMountsRead},
+    [PROCFS_PIDDIR_MAPS_TYPE -
+        PROCFS_PIDDIR_TYPE] = {0, S_IFREG | 0444, 0, 0, PROCFS_PIDDIR_MAPS_TYPE,
+                               "maps", .read = ProcfsPiddirMapsRead},
+    [PROCFS_PIDDIR_SMAPS_TYPE -
+        PROCFS_PIDDIR_TYPE] = {0, S_IFREG | 0444, 0, 0,
+                               PROCFS_PIDDIR_SMAPS_TYPE, "smaps",
+                               .read = ProcfsPiddirSmapsRead},
+    [PROCFS_PIDDIR_STAT_TYPE -
+        PROCFS_PIDDIR_TYPE] = {0, S_IFREG | 0444, 0, 0, PROCFS_PIDDIR_STAT_TYPE,
+                               "stat", .read = ProcfsPiddirStatRead},
+    [PROCFS_PIDDIR_STATUS_TYPE -
+        PROCFS_PIDDIR_TYPE] = {0, S_IFREG | 0444, 0, 0,
+                               PROCFS_PIDDIR_STATUS_TYPE, "status",
+                               .read = ProcfsPiddirStatusRead},
     [PROCFS_PIDDIR_FDDIR_TYPE - PROCFS_PIDDIR_TYPE] = {0, S_IFDIR | 0555, 0, 0,
                                                        PROCFS_PIDDIR_FDDIR_TYPE,
                                                        "fd"},
@@ -230,6 +315,19 @@ static int ProcfsCreatePiddirInfo(struct ProcfsInfo **info,
   return 0;
 }
 
+static int ProcfsCreateBlinkInfo(struct ProcfsInfo **info,
+                                 struct ProcfsInfo *parent, u32 type) {
+  *info = malloc(sizeof(struct ProcfsInfo));
+  if (*info == NULL) {
+    return enomem();
+  }
+  **info = g_blinkinfos[type - PROCFS_BLINK_STATS_TYPE];
+  (*info)->uid = parent->uid;
+  (*info)->gid = parent->gid;
+  (*info)->time = GetTime();
+  return 0;
+}
+
 static int ProcfsFreeInfo(void *info) {
   if (info == NULL) {
     return 0;
@@ -367,6 +465,17 @@ static int ProcfsFinddir(struct VfsInfo *parent, const char *name,
         }
       }
       break;
+    case PROCFS_BLINK_TYPE:
+      for (i = 0; i <= PROCFS_BLINK_LAST_TYPE - PROCFS_BLINK_STATS_TYPE; ++i) {
+        if (!strcmp(name, g_blinkinfos[i].name)) {
+          if (ProcfsCreateBlinkInfo(&procoutput, procparent,
+                                    i + PROCFS_BLINK_STATS_TYPE) == -1) {
+            goto cleananddie;
+          }
+          break;
+        }
+      }
+      break;
   }
   if (procoutput == NULL) {
     enoent();
@@ -1098,6 +1207,34 @@ static int ProcfsPiddirReaddir(struct VfsInfo *info, struct dirent *de) {
   return ret;
 }
 
+static int ProcfsBlinkReaddir(struct VfsInfo *info, struct dirent *de) {
+  struct ProcfsInfo *procinfo = (struct ProcfsInfo *)info->data;
+  struct ProcfsOpenDir *dir = procinfo->opendir;
+  int ret = 0;
+  LOCK(&dir->lock);
+  if (dir->index == 0) {
+    de->d_ino = info->parent->ino;
+#ifdef DT_DIR
+    de->d_type = DT_DIR;
+#endif
+    strcpy(de->d_name, "..");
+  } else if (dir->index == 1) {
+    de->d_ino = info->ino;
+#ifdef DT_DIR
+    de->d_type = DT_DIR;
+#endif
+    strcpy(de->d_name, ".");
+  } else if ((dir->index - 2) >
+             (PROCFS_BLINK_LAST_TYPE - PROCFS_BLINK_STATS_TYPE)) {
+    ret = enoent();
+  } else {
+    ret = ProcfsInfoToDirent(&g_blinkinfos[dir->index - 2], de);
+  }
+  ++dir->index;
+  UNLOCK(&dir->lock);
+  return ret;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 static ssize_t ProcfsSelfReadlink(struct VfsInfo *info, char **buf) {
@@ -1142,11 +1279,21 @@ static ssize_t ProcfsPiddirExeReadlink(struct VfsInfo *info, char **buf) {
 }
 
 static ssize_t ProcfsPiddirCwdReadlink(struct VfsInfo *info, char **buf) {
-  return VfsPathBuildFull(g_cwdinfo, NULL, buf);
+  ssize_t len;
+  struct VfsInfo *cwd;
+  unassert(!VfsAcquireCwd(&cwd));
+  len = VfsPathBuildFull(cwd, NULL, buf);
+  unassert(!VfsFreeInfo(cwd));
+  return len;
 }
 
 static ssize_t ProcfsPiddirRootReadlink(struct VfsInfo *info, char **buf) {
-  return VfsPathBuildFull(g_rootinfo, g_actualrootinfo, buf);
+  ssize_t len;
+  struct VfsInfo *root;
+  unassert(!VfsAcquireRoot(&root));
+  len = VfsPathBuildFull(root, g_actualrootinfo, buf);
+  unassert(!VfsFreeInfo(root));
+  return len;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1410,6 +1557,416 @@ static int ProcfsPiddirMountsRead(struct VfsInfo *info,
   return 0;
 }
 
+// Memory maps are generated from the guest page tables rather than from
+// a list of mappings, since that's the only authoritative record blink
+// keeps. The open file index is the guest address to resume the walk at
+// so each buffer refill only visits page tables not yet reported on.
+
+static struct System *ProcfsGetSystem(void) {
+  if (!g_machine || g_machine->mode.omode != XED_MODE_LONG) return 0;
+  return g_machine->system;
+}
+
+// Returns 48-bit address of first page mapped at or after `pos`, whose
+// entry and size are stored to the output parameters. Absent tables are
+// skipped whole. Returns -1 if there are no more pages.
+static i64 ProcfsNextPage(struct System *s, i64 pos, u64 *out_entry,
+                          i64 *out_size) {
+  u8 *mi;
+  i64 size;
+  int level;
+  u64 entry, table;
+  while (pos < PROCFS_VIRT_END) {
+    for (table = s->cr3, level = 39;; table = entry, level -= 9) {
+      size = (i64)1 << level;
+      if (!(mi = GetPageAddress(s, table, level == 39))) return -1;
+      entry = LoadPte(mi + ((pos >> level) & 511) * 8);
+      if (!(entry & PAGE_V)) {
+        pos = (pos & -size) + size;
+        break;
+      }
+      if (level == 12 || (entry & PAGE_PS)) {
+        *out_entry = entry;
+        *out_size = size;
+        return pos & -size;
+      }
+    }
+  }
+  return -1;
+}
+
+static struct FileMap *ProcfsGetFileMap(struct System *s, struct FileMap *fm,
+                                        u64 entry, i64 virt) {
+  u64 i;
+  if (!(entry & PAGE_FILE)) return 0;
+  virt = (i64)((u64)virt << 16) >> 16;
+  if (fm && virt >= fm->virt && virt < fm->virt + fm->size) {
+    i = (virt - fm->virt) / 4096;
+    if (fm->present[i / 64] & ((u64)1 << (i % 64))) {
+      return fm;
+    }
+  }
+  return GetFileMap(s, virt);
+}
+
+// Returns number of 4096 byte pages in run the host has in memory. Pages
+// which blink mapped from the host (which is every page in linear mode)
+// are committed lazily by the host kernel, so we need to ask it.
+static long ProcfsFlushRun(struct ProcfsRun *run) {
+  long n = 0;
+#ifdef HAVE_MINCORE
+  size_t i, k;
+  unsigned char vec[256];
+  uintptr_t a, b, p, end, pagesize;
+  pagesize = FLAG_pagesize;
+  end = run->addr + run->size;
+  for (p = run->addr & -pagesize; p < end; p += k * pagesize) {
+    k = MIN(ARRAYLEN(vec), (end - p + pagesize - 1) / pagesize);
+    if (mincore((void *)p, k * pagesize, (void *)vec)) break;
+    for (i = 0; i < k; ++i) {
+      if (vec[i] & 1) {
+        a = MAX(p + i * pagesize, run->addr);
+        b = MIN(p + (i + 1) * pagesize, end);
+        n += (b - a) / 4096;
+      }
+    }
+  }
+#else
+  n = run->size / 4096;
+#endif
+  run->size = 0;
+  return n;
+}
+
+// Returns number of pages in [addr,addr+size) that are resident. Pages
+// which blink allocated itself are resident, since it zeroes them, and
+// host mapped pages get batched into `run` to be asked about later.
+static long ProcfsCountResident(struct ProcfsRun *run, u64 entry, i64 size) {
+  long n = 0;
+  uintptr_t real;
+  if ((entry & (PAGE_HOST | PAGE_MAP)) == (PAGE_HOST | PAGE_MAP)) {
+    real = entry & PAGE_TA;
+    if (run->size && run->addr + run->size != real) {
+      n = ProcfsFlushRun(run);
+    }
+    if (!run->size) run->addr = real;
+    run->size += size;
+  } else if (!(entry & PAGE_RSRV)) {
+    n = size / 4096;
+  }
+  return n;
+}
+
+// Coalesces the adjacent pages at or after `pos` which share the same
+// protection and file mapping, the way Linux would've merged its vmas.
+static bool ProcfsNextVma(struct System *s, i64 pos, struct ProcfsVma *vma) {
+  u64 entry;
+  i64 addr, size;
+  struct FileMap *fm;
+  struct ProcfsRun run = {0};
+  if ((addr = ProcfsNextPage(s, pos, &entry, &size)) == -1) return false;
+  vma->start = vma->end = addr;
+  vma->key = entry & (PAGE_U | PAGE_RW | PAGE_XD);
+  vma->fm = fm = ProcfsGetFileMap(s, 0, entry, addr);
+  if (fm && fm->offset != -1) {
+    vma->offset = fm->offset + ((i64)((u64)addr << 16) >> 16) - fm->virt;
+  } else {
+    vma->offset = -1;
+  }
+  vma->resident = 0;
+  vma->anonymous = 0;
+  do {
+    vma->end = addr + size;
+    vma->resident += ProcfsCountResident(&run, entry, size);
+  } while ((addr = ProcfsNextPage(s, vma->end, &entry, &size)) == vma->end &&
+           (entry & (PAGE_U | PAGE_RW | PAGE_XD)) == vma->key &&
+           ProcfsGetFileMap(s, fm, entry, addr) == fm);
+  vma->resident += ProcfsFlushRun(&run);
+  if (vma->offset == -1) {
+    vma->anonymous = vma->resident;
+  }
+  return true;
+}
+
+static long ProcfsGetRss(struct System *s) {
+  long rss = 0;
+  struct ProcfsVma vma;
+  for (vma.end = 0; ProcfsNextVma(s, vma.end, &vma);) {
+    rss += vma.resident;
+  }
+  return rss;
+}
+
+static int ProcfsFormatDevice(char *buf, size_t size, u64 dev) {
+#ifdef HAVE_SYS_SYSMACROS_H
+  return snprintf(buf, size, "%02x:%02x", (unsigned)major(dev),
+                  (unsigned)minor(dev));
+#else
+  return snprintf(buf, size, "%02x:%02x", (unsigned)(dev >> 8) & 0xfff,
+                  (unsigned)(dev & 0xff));
+#endif
+}
+
+static int ProcfsFormatVma(char *buf, size_t size, struct ProcfsVma *vma,
+                           bool detailed) {
+  int n, prot;
+  size_t i;
+  i64 start, end;
+  char dev[16];
+  start = (i64)((u64)vma->start << 16) >> 16;
+  end = (i64)((u64)vma->end << 16) >> 16;
+  prot = GetProtection(vma->key);
+  ProcfsFormatDevice(dev, sizeof(dev), vma->fm ? vma->fm->dev : 0);
+  n = snprintf(buf, size, "%08" PRIx64 "-%08" PRIx64 " %c%c%cp %08" PRIx64
+               " %s %" PRIu64,
+               start, end, (prot & PROT_READ) ? 'r' : '-',
+               (prot & PROT_WRITE) ? 'w' : '-', (prot & PROT_EXEC) ? 'x' : '-',
+               vma->offset == -1 ? 0 : vma->offset, dev,
+               vma->fm ? vma->fm->ino : 0);
+  if (vma->fm) {
+    for (i = n; i < PROCFS_PATH_COL && i + 1 < size; ++i) {
+      buf[i] = ' ';
+    }
+    n = i;
+    n += snprintf(buf + MIN(n, size), size - MIN(n, size), "%s",
+                  vma->fm->path);
+  }
+  n += snprintf(buf + MIN(n, size), size - MIN(n, size), "\n");
+  if (detailed) {
+    n += snprintf(
+        buf + MIN(n, size), size - MIN(n, size),
+        "Size:           %8" PRId64 " kB\n"
+        "KernelPageSize: %8d kB\n"
+        "MMUPageSize:    %8d kB\n"
+        "Rss:            %8ld kB\n"
+        "Pss:            %8ld kB\n"
+        "Shared_Clean:   %8d kB\n"
+        "Shared_Dirty:   %8d kB\n"
+        "Private_Clean:  %8ld kB\n"
+        "Private_Dirty:  %8ld kB\n"
+        "Referenced:     %8ld kB\n"
+        "Anonymous:      %8ld kB\n"
+        "LazyFree:       %8d kB\n"
+        "AnonHugePages:  %8d kB\n"
+        "Swap:           %8d kB\n"
+        "SwapPss:        %8d kB\n"
+        "Locked:         %8d kB\n"
+        "VmFlags:%s%s%s%s%s%s\n",
+        (vma->end - vma->start) / 1024, 4, 4, vma->resident * 4,
+        vma->resident * 4, 0, 0, (vma->resident - vma->anonymous) * 4,
+        vma->anonymous * 4, vma->resident * 4, vma->anonymous * 4, 0, 0, 0, 0,
+        0, (prot & PROT_READ) ? " rd" : "", (prot & PROT_WRITE) ? " wr" : "",
+        (prot & PROT_EXEC) ? " ex" : "", " mr", " mw", " me");
+  }
+  return n;
+}
+
+static int ProcfsPiddirMapsReadImpl(struct ProcfsOpenFile *openfile,
+                                    bool detailed) {
+  size_t byteswritten = 0;
+  size_t bytesleft = sizeof(openfile->readbuf);
+  size_t ret;
+  struct System *s;
+  struct ProcfsVma vma;
+  if (openfile->readbufend > sizeof(openfile->readbuf)) {
+    return 0;
+  }
+  if ((s = ProcfsGetSystem())) {
+    RDLOCK(&s->mmap_lock);
+    while (ProcfsNextVma(s, openfile->index, &vma)) {
+      ret = ProcfsFormatVma(openfile->readbuf + byteswritten, bytesleft, &vma,
+                            detailed);
+      if (ret >= bytesleft) {
+        if (byteswritten) break;
+        // a single record with an enormous path is truncated
+        ret = bytesleft - 1;
+        openfile->readbuf[ret - 1] = '\n';
+      }
+      byteswritten += ret;
+      bytesleft -= ret;
+      openfile->index = vma.end;
+    }
+    RWUNLOCK(&s->mmap_lock);
+  }
+  if (byteswritten == 0) {
+    openfile->readbufstart = sizeof(openfile->readbuf) + 1;
+    openfile->readbufend = sizeof(openfile->readbuf) + 1;
+  } else {
+    openfile->readbufstart = 0;
+    openfile->readbufend = byteswritten;
+  }
+  return 0;
+}
+
+static int ProcfsPiddirMapsRead(struct VfsInfo *info,
+                                struct ProcfsOpenFile *openfile) {
+  return ProcfsPiddirMapsReadImpl(openfile, false);
+}
+
+static int ProcfsPiddirSmapsRead(struct VfsInfo *info,
+                                 struct ProcfsOpenFile *openfile) {
+  return ProcfsPiddirMapsReadImpl(openfile, true);
+}
+
+static void ProcfsGetComm(struct System *s, char comm[16]) {
+  const char *name, *p;
+  name = s && s->elf.prog ? s->elf.prog : "blink";
+  if ((p = strrchr(name, '/'))) name = p + 1;
+  snprintf(comm, 16, "%s", name);
+}
+
+static int ProcfsCountThreads(struct System *s) {
+  int n = 0;
+  struct Dll *e;
+  LOCK(&s->machines_lock);
+  for (e = dll_first(s->machines); e; e = dll_next(s->machines, e)) {
+    ++n;
+  }
+  UNLOCK(&s->machines_lock);
+  return n;
+}
+
+static u64 ProcfsGetTicks(struct timeval tv) {
+  long hz = sysconf(_SC_CLK_TCK);
+  return (u64)tv.tv_sec * hz + (u64)tv.tv_usec * hz / 1000000;
+}
+
+static int ProcfsPiddirStatusRead(struct VfsInfo *info,
+                                  struct ProcfsOpenFile *openfile) {
+  char comm[16];
+  struct System *s;
+  struct MachineMemstat memstat = {0};
+  long vss = 0, rss = 0;
+  int threads = 1;
+  if (openfile->index > 0) {
+    openfile->readbufstart = sizeof(openfile->readbuf) + 1;
+    openfile->readbufend = sizeof(openfile->readbuf) + 1;
+    return 0;
+  }
+  if ((s = ProcfsGetSystem())) {
+    RDLOCK(&s->mmap_lock);
+    memstat = s->memstat;
+    vss = s->vss;
+    rss = ProcfsGetRss(s);
+    RWUNLOCK(&s->mmap_lock);
+    threads = ProcfsCountThreads(s);
+  }
+  ProcfsGetComm(s, comm);
+  openfile->readbufstart = 0;
+  openfile->readbufend = snprintf(
+      openfile->readbuf, sizeof(openfile->readbuf),
+      "Name:\t%s\n"
+      "State:\tR (running)\n"
+      "Tgid:\t%d\n"
+      "Pid:\t%d\n"
+      "PPid:\t%d\n"
+      "TracerPid:\t0\n"
+      "Uid:\t%d\t%d\t%d\t%d\n"
+      "Gid:\t%d\t%d\t%d\t%d\n"
+      "VmSize:\t%8ld kB\n"
+      "VmRSS:\t%8ld kB\n"
+      "VmPTE:\t%8ld kB\n"
+      "VmSwap:\t%8d kB\n"
+      "Threads:\t%d\n",
+      comm, getpid(), getpid(), getppid(), (int)getuid(), (int)geteuid(),
+      (int)geteuid(), (int)geteuid(), (int)getgid(), (int)getegid(),
+      (int)getegid(), (int)getegid(), vss * 4, rss * 4, memstat.tables * 4, 0,
+      threads);
+  openfile->index = 1;
+  return 0;
+}
+
+static int ProcfsPiddirStatRead(struct VfsInfo *info,
+                                struct ProcfsOpenFile *openfile) {
+  char comm[16];
+  struct System *s;
+  struct rusage ru;
+  u64 rsslim = RLIM_INFINITY_LINUX;
+  i64 codestart = 0, codeend = 0, brk = 0;
+  long vss = 0, rss = 0;
+  int threads = 1;
+  if (openfile->index > 0) {
+    openfile->readbufstart = sizeof(openfile->readbuf) + 1;
+    openfile->readbufend = sizeof(openfile->readbuf) + 1;
+    return 0;
+  }
+  if (getrusage(RUSAGE_SELF, &ru) == -1) {
+    return -1;
+  }
+  if ((s = ProcfsGetSystem())) {
+    RDLOCK(&s->mmap_lock);
+    vss = s->vss;
+    rss = ProcfsGetRss(s);
+    brk = s->brk;
+    codestart = s->codestart;
+    codeend = s->codestart + s->codesize;
+    RWUNLOCK(&s->mmap_lock);
+    rsslim = Read64(s->rlim[RLIMIT_RSS_LINUX].cur);
+    threads = ProcfsCountThreads(s);
+  }
+  ProcfsGetComm(s, comm);
+  openfile->readbufstart = 0;
+  openfile->readbufend = snprintf(
+      openfile->readbuf, sizeof(openfile->readbuf),
+      "%d (%s) R %d %d %d 0 -1 0 %ld 0 %ld 0 %" PRIu64 " %" PRIu64
+      " 0 0 20 0 %d 0 0 %" PRIu64 " %ld %" PRIu64 " %" PRIu64 " %" PRIu64
+      " 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0 0 0 %" PRIu64
+      " 0 0 0 0 0\n",
+      getpid(), comm, getppid(), getpgrp(), getsid(0), (long)ru.ru_minflt,
+      (long)ru.ru_majflt, ProcfsGetTicks(ru.ru_utime),
+      ProcfsGetTicks(ru.ru_stime), threads, (u64)vss * 4096,
+      rss, rsslim, (u64)codestart, (u64)codeend, (u64)brk);
+  openfile->index = 1;
+  return 0;
+}
+
+// Statistics are rendered a buffer at a time from a fresh snapshot and
+// the index is the number of the next statistic, or the next system call
+// ordinal, so lines stay whole even when counters change between reads.
+static int ProcfsBlinkRead(struct VfsInfo *info,
+                           struct ProcfsOpenFile *openfile) {
+  long cursor;
+  struct Stats *st;
+  struct Buffer b = {0};
+  struct ProcfsInfo *procinfo = (struct ProcfsInfo *)info->data;
+  if (openfile->readbufend > sizeof(openfile->readbuf)) {
+    return 0;
+  }
+  if (!(st = (struct Stats *)malloc(sizeof(*st)))) {
+    return enomem();
+  }
+  MergeStats(st);
+  cursor = openfile->index;
+  switch (procinfo->type) {
+    case PROCFS_BLINK_STATS_TYPE:
+      FormatStats(&b, st, 0, &cursor, sizeof(openfile->readbuf));
+      break;
+    case PROCFS_BLINK_JIT_TYPE:
+      // every path_ statistic comes before the jit_ ones in stats.inc
+      if (FormatStats(&b, st, "path_", &cursor, sizeof(openfile->readbuf))) {
+        FormatStats(&b, st, "jit_", &cursor, sizeof(openfile->readbuf));
+      }
+      break;
+    case PROCFS_BLINK_SYSCALLS_TYPE:
+      FormatSyscallStats(&b, st, &cursor, sizeof(openfile->readbuf));
+      break;
+    default:
+      __builtin_unreachable();
+  }
+  free(st);
+  if (b.i) {
+    memcpy(openfile->readbuf, b.p, b.i);
+    openfile->index = cursor;
+    openfile->readbufstart = 0;
+    openfile->readbufend = b.i;
+  } else {
+    openfile->readbufstart = sizeof(openfile->readbuf) + 1;
+    openfile->readbufend = sizeof(openfile->readbuf) + 1;
+  }
+  free(b.p);
+  return 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 struct VfsSystem g_procfs = {.name = "proc",
@@ -21,15 +21,18 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <string.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "blink/assert.h"
+#include "blink/endian.h"
 #include "blink/errno.h"
 #include "blink/linux.h"
 #include "blink/log.h"
 #include "blink/macros.h"
+#include "blink/thread.h"
 #include "blink/types.h"
 #include "blink/util.h"
 
@@ -132,3 +135,109 @@ ssize_t GetRandom(void *p, size_t n, int flags) {
   return GetWeakRandom((char *)p, n);
 #endif
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// ChaCha20 keystream with fast key erasure, for when GetRandom() is too
+// slow, e.g. a guest reading /dev/urandom in bulk. Each refill uses the
+// start of its own output as the next key, so earlier output can't be
+// recovered from the state. The key is reseeded from the host now and
+// then, and in forked children so they don't repeat their parent.
+
+#define CHACHA_KEYSTREAM (16 * 64)         // bytes generated per refill
+#define CHACHA_RESEED    (1024 * 1024)     // bytes served between reseeds
+#define CHACHA_ROTL(x, n) ((x) << (n) | (x) >> (32 - (n)))
+#define CHACHA_QR(a, b, c, d)                   \
+  a += b, d ^= a, d = CHACHA_ROTL(d, 16), \
+  c += d, b ^= c, b = CHACHA_ROTL(b, 12), \
+  a += b, d ^= a, d = CHACHA_ROTL(d, 8),  \
+  c += d, b ^= c, b = CHACHA_ROTL(b, 7)
+
+static struct FastRandom {
+  pthread_once_t_ once;
+  pthread_mutex_t_ lock;
+  bool seeded;
+  size_t served;
+  size_t avail;
+  u8 key[32];
+  u8 buf[CHACHA_KEYSTREAM];
+} g_fastrandom = {
+    PTHREAD_ONCE_INIT_,
+    PTHREAD_MUTEX_INITIALIZER_,
+};
+
+// Computes ChaCha20 block, laid out as in RFC 8439.
+void ChaCha20(u8 out[64], const u8 key[32], u32 counter, const u8 nonce[12]) {
+  int i;
+  u32 x[16], s[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+  for (i = 0; i < 8; ++i) s[4 + i] = Read32(key + i * 4);
+  s[12] = counter;
+  for (i = 0; i < 3; ++i) s[13 + i] = Read32(nonce + i * 4);
+  memcpy(x, s, sizeof(x));
+  for (i = 0; i < 10; ++i) {
+    CHACHA_QR(x[0], x[4], x[8], x[12]);
+    CHACHA_QR(x[1], x[5], x[9], x[13]);
+    CHACHA_QR(x[2], x[6], x[10], x[14]);
+    CHACHA_QR(x[3], x[7], x[11], x[15]);
+    CHACHA_QR(x[0], x[5], x[10], x[15]);
+    CHACHA_QR(x[1], x[6], x[11], x[12]);
+    CHACHA_QR(x[2], x[7], x[8], x[13]);
+    CHACHA_QR(x[3], x[4], x[9], x[14]);
+  }
+  for (i = 0; i < 16; ++i) Write32(out + i * 4, x[i] + s[i]);
+}
+
+static void FastRandomBeforeFork(void) {
+  LOCK(&g_fastrandom.lock);
+}
+
+static void FastRandomAfterForkParent(void) {
+  UNLOCK(&g_fastrandom.lock);
+}
+
+static void FastRandomAfterForkChild(void) {
+  g_fastrandom.seeded = false;
+  UNLOCK(&g_fastrandom.lock);
+}
+
+static void FastRandomSetup(void) {
+  unassert(!pthread_atfork(FastRandomBeforeFork, FastRandomAfterForkParent,
+                           FastRandomAfterForkChild));
+}
+
+// @assume g_fastrandom.lock
+static void FastRandomRefill(void) {
+  u32 i;
+  static const u8 kNonce[12];  // zero since each key is used once
+  if (!g_fastrandom.seeded || g_fastrandom.served >= CHACHA_RESEED) {
+    unassert(GetRandom(g_fastrandom.key, sizeof(g_fastrandom.key), 0) ==
+             sizeof(g_fastrandom.key));
+    g_fastrandom.seeded = true;
+    g_fastrandom.served = 0;
+  }
+  for (i = 0; i < CHACHA_KEYSTREAM / 64; ++i) {
+    ChaCha20(g_fastrandom.buf + i * 64, g_fastrandom.key, i, kNonce);
+  }
+  memcpy(g_fastrandom.key, g_fastrandom.buf, sizeof(g_fastrandom.key));
+  memset(g_fastrandom.buf, 0, sizeof(g_fastrandom.key));
+  g_fastrandom.avail = CHACHA_KEYSTREAM - sizeof(g_fastrandom.key);
+}
+
+// Fills `p` with `n` cryptographically secure random bytes.
+void GetFastRandom(void *p, size_t n) {
+  size_t m;
+  unassert(!pthread_once_(&g_fastrandom.once, FastRandomSetup));
+  LOCK(&g_fastrandom.lock);
+  while (n) {
+    if (!g_fastrandom.avail || !g_fastrandom.seeded) {
+      FastRandomRefill();
+    }
+    m = MIN(n, g_fastrandom.avail);
+    memcpy(p, g_fastrandom.buf + CHACHA_KEYSTREAM - g_fastrandom.avail, m);
+    memset(g_fastrandom.buf + CHACHA_KEYSTREAM - g_fastrandom.avail, 0, m);
+    g_fastrandom.avail -= m;
+    g_fastrandom.served += m;
+    p = (u8 *)p + m;
+    n -= m;
+  }
+  UNLOCK(&g_fastrandom.lock);
+}
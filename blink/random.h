@@ -2,6 +2,10 @@
 #define BLINK_RANDOM_H_
 #include <sys/types.h>
 
+#include "blink/types.h"
+
+void ChaCha20(u8[64], const u8[32], u32, const u8[12]);
 ssize_t GetRandom(void *, size_t, int);
+void GetFastRandom(void *, size_t);
 
 #endif /* BLINK_RANDOM_H_ */
@@ -99,14 +99,14 @@ void ResetCpu(struct Machine *m) {
 }
 
 void ResetTlb(struct Machine *m) {
-  STATISTIC(++tlb_resets);
+  STATISTIC(++g_stats->tlb_resets);
   memset(m->tlb, 0, sizeof(m->tlb));
   m->opcache->codevirt = 0;
   m->opcache->codehost = 0;
 }
 
 void ResetInstructionCache(struct Machine *m) {
-  STATISTIC(++icache_resets);
+  STATISTIC(++g_stats->icache_resets);
   memset(m->opcache->icache, 0, sizeof(m->opcache->icache));
   m->opcache->codevirt = 0;
   m->opcache->codehost = 0;
@@ -18,6 +18,7 @@
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "blink/signal.h"
 
+#include <errno.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
@@ -227,7 +228,8 @@ static int ConsumeSignalImpl(struct Machine *m, int *delivered, bool *restart) {
   // look for a pending signal that isn't currently masked
   while ((signals = m->signals & ~m->sigmask)) {
     sig = bsr(signals) + 1;
-    m->signals &= ~((u64)1 << (sig - 1));
+    atomic_fetch_and_explicit(&m->signals, ~((u64)1 << (sig - 1)),
+                              memory_order_acq_rel);
     handler = Read64(m->system->hands[sig - 1].handler);
     if (handler == SIG_DFL_LINUX) {
       if (IsSignalIgnoredByDefault(sig)) {
@@ -263,13 +265,121 @@ int ConsumeSignal(struct Machine *m, int *delivered, bool *restart) {
   return rc;
 }
 
-void EnqueueSignal(struct Machine *m, int sig) {
+// signalfd slots are also guarded by a spin lock, since their sockets
+// get poked from signal handlers, which mustn't block on sig_lock. it's
+// held with host signals blocked, so a handler can't interrupt holders
+void LockSignalFds(struct System *s, sigset_t *oldmask) {
+  sigset_t block;
+  sigfillset(&block);
+  unassert(!pthread_sigmask(SIG_BLOCK, &block, oldmask));
+  while (atomic_exchange_explicit(&s->signalfds_lock, true,
+                                  memory_order_acquire)) {
+  }
+}
+
+void UnlockSignalFds(struct System *s, const sigset_t *oldmask) {
+  atomic_store_explicit(&s->signalfds_lock, false, memory_order_release);
+  unassert(!pthread_sigmask(SIG_SETMASK, oldmask, 0));
+}
+
+// wakes up signalfd() descriptors watching `sig` (async signal safe)
+void NotifySignalFds(struct System *s, int sig) {
+  int i, e;
+  u64 mask;
+  e = errno;
+  while (atomic_exchange_explicit(&s->signalfds_lock, true,
+                                  memory_order_acquire)) {
+  }
+  for (i = 0; i < kMaxSignalFds; ++i) {
+    mask = atomic_load_explicit(&s->signalfds[i].mask, memory_order_acquire);
+    if (mask & ((u64)1 << (sig - 1))) {
+      (void)!write(atomic_load_explicit(&s->signalfds[i].wfd,  //
+                                        memory_order_relaxed),
+                   "", 1);
+    }
+  }
+  atomic_store_explicit(&s->signalfds_lock, false, memory_order_release);
+  errno = e;
+}
+
+bool IsSignalFdSig(struct System *s, int sig) {
+  int i;
+  for (i = 0; i < kMaxSignalFds; ++i) {
+    if (s->signalfds[i].used &&
+        (atomic_load_explicit(&s->signalfds[i].mask, memory_order_relaxed) &
+         ((u64)1 << (sig - 1)))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// queues `sig` on `m`, remembering who sent it for signalfd() readers.
+// the pending set is updated with atomic read-modify-writes, since the
+// host signal handlers that call this don't hold sig_lock
+void EnqueueSignalFrom(struct Machine *m, int sig, int code, int pid,
+                       u32 uid) {
+  u64 bit;
   if (m && (1 <= sig && sig <= 64)) {
-    m->signals |= 1ul << (sig - 1);
-    if ((m->signals & ~m->sigmask)) {
+    bit = (u64)1 << (sig - 1);
+    m->sigfrom[sig - 1].code = code;
+    m->sigfrom[sig - 1].pid = pid;
+    m->sigfrom[sig - 1].uid = uid;
+    if ((atomic_fetch_or_explicit(&m->signals, bit, memory_order_acq_rel) |
+         bit) &
+        ~m->sigmask) {
       atomic_store_explicit(&m->attention, true, memory_order_release);
     }
+    NotifySignalFds(m->system, sig);
+  }
+}
+
+void EnqueueSignal(struct Machine *m, int sig) {
+  EnqueueSignalFrom(m, sig, SI_KERNEL_LINUX, 0, 0);
+}
+
+// atomically takes the lowest signal in `mask` pending on `m`
+static int TakeSignal(struct Machine *m, u64 mask, struct SignalSender *from) {
+  int sig;
+  u64 bit, signals;
+  while ((signals = atomic_load_explicit(&m->signals, memory_order_acquire) &
+                    mask)) {
+    sig = bsf(signals) + 1;
+    bit = (u64)1 << (sig - 1);
+    if (atomic_fetch_and_explicit(&m->signals, ~bit, memory_order_acq_rel) &
+        bit) {
+      if (from) *from = m->sigfrom[sig - 1];
+      return sig;
+    }
+  }
+  return 0;
+}
+
+// removes lowest pending signal in `mask` from the calling thread or,
+// failing that, from any other thread; caller must hold sig_lock
+int DequeueSignal(struct Machine *m, u64 mask, struct SignalSender *from) {
+  int sig;
+  struct Dll *e;
+  if ((sig = TakeSignal(m, mask, from))) return sig;
+  LOCK(&m->system->machines_lock);
+  for (e = dll_first(m->system->machines); e;
+       e = dll_next(m->system->machines, e)) {
+    if ((sig = TakeSignal(MACHINE_CONTAINER(e), mask, from))) break;
+  }
+  UNLOCK(&m->system->machines_lock);
+  return sig;
+}
+
+// returns signals in `mask` pending on any thread; needs sig_lock
+u64 GetPendingSignals(struct System *s, u64 mask) {
+  u64 res = 0;
+  struct Dll *e;
+  LOCK(&s->machines_lock);
+  for (e = dll_first(s->machines); e; e = dll_next(s->machines, e)) {
+    res |= MACHINE_CONTAINER(e)->signals & mask;
   }
+  UNLOCK(&s->machines_lock);
+  return res;
 }
 
 void CheckForSignals(struct Machine *m) {
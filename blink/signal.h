@@ -6,8 +6,15 @@ bool IsSignalSerious(int);
 bool IsSignalQueueable(int);
 void SigRestore(struct Machine *);
 bool IsSignalIgnoredByDefault(int);
+bool IsSignalFdSig(struct System *, int);
 void OnSignal(int, siginfo_t *, void *);
 void EnqueueSignal(struct Machine *, int);
+void EnqueueSignalFrom(struct Machine *, int, int, int, u32);
+int DequeueSignal(struct Machine *, u64, struct SignalSender *);
+void NotifySignalFds(struct System *, int);
+void LockSignalFds(struct System *, sigset_t *);
+void UnlockSignalFds(struct System *, const sigset_t *);
+u64 GetPendingSignals(struct System *, u64);
 void DeliverSignal(struct Machine *, int, int);
 void TerminateSignal(struct Machine *, int, int);
 int ConsumeSignal(struct Machine *, int *, bool *);
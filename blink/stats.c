@@ -18,28 +18,112 @@
 ╚─────────────────────────────────────────────────────────────────────────────*/
 #include "blink/stats.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "blink/log.h"
+#include "blink/macros.h"
+
+struct Stats g_statshards[kStatsShards];
+_Thread_local struct Stats *g_stats = g_statshards;
+
+void SetStatsShard(int tid) {
+  g_stats = g_statshards + (unsigned)tid % kStatsShards;
+}
 
-#define DEFINE_AVERAGE(S) struct Average S;
-#define DEFINE_COUNTER(S) long S;
+static void MergeAverage(struct Average *x, const struct Average *y) {
+  if (!y->i) return;
+  x->a += (y->a - x->a) * y->i / (x->i + y->i);
+  x->i += y->i;
+}
+
+void MergeStats(struct Stats *st) {
+  int i, j;
+  const struct Stats *sh;
+  memset(st, 0, sizeof(*st));
+  IGNORE_RACES_START();
+  for (i = 0; i < kStatsShards; ++i) {
+    sh = g_statshards + i;
+#define DEFINE_COUNTER(S) st->S += sh->S;
+#define DEFINE_MAXIMUM(S) st->S = MAX(st->S, sh->S);
+#define DEFINE_AVERAGE(S) MergeAverage(&st->S, &sh->S);
 #include "blink/stats.inc"
+#undef DEFINE_COUNTER
+#undef DEFINE_MAXIMUM
 #undef DEFINE_AVERAGE
+    for (j = 0; j < kStatsSyscalls; ++j) {
+      st->syscall[j] += sh->syscall[j];
+    }
+  }
+  IGNORE_RACES_END();
+}
+
+static bool AppendStat(struct Buffer *b, const char *line, int n,
+                       size_t limit) {
+  if (b->i + n > limit) return false;
+  AppendData(b, line, n);
+  return true;
+}
+
+// formats nonzero statistics whose names start with prefix, if any,
+// beginning with the one numbered *cursor in stats.inc. it returns
+// false if the next line would grow b past limit bytes, in which case
+// *cursor is where a later call should resume, so readers that format
+// a chunk at a time never see a line torn by a counter that changed.
+bool FormatStats(struct Buffer *b, const struct Stats *st, const char *prefix,
+                 long *cursor, size_t limit) {
+  int n;
+  long i = 0;
+  size_t m;
+  char line[80];
+  if (!prefix) prefix = "";
+  m = strlen(prefix);
+#define DEFINE_COUNTER(S)                                             \
+  if (i++ >= *cursor && st->S && !strncmp(#S, prefix, m)) {           \
+    n = snprintf(line, sizeof(line), "%-32s = %ld\n", #S, st->S);     \
+    if (!AppendStat(b, line, n, limit)) return false;                 \
+    *cursor = i;                                                      \
+  }
+#define DEFINE_MAXIMUM(S) DEFINE_COUNTER(S)
+#define DEFINE_AVERAGE(S)                                             \
+  if (i++ >= *cursor && st->S.a && !strncmp(#S, prefix, m)) {         \
+    n = snprintf(line, sizeof(line), "%-32s = %.6g\n", #S, st->S.a);  \
+    if (!AppendStat(b, line, n, limit)) return false;                 \
+    *cursor = i;                                                      \
+  }
+#include "blink/stats.inc"
 #undef DEFINE_COUNTER
+#undef DEFINE_MAXIMUM
+#undef DEFINE_AVERAGE
+  return true;
+}
 
-#define APPEND(...) o += snprintf(b + o, n - o, __VA_ARGS__)
+// formats nonzero system call counts, resuming at ordinal *cursor
+bool FormatSyscallStats(struct Buffer *b, const struct Stats *st,
+                        long *cursor, size_t limit) {
+  int n;
+  char line[48];
+  for (; *cursor < kStatsSyscalls; ++*cursor) {
+    if (st->syscall[*cursor]) {
+      n = snprintf(line, sizeof(line), "%-3ld %ld\n", *cursor,
+                   st->syscall[*cursor]);
+      if (!AppendStat(b, line, n, limit)) return false;
+    }
+  }
+  return true;
+}
 
 void PrintStats(void) {
-#ifndef NDEBUG
-  char b[4096];
-  int n = sizeof(b);
-  int o = 0;
-  b[0] = 0;
-#define DEFINE_COUNTER(S) \
-  if (S) APPEND("%-32s = %ld\n", #S, S);
-#define DEFINE_AVERAGE(S) \
-  if (S.a) APPEND("%-32s = %.6g\n", #S, S.a);
-#include "blink/stats.inc"
-#undef S
-  WriteErrorString(b);
+#if STATISTICS
+  long cursor = 0;
+  struct Stats st;
+  struct Buffer b = {0};
+  MergeStats(&st);
+  FormatStats(&b, &st, 0, &cursor, -1);
+  if (b.p) {
+    WriteErrorString(b.p);
+    free(b.p);
+  }
 #endif
 }
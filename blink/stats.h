@@ -2,10 +2,19 @@
 #define BLINK_STATS_H_
 #include <stdbool.h>
 
+#include "blink/buffer.h"
 #include "blink/builtin.h"
+#include "blink/thread.h"
 #include "blink/tsan.h"
+#include "blink/tunables.h"
 
-#ifndef NDEBUG
+#if !defined(DISABLE_STATISTICS) && !defined(TINY)
+#define STATISTICS 1
+#else
+#define STATISTICS 0
+#endif
+
+#if STATISTICS
 // we don't care about the accuracy of statistics across threads. some
 // hardware architectures don't even seem to have atomic addition ops.
 #define STATISTIC(x)      \
@@ -26,7 +35,7 @@
 
 #define AVERAGE(S, x) S.a += ((x)-S.a) / ++S.i
 
-#ifndef NDEBUG
+#if STATISTICS
 #ifdef __GNUC__
 #define GET_COUNTER(S)    \
   __extension__({         \
@@ -42,19 +51,33 @@
 #define GET_COUNTER(S) 0L
 #endif
 
-#define DEFINE_COUNTER(S) extern long S;
-#define DEFINE_AVERAGE(S) extern struct Average S;
-#include "blink/stats.inc"
-#undef DEFINE_COUNTER
-#undef DEFINE_AVERAGE
-
 struct Average {
   double a;
   long i;
 };
 
+// each thread increments one of kStatsShards copies of these counters
+// so the hot paths don't bounce cache lines, and readers merge them.
+struct Stats {
+#define DEFINE_COUNTER(S) long S;
+#define DEFINE_MAXIMUM(S) long S;
+#define DEFINE_AVERAGE(S) struct Average S;
+#include "blink/stats.inc"
+#undef DEFINE_COUNTER
+#undef DEFINE_MAXIMUM
+#undef DEFINE_AVERAGE
+  long syscall[kStatsSyscalls];  // system calls by ordinal
+};
+
 extern bool FLAG_statistics;
+extern struct Stats g_statshards[kStatsShards];
+extern _Thread_local struct Stats *g_stats;
 
+void SetStatsShard(int);
+void MergeStats(struct Stats *);
+bool FormatStats(struct Buffer *, const struct Stats *, const char *, long *,
+                 size_t);
+bool FormatSyscallStats(struct Buffer *, const struct Stats *, long *, size_t);
 void PrintStats(void);
 
 #endif /* BLINK_STATS_H_ */
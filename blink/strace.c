@@ -252,6 +252,8 @@ const struct MagicNumber kFcntl[] = {
     {F_SETOWN_EX_LINUX, "F_SETOWN_EX"},          //
     {F_GETOWN_EX_LINUX, "F_GETOWN_EX"},          //
     {F_GETOWNER_UIDS_LINUX, "F_GETOWNER_UIDS"},  //
+    {F_ADD_SEALS_LINUX, "F_ADD_SEALS"},          //
+    {F_GET_SEALS_LINUX, "F_GET_SEALS"},          //
 };
 
 const struct MagicNumber kFlockType[] = {
@@ -45,6 +45,7 @@
 #include <sys/time.h>
 #include <sys/times.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
@@ -103,6 +104,18 @@
 #ifdef HAVE_EPOLL_PWAIT1
 #include <sys/epoll.h>
 #endif
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+#ifdef HAVE_TIMERFD
+#include <sys/timerfd.h>
+#endif
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+#ifdef HAVE_SYS_GETDENTS64
+#include <sys/syscall.h>
+#endif
 
 #ifdef HAVE_SYS_MOUNT_H
 #include <sys/mount.h>
@@ -222,7 +235,7 @@ const char *GetDirFildesPath(struct System *s, int fildes) {
 
 void SignalActor(struct Machine *m) {
   for (;;) {
-    STATISTIC(++interps);
+    STATISTIC(++g_stats->interps);
     JitlessDispatch(DISPATCH_NOTHING);
     if (atomic_load_explicit(&m->attention, memory_order_acquire)) {
       if (m->restored) break;
@@ -353,7 +366,7 @@ _Noreturn void SysExitGroup(struct Machine *m, int rc) {
   THR_LOGF("pid=%d tid=%d SysExitGroup", m->system->pid, m->tid);
   ClearChildTid(m);
   if (m->system->isfork) {
-#ifndef NDEBUG
+#if STATISTICS
     if (FLAG_statistics) {
       PrintStats();
     }
@@ -375,7 +388,7 @@ _Noreturn void SysExitGroup(struct Machine *m, int rc) {
 #ifdef HAVE_JIT
     ShutdownJit();
 #endif
-#ifndef NDEBUG
+#if STATISTICS
     if (FLAG_statistics) {
       PrintStats();
     }
@@ -409,10 +422,12 @@ static int Fork(struct Machine *m, u64 flags, u64 stack, u64 ctid) {
   // exec_lock must come before fds.lock (see execve)
   // mmap_lock must come before fds.lock (see GetOflags)
   // mmap_lock must come before pagelocks_lock (see FreePage)
+  // mmap_lock must come before rlim_lock (see SysBrk)
   if (m->threaded) {
     LOCK(&m->system->exec_lock);
     LOCK(&m->system->sig_lock);
-    LOCK(&m->system->mmap_lock);
+    WRLOCK(&m->system->mmap_lock);
+    WRLOCK(&m->system->rlim_lock);
     LOCK(&m->system->pagelocks_lock);
     LOCK(&m->system->fds.lock);
     LOCK(&m->system->machines_lock);
@@ -439,7 +454,8 @@ static int Fork(struct Machine *m, u64 flags, u64 stack, u64 ctid) {
     UNLOCK(&m->system->machines_lock);
     UNLOCK(&m->system->fds.lock);
     UNLOCK(&m->system->pagelocks_lock);
-    UNLOCK(&m->system->mmap_lock);
+    RWUNLOCK(&m->system->rlim_lock);
+    RWUNLOCK(&m->system->mmap_lock);
     UNLOCK(&m->system->sig_lock);
     UNLOCK(&m->system->exec_lock);
   }
@@ -484,11 +500,118 @@ static int SysVfork(struct Machine *m) {
   return SysFork(m);
 }
 
+#ifdef HAVE_FORK
+// Turns this process into a fork server once the guest has finished
+// initializing and first reads from FLAG_forkserverfd, which is stdin
+// unless -f says otherwise. Every connection accepted on the unix
+// socket FLAG_forkserver gets its own host fork of the emulator, which
+// inherits the loaded image, the guest heap and all the JIT paths made
+// so far. The connection replaces that descriptor and stdout in the
+// child, which then carries on with the read() the snapshot was taken
+// on, so each request supplies its own input; the arguments and the
+// environment are the ones the server was started with. The server
+// itself never returns, unless it couldn't be set up.
+static void ReapForks(int *pids, int *n) {
+  int i, rc;
+  for (i = 0; i < *n;) {
+    if ((rc = waitpid(pids[i], 0, WNOHANG)) > 0 ||
+        (rc == -1 && errno == ECHILD)) {
+      pids[i] = pids[--*n];
+    } else {
+      ++i;
+    }
+  }
+}
+
+static void ServeForks(struct Machine *m) {
+  int i, fd, pid, server, client, npids, *pids;
+  const char *path;
+  struct sockaddr_un addr;
+  struct sigaction sa, oldsa[3];
+  static const int kServerSignals[3] = {SIGHUP, SIGINT, SIGTERM};
+  path = FLAG_forkserver;
+  fd = FLAG_forkserverfd;
+  FLAG_forkserver = 0;
+  if (m->threaded) {
+    LOGF("fork server can't snapshot a multi-threaded guest");
+    return;
+  }
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    LOGF("fork server path too long: %s", path);
+    return;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+  if ((server = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ||
+      fcntl(server, F_SETFD, FD_CLOEXEC) == -1 ||
+      bind(server, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(server, SOMAXCONN) == -1) {
+    LOGF("fork server %s failed: %s", path, DescribeHostErrno(errno));
+    if (server != -1) close(server);
+    return;
+  }
+  // the server is no longer running guest code, so make it killable
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = SIG_DFL;
+  for (i = 0; i < 3; ++i) {
+    if (sigaction(kServerSignals[i], &sa, oldsa + i)) {
+      LOGF("fork server sigaction failed: %s", DescribeHostErrno(errno));
+      while (i--) sigaction(kServerSignals[i], oldsa + i, 0);
+      close(server);
+      return;
+    }
+  }
+  LOGF("serving forks on %s", path);
+  // only reap our own forks, since the guest may have children too
+  npids = 0;
+  pids = 0;
+  for (;;) {
+    ReapForks(pids, &npids);
+    if ((client = accept(server, 0, 0)) == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      LOGF("fork server accept failed: %s", DescribeHostErrno(errno));
+      _exit(1);
+    }
+    if (!(pids = (int *)realloc(pids, (npids + 1) * sizeof(*pids)))) {
+      LOGF("fork server out of memory");
+      _exit(1);
+    }
+    if ((pid = Fork(m, 0, 0, 0)) == -1) {
+      LOGF("fork server fork failed: %s", DescribeHostErrno(errno));
+      close(client);
+      continue;
+    }
+    if (!pid) {
+      free(pids);
+      close(server);
+      for (i = 0; i < 3; ++i) {
+        sigaction(kServerSignals[i], oldsa + i, 0);
+      }
+      // guest fds are vfs slots rather than host fds when vfs is on
+      if ((client = VfsWrapFd(client)) == -1 ||
+          (client != fd && VfsDup2(client, fd) == -1) ||
+          (client != 1 && VfsDup2(client, 1) == -1)) {
+        // only this request is dropped, the server keeps on serving
+        LOGF("fork server dup2 failed: %s", DescribeHostErrno(errno));
+        _exit(1);
+      }
+      if (client != fd && client != 1) VfsClose(client);
+      return;
+    }
+    pids[npids++] = pid;
+    close(client);
+  }
+}
+#endif
+
 static void *OnSpawn(void *arg) {
   int rc;
   struct Machine *m = (struct Machine *)arg;
   THR_LOGF("pid=%d tid=%d OnSpawn", m->system->pid, m->tid);
   m->thread = pthread_self();
+  SetStatsShard(m->tid);
   if (!(rc = sigsetjmp(m->onhalt, 1))) {
     m->canhalt = true;
     unassert(!pthread_sigmask(SIG_SETMASK, &m->spawn_sigmask, 0));
@@ -1074,10 +1197,10 @@ static int SysMprotect(struct Machine *m, i64 addr, u64 size, int prot) {
     return einval();
   }
   BEGIN_NO_PAGE_FAULTS;
-  LOCK(&m->system->mmap_lock);
+  WRLOCK(&m->system->mmap_lock);
   rc = ProtectVirtual(m->system, addr, size, prot, false);
   unassert(CheckMemoryInvariants(m->system));
-  UNLOCK(&m->system->mmap_lock);
+  RWUNLOCK(&m->system->mmap_lock);
   END_NO_PAGE_FAULTS;
   return rc;
 }
@@ -1090,7 +1213,7 @@ static i64 SysBrk(struct Machine *m, i64 addr) {
   i64 rc, size;
   long pagesize;
   BEGIN_NO_PAGE_FAULTS;
-  LOCK(&m->system->mmap_lock);
+  WRLOCK(&m->system->mmap_lock);
   MEM_LOGF("brk(%#" PRIx64 ") currently %#" PRIx64, addr, m->system->brk);
   pagesize = FLAG_pagesize;
   addr = ROUNDUP(addr, pagesize);
@@ -1129,7 +1252,7 @@ static i64 SysBrk(struct Machine *m, i64 addr) {
   }
   rc = m->system->brk;
   unassert(CheckMemoryInvariants(m->system));
-  UNLOCK(&m->system->mmap_lock);
+  RWUNLOCK(&m->system->mmap_lock);
   END_NO_PAGE_FAULTS;
   return rc;
 }
@@ -1137,10 +1260,10 @@ static i64 SysBrk(struct Machine *m, i64 addr) {
 static int SysMunmap(struct Machine *m, i64 virt, u64 size) {
   int rc;
   BEGIN_NO_PAGE_FAULTS;
-  LOCK(&m->system->mmap_lock);
+  WRLOCK(&m->system->mmap_lock);
   rc = FreeVirtual(m->system, virt, size);
   unassert(CheckMemoryInvariants(m->system));
-  UNLOCK(&m->system->mmap_lock);
+  RWUNLOCK(&m->system->mmap_lock);
   END_NO_PAGE_FAULTS;
   return rc;
 }
@@ -1158,6 +1281,33 @@ int GetOflags(struct Machine *m, int fildes) {
   return oflags;
 }
 
+#ifdef HAVE_MEMFD_CREATE
+// the host refuses shared writable maps of a write sealed memfd, which
+// needs to be caught before ReserveVirtual() treats that as a crisis
+static bool IsWriteSealed(int fildes) {
+  int seals;
+  if ((seals = VfsFcntl(fildes, F_GET_SEALS)) == -1) return false;
+  return !!(UnXlatSeals(seals) &
+            (F_SEAL_WRITE_LINUX | F_SEAL_FUTURE_WRITE_LINUX));
+}
+#endif
+
+// Returns -1 w/ errno if `fildes` is a device the host can't map, e.g.
+// /dev/null, since ReserveVirtual() only finds out once it's committed
+// to the mapping, when there's no way left to report an error.
+static int CheckMappableDevice(int fildes, i64 offset, bool shared) {
+  void *p;
+  struct stat st;
+  if (VfsFstat(fildes, &st) || !S_ISCHR(st.st_mode)) return 0;
+  if ((p = Mmap(0, FLAG_pagesize, PROT_READ,
+                shared ? MAP_SHARED : MAP_PRIVATE, fildes,
+                ROUNDDOWN(offset, FLAG_pagesize), "probe")) == MAP_FAILED) {
+    return -1;
+  }
+  unassert(!Munmap(p, FLAG_pagesize));
+  return 0;
+}
+
 static i64 SysMmapImpl(struct Machine *m, i64 virt, i64 size, int prot,
                        int flags, int fildes, i64 offset) {
   u64 key;
@@ -1199,6 +1349,18 @@ static i64 SysMmapImpl(struct Machine *m, i64 virt, i64 size, int prot,
       errno = EACCES;
       return -1;
     }
+    if (VfsIsDevZero(fildes)) {
+      fildes = -1;  // what linux does, even for shared mappings
+    } else if (CheckMappableDevice(fildes, offset,
+                                   !!(flags & MAP_SHARED_LINUX)) == -1) {
+      return -1;
+    }
+#ifdef HAVE_MEMFD_CREATE
+    if ((prot & PROT_WRITE) && (flags & MAP_SHARED_LINUX) &&
+        IsWriteSealed(fildes)) {
+      return eperm();
+    }
+#endif
   }
   newautomap = -1;
   fixedmap = false;
@@ -1245,10 +1407,10 @@ static i64 SysMmap(struct Machine *m, i64 virt, u64 size, int prot, int flags,
                    int fildes, i64 offset) {
   i64 res;
   BEGIN_NO_PAGE_FAULTS;
-  LOCK(&m->system->mmap_lock);
+  WRLOCK(&m->system->mmap_lock);
   res = SysMmapImpl(m, virt, size, prot, flags, fildes, offset);
   unassert(CheckMemoryInvariants(m->system));
-  UNLOCK(&m->system->mmap_lock);
+  RWUNLOCK(&m->system->mmap_lock);
   END_NO_PAGE_FAULTS;
   return res;
 }
@@ -1296,9 +1458,15 @@ static int XlatMsyncFlags(int flags) {
 }
 
 static int SysMsync(struct Machine *m, i64 virt, u64 size, int flags) {
+  int rc;
   if (size > NUMERIC_MAX(size_t)) return eoverflow();
   if ((flags = XlatMsyncFlags(flags)) == -1) return -1;
-  return SyncVirtual(m->system, virt, size, flags);
+  BEGIN_NO_PAGE_FAULTS;
+  RDLOCK(&m->system->mmap_lock);
+  rc = SyncVirtual(m->system, virt, size, flags);
+  RWUNLOCK(&m->system->mmap_lock);
+  END_NO_PAGE_FAULTS;
+  return rc;
 }
 
 static int SysDup1(struct Machine *m, i32 fildes) {
@@ -1340,6 +1508,16 @@ static int Dup3(struct Machine *m, int fildes, int newfildes, int flags) {
 }
 #endif
 
+// returns true if io_uring holds fildes, which guest can't replace
+static bool IsPinnedFd(struct Machine *m, int fildes) {
+  bool res;
+  struct Fd *fd;
+  LOCK(&m->system->fds.lock);
+  res = (fd = GetFd(&m->system->fds, fildes)) && fd->pinned;
+  UNLOCK(&m->system->fds.lock);
+  return res;
+}
+
 static int SysDup2(struct Machine *m, i32 fildes, i32 newfildes) {
   int rc, oflags;
   struct Fd *fd;
@@ -1356,12 +1534,13 @@ static int SysDup2(struct Machine *m, i32 fildes, i32 newfildes) {
       rc = -1;
     }
     UNLOCK(&m->system->fds.lock);
-  } else if (newfildes >= GetFileDescriptorLimit(m->system)) {
+  } else if (newfildes >= GetFileDescriptorLimit(m->system) ||
+             IsPinnedFd(m, newfildes)) {
     return ebadf();
   } else if ((rc = Dup2(m, fildes, newfildes)) != -1) {
     LOCK(&m->system->fds.lock);
     if ((fd = GetFd(&m->system->fds, newfildes))) {
-      dll_remove(&m->system->fds.list, &fd->elem);
+      RemoveFd(&m->system->fds, fd);
       FreeFd(fd);
     }
     unassert(fd = GetFd(&m->system->fds, fildes));
@@ -1380,6 +1559,7 @@ static int SysDup3(struct Machine *m, i32 fildes, i32 newfildes, i32 flags) {
   if (fildes == newfildes) return einval();
   if (flags & ~O_CLOEXEC_LINUX) return einval();
   if (newfildes >= GetFileDescriptorLimit(m->system)) return ebadf();
+  if (IsPinnedFd(m, newfildes)) return ebadf();
 #ifdef HAVE_DUP3
   if ((rc = Dup3(m, fildes, newfildes, XlatOpenFlags(flags))) != -1) {
 #else
@@ -1390,7 +1570,7 @@ static int SysDup3(struct Machine *m, i32 fildes, i32 newfildes, i32 flags) {
 #endif
     LOCK(&m->system->fds.lock);
     if ((fd = GetFd(&m->system->fds, newfildes))) {
-      dll_remove(&m->system->fds.list, &fd->elem);
+      RemoveFd(&m->system->fds, fd);
       FreeFd(fd);
     }
     unassert(fd = GetFd(&m->system->fds, fildes));
@@ -2177,6 +2357,9 @@ static int SysConnectBind(struct Machine *m, i32 fildes, i64 sockaddr_addr,
   INTERRUPTIBLE(!norestart,
                 (rc = impl(fildes, (const struct sockaddr *)&addr, addrlen)));
   if (rc != -1 && impl == VfsBind) {
+#if defined(DISABLE_VFS) && !defined(DISABLE_OVERLAYS)
+    if (addr.ss_family == AF_UNIX) InvalidateOverlays();
+#endif
     LOCK(&m->system->fds.lock);
     if ((fd = GetFd(&m->system->fds, fildes))) {
       memcpy(&fd->saddr, &addr, sizeof(fd->saddr));
@@ -2342,6 +2525,9 @@ static i64 SysRead(struct Machine *m, i32 fildes, i64 addr, u64 size) {
   struct Iovs iv;
   ssize_t (*readv_impl)(int, const struct iovec *, int);
   if (size > NUMERIC_MAX(size_t)) return eoverflow();
+#ifdef HAVE_FORK
+  if (FLAG_forkserver && fildes == FLAG_forkserverfd) ServeForks(m);
+#endif
   LOCK(&m->system->fds.lock);
   if ((fd = GetFd(&m->system->fds, fildes))) {
     unassert(fd->cb);
@@ -2401,6 +2587,14 @@ static i64 SysWrite(struct Machine *m, i32 fildes, i64 addr, u64 size) {
 
 // FreeBSD doesn't do access mode check on read/write to pipes.
 // Cygwin generally doesn't do access checks or is inconsistent.
+static int CheckFd(struct Machine *m, i32 fildes) {
+  struct Fd *fd;
+  LOCK(&m->system->fds.lock);
+  fd = GetFd(&m->system->fds, fildes);
+  UNLOCK(&m->system->fds.lock);
+  return fd ? 0 : -1;
+}
+
 static long CheckFdAccess(struct Machine *m, i32 fildes, bool writable,
                           int errno_if_check_fails) {
   int oflags;
@@ -2471,6 +2665,11 @@ static i64 SysPreadv2(struct Machine *m, i32 fildes, i64 iovaddr, u32 iovlen,
     return einval();
   }
   if (iovlen > IOV_MAX_LINUX) return einval();
+#ifdef HAVE_FORK
+  if (FLAG_forkserver && fildes == FLAG_forkserverfd && offset == -1) {
+    ServeForks(m);
+  }
+#endif
   LOCK(&m->system->fds.lock);
   if ((fd = GetFd(&m->system->fds, fildes))) {
     unassert(fd->cb);
@@ -2576,36 +2775,49 @@ static i64 SysPwritev(struct Machine *m, i32 fildes, i64 iovaddr, u32 iovlen,
   return SysPwritev2(m, fildes, iovaddr, iovlen, offset, 0);
 }
 
-static i64 SysSendfile(struct Machine *m, i32 out_fd, i32 in_fd, i64 offsetaddr,
-                       u64 count) {
-  u64 toto, offset;
-  ssize_t got, wrote;
-  u8 *buf, *offsetp = 0;
-  size_t chunk, maxchunk = 16384;
-  if (CheckFdAccess(m, out_fd, true, EBADF) == -1) return -1;
-  if (CheckFdAccess(m, in_fd, false, EBADF) == -1) return -1;
-  if (offsetaddr && !(offsetp = (u8 *)SchlepRW(m, offsetaddr, 8))) return -1;
-  if (!(buf = (u8 *)AddToFreeList(m, malloc(maxchunk)))) return -1;
-  if (offsetp) {
-    offset = Read64(offsetp);
-    if ((i64)offset < 0) return einval();
-    if (Read64(offsetp) + count < count ||
-        Read64(offsetp) + count > NUMERIC_MAX(off_t)) {
-      return eoverflow();
-    }
+// returns host fd backing a guest fd if the kernel can move its data
+// directly, or -1 if it has to be bounced through blink's own memory
+static int GetHostFd(struct Machine *m, i32 fildes) {
+  int res;
+  struct Fd *fd;
+  LOCK(&m->system->fds.lock);
+  if ((fd = GetFd(&m->system->fds, fildes)) && fd->cb == &kFdCbHost) {
+    res = VfsGetHostFd(fildes);
+  } else {
+    res = -1;
   }
+  UNLOCK(&m->system->fds.lock);
+  return res;
+}
+
+// copies data between guest fds using a bounce buffer, which is only
+// needed for files that only exist in the virtual filesystem
+static i64 CopyFdData(struct Machine *m, i32 in_fd, i64 *inoff, i32 out_fd,
+                      i64 *outoff, u64 count) {
+  u8 *buf;
+  u64 toto;
+  ssize_t got, wrote;
+  size_t chunk, maxchunk;
+  maxchunk = MIN(count, kCopyFdChunk);
+  if (!(buf = (u8 *)AddToFreeList(m, malloc(MAX(maxchunk, 1))))) return -1;
   for (toto = 0; toto < count;) {
     chunk = MIN(count - toto, maxchunk);
-    if (offsetp) {
-      got = VfsPread(in_fd, buf, chunk, offset + toto);
+    if (inoff) {
+      got = VfsPread(in_fd, buf, chunk, *inoff);
     } else {
       got = VfsRead(in_fd, buf, chunk);
     }
     if (got == -1) goto OnFailure;
-    if (offsetp) Write64(offsetp, offset + toto + got);
+    if (inoff) *inoff += got;
     if (got == 0) break;
     while (got > 0) {
-      if ((wrote = VfsWrite(out_fd, buf, got)) == -1) goto OnFailure;
+      if (outoff) {
+        wrote = VfsPwrite(out_fd, buf, got, *outoff);
+      } else {
+        wrote = VfsWrite(out_fd, buf, got);
+      }
+      if (wrote == -1) goto OnFailure;
+      if (outoff) *outoff += wrote;
       toto += wrote;
       got -= wrote;
     }
@@ -2613,13 +2825,214 @@ static i64 SysSendfile(struct Machine *m, i32 out_fd, i32 in_fd, i64 offsetaddr,
   return toto;
 OnFailure:
   if (toto) {
-    LOGF("sendfile() partial failure: %s", DescribeHostErrno(errno));
+    LOGF("data copy partial failure: %s", DescribeHostErrno(errno));
     return toto;
   } else {
     return -1;
   }
 }
 
+// loads optional file offset argument, where `wrapfirst` asks for the
+// order copy_file_range() checks it in, since a negative offset which
+// wraps around when `count` is added is an overflow rather than EINVAL
+static int LoadFileOffset(struct Machine *m, i64 addr, u64 count, u8 **p,
+                          i64 *offset, bool wrapfirst) {
+  if (!addr) {
+    *p = 0;
+    return 0;
+  }
+  if (!(*p = (u8 *)SchlepRW(m, addr, 8))) return -1;
+  *offset = Read64(*p);
+  if (wrapfirst && (u64)*offset + count < (u64)*offset) return eoverflow();
+  if (*offset < 0) return einval();
+  if (*offset + count < count || *offset + count > NUMERIC_MAX(off_t)) {
+    return eoverflow();
+  }
+  return 0;
+}
+
+static i64 SysSendfile(struct Machine *m, i32 out_fd, i32 in_fd, i64 offsetaddr,
+                       u64 count) {
+  i64 rc, offset;
+  u8 *offsetp;
+  if (CheckFdAccess(m, out_fd, true, EBADF) == -1) return -1;
+  if (CheckFdAccess(m, in_fd, false, EBADF) == -1) return -1;
+  if (LoadFileOffset(m, offsetaddr, count, &offsetp, &offset, false) == -1) {
+    return -1;
+  }
+#if defined(HAVE_SENDFILE) || defined(HAVE_COPY_FILE_RANGE)
+  {
+    off_t off = offset;
+    int hin, hout;
+    if ((hin = GetHostFd(m, in_fd)) != -1 &&
+        (hout = GetHostFd(m, out_fd)) != -1) {
+      count = MIN(count, kMaxCopyFd);
+#ifdef HAVE_SENDFILE
+      RESTARTABLE(rc = sendfile(hout, hin, offsetp ? &off : 0, count));
+#else
+      RESTARTABLE(rc = copy_file_range(hin, offsetp ? &off : 0, hout, 0,
+                                       count, 0));
+      if (rc == -1 && (errno == EINVAL || errno == EXDEV ||
+                       errno == EBADF || errno == ENOSYS)) {
+        goto BounceIt;
+      }
+#endif
+      if (rc != -1 && offsetp) Write64(offsetp, off);
+      return rc;
+    }
+  }
+#ifndef HAVE_SENDFILE
+BounceIt:
+#endif
+#endif
+  rc = CopyFdData(m, in_fd, offsetp ? &offset : 0, out_fd, 0, count);
+  if (offsetp) Write64(offsetp, offset);
+  return rc;
+}
+
+#ifndef DISABLE_NONPOSIX
+
+static i64 SysCopyFileRange(struct Machine *m, i32 in_fd, i64 inoffaddr,
+                            i32 out_fd, i64 outoffaddr, u64 count, u32 flags) {
+  i64 rc, inoff, outoff;
+  u8 *inoffp, *outoffp;
+  if (flags) return einval();
+  if (CheckFdAccess(m, out_fd, true, EBADF) == -1) return -1;
+  if (CheckFdAccess(m, in_fd, false, EBADF) == -1) return -1;
+  if (LoadFileOffset(m, inoffaddr, count, &inoffp, &inoff, true) == -1 ||
+      LoadFileOffset(m, outoffaddr, count, &outoffp, &outoff, true) == -1) {
+    return -1;
+  }
+#ifdef HAVE_COPY_FILE_RANGE
+  {
+    int hin, hout;
+    off_t hinoff = inoff, houtoff = outoff;
+    if ((hin = GetHostFd(m, in_fd)) != -1 &&
+        (hout = GetHostFd(m, out_fd)) != -1) {
+      RESTARTABLE(rc = copy_file_range(hin, inoffp ? &hinoff : 0, hout,
+                                       outoffp ? &houtoff : 0,
+                                       MIN(count, kMaxCopyFd), 0));
+      // older kernels can't copy across filesystems
+      if (rc != -1 || (errno != EXDEV && errno != ENOSYS &&
+                       errno != EOPNOTSUPP)) {
+        if (rc != -1 && inoffp) Write64(inoffp, hinoff);
+        if (rc != -1 && outoffp) Write64(outoffp, houtoff);
+        return rc;
+      }
+    }
+  }
+#endif
+  rc = CopyFdData(m, in_fd, inoffp ? &inoff : 0, out_fd,
+                  outoffp ? &outoff : 0, count);
+  if (rc != -1 && inoffp) Write64(inoffp, inoff);
+  if (rc != -1 && outoffp) Write64(outoffp, outoff);
+  return rc;
+}
+
+static i64 SysSplice(struct Machine *m, i32 in_fd, i64 inoffaddr, i32 out_fd,
+                     i64 outoffaddr, u64 count, u32 flags) {
+  i64 rc, inoff, outoff;
+  u8 *inoffp, *outoffp;
+  if (flags & ~(SPLICE_F_MOVE_LINUX | SPLICE_F_NONBLOCK_LINUX |
+                SPLICE_F_MORE_LINUX | SPLICE_F_GIFT_LINUX)) {
+    return einval();
+  }
+  if (CheckFdAccess(m, out_fd, true, EBADF) == -1) return -1;
+  if (CheckFdAccess(m, in_fd, false, EBADF) == -1) return -1;
+  if (LoadFileOffset(m, inoffaddr, count, &inoffp, &inoff, false) == -1 ||
+      LoadFileOffset(m, outoffaddr, count, &outoffp, &outoff, false) == -1) {
+    return -1;
+  }
+#ifdef HAVE_SPLICE
+  {
+    int hin, hout;
+    unsigned sysflags = 0;
+    off_t hinoff = inoff, houtoff = outoff;
+    if ((hin = GetHostFd(m, in_fd)) != -1 &&
+        (hout = GetHostFd(m, out_fd)) != -1) {
+      if (flags & SPLICE_F_MOVE_LINUX) sysflags |= SPLICE_F_MOVE;
+      if (flags & SPLICE_F_NONBLOCK_LINUX) sysflags |= SPLICE_F_NONBLOCK;
+      if (flags & SPLICE_F_MORE_LINUX) sysflags |= SPLICE_F_MORE;
+      if (flags & SPLICE_F_GIFT_LINUX) sysflags |= SPLICE_F_GIFT;
+      RESTARTABLE(rc = splice(hin, inoffp ? &hinoff : 0, hout,
+                              outoffp ? &houtoff : 0, MIN(count, kMaxCopyFd),
+                              sysflags));
+      if (rc != -1 && inoffp) Write64(inoffp, hinoff);
+      if (rc != -1 && outoffp) Write64(outoffp, houtoff);
+      return rc;
+    }
+  }
+#endif
+  rc = CopyFdData(m, in_fd, inoffp ? &inoff : 0, out_fd,
+                  outoffp ? &outoff : 0, count);
+  if (rc != -1 && inoffp) Write64(inoffp, inoff);
+  if (rc != -1 && outoffp) Write64(outoffp, outoff);
+  return rc;
+}
+
+#ifdef HAVE_SPLICE
+static i64 SysTee(struct Machine *m, i32 in_fd, i32 out_fd, u64 count,
+                  u32 flags) {
+  i64 rc;
+  int hin, hout;
+  unsigned sysflags = 0;
+  if (flags & ~(SPLICE_F_MOVE_LINUX | SPLICE_F_NONBLOCK_LINUX |
+                SPLICE_F_MORE_LINUX | SPLICE_F_GIFT_LINUX)) {
+    return einval();
+  }
+  if (CheckFdAccess(m, out_fd, true, EBADF) == -1) return -1;
+  if (CheckFdAccess(m, in_fd, false, EBADF) == -1) return -1;
+  // tee() only works on pipes, which always live on the host
+  if ((hin = GetHostFd(m, in_fd)) == -1 ||
+      (hout = GetHostFd(m, out_fd)) == -1) {
+    return einval();
+  }
+  if (flags & SPLICE_F_NONBLOCK_LINUX) sysflags |= SPLICE_F_NONBLOCK;
+  RESTARTABLE(rc = tee(hin, hout, MIN(count, kMaxCopyFd), sysflags));
+  return rc;
+}
+#endif
+
+#endif /* DISABLE_NONPOSIX */
+
+#if defined(HAVE_SYS_GETDENTS64) && defined(DISABLE_VFS)
+#define HAVE_GETDENTS_HOST
+#endif
+
+#ifdef HAVE_GETDENTS_HOST
+// linux hosts hand us records in the same layout the guest expects, so
+// we read them straight into a bounce buffer with the getdents64 system
+// call, fix up the byte order, and copy the whole batch to guest memory
+static i64 GetdentsHost(struct Machine *m, i32 fildes, i64 addr, i64 size,
+                        struct Fd *fd) {
+  u8 *buf;
+  u64 ino, off;
+  i64 i, rc;
+  u16 reclen;
+  struct dirent_linux *rec;
+  if (size < sizeof(*rec) - sizeof(rec->name)) return einval();
+  if ((fd->oflags & O_DIRECTORY) != O_DIRECTORY) return enotdir();
+  if (!IsValidMemory(m, addr, size, PROT_WRITE)) return -1;
+  size = MIN(size, kMaxGetdents);
+  if (!(buf = (u8 *)AddToFreeList(m, malloc(size)))) return -1;
+  RESTARTABLE(rc = syscall(SYS_getdents64, fd->fildes, buf, size));
+  if (rc > 0) {
+    for (i = 0; i < rc; i += reclen) {
+      rec = (struct dirent_linux *)(buf + i);
+      memcpy(&ino, rec->ino, 8);
+      memcpy(&off, rec->off, 8);
+      memcpy(&reclen, rec->reclen, 2);
+      Write64(rec->ino, ino);
+      Write64(rec->off, off);
+      Write16(rec->reclen, reclen);
+    }
+    if (CopyToUserWrite(m, addr, buf, rc) == -1) rc = -1;
+  }
+  return rc;
+}
+#endif
+
+#if !defined(HAVE_GETDENTS_HOST) || !defined(DISABLE_OVERLAYS)
 static int UnXlatDt(int x) {
 #ifndef DT_UNKNOWN
   return DT_UNKNOWN_LINUX;
@@ -2639,25 +3052,31 @@ static int UnXlatDt(int x) {
 #endif
 }
 
-static i64 Getdents(struct Machine *m, i32 fildes, i64 addr, i64 size,
-                    struct Fd *fd) {
+static i64 GetdentsDir(struct Machine *m, i32 fildes, i64 addr, i64 size,
+                       struct Fd *fd) {
   i64 i;
+  u8 *buf;
   int type;
   off_t off;
   int reclen;
   size_t len;
   struct stat st;
   struct dirent *ent;
-  struct dirent_linux rec;
-  if (size < sizeof(rec) - sizeof(rec.name)) return einval();
+  struct dirent_linux *rec;
+  if (size < sizeof(*rec) - sizeof(rec->name)) return einval();
   if ((fd->oflags & O_DIRECTORY) != O_DIRECTORY) return enotdir();
   if (!IsValidMemory(m, addr, size, PROT_WRITE)) return -1;
   if (VfsFstat(fildes, &st) || !st.st_nlink) return enoent();
   if (!fd->dirstream && !(fd->dirstream = VfsOpendir(fd->fildes))) {
     return -1;
   }
-  for (i = 0; i + sizeof(rec) <= size; i += reclen) {
-    // telldir() can actually return negative on ARM/MIPS/i386
+  size = MIN(size, kMaxGetdents);
+  if (!(buf = (u8 *)AddToFreeList(m, malloc(size)))) return -1;
+  for (i = 0; i + ROUNDUP(sizeof(*rec), 8) <= size; i += reclen) {
+    if (!(ent = VfsReaddir(fd->dirstream))) break;
+    // linux's d_off is where the next entry is, since it's what libc's
+    // telldir() returns after reading this one. note that telldir() can
+    // actually return negative on ARM/MIPS/i386
 #ifdef HAVE_SEEKDIR
     long tell;
     errno = 0;
@@ -2667,9 +3086,8 @@ static i64 Getdents(struct Machine *m, i32 fildes, i64 addr, i64 size,
 #else
     off = -1;
 #endif
-    if (!(ent = VfsReaddir(fd->dirstream))) break;
     len = strlen(ent->d_name);
-    if (len + 1 > sizeof(rec.name)) {
+    if (len + 1 > sizeof(rec->name)) {
       LOGF("ignoring %zu byte d_name: %s", len, ent->d_name);
       reclen = 0;
       continue;
@@ -2704,16 +3122,34 @@ static i64 Getdents(struct Machine *m, i32 fildes, i64 addr, i64 size,
     }
 #endif
     reclen = ROUNDUP(8 + 8 + 2 + 1 + len + 1, 8);
-    memset(&rec, 0, sizeof(rec));
-    Write64(rec.ino, ent->d_ino);
-    Write64(rec.off, off);
-    Write16(rec.reclen, reclen);
-    Write8(rec.type, type);
-    strcpy(rec.name, ent->d_name);
-    CopyToUserWrite(m, addr + i, &rec, reclen);
-  }
+    rec = (struct dirent_linux *)(buf + i);
+    memset(rec, 0, reclen);
+    Write64(rec->ino, ent->d_ino);
+    Write64(rec->off, off);
+    Write16(rec->reclen, reclen);
+    Write8(rec->type, type);
+    strcpy(rec->name, ent->d_name);
+  }
+  if (i && CopyToUserWrite(m, addr, buf, i) == -1) return -1;
   return i;
 }
+#endif
+
+static i64 Getdents(struct Machine *m, i32 fildes, i64 addr, i64 size,
+                    struct Fd *fd) {
+#ifdef HAVE_GETDENTS_HOST
+#ifndef DISABLE_OVERLAYS
+  // directories of an overlay union need their layers merged, which
+  // the raw getdents64 system call knows nothing about
+  if (fd->dirstream || IsMergedDirectory(fd->fildes)) {
+    return GetdentsDir(m, fildes, addr, size, fd);
+  }
+#endif
+  return GetdentsHost(m, fildes, addr, size, fd);
+#else
+  return GetdentsDir(m, fildes, addr, size, fd);
+#endif
+}
 
 static i64 SysGetdents(struct Machine *m, i32 fildes, i64 addr, i64 size) {
   i64 rc;
@@ -2729,11 +3165,80 @@ static int SysSetTidAddress(struct Machine *m, i64 ctid) {
   return m->tid;
 }
 
-static int SysFadvise(struct Machine *m, u32 fd, u64 offset, u64 len,
+static int SysFadvise(struct Machine *m, i32 fildes, i64 offset, i64 len,
                       i32 advice) {
+#ifdef HAVE_POSIX_FADVISE
+  int rc;
+#endif
+  if (CheckFd(m, fildes) == -1) return -1;
+  if (len < 0) return einval();
+#ifdef HAVE_POSIX_FADVISE
+  if ((advice = XlatFadvise(advice)) == -1) return -1;
+  if ((rc = VfsFadvise(fildes, offset, len, advice))) {
+    errno = rc;
+    return -1;
+  }
+#else
+  if (advice < POSIX_FADV_NORMAL_LINUX || advice > POSIX_FADV_NOREUSE_LINUX) {
+    return einval();
+  }
+#endif
+  return 0;
+}
+
+static i64 SysReadahead(struct Machine *m, i32 fildes, i64 offset,
+                        u64 count) {
+#ifdef HAVE_POSIX_FADVISE
+  int rc;
+#endif
+  struct stat st;
+  if (CheckFdAccess(m, fildes, false, EBADF) == -1) return -1;
+  // linux only reads ahead files with a page cache, and says EINVAL for
+  // pipes and sockets, where posix_fadvise() would have said ESPIPE
+  if (VfsFstat(fildes, &st) == -1) return -1;
+  if (!S_ISREG(st.st_mode) && !S_ISBLK(st.st_mode)) return einval();
+#ifdef HAVE_POSIX_FADVISE
+  if ((rc = VfsFadvise(fildes, offset, MIN(count, NUMERIC_MAX(off_t)),
+                       POSIX_FADV_WILLNEED))) {
+    errno = rc;
+    return -1;
+  }
+#endif
   return 0;
 }
 
+#ifdef HAVE_FALLOCATE
+// linux is the only host with fallocate() so the flags are identical
+_Static_assert(FALLOC_FL_KEEP_SIZE == FALLOC_FL_KEEP_SIZE_LINUX, "");
+_Static_assert(FALLOC_FL_PUNCH_HOLE == FALLOC_FL_PUNCH_HOLE_LINUX, "");
+#endif
+
+static int SysFallocate(struct Machine *m, i32 fildes, i32 mode, i64 offset,
+                        i64 len) {
+#ifdef HAVE_FALLOCATE
+  int rc;
+#endif
+  if (offset < 0 || len <= 0) return einval();
+  if (offset + (u64)len > NUMERIC_MAX(off_t)) return efbig();
+  if (mode & ~(FALLOC_FL_KEEP_SIZE_LINUX | FALLOC_FL_PUNCH_HOLE_LINUX |
+               FALLOC_FL_COLLAPSE_RANGE_LINUX | FALLOC_FL_ZERO_RANGE_LINUX |
+               FALLOC_FL_INSERT_RANGE_LINUX | FALLOC_FL_UNSHARE_RANGE_LINUX)) {
+    LOGF("unsupported %s mode: %#x", "fallocate", mode);
+    return eopnotsupp();
+  }
+  if ((mode & FALLOC_FL_PUNCH_HOLE_LINUX) &&
+      !(mode & FALLOC_FL_KEEP_SIZE_LINUX)) {
+    return eopnotsupp();
+  }
+  if (CheckFdAccess(m, fildes, true, EBADF) == -1) return -1;
+#ifdef HAVE_FALLOCATE
+  RESTARTABLE(rc = VfsFallocate(fildes, mode, offset, len));
+  return rc;
+#else
+  return eopnotsupp();
+#endif
+}
+
 static i64 SysLseek(struct Machine *m, i32 fildes, i64 offset, int whence) {
   i64 rc;
   struct Fd *fd;
@@ -2865,6 +3370,37 @@ static int SysFstatat(struct Machine *m, i32 dirfd, i64 pathaddr, i64 staddr,
   return rc;
 }
 
+static int SysStatx(struct Machine *m, i32 dirfd, i64 pathaddr, i32 flags,
+                    u32 mask, i64 bufaddr) {
+  int rc;
+  struct stat st;
+  const char *path;
+  struct statx_linux gst;
+  if (mask & STATX_RESERVED_LINUX) return einval();
+  if ((flags & AT_STATX_SYNC_TYPE_LINUX) == AT_STATX_SYNC_TYPE_LINUX) {
+    return einval();
+  }
+  if (!(path = LoadStr(m, pathaddr))) return -1;
+  // every host stat() is synchronous with respect to our own writes
+  flags &= ~AT_STATX_SYNC_TYPE_LINUX;
+  if ((flags & AT_EMPTY_PATH_LINUX) && !*path) {
+    if (dirfd == AT_FDCWD_LINUX) {
+      rc = VfsStat(AT_FDCWD, ".", &st, 0);
+    } else {
+      rc = VfsFstat(dirfd, &st);
+    }
+  } else if ((flags = XlatFstatatFlags(flags & ~AT_EMPTY_PATH_LINUX)) != -1) {
+    rc = VfsStat(GetDirFildes(dirfd), path, &st, flags);
+  } else {
+    rc = einval();
+  }
+  if (rc != -1) {
+    XlatStatxToLinux(&gst, &st);
+    if (CopyToUserWrite(m, bufaddr, &gst, sizeof(gst)) == -1) rc = -1;
+  }
+  return rc;
+}
+
 static int XlatFchownatFlags(int x) {
   int res = 0;
   if (x & AT_SYMLINK_FOLLOW_LINUX) {
@@ -3293,6 +3829,18 @@ static int SysFcntl(struct Machine *m, i32 fildes, i32 cmd, i64 arg) {
   } else if (cmd == F_GETOWN_EX_LINUX) {
     rc = SysFcntlGetownEx(m, fd->fildes, arg);
 #endif
+#ifdef HAVE_MEMFD_CREATE
+  } else if (cmd == F_ADD_SEALS_LINUX) {
+    if ((fl = XlatSeals(arg)) != -1) {
+      rc = VfsFcntl(fd->fildes, F_ADD_SEALS, fl);
+    } else {
+      rc = -1;
+    }
+  } else if (cmd == F_GET_SEALS_LINUX) {
+    if ((rc = VfsFcntl(fd->fildes, F_GET_SEALS)) != -1) {
+      rc = UnXlatSeals(rc);
+    }
+#endif
 #endif
   } else {
     LOGF("missing fcntl() command %" PRId32, cmd);
@@ -3647,15 +4195,15 @@ static bool IsSupportedResourceLimit(int resource) {
 
 static void GetResourceLimit_(struct Machine *m, int resource,
                               struct rlimit_linux *lux) {
-  LOCK(&m->system->mmap_lock);
+  RDLOCK(&m->system->rlim_lock);
   memcpy(lux, m->system->rlim + resource, sizeof(*lux));
-  UNLOCK(&m->system->mmap_lock);
+  RWUNLOCK(&m->system->rlim_lock);
 }
 
 static int SetResourceLimit(struct Machine *m, int resource,
                             const struct rlimit_linux *lux) {
   int rc;
-  LOCK(&m->system->mmap_lock);
+  WRLOCK(&m->system->rlim_lock);
   if (Read64(lux->cur) <= Read64(m->system->rlim[resource].max) &&
       Read64(lux->max) <= Read64(m->system->rlim[resource].max)) {
     memcpy(m->system->rlim + resource, lux, sizeof(*lux));
@@ -3663,7 +4211,7 @@ static int SetResourceLimit(struct Machine *m, int resource,
   } else {
     rc = eperm();
   }
-  UNLOCK(&m->system->mmap_lock);
+  RWUNLOCK(&m->system->rlim_lock);
   return rc;
 }
 
@@ -3772,7 +4320,8 @@ static ssize_t SysGetrandom(struct Machine *m, i64 a, size_t n, int f) {
 
 void OnSignal(int sig, siginfo_t *si, void *uc) {
   SIG_LOGF("OnSignal(%s)", DescribeSignal(UnXlatSignal(sig)));
-  EnqueueSignal(g_machine, UnXlatSignal(sig));
+  EnqueueSignalFrom(g_machine, UnXlatSignal(sig),
+                    UnXlatSiCode(sig, si->si_code), si->si_pid, si->si_uid);
 }
 
 static int SysSigaction(struct Machine *m, int sig, i64 act, i64 old,
@@ -3836,7 +4385,8 @@ static int SysSigaction(struct Machine *m, int sig, i64 act, i64 old,
   if (act) {
     m->system->hands[sig - 1] = hand;
     if (isignored) {
-      m->signals &= ~((u64)1 << (sig - 1));
+      atomic_fetch_and_explicit(&m->signals, ~((u64)1 << (sig - 1)),
+                                memory_order_acq_rel);
     }
     if ((syssig = XlatSignal(sig)) != -1 && !IsBlinkSig(m->system, sig)) {
       sigfillset(&syshand.sa_mask);
@@ -3847,7 +4397,11 @@ static int SysSigaction(struct Machine *m, int sig, i64 act, i64 old,
 #endif
       switch (handler) {
         case SIG_DFL_LINUX:
-          syshand.sa_handler = SIG_DFL;
+          if (IsSignalFdSig(m->system, sig)) {
+            syshand.sa_sigaction = OnSignal;
+          } else {
+            syshand.sa_handler = SIG_DFL;
+          }
           break;
         case SIG_IGN_LINUX:
           syshand.sa_handler = SIG_IGN;
@@ -4410,31 +4964,165 @@ static int SaveFdSet(struct Machine *m, int nfds, const fd_set *fds, i64 addr) {
   return CopyToUserWrite(m, addr, p, FD_SETSIZE_LINUX / 8);
 }
 
-static i32 Select(struct Machine *m,          //
-                  i32 nfds,                   //
-                  i64 readfds_addr,           //
-                  i64 writefds_addr,          //
-                  i64 exceptfds_addr,         //
-                  struct timespec *timeoutp,  //
-                  const u64 *sigmaskp_guest) {
-  int fildes, rc;
-  i32 setsize;
-  u64 oldmask_guest = 0;
-  fd_set readfds, writefds, exceptfds, readyreadfds, readywritefds,
-      readyexceptfds;
-  struct pollfd hfds[1];
-  struct timespec now, wait, remain, deadline = {0};
+// Waits for events on guest file descriptors. The caller passes guest
+// fds along with host poll() event bits, and receives host revents in
+// return. Descriptors that are backed by a host fd, including hostfs
+// ones in the VFS, are all waited upon by a single host ppoll() call,
+// with signals only being unblocked for its duration, similar to
+// EpollPwait(). Virtual fds that don't have a host fd are asked
+// individually through their poll callback, in which case we can't
+// block for longer than kPollingMs. If wakefd isn't -1, it's a host fd
+// that ends the wait early once readable, in which case a single byte
+// is consumed from it.
+static int PollFds(struct Machine *m, struct pollfd *fds, nfds_t n,
+                   int wakefd, struct timespec deadline) {
+  char b;
+  nfds_t i, hn;
   struct Fd *fd;
-  int (*poll_impl)(struct pollfd *, nfds_t, int);
-  if (timeoutp) {
-    deadline = AddTime(GetTime(), *timeoutp);
+  bool isvirtual;
+  int rc, bad, got, hostfd;
+  struct pollfd *hfds, pfd;
+  sigset_t block, oldmask;
+  struct timespec now, wait, *waitp;
+  int (**impls)(struct pollfd *, nfds_t, int);
+  if (!(hfds = (struct pollfd *)AddToFreeList(
+            m, calloc(n + 1, sizeof(*hfds)))) ||
+      !(impls = (int (**)(struct pollfd *, nfds_t, int))AddToFreeList(
+            m, calloc(n ? n : 1, sizeof(*impls))))) {
+    return -1;
   }
-  setsize = MIN(FD_SETSIZE, FD_SETSIZE_LINUX);
-  if (nfds < 0 || nfds > setsize) {
-    LOGF("select() nfds=%d can't exceed %d on this platform", nfds, setsize);
-    return einval();
+  bad = 0;
+  isvirtual = false;
+  LOCK(&m->system->fds.lock);
+  for (i = 0; i < n; ++i) {
+    hfds[i].fd = -1;
+    hfds[i].events = fds[i].events;
+    fds[i].revents = 0;
+    if (fds[i].fd < 0) continue;
+    if ((fd = GetFd(&m->system->fds, fds[i].fd))) {
+      unassert(fd->cb);
+      unassert(fd->cb->poll);
+      if (fd->cb->poll == VfsPoll &&
+          (hostfd = VfsGetHostFd(fds[i].fd)) != -1) {
+        hfds[i].fd = hostfd;
+      } else {
+        impls[i] = fd->cb->poll;
+        isvirtual = true;
+      }
+    } else {
+      fds[i].revents = POLLNVAL;
+      ++bad;
+    }
   }
-  if (readfds_addr) {
+  UNLOCK(&m->system->fds.lock);
+  hn = n;
+  if (wakefd != -1) {
+    hfds[hn].fd = wakefd;
+    hfds[hn].events = POLLIN;
+    ++hn;
+  }
+  unassert(!sigfillset(&block));
+  unassert(!pthread_sigmask(SIG_BLOCK, &block, &oldmask));
+  for (;;) {
+    if (CheckInterrupt(m, false)) {
+      rc = eintr();
+      break;
+    }
+    got = bad;
+    if (isvirtual) {
+      for (i = 0; i < n; ++i) {
+        if (!impls[i]) continue;
+        pfd.fd = fds[i].fd;
+        pfd.events = fds[i].events;
+        pfd.revents = 0;
+        switch (impls[i](&pfd, 1, 0)) {
+          case 0:
+            fds[i].revents = 0;
+            break;
+          case 1:
+            fds[i].revents = pfd.revents ? pfd.revents : POLLERR;
+            ++got;
+            break;
+          default:
+            fds[i].revents = errno == EINTR ? 0 : POLLERR;
+            got += !!fds[i].revents;
+            break;
+        }
+      }
+    }
+    if (got) {
+      wait = GetZeroTime();
+      waitp = &wait;
+    } else if (!CompareTime(deadline, GetMaxTime()) && !isvirtual) {
+      waitp = 0;
+    } else {
+      now = GetTime();
+      if (CompareTime(now, deadline) < 0) {
+        wait = SubtractTime(deadline, now);
+      } else {
+        wait = GetZeroTime();
+      }
+      if (isvirtual && CompareTime(wait, FromMilliseconds(kPollingMs)) > 0) {
+        wait = FromMilliseconds(kPollingMs);
+      }
+      waitp = &wait;
+    }
+#ifdef HAVE_PPOLL
+    rc = ppoll(hfds, hn, waitp, &oldmask);
+#else
+    unassert(!pthread_sigmask(SIG_SETMASK, &oldmask, 0));
+    rc = poll(hfds, hn, waitp ? ConvertTimeToInt(ToMilliseconds(*waitp)) : -1);
+    unassert(!pthread_sigmask(SIG_BLOCK, &block, 0));
+#endif
+    if (rc == -1) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    for (i = 0; i < n; ++i) {
+      if (hfds[i].fd >= 0) {
+        fds[i].revents = hfds[i].revents;
+        got += !!hfds[i].revents;
+      }
+    }
+    if (hn > n && hfds[n].revents) {
+      (void)!read(wakefd, &b, 1);
+      rc = got;
+      break;
+    }
+    if (got || (waitp && CompareTime(GetTime(), deadline) >= 0)) {
+      rc = got;
+      break;
+    }
+  }
+  unassert(!pthread_sigmask(SIG_SETMASK, &oldmask, 0));
+  return rc;
+}
+
+static i32 Select(struct Machine *m,          //
+                  i32 nfds,                   //
+                  i64 readfds_addr,           //
+                  i64 writefds_addr,          //
+                  i64 exceptfds_addr,         //
+                  struct timespec *timeoutp,  //
+                  const u64 *sigmaskp_guest) {
+  i32 setsize;
+  int i, n, fildes, rc;
+  u64 oldmask_guest = 0;
+  struct pollfd *fds;
+  fd_set readfds, writefds, exceptfds, readyreadfds, readywritefds,
+      readyexceptfds;
+  struct timespec now, deadline;
+  if (timeoutp) {
+    deadline = AddTime(GetTime(), *timeoutp);
+  } else {
+    deadline = GetMaxTime();
+  }
+  setsize = MIN(FD_SETSIZE, FD_SETSIZE_LINUX);
+  if (nfds < 0 || nfds > setsize) {
+    LOGF("select() nfds=%d can't exceed %d on this platform", nfds, setsize);
+    return einval();
+  }
+  if (readfds_addr) {
     if (LoadFdSet(m, nfds, &readfds, readfds_addr) == -1) {
       return -1;
     }
@@ -4458,86 +5146,47 @@ static i32 Select(struct Machine *m,          //
   FD_ZERO(&readyreadfds);
   FD_ZERO(&readywritefds);
   FD_ZERO(&readyexceptfds);
+  if (!(fds = (struct pollfd *)AddToFreeList(
+            m, calloc(nfds ? nfds : 1, sizeof(*fds))))) {
+    return -1;
+  }
+  for (n = fildes = 0; fildes < nfds; ++fildes) {
+    if (FD_ISSET(fildes, &readfds) || FD_ISSET(fildes, &writefds) ||
+        FD_ISSET(fildes, &exceptfds)) {
+      fds[n].fd = fildes;
+      fds[n].events = ((FD_ISSET(fildes, &readfds) ? POLLIN : 0) |
+                       (FD_ISSET(fildes, &writefds) ? POLLOUT : 0) |
+                       (FD_ISSET(fildes, &exceptfds) ? POLLPRI : 0));
+      ++n;
+    }
+  }
   if (sigmaskp_guest) {
     oldmask_guest = m->sigmask;
     m->sigmask = *sigmaskp_guest;
     SIG_LOGF("sigmask push %" PRIx64, m->sigmask);
   }
-  for (;;) {
-    if (CheckInterrupt(m, false)) {
-      rc = eintr();
-      break;
-    }
-    rc = 0;
-    for (fildes = 0; fildes < nfds; ++fildes) {
-      if (!FD_ISSET(fildes, &readfds) && !FD_ISSET(fildes, &writefds) &&
-          !FD_ISSET(fildes, &exceptfds)) {
-        continue;
-      }
-    TryAgain:
-      if (CheckInterrupt(m, false)) {
-        rc = eintr();
+  if ((rc = PollFds(m, fds, n, -1, deadline)) > 0) {
+    for (rc = i = 0; i < n; ++i) {
+      fildes = fds[i].fd;
+      if (fds[i].revents & POLLNVAL) {
+        rc = ebadf();
         break;
       }
-      LOCK(&m->system->fds.lock);
-      if ((fd = GetFd(&m->system->fds, fildes))) {
-        unassert(fd->cb);
-        unassert(poll_impl = fd->cb->poll);
-      } else {
-        poll_impl = 0;
+      if (FD_ISSET(fildes, &readfds) &&
+          (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+        FD_SET(fildes, &readyreadfds);
+        ++rc;
       }
-      UNLOCK(&m->system->fds.lock);
-      if (fd) {
-        hfds[0].fd = fildes;
-        hfds[0].events = ((FD_ISSET(fildes, &readfds) ? POLLIN : 0) |
-                          (FD_ISSET(fildes, &writefds) ? POLLOUT : 0) |
-                          (FD_ISSET(fildes, &exceptfds) ? POLLPRI : 0));
-        switch (poll_impl(hfds, 1, 0)) {
-          case 0:
-            break;
-          case 1:
-            if (FD_ISSET(fildes, &readfds) && (hfds[0].revents & POLLIN)) {
-              ++rc;
-              FD_SET(fildes, &readyreadfds);
-              FD_CLR(fildes, &readfds);
-            }
-            if (FD_ISSET(fildes, &writefds) && (hfds[0].revents & POLLOUT)) {
-              ++rc;
-              FD_SET(fildes, &readywritefds);
-              FD_CLR(fildes, &writefds);
-            }
-            if (FD_ISSET(fildes, &exceptfds) && (hfds[0].revents & POLLPRI)) {
-              ++rc;
-              FD_SET(fildes, &readyexceptfds);
-              FD_CLR(fildes, &exceptfds);
-            }
-            break;
-          case -1:
-            if (errno == EINTR) {
-              goto TryAgain;
-            }
-            rc = -1;
-            goto BreakLoop;
-        }
-      } else {
-        rc = ebadf();
-        break;
+      if (FD_ISSET(fildes, &writefds) &&
+          (fds[i].revents & (POLLOUT | POLLERR))) {
+        FD_SET(fildes, &readywritefds);
+        ++rc;
       }
-    }
-  BreakLoop:
-    if (rc || (timeoutp && CompareTime(now = GetTime(), deadline) >= 0)) {
-      break;
-    }
-    if (timeoutp) {
-      wait = FromMilliseconds(kPollingMs);
-      remain = SubtractTime(deadline, now);
-      if (CompareTime(remain, wait) < 0) {
-        wait = remain;
+      if (FD_ISSET(fildes, &exceptfds) && (fds[i].revents & POLLPRI)) {
+        FD_SET(fildes, &readyexceptfds);
+        ++rc;
       }
-    } else {
-      wait = FromMilliseconds(kPollingMs);
     }
-    nanosleep(&wait, 0);
   }
   if (sigmaskp_guest) {
     m->sigmask = oldmask_guest;
@@ -4661,82 +5310,35 @@ static i32 SysPselect(struct Machine *m, i32 nfds, i64 readfds_addr,
 
 static int Poll(struct Machine *m, i64 fdsaddr, u64 nfds,
                 struct timespec deadline) {
-  long i;
+  u64 i;
+  int rc, ev;
   u64 gfdssize;
-  struct Fd *fd;
-  int fildes, rc, ev;
-  struct pollfd hfds[1];
+  struct pollfd *fds;
   struct pollfd_linux *gfds;
-  struct timespec now, wait, remain;
-  int (*poll_impl)(struct pollfd *, nfds_t, int);
   if (!CheckedMul(nfds, sizeof(struct pollfd_linux), &gfdssize) &&
       gfdssize <= 0x7ffff000) {
-    if ((gfds = (struct pollfd_linux *)AddToFreeList(m, malloc(gfdssize)))) {
-      rc = 0;
+    if ((gfds = (struct pollfd_linux *)AddToFreeList(m, malloc(gfdssize))) &&
+        (fds = (struct pollfd *)AddToFreeList(
+             m, calloc(nfds ? nfds : 1, sizeof(*fds))))) {
       CopyFromUserRead(m, gfds, fdsaddr, gfdssize);
-      for (;;) {
+      for (i = 0; i < nfds; ++i) {
+        fds[i].fd = (i32)Read32(gfds[i].fd);
+        ev = Read16(gfds[i].events);
+        fds[i].events = (((ev & POLLIN_LINUX) ? POLLIN : 0) |
+                         ((ev & POLLOUT_LINUX) ? POLLOUT : 0) |
+                         ((ev & POLLPRI_LINUX) ? POLLPRI : 0));
+      }
+      if ((rc = PollFds(m, fds, nfds, -1, deadline)) != -1) {
         for (i = 0; i < nfds; ++i) {
-        TryAgain:
-          if (CheckInterrupt(m, false)) {
-            rc = eintr();
-            break;
-          }
-          fildes = Read32(gfds[i].fd);
-          LOCK(&m->system->fds.lock);
-          if ((fd = GetFd(&m->system->fds, fildes))) {
-            unassert(fd->cb);
-            unassert(poll_impl = fd->cb->poll);
-          } else {
-            poll_impl = 0;
-          }
-          UNLOCK(&m->system->fds.lock);
-          if (fd) {
-            hfds[0].fd = fildes;
-            ev = Read16(gfds[i].events);
-            hfds[0].events = (((ev & POLLIN_LINUX) ? POLLIN : 0) |
-                              ((ev & POLLOUT_LINUX) ? POLLOUT : 0) |
-                              ((ev & POLLPRI_LINUX) ? POLLPRI : 0));
-            switch (poll_impl(hfds, 1, 0)) {
-              case 0:
-                Write16(gfds[i].revents, 0);
-                break;
-              case 1:
-                ++rc;
-                ev = 0;
-                if (hfds[0].revents & POLLIN) ev |= POLLIN_LINUX;
-                if (hfds[0].revents & POLLPRI) ev |= POLLPRI_LINUX;
-                if (hfds[0].revents & POLLOUT) ev |= POLLOUT_LINUX;
-                if (hfds[0].revents & POLLERR) ev |= POLLERR_LINUX;
-                if (hfds[0].revents & POLLHUP) ev |= POLLHUP_LINUX;
-                if (hfds[0].revents & POLLNVAL) ev |= POLLERR_LINUX;
-                if (!ev) ev |= POLLERR_LINUX;
-                Write16(gfds[i].revents, ev);
-                break;
-              case -1:
-                if (errno == EINTR) {
-                  goto TryAgain;
-                }
-                ++rc;
-                Write16(gfds[i].revents, POLLERR_LINUX);
-                break;
-              default:
-                break;
-            }
-          } else {
-            Write16(gfds[i].revents, POLLNVAL_LINUX);
-          }
-        }
-        if (rc || CompareTime((now = GetTime()), deadline) >= 0) {
-          break;
-        }
-        wait = FromMilliseconds(kPollingMs);
-        remain = SubtractTime(deadline, now);
-        if (CompareTime(remain, wait) < 0) {
-          wait = remain;
+          ev = 0;
+          if (fds[i].revents & POLLIN) ev |= POLLIN_LINUX;
+          if (fds[i].revents & POLLPRI) ev |= POLLPRI_LINUX;
+          if (fds[i].revents & POLLOUT) ev |= POLLOUT_LINUX;
+          if (fds[i].revents & POLLERR) ev |= POLLERR_LINUX;
+          if (fds[i].revents & POLLHUP) ev |= POLLHUP_LINUX;
+          if (fds[i].revents & POLLNVAL) ev |= POLLNVAL_LINUX;
+          Write16(gfds[i].revents, ev);
         }
-        nanosleep(&wait, 0);
-      }
-      if (rc != -1) {
         CopyToUserWrite(m, fdsaddr, gfds, nfds * sizeof(*gfds));
       }
     } else {
@@ -4908,7 +5510,7 @@ static int SysTkill(struct Machine *m, int tid, int sig) {
       UNLOCK(&m->system->sig_lock);
       return rc;
     } else {
-      m->signals |= (u64)1 << (sig - 1);
+      EnqueueSignalFrom(m, sig, SI_TKILL_LINUX, m->system->pid, getuid());
       return 0;
     }
   }
@@ -4928,7 +5530,8 @@ static int SysTkill(struct Machine *m, int tid, int sig) {
       m2 = MACHINE_CONTAINER(e);
       if (m2->tid == tid) {
         if (sig) {
-          EnqueueSignal(m2, sig);
+          EnqueueSignalFrom(m2, sig, SI_TKILL_LINUX, m->system->pid,
+                            getuid());
           err = pthread_kill(m2->thread, SIGSYS);
         } else {
           err = pthread_kill(m2->thread, 0);
@@ -5185,7 +5788,7 @@ static int SysSchedYield(struct Machine *m) {
 }
 
 static int SysUmask(struct Machine *m, int mask) {
-  return umask(mask);
+  return VfsUmask(mask);
 }
 
 static int SysSetuid(struct Machine *m, int uid) {
@@ -5440,145 +6043,1690 @@ static int SysEpollWait(struct Machine *m, i32 epfd, i64 eventsaddr,
 
 #endif /* HAVE_EPOLL_PWAIT1 */
 
-void OpSyscall(P) {
-  size_t mark;
-  u64 ax, di, si, dx, r0, r8, r9;
-  unassert(!m->nofault);
-  if (Get64(m->ax) == 0xE4) {
-    // clock_gettime() is
-    //   1) called frequently,
-    //   2) latency sensitive, and
-    //   3) usually implemented as a VDSO.
-    // Therefore we exempt it from system call tracing.
-    ax = SysClockGettime(m, Get64(m->di), Get64(m->si));
-    Put64(m->ax, ax != -1 ? ax : -(XlatErrno(errno) & 0xfff));
-    return;
+#ifndef DISABLE_NONPOSIX
+
+static i32 AddEventFd(struct Machine *m, int fildes, int oflags,
+                      const struct FdCb *cb) {
+  int lim;
+  struct Fd *fd;
+  if (fildes == -1) return -1;
+  if ((fildes = VfsWrapFd(fildes)) == -1) return -1;
+  if (!(lim = GetFileDescriptorLimit(m->system)) || fildes >= lim) {
+    VfsClose(fildes);
+    return emfile();
   }
-  STATISTIC(++syscalls);
-  // make sure blinkenlights display is up to date before performing any
-  // potentially blocking operations which would otherwise freeze things
-  if (m->system->redraw && m->tid == m->system->pid) {
-    m->system->redraw(true);
+  LOCK(&m->system->fds.lock);
+  unassert(fd = AddFd(&m->system->fds, fildes, oflags));
+  fd->cb = cb;
+  UNLOCK(&m->system->fds.lock);
+  return fildes;
+}
+
+#ifdef HAVE_EVENTFD
+
+static i32 SysEventfd2(struct Machine *m, u32 initval, i32 flags) {
+  int oflags, sysflags;
+  oflags = O_RDWR;
+  sysflags = 0;
+  if (flags & EFD_CLOEXEC_LINUX) {
+    oflags |= O_CLOEXEC;
+    sysflags |= EFD_CLOEXEC;
+    flags &= ~EFD_CLOEXEC_LINUX;
   }
-  // unlike pure opcodes where we'll confidently longjmp out of segfault
-  // handlers, system calls are too complex to do that safely, and it is
-  // therefore of the highest importance that they never crash under any
-  // circumstances. in order to do ensure that we need to lock any pages
-  // the system call accesses, so the user can't munmap() them away from
-  // some other thread. since we don't want to slow down instructions by
-  // adding locking logic to the tranlation lookaside buffer, we need to
-  // ensure any memory references the system call performs will tlb miss
-  m->insyscall = true;
-  if (!m->sysdepth++) {
-    atomic_store_explicit(&m->invalidated, true, memory_order_relaxed);
+  if (flags & EFD_NONBLOCK_LINUX) {
+    oflags |= O_NDELAY;
+    sysflags |= EFD_NONBLOCK;
+    flags &= ~EFD_NONBLOCK_LINUX;
   }
-  // to make system calls simpler and safer, any temporary memory that's
-  // allocated will be added to a free list to be collected later. since
-  // OpSyscall() is potentially recursive when SA_RESTART signals happen
-  // we need to save the current mark, so we don't collect parent's data
-  mark = m->freelist.n;
-  m->interrupted = false;
-  ax = Get64(m->ax);
-  di = Get64(m->di);
-  si = Get64(m->si);
-  dx = Get64(m->dx);
-  r0 = Get64(m->r10);
-  r8 = Get64(m->r8);
-  r9 = Get64(m->r9);
-  switch (ax & 0xfff) {
-    SYSCALL(3, 0x000, "read", SysRead, STRACE_READ);
-    SYSCALL(3, 0x001, "write", SysWrite, STRACE_WRITE);
-    SYSCALL(3, 0x002, "open", SysOpen, STRACE_OPEN);
-    SYSCALL(1, 0x003, "close", SysClose, STRACE_CLOSE);
-    SYSCALL(2, 0x004, "stat", SysStat, STRACE_STAT);
-    SYSCALL(2, 0x005, "fstat", SysFstat, STRACE_FSTAT);
-    SYSCALL(2, 0x006, "lstat", SysLstat, STRACE_LSTAT);
-    SYSCALL(3, 0x007, "poll", SysPoll, STRACE_3);
-    SYSCALL(3, 0x008, "lseek", SysLseek, STRACE_LSEEK);
-    SYSCALL(6, 0x009, "mmap", SysMmap, STRACE_MMAP);
-    SYSCALL(4, 0x011, "pread", SysPread, STRACE_PREAD);
-    SYSCALL(4, 0x012, "pwrite", SysPwrite, STRACE_PWRITE);
-    SYSCALL(5, 0x017, "select", SysSelect, STRACE_SELECT);
-    SYSCALL(5, 0x019, "mremap", SysMremap, STRACE_5);
-    SYSCALL(6, 0x10E, "pselect6", SysPselect, STRACE_6);
-    SYSCALL(3, 0x01A, "msync", SysMsync, STRACE_3);
-    SYSCALL(3, 0x00A, "mprotect", SysMprotect, STRACE_MPROTECT);
-    SYSCALL(2, 0x00B, "munmap", SysMunmap, STRACE_MUNMAP);
-    SYSCALL(4, 0x00D, "rt_sigaction", SysSigaction, STRACE_SIGACTION);
-    SYSCALL(4, 0x00E, "rt_sigprocmask", SysSigprocmask, STRACE_SIGPROCMASK);
-    SYSCALL(3, 0x010, "ioctl", SysIoctl, STRACE_3);
-    SYSCALL(3, 0x013, "readv", SysReadv, STRACE_READV);
-    SYSCALL(3, 0x014, "writev", SysWritev, STRACE_WRITEV);
-    SYSCALL(2, 0x015, "access", SysAccess, STRACE_ACCESS);
-    SYSCALL(3, 0x10D, "faccessat", SysFaccessat, STRACE_FACCESSAT);
-    SYSCALL(4, 0x1b7, "faccessat2", SysFaccessat2, STRACE_FACCESSAT2);
-    SYSCALL(0, 0x018, "sched_yield", SysSchedYield, STRACE_0);
-    SYSCALL(3, 0x01C, "madvise", SysMadvise, STRACE_3);
-    SYSCALL(1, 0x020, "dup", SysDup1, STRACE_DUP);
-    SYSCALL(2, 0x021, "dup2", SysDup2, STRACE_DUP2);
-    SYSCALL(0, 0x022, "pause", SysPause, STRACE_PAUSE);
-    SYSCALL(2, 0x023, "nanosleep", SysNanosleep, STRACE_NANOSLEEP);
-    SYSCALL(2, 0x024, "getitimer", SysGetitimer, STRACE_2);
-    SYSCALL(1, 0x025, "alarm", SysAlarm, STRACE_ALARM);
-    SYSCALL(3, 0x026, "setitimer", SysSetitimer, STRACE_3);
-    SYSCALL(0, 0x027, "getpid", SysGetpid, STRACE_GETPID);
-    SYSCALL(0, 0x0BA, "gettid", SysGettid, STRACE_GETTID);
-    SYSCALL(1, 0x03F, "uname", SysUname, STRACE_1);
-    SYSCALL(3, 0x048, "fcntl", SysFcntl, STRACE_FCNTL);
-    SYSCALL(2, 0x049, "flock", SysFlock, STRACE_2);
-    SYSCALL(1, 0x04A, "fsync", SysFsync, STRACE_FSYNC);
-    SYSCALL(1, 0x04B, "fdatasync", SysFdatasync, STRACE_FDATASYNC);
-    SYSCALL(2, 0x04C, "truncate", SysTruncate, STRACE_TRUNCATE);
-    SYSCALL(2, 0x04D, "ftruncate", SysFtruncate, STRACE_FTRUNCATE);
-    SYSCALL(2, 0x04F, "getcwd", SysGetcwd, STRACE_GETCWD);
-    SYSCALL(1, 0x050, "chdir", SysChdir, STRACE_CHDIR);
-    SYSCALL(1, 0x051, "fchdir", SysFchdir, STRACE_FCHOWN);
-    SYSCALL(2, 0x052, "rename", SysRename, STRACE_RENAME);
-    SYSCALL(2, 0x053, "mkdir", SysMkdir, STRACE_MKDIR);
-    SYSCALL(1, 0x054, "rmdir", SysRmdir, STRACE_RMDIR);
-    SYSCALL(2, 0x055, "creat", SysCreat, STRACE_CREAT);
-    SYSCALL(2, 0x056, "link", SysLink, STRACE_LINK);
-    SYSCALL(1, 0x057, "unlink", SysUnlink, STRACE_UNLINK);
-    SYSCALL(2, 0x058, "symlink", SysSymlink, STRACE_SYMLINK);
-    SYSCALL(3, 0x059, "readlink", SysReadlink, STRACE_READLINK);
-    SYSCALL(2, 0x05A, "chmod", SysChmod, STRACE_CHMOD);
-    SYSCALL(2, 0x05B, "fchmod", SysFchmod, STRACE_FCHOWN);
-    SYSCALL(3, 0x05C, "chown", SysChown, STRACE_CHOWN);
-    SYSCALL(3, 0x05D, "fchown", SysFchown, STRACE_FCHOWN);
-    SYSCALL(3, 0x05E, "lchown", SysLchown, STRACE_LCHOWN);
-    SYSCALL(5, 0x104, "fchownat", SysFchownat, STRACE_CHOWNAT);
-    SYSCALL(1, 0x05F, "umask", SysUmask, STRACE_UMASK);
-    SYSCALL(2, 0x060, "gettimeofday", SysGettimeofday, STRACE_2);
-    SYSCALL(2, 0x061, "getrlimit", SysGetrlimit, STRACE_GETRLIMIT);
-    SYSCALL(2, 0x062, "getrusage", SysGetrusage, STRACE_2);
-    SYSCALL(1, 0x064, "times", SysTimes, STRACE_1);
-    SYSCALL(0, 0x06F, "getpgrp", SysGetpgrp, STRACE_GETPGRP);
-    SYSCALL(0, 0x070, "setsid", SysSetsid, STRACE_SETSID);
-    SYSCALL(2, 0x073, "getgroups", SysGetgroups, STRACE_2);
-    SYSCALL(1, 0x079, "getpgid", SysGetpgid, STRACE_GETPGID);
-    SYSCALL(1, 0x07C, "getsid", SysGetsid, STRACE_1);
-    SYSCALL(1, 0x07F, "rt_sigpending", SysSigpending, STRACE_1);
-    SYSCALL(2, 0x089, "statfs", SysStatfs, STRACE_2);
-    SYSCALL(2, 0x08A, "fstatfs", SysFstatfs, STRACE_2);
-    SYSCALL(2, 0x06D, "setpgid", SysSetpgid, STRACE_2);
-    SYSCALL(0, 0x066, "getuid", SysGetuid, STRACE_GETUID);
-    SYSCALL(0, 0x068, "getgid", SysGetgid, STRACE_GETGID);
-    SYSCALL(1, 0x069, "setuid", SysSetuid, STRACE_SETUID);
-    SYSCALL(1, 0x06A, "setgid", SysSetgid, STRACE_SETGID);
-    SYSCALL(0, 0x06B, "geteuid", SysGeteuid, STRACE_GETEUID);
-    SYSCALL(0, 0x06C, "getegid", SysGetegid, STRACE_GETEGID);
-    SYSCALL(0, 0x06E, "getppid", SysGetppid, STRACE_GETPPID);
-    SYSCALL(2, 0x071, "setreuid", SysSetreuid, STRACE_SETREUID);
-    SYSCALL(2, 0x072, "setregid", SysSetregid, STRACE_SETREGID);
-    SYSCALL(2, 0x082, "rt_sigsuspend", SysSigsuspend, STRACE_SIGSUSPEND);
-    SYSCALL(2, 0x083, "sigaltstack", SysSigaltstack, STRACE_2);
-    SYSCALL(3, 0x085, "mknod", SysMknod, STRACE_3);
-    SYSCALL(2, 0x09E, "arch_prctl", SysArchPrctl, STRACE_2);
+  if (flags & EFD_SEMAPHORE_LINUX) {
+    sysflags |= EFD_SEMAPHORE;
+    flags &= ~EFD_SEMAPHORE_LINUX;
+  }
+  if (flags) {
+    LOGF("unsupported %s flags: %#x", "eventfd2", flags);
+    return einval();
+  }
+  return AddEventFd(m, eventfd(initval, sysflags), oflags, &kFdCbHost);
+}
+
+static i32 SysEventfd(struct Machine *m, u32 initval) {
+  return SysEventfd2(m, initval, 0);
+}
+
+#endif /* HAVE_EVENTFD */
+
+#ifdef HAVE_TIMERFD
+
+static i32 SysTimerfdCreate(struct Machine *m, i32 clock, i32 flags) {
+  clock_t sysclock;
+  int oflags, sysflags;
+  oflags = O_RDWR;
+  sysflags = 0;
+  if (flags & TFD_CLOEXEC_LINUX) {
+    oflags |= O_CLOEXEC;
+    sysflags |= TFD_CLOEXEC;
+    flags &= ~TFD_CLOEXEC_LINUX;
+  }
+  if (flags & TFD_NONBLOCK_LINUX) {
+    oflags |= O_NDELAY;
+    sysflags |= TFD_NONBLOCK;
+    flags &= ~TFD_NONBLOCK_LINUX;
+  }
+  if (flags) {
+    LOGF("unsupported %s flags: %#x", "timerfd_create", flags);
+    return einval();
+  }
+  if (XlatClock(clock, &sysclock) == -1) return -1;
+  return AddEventFd(m, timerfd_create(sysclock, sysflags), oflags, &kFdCbHost);
+}
+
+static i32 SysTimerfdSettime(struct Machine *m, i32 fildes, i32 flags,
+                             i64 neuaddr, i64 oldaddr) {
+  int rc, sysflags;
+  struct itimerspec neu, old;
+  struct itimerspec_linux gold;
+  const struct itimerspec_linux *gneu;
+  sysflags = 0;
+  if (flags & TFD_TIMER_ABSTIME_LINUX) {
+    sysflags |= TFD_TIMER_ABSTIME;
+    flags &= ~TFD_TIMER_ABSTIME_LINUX;
+  }
+#ifdef TFD_TIMER_CANCEL_ON_SET
+  if (flags & TFD_TIMER_CANCEL_ON_SET_LINUX) {
+    sysflags |= TFD_TIMER_CANCEL_ON_SET;
+    flags &= ~TFD_TIMER_CANCEL_ON_SET_LINUX;
+  }
+#endif
+  if (flags) {
+    LOGF("unsupported %s flags: %#x", "timerfd_settime", flags);
+    return einval();
+  }
+  if (!(gneu = (const struct itimerspec_linux *)SchlepR(m, neuaddr,
+                                                        sizeof(*gneu))) ||
+      (oldaddr && !IsValidMemory(m, oldaddr, sizeof(gold), PROT_WRITE))) {
+    return -1;
+  }
+  if (CheckFd(m, fildes) == -1) return -1;
+  XlatLinuxToItimerspec(&neu, gneu);
+  rc = timerfd_settime(VfsGetHostFd(fildes), sysflags, &neu, &old);
+  if (rc != -1 && oldaddr) {
+    XlatItimerspecToLinux(&gold, &old);
+    CopyToUserWrite(m, oldaddr, &gold, sizeof(gold));
+  }
+  return rc;
+}
+
+static i32 SysTimerfdGettime(struct Machine *m, i32 fildes, i64 curaddr) {
+  int rc;
+  struct itimerspec cur;
+  struct itimerspec_linux gcur;
+  if (!IsValidMemory(m, curaddr, sizeof(gcur), PROT_WRITE)) return -1;
+  if (CheckFd(m, fildes) == -1) return -1;
+  if ((rc = timerfd_gettime(VfsGetHostFd(fildes), &cur)) != -1) {
+    XlatItimerspecToLinux(&gcur, &cur);
+    CopyToUserWrite(m, curaddr, &gcur, sizeof(gcur));
+  }
+  return rc;
+}
+
+#endif /* HAVE_TIMERFD */
+
+// signalfd() is emulated using a socketpair. the guest holds one end,
+// and EnqueueSignal() writes a byte to the other end whenever a signal
+// it's watching becomes pending, so host poll(), select() and epoll()
+// report readiness. reads then dequeue from the guest's signal queue.
+
+static struct SignalFd *GetSignalFd(struct System *s, int fildes) {
+  int i;
+  struct stat st;
+  if (fstat(fildes, &st)) return 0;
+  for (i = 0; i < kMaxSignalFds; ++i) {
+    if (s->signalfds[i].used &&               //
+        s->signalfds[i].dev == st.st_dev &&  //
+        s->signalfds[i].ino == st.st_ino) {
+      return s->signalfds + i;
+    }
+  }
+  return 0;
+}
+
+// signals with default dispositions still need a host handler so they
+// can be queued for signalfd() readers; caller must hold sig_lock
+static void CatchSignalFdSignals(struct System *s, u64 mask) {
+  int sig, syssig;
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sigfillset(&sa.sa_mask);
+  sa.sa_flags = SA_SIGINFO;
+  sa.sa_sigaction = OnSignal;
+  for (sig = 1; sig <= 64; ++sig) {
+    if ((mask & ((u64)1 << (sig - 1))) &&
+        Read64(s->hands[sig - 1].handler) == SIG_DFL_LINUX &&
+        !IsBlinkSig(s, sig) && (syssig = XlatSignal(sig)) != -1) {
+      sigaction(syssig, &sa, 0);
+    }
+  }
+}
+
+static ssize_t SignalFdReadv(int fildes, const struct iovec *iov, int iovlen) {
+  int i, n, sig, hostfd;
+  size_t j, k, size;
+  struct pollfd pfd;
+  struct SignalFd *sfd;
+  struct SignalSender from;
+  struct Machine *m = g_machine;
+  struct System *s = m->system;
+  char drain[64];
+  struct signalfd_siginfo_linux si[16];
+  for (size = i = 0; i < iovlen; ++i) size += iov[i].iov_len;
+  if (size < sizeof(si[0])) return einval();
+  if ((hostfd = VfsGetHostFd(fildes)) == -1) return ebadf();
+  for (;;) {
+    LOCK(&s->sig_lock);
+    if (!(sfd = GetSignalFd(s, hostfd))) {
+      UNLOCK(&s->sig_lock);
+      return ebadf();
+    }
+    while (recv(hostfd, drain, sizeof(drain), MSG_DONTWAIT) > 0) {
+    }
+    for (n = 0; n < ARRAYLEN(si) && (n + 1) * sizeof(si[0]) <= size &&
+                (sig = DequeueSignal(m, sfd->mask, &from));
+         ++n) {
+      memset(si + n, 0, sizeof(si[n]));
+      Write32(si[n].signo, sig);
+      Write32(si[n].code, from.code);
+      Write32(si[n].pid, from.pid);
+      Write32(si[n].uid, from.uid);
+    }
+    if (GetPendingSignals(s, sfd->mask)) {
+      (void)!write(sfd->wfd, "", 1);
+    }
+    UNLOCK(&s->sig_lock);
+    if (n) break;
+    if (fcntl(hostfd, F_GETFL) & O_NONBLOCK) return eagain();
+    pfd.fd = hostfd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, -1) == -1) return -1;
+  }
+  for (size = n * sizeof(si[0]), j = i = 0; j < size; ++i) {
+    k = MIN(iov[i].iov_len, size - j);
+    memcpy(iov[i].iov_base, (char *)si + j, k);
+    j += k;
+  }
+  return size;
+}
+
+static ssize_t SignalFdWritev(int fildes, const struct iovec *iov,
+                              int iovlen) {
+  return einval();
+}
+
+static int SignalFdClose(int fildes) {
+  int rc;
+  sigset_t oldmask;
+  struct pollfd pfd;
+  struct SignalFd *sfd;
+  struct System *s = g_machine->system;
+  LOCK(&s->sig_lock);
+  sfd = GetSignalFd(s, VfsGetHostFd(fildes));
+  rc = VfsClose(fildes);
+  if (sfd) {
+    // the slot is retired once its last guest descriptor goes away
+    pfd.fd = sfd->wfd;
+    pfd.events = 0;
+    if (poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLHUP)) {
+      LockSignalFds(s, &oldmask);
+      atomic_store_explicit(&sfd->mask, 0, memory_order_release);
+      close(sfd->wfd);
+      UnlockSignalFds(s, &oldmask);
+      sfd->used = false;
+    }
+  }
+  UNLOCK(&s->sig_lock);
+  return rc;
+}
+
+static const struct FdCb kFdCbSignalfd = {
+    .close = SignalFdClose,
+    .readv = SignalFdReadv,
+    .writev = SignalFdWritev,
+    .poll = VfsPoll,
+    .tcgetattr = VfsTcgetattr,
+    .tcsetattr = VfsTcsetattr,
+    .tcgetwinsize = my_tcgetwinsize,
+    .tcsetwinsize = my_tcsetwinsize,
+};
+
+static i32 SysSignalfd4(struct Machine *m, i32 fildes, i64 maskaddr,
+                        u64 sigsetsize, i32 flags) {
+  u64 mask;
+  int i, rc, oflags, sv[2];
+  sigset_t oldmask;
+  struct stat st;
+  const u8 *neu;
+  struct SignalFd *sfd;
+  struct System *s = m->system;
+  if (sigsetsize != 8) return einval();
+  if (flags & ~(SFD_CLOEXEC_LINUX | SFD_NONBLOCK_LINUX)) {
+    LOGF("unsupported %s flags: %#x", "signalfd4", flags);
+    return einval();
+  }
+  if (!(neu = (const u8 *)SchlepR(m, maskaddr, 8))) return -1;
+  mask = Read64(neu) & ~((u64)1 << (SIGKILL_LINUX - 1) |
+                         (u64)1 << (SIGSTOP_LINUX - 1));
+  if (fildes != -1) {
+    if (CheckFd(m, fildes) == -1) return -1;
+    LOCK(&s->sig_lock);
+    if ((sfd = GetSignalFd(s, VfsGetHostFd(fildes)))) {
+      atomic_store_explicit(&sfd->mask, mask, memory_order_release);
+      CatchSignalFdSignals(s, mask);
+      if (GetPendingSignals(s, mask)) {
+        (void)!write(sfd->wfd, "", 1);
+      }
+      rc = fildes;
+    } else {
+      rc = einval();
+    }
+    UNLOCK(&s->sig_lock);
+    return rc;
+  }
+  oflags = O_RDWR;
+  if (flags & SFD_CLOEXEC_LINUX) oflags |= O_CLOEXEC;
+  if (flags & SFD_NONBLOCK_LINUX) oflags |= O_NDELAY;
+  LOCK(&s->sig_lock);
+  for (sfd = 0, i = 0; i < kMaxSignalFds; ++i) {
+    if (!s->signalfds[i].used) {
+      sfd = s->signalfds + i;
+      break;
+    }
+  }
+  if (!sfd) {
+    LOGF("too many signalfds");
+    UNLOCK(&s->sig_lock);
+    return emfile();
+  }
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+    UNLOCK(&s->sig_lock);
+    return -1;
+  }
+  if ((rc = fcntl(sv[1], F_DUPFD_CLOEXEC, kMinBlinkFd)) == -1 ||
+      fcntl(rc, F_SETFL, O_NONBLOCK) == -1 ||
+      ((oflags & O_CLOEXEC) && fcntl(sv[0], F_SETFD, FD_CLOEXEC) == -1) ||
+      ((oflags & O_NDELAY) && fcntl(sv[0], F_SETFL, O_NDELAY) == -1) ||
+      fstat(sv[0], &st) == -1) {
+    if (rc != -1) close(rc);
+    close(sv[0]);
+    close(sv[1]);
+    UNLOCK(&s->sig_lock);
+    return -1;
+  }
+  close(sv[1]);
+  shutdown(sv[0], SHUT_WR);
+  sfd->used = true;
+  sfd->dev = st.st_dev;
+  sfd->ino = st.st_ino;
+  atomic_store_explicit(&sfd->wfd, rc, memory_order_relaxed);
+  atomic_store_explicit(&sfd->mask, mask, memory_order_release);
+  CatchSignalFdSignals(s, mask);
+  if (GetPendingSignals(s, mask)) {
+    (void)!write(rc, "", 1);
+  }
+  UNLOCK(&s->sig_lock);
+  if ((rc = AddEventFd(m, sv[0], oflags, &kFdCbSignalfd)) == -1) {
+    LOCK(&s->sig_lock);
+    LockSignalFds(s, &oldmask);
+    atomic_store_explicit(&sfd->mask, 0, memory_order_release);
+    close(sfd->wfd);
+    UnlockSignalFds(s, &oldmask);
+    sfd->used = false;
+    UNLOCK(&s->sig_lock);
+  }
+  return rc;
+}
+
+static i32 SysSignalfd(struct Machine *m, i32 fildes, i64 maskaddr,
+                       u64 sigsetsize) {
+  return SysSignalfd4(m, fildes, maskaddr, sigsetsize, 0);
+}
+
+// memfd_create() is backed by a host memfd when one is available, or
+// else by an unlinked temporary file. in both cases guest mappings of
+// it are shared mappings of a host file, so aliased views stay in sync
+#define kMemfdNameMax 249
+
+static i32 SysMemfdCreate(struct Machine *m, i64 nameaddr, u32 flags) {
+  int lim, fildes, oflags;
+  const char *name;
+  struct Fd *fd;
+#ifdef HAVE_MEMFD_CREATE
+  int seals, sysflags;
+#else
+  char tmp[] = "/tmp/blink.memfd.XXXXXX";
+#endif
+  if (!(name = LoadStr(m, nameaddr))) return -1;
+  if (strlen(name) > kMemfdNameMax) return einval();
+  if (flags & ~(MFD_CLOEXEC_LINUX | MFD_ALLOW_SEALING_LINUX |
+                MFD_NOEXEC_SEAL_LINUX | MFD_EXEC_LINUX)) {
+    LOGF("unsupported %s flags: %#x", "memfd_create", flags);
+    return einval();
+  }
+  if ((flags & MFD_NOEXEC_SEAL_LINUX) && (flags & MFD_EXEC_LINUX)) {
+    return einval();
+  }
+  if (!(lim = GetFileDescriptorLimit(m->system))) return emfile();
+  oflags = O_RDWR;
+  if (flags & MFD_CLOEXEC_LINUX) oflags |= O_CLOEXEC;
+#ifdef HAVE_MEMFD_CREATE
+  sysflags = 0;
+  if (flags & MFD_CLOEXEC_LINUX) sysflags |= MFD_CLOEXEC;
+  if (flags & (MFD_ALLOW_SEALING_LINUX | MFD_NOEXEC_SEAL_LINUX)) {
+    sysflags |= MFD_ALLOW_SEALING;
+  }
+  if ((fildes = memfd_create(name, sysflags)) == -1) return -1;
+  // linux creates these 0666 with F_SEAL_EXEC, and kernels too old to
+  // support that seal reject the flag with EINVAL, as we do here too
+  if ((flags & MFD_NOEXEC_SEAL_LINUX) &&
+      (fchmod(fildes, 0666) == -1 ||
+       (seals = XlatSeals(F_SEAL_EXEC_LINUX)) == -1 ||
+       fcntl(fildes, F_ADD_SEALS, seals) == -1)) {
+    close(fildes);
+    return -1;
+  }
+#else
+  if ((fildes = mkstemp(tmp)) == -1) return -1;
+  unlink(tmp);
+  if ((oflags & O_CLOEXEC) && fcntl(fildes, F_SETFD, FD_CLOEXEC) == -1) {
+    close(fildes);
+    return -1;
+  }
+#endif
+  if ((fildes = VfsWrapFd(fildes)) == -1) return -1;
+  if (fildes >= lim) {
+    VfsClose(fildes);
+    return emfile();
+  }
+  LOCK(&m->system->fds.lock);
+  unassert(fd = AddFd(&m->system->fds, fildes, oflags));
+  fd->cb = &kFdCbHost;
+  if ((fd->path =
+           (char *)malloc(sizeof("/memfd: (deleted)") + strlen(name)))) {
+    sprintf(fd->path, "/memfd:%s (deleted)", name);
+  }
+  UNLOCK(&m->system->fds.lock);
+  return fildes;
+}
+
+// io_uring() is emulated without kernel worker threads. both rings are
+// kept in an unlinked temporary file that blink and the guest each map
+// shared, and submissions are performed by the thread which is calling
+// io_uring_enter(), using the same code as the equivalent system calls.
+// operations that would block are parked until poll() says they're able
+// to make progress, so one enter() can wait on an entire batch of them.
+
+#define kUringSqHead     0
+#define kUringSqTail     64
+#define kUringCqHead     128
+#define kUringCqTail     192
+#define kUringSqMask     256
+#define kUringSqEntries  260
+#define kUringSqFlags    264
+#define kUringSqDropped  268
+#define kUringCqMask     272
+#define kUringCqEntries  276
+#define kUringCqOverflow 280
+#define kUringCqFlags    284
+#define kUringCqes       320
+
+#define kUringSetupFlags                                             \
+  (IORING_SETUP_CQSIZE_LINUX | IORING_SETUP_CLAMP_LINUX |            \
+   IORING_SETUP_SUBMIT_ALL_LINUX | IORING_SETUP_COOP_TASKRUN_LINUX | \
+   IORING_SETUP_TASKRUN_FLAG_LINUX | IORING_SETUP_SINGLE_ISSUER_LINUX)
+
+#define kUringSqeFlags                                                   \
+  (IOSQE_FIXED_FILE_LINUX | IOSQE_IO_DRAIN_LINUX | IOSQE_IO_LINK_LINUX | \
+   IOSQE_IO_HARDLINK_LINUX | IOSQE_ASYNC_LINUX |                         \
+   IOSQE_CQE_SKIP_SUCCESS_LINUX)
+
+struct UringChain {
+  struct Dll elem;
+  int i, n;        // current and total number of linked submissions
+  bool drain;      // IOSQE_IO_DRAIN was set on the first submission
+  bool started;    // current submission is a timeout that's armed
+  bool canceled;   // remaining submissions complete with ECANCELED
+  bool busy;       // a thread is running it without the ring lock
+  short events;    // poll() events the current submission awaits
+  short revents;   // readiness latched before running the batch
+  i32 fildes;      // descriptor the current submission awaits
+  u64 target;      // completion count which satisfies timeout
+  u64 pass;        // last UringRun() pass that advanced this chain
+  struct timespec deadline;
+  struct io_uring_sqe_linux sqes[];
+};
+
+struct Uring {
+  struct Dll elem;
+  dev_t dev;
+  ino_t ino;
+  int refs;              // [g_uring.lock]
+  bool closed;           // [g_uring.lock]
+  pthread_mutex_t_ lock;
+  u8 *ring;              // host view of IORING_OFF_SQ_RING
+  u8 *sqes;              // host view of IORING_OFF_SQES
+  size_t ringsize;
+  size_t sqessize;
+  u32 sqentries;
+  u32 cqentries;
+  u64 posted;            // total number of completions posted
+  u64 passes;            // number of times UringRun() was called
+  int eventfd;           // registered eventfd duplicate, or -1
+  int waiters;           // threads blocked in UringWait()
+  int wake[2];           // pipe that UringWake() uses to notify them
+  u32 nfiles;
+  struct Fd **files;     // pinned duplicates of registered files
+  struct Dll *parked;    // chains waiting on i/o or timers
+};
+
+#define URING_CONTAINER(e)       DLL_CONTAINER(struct Uring, elem, e)
+#define URING_CHAIN_CONTAINER(e) DLL_CONTAINER(struct UringChain, elem, e)
+
+static struct UringGlobals {
+  pthread_mutex_t_ lock;
+  struct Dll *rings;
+} g_uring = {
+    PTHREAD_MUTEX_INITIALIZER_,
+};
+
+static u32 UringLoad(struct Uring *r, int off) {
+  return Little32(atomic_load_explicit((_Atomic(u32) *)(r->ring + off),
+                                       memory_order_acquire));
+}
+
+static void UringStore(struct Uring *r, int off, u32 x) {
+  atomic_store_explicit((_Atomic(u32) *)(r->ring + off), Little32(x),
+                        memory_order_release);
+}
+
+static u32 UringReady(struct Uring *r) {
+  return UringLoad(r, kUringCqTail) - UringLoad(r, kUringCqHead);
+}
+
+// caller must hold g_uring.lock
+static struct Uring *FindUring(dev_t dev, ino_t ino) {
+  struct Dll *e;
+  struct Uring *r;
+  for (e = dll_first(g_uring.rings); e; e = dll_next(g_uring.rings, e)) {
+    r = URING_CONTAINER(e);
+    if (!r->closed && r->dev == dev && r->ino == ino) {
+      return r;
+    }
+  }
+  return 0;
+}
+
+// releases the duplicate that io_uring_register() made of a file
+static void UringUnpinFile(struct Fd *fd) {
+  struct System *s = g_machine->system;
+  LOCK(&s->fds.lock);
+  RemoveFd(&s->fds, fd);
+  UNLOCK(&s->fds.lock);
+  fd->cb->close(fd->fildes);
+  FreeFd(fd);
+}
+
+static void UringUnpinFiles(struct Uring *r) {
+  u32 i;
+  for (i = 0; i < r->nfiles; ++i) {
+    if (r->files[i]) UringUnpinFile(r->files[i]);
+  }
+  free(r->files);
+  r->files = 0;
+  r->nfiles = 0;
+}
+
+static void FreeUring(struct Uring *r) {
+  struct Dll *e;
+  while ((e = dll_first(r->parked))) {
+    dll_remove(&r->parked, e);
+    free(URING_CHAIN_CONTAINER(e));
+  }
+  UringUnpinFiles(r);
+  if (r->eventfd != -1) close(r->eventfd);
+  if (r->wake[0] != -1) close(r->wake[0]);
+  if (r->wake[1] != -1) close(r->wake[1]);
+  if (r->ring != MAP_FAILED) munmap(r->ring, r->ringsize);
+  if (r->sqes != MAP_FAILED) munmap(r->sqes, r->sqessize);
+  unassert(!pthread_mutex_destroy(&r->lock));
+  free(r);
+}
+
+static void PutUring(struct Uring *r) {
+  bool gone;
+  LOCK(&g_uring.lock);
+  if ((gone = !--r->refs)) {
+    dll_remove(&g_uring.rings, &r->elem);
+  }
+  UNLOCK(&g_uring.lock);
+  if (gone) FreeUring(r);
+}
+
+static int UringClose(int fildes) {
+  int rc;
+  bool last;
+  struct Fd *fd;
+  struct Dll *e;
+  struct Uring *r;
+  struct stat st, st2;
+  struct System *s = g_machine->system;
+  if (fstat(VfsGetHostFd(fildes), &st)) return VfsClose(fildes);
+  rc = VfsClose(fildes);
+  // the ring is retired once its last guest descriptor goes away
+  last = true;
+  LOCK(&s->fds.lock);
+  for (e = dll_first(s->fds.list); e; e = dll_next(s->fds.list, e)) {
+    fd = FD_CONTAINER(e);
+    if (fd->cb->close == UringClose && fd->fildes != fildes &&
+        !fstat(VfsGetHostFd(fd->fildes), &st2) &&
+        st2.st_dev == st.st_dev && st2.st_ino == st.st_ino) {
+      last = false;
+      break;
+    }
+  }
+  UNLOCK(&s->fds.lock);
+  if (last) {
+    LOCK(&g_uring.lock);
+    if ((r = FindUring(st.st_dev, st.st_ino))) {
+      r->closed = true;
+    }
+    UNLOCK(&g_uring.lock);
+    if (r) PutUring(r);
+  }
+  return rc;
+}
+
+static ssize_t UringReadv(int fildes, const struct iovec *iov, int iovlen) {
+  return einval();
+}
+
+static ssize_t UringWritev(int fildes, const struct iovec *iov, int iovlen) {
+  return einval();
+}
+
+// reports POLLIN when completions are available and POLLOUT when the
+// submission queue has room. this is only ever called non-blocking.
+static int UringPoll(struct pollfd *fds, nfds_t nfds, int timeout_ms) {
+  int rc;
+  nfds_t i;
+  struct stat st;
+  struct Uring *r;
+  for (rc = i = 0; i < nfds; ++i) {
+    fds[i].revents = 0;
+    if (fds[i].fd < 0) continue;
+    if (fstat(VfsGetHostFd(fds[i].fd), &st)) {
+      fds[i].revents = POLLNVAL;
+    } else {
+      LOCK(&g_uring.lock);
+      if ((r = FindUring(st.st_dev, st.st_ino))) {
+        if ((fds[i].events & POLLIN) && UringReady(r)) {
+          fds[i].revents |= POLLIN;
+        }
+        if ((fds[i].events & POLLOUT) &&
+            UringLoad(r, kUringSqTail) - UringLoad(r, kUringSqHead) <
+                r->sqentries) {
+          fds[i].revents |= POLLOUT;
+        }
+      } else {
+        fds[i].revents = POLLNVAL;
+      }
+      UNLOCK(&g_uring.lock);
+    }
+    rc += !!fds[i].revents;
+  }
+  return rc;
+}
+
+static const struct FdCb kFdCbUring = {
+    .close = UringClose,
+    .readv = UringReadv,
+    .writev = UringWritev,
+    .poll = UringPoll,
+    .tcgetattr = VfsTcgetattr,
+    .tcsetattr = VfsTcsetattr,
+    .tcgetwinsize = my_tcgetwinsize,
+    .tcsetwinsize = my_tcsetwinsize,
+};
+
+static struct Uring *GetUring(struct Machine *m, i32 fildes) {
+  struct Fd *fd;
+  struct stat st;
+  struct Uring *r;
+  const struct FdCb *cb;
+  LOCK(&m->system->fds.lock);
+  cb = (fd = GetFd(&m->system->fds, fildes)) ? fd->cb : 0;
+  UNLOCK(&m->system->fds.lock);
+  if (!fd) return 0;
+  if (cb != &kFdCbUring) {
+    eopnotsupp();
+    return 0;
+  }
+  if (fstat(VfsGetHostFd(fildes), &st)) return 0;
+  LOCK(&g_uring.lock);
+  if ((r = FindUring(st.st_dev, st.st_ino))) {
+    ++r->refs;
+  }
+  UNLOCK(&g_uring.lock);
+  if (!r) ebadf();
+  return r;
+}
+
+// tells threads in UringWait() that completions or parked submissions
+// changed, which they can't otherwise notice while blocked in poll()
+static void UringWake(struct Uring *r) {
+  int i;
+  for (i = 0; i < r->waiters; ++i) {
+    if (write(r->wake[1], "", 1) != 1) break;
+  }
+}
+
+static bool UringPost(struct Uring *r, u64 user_data, i32 res) {
+  u32 tail;
+  u64 one = 1;
+  struct io_uring_cqe_linux *cqe;
+  tail = UringLoad(r, kUringCqTail);
+  if (tail - UringLoad(r, kUringCqHead) >= r->cqentries) {
+    UringStore(r, kUringCqOverflow, UringLoad(r, kUringCqOverflow) + 1);
+    return false;
+  }
+  cqe = (struct io_uring_cqe_linux *)(r->ring + kUringCqes) +
+        (tail & (r->cqentries - 1));
+  Write64(cqe->user_data, user_data);
+  Write32(cqe->res, res);
+  Write32(cqe->flags, 0);
+  UringStore(r, kUringCqTail, tail + 1);
+  ++r->posted;
+  if (r->eventfd != -1) {
+    (void)!write(r->eventfd, &one, sizeof(one));
+  }
+  UringWake(r);
+  return true;
+}
+
+// returns host poll() revents for a single guest file descriptor
+static int UringPollFd(struct Machine *m, i32 fildes, short events) {
+  struct Fd *fd;
+  struct pollfd pfd;
+  int (*impl)(struct pollfd *, nfds_t, int);
+  LOCK(&m->system->fds.lock);
+  impl = (fd = GetFd(&m->system->fds, fildes)) ? fd->cb->poll : 0;
+  UNLOCK(&m->system->fds.lock);
+  if (!impl) return POLLNVAL;
+  pfd.fd = fildes;
+  pfd.events = events;
+  pfd.revents = 0;
+  if (impl(&pfd, 1, 0) == -1) return POLLERR;
+  return pfd.revents;
+}
+
+static int UringEvents(int ev) {
+  return (((ev & POLLIN_LINUX) ? POLLIN : 0) |
+          ((ev & POLLOUT_LINUX) ? POLLOUT : 0) |
+          ((ev & POLLPRI_LINUX) ? POLLPRI : 0));
+}
+
+static int UringRevents(int ev) {
+  return (((ev & POLLIN) ? POLLIN_LINUX : 0) |
+          ((ev & POLLPRI) ? POLLPRI_LINUX : 0) |
+          ((ev & POLLOUT) ? POLLOUT_LINUX : 0) |
+          ((ev & POLLERR) ? POLLERR_LINUX : 0) |
+          ((ev & POLLHUP) ? POLLHUP_LINUX : 0) |
+          ((ev & POLLNVAL) ? POLLNVAL_LINUX : 0));
+}
+
+static int UringArmTimeout(struct Machine *m, struct Uring *r,
+                           struct UringChain *c,
+                           const struct io_uring_sqe_linux *sqe) {
+  u32 flags;
+  struct timespec ts;
+  flags = Read32(sqe->op_flags);
+  if (Read32(sqe->len) != 1) return einval();
+  if (flags & ~(IORING_TIMEOUT_ABS_LINUX | IORING_TIMEOUT_REALTIME_LINUX)) {
+    return einval();
+  }
+  if (LoadTimespecR(m, Read64(sqe->addr), &ts) == -1) return -1;
+  if (!(flags & IORING_TIMEOUT_ABS_LINUX)) {
+    c->deadline = AddTime(GetTime(), ts);
+  } else if (flags & IORING_TIMEOUT_REALTIME_LINUX) {
+    c->deadline = ts;
+  } else {
+    c->deadline = AddTime(GetTime(), SubtractTime(ts, GetMonotonic()));
+  }
+  c->target = Read64(sqe->off) ? r->posted + Read64(sqe->off) : 0;
+  c->started = true;
+  return 0;
+}
+
+// marks parked submission whose user_data matches key for cancelation
+static int UringCancel(struct Uring *r, struct UringChain *self, u64 key,
+                       int op) {
+  struct Dll *e;
+  struct UringChain *c;
+  for (e = dll_first(r->parked); e; e = dll_next(r->parked, e)) {
+    c = URING_CHAIN_CONTAINER(e);
+    if (c != self && !c->canceled && c->i < c->n &&
+        Read64(c->sqes[c->i].user_data) == key &&
+        (op == -1 || c->sqes[c->i].opcode == op)) {
+      c->canceled = true;
+      return 0;
+    }
+  }
+  return enoent();
+}
+
+// performs system call for submission, without holding ring lock
+static i64 UringSyscall(struct Machine *m, u8 opcode, i32 fildes, u64 addr,
+                        u32 len, u64 off, u32 opflags) {
+  i64 rc;
+  switch (opcode) {
+    case IORING_OP_READV_LINUX:
+      rc = SysPreadv2(m, fildes, addr, len, off, opflags);
+      break;
+    case IORING_OP_WRITEV_LINUX:
+      rc = SysPwritev2(m, fildes, addr, len, off, opflags);
+      break;
+    case IORING_OP_READ_FIXED_LINUX:
+    case IORING_OP_READ_LINUX:
+      if (off == -1) {
+        rc = SysRead(m, fildes, addr, len);
+      } else {
+        rc = SysPread(m, fildes, addr, len, off);
+      }
+      break;
+    case IORING_OP_WRITE_FIXED_LINUX:
+    case IORING_OP_WRITE_LINUX:
+      if (off == -1) {
+        rc = SysWrite(m, fildes, addr, len);
+      } else {
+        rc = SysPwrite(m, fildes, addr, len, off);
+      }
+      break;
+    case IORING_OP_FSYNC_LINUX:
+      if (opflags & IORING_FSYNC_DATASYNC_LINUX) {
+        rc = SysFdatasync(m, fildes);
+      } else {
+        rc = SysFsync(m, fildes);
+      }
+      break;
+    case IORING_OP_SEND_LINUX:
+      rc = SysSendto(m, fildes, addr, len, opflags, 0, 0);
+      break;
+    case IORING_OP_RECV_LINUX:
+      rc = SysRecvfrom(m, fildes, addr, len, opflags, 0, 0);
+      break;
+    case IORING_OP_SENDMSG_LINUX:
+      rc = SysSendmsg(m, fildes, addr, opflags);
+      break;
+    case IORING_OP_RECVMSG_LINUX:
+      rc = SysRecvmsg(m, fildes, addr, opflags);
+      break;
+    case IORING_OP_ACCEPT_LINUX:
+      rc = SysAccept4(m, fildes, addr, off, opflags);
+      break;
+    case IORING_OP_CONNECT_LINUX:
+      rc = SysConnect(m, fildes, addr, off);
+      break;
+    case IORING_OP_SHUTDOWN_LINUX:
+      rc = SysShutdown(m, fildes, len);
+      break;
+    case IORING_OP_OPENAT_LINUX:
+      rc = SysOpenat(m, fildes, addr, opflags, len);
+      break;
+    case IORING_OP_CLOSE_LINUX:
+      rc = SysClose(m, fildes);
+      break;
+    default:
+      LOGF("unsupported io_uring opcode %d", opcode);
+      rc = einval();
+      break;
+  }
+  return rc;
+}
+
+// performs submission, returning true if it completed with res
+static bool UringExec(struct Machine *m, struct Uring *r,
+                      struct UringChain *c,
+                      const struct io_uring_sqe_linux *sqe, i64 *res) {
+  i64 rc;
+  i32 fildes;
+  short events;
+  u64 off, addr;
+  u32 len, opflags;
+  struct timespec now;
+  fildes = Read32(sqe->fd);
+  off = Read64(sqe->off);
+  addr = Read64(sqe->addr);
+  len = Read32(sqe->len);
+  opflags = Read32(sqe->op_flags);
+  if (sqe->flags & ~kUringSqeFlags) {
+    *res = -EINVAL_LINUX;
+    return true;
+  }
+  if (sqe->flags & IOSQE_FIXED_FILE_LINUX) {
+    if ((u32)fildes >= r->nfiles || !r->files[fildes]) {
+      *res = -EBADF_LINUX;
+      return true;
+    }
+    fildes = r->files[fildes]->fildes;
+  }
+  switch (sqe->opcode) {
+    case IORING_OP_READV_LINUX:
+    case IORING_OP_READ_FIXED_LINUX:
+    case IORING_OP_READ_LINUX:
+    case IORING_OP_RECV_LINUX:
+    case IORING_OP_RECVMSG_LINUX:
+    case IORING_OP_ACCEPT_LINUX:
+      events = POLLIN;
+      break;
+    case IORING_OP_WRITEV_LINUX:
+    case IORING_OP_WRITE_FIXED_LINUX:
+    case IORING_OP_WRITE_LINUX:
+    case IORING_OP_SEND_LINUX:
+    case IORING_OP_SENDMSG_LINUX:
+      events = POLLOUT;
+      break;
+    case IORING_OP_POLL_ADD_LINUX:
+      events = UringEvents(opflags);
+      break;
+    default:
+      events = 0;
+      break;
+  }
+  if (sqe->opcode == IORING_OP_POLL_ADD_LINUX && c->revents) {
+    rc = c->revents;
+  } else if (events) {
+    rc = UringPollFd(m, fildes, events);
+  } else {
+    rc = 1;
+  }
+  if (!rc) {
+    c->fildes = fildes;
+    c->events = events;
+    return false;
+  }
+  switch (sqe->opcode) {
+    case IORING_OP_NOP_LINUX:
+      rc = 0;
+      break;
+    case IORING_OP_POLL_ADD_LINUX:
+      rc = UringRevents(rc);
+      break;
+    case IORING_OP_TIMEOUT_LINUX:
+      if (!c->started && UringArmTimeout(m, r, c, sqe) == -1) {
+        rc = -1;
+        break;
+      }
+      now = GetTime();
+      if (c->target && r->posted >= c->target) {
+        rc = 0;
+      } else if (CompareTime(now, c->deadline) >= 0) {
+        *res = -ETIME_LINUX;
+        return true;
+      } else {
+        c->fildes = -1;
+        c->events = 0;
+        return false;
+      }
+      break;
+    case IORING_OP_ASYNC_CANCEL_LINUX:
+      rc = UringCancel(r, c, addr, -1);
+      break;
+    case IORING_OP_POLL_REMOVE_LINUX:
+      rc = UringCancel(r, c, addr, IORING_OP_POLL_ADD_LINUX);
+      break;
+    case IORING_OP_TIMEOUT_REMOVE_LINUX:
+      rc = UringCancel(r, c, addr, IORING_OP_TIMEOUT_LINUX);
+      break;
+    default:
+      // the system call runs without the ring lock, so other threads
+      // can submit and reap while it's in progress, or blocked
+      c->busy = true;
+      UNLOCK(&r->lock);
+      rc = UringSyscall(m, sqe->opcode, fildes, addr, len, off, opflags);
+      LOCK(&r->lock);
+      c->busy = false;
+      break;
+  }
+  if (rc == -1 && errno == EAGAIN && events) {
+    c->fildes = fildes;
+    c->events = events;
+    // threads in UringWait() didn't poll for it while it was running
+    UringWake(r);
+    return false;
+  }
+  *res = rc != -1 ? rc : -XlatErrno(errno);
+  return true;
+}
+
+// runs linked submissions in order, returning true once all are done
+static bool UringAdvance(struct Machine *m, struct Uring *r,
+                         struct UringChain *c) {
+  i64 res;
+  bool done;
+  size_t mark;
+  struct io_uring_sqe_linux *sqe;
+  for (; c->i < c->n; ++c->i, c->started = false, c->revents = 0) {
+    sqe = c->sqes + c->i;
+    if (c->canceled) {
+      UringPost(r, Read64(sqe->user_data), -ECANCELED_LINUX);
+      continue;
+    }
+    if (UringReady(r) >= r->cqentries) return false;
+    mark = m->freelist.n;
+    done = UringExec(m, r, c, sqe, &res);
+    CollectGarbage(m, mark);
+    if (!done) return false;
+    if (res < 0 || !(sqe->flags & IOSQE_CQE_SKIP_SUCCESS_LINUX)) {
+      UringPost(r, Read64(sqe->user_data), res);
+    }
+    if (res < 0 && !(sqe->opcode == IORING_OP_TIMEOUT_LINUX &&
+                     res == -ETIME_LINUX) &&
+        !(sqe->flags & IOSQE_IO_HARDLINK_LINUX)) {
+      for (++c->i; c->i < c->n; ++c->i) {
+        UringPost(r, Read64(c->sqes[c->i].user_data), -ECANCELED_LINUX);
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+static void UringRun(struct Machine *m, struct Uring *r) {
+  u64 pass;
+  struct Dll *e;
+  struct UringChain *c;
+  // poll requests must observe events that other requests in the same
+  // batch will consume, e.g. a recv() and poll() on the same socket
+  for (e = dll_first(r->parked); e; e = dll_next(r->parked, e)) {
+    c = URING_CHAIN_CONTAINER(e);
+    if (!c->busy && c->i < c->n &&
+        c->sqes[c->i].opcode == IORING_OP_POLL_ADD_LINUX && c->events &&
+        !c->revents) {
+      c->revents = UringPollFd(m, c->fildes, c->events);
+    }
+  }
+  // the ring lock is released while a chain runs, during which other
+  // threads may finish and free any other chain, so after each one we
+  // start over from the beginning, skipping those done on this pass
+  pass = ++r->passes;
+  for (e = dll_first(r->parked); e;) {
+    c = URING_CHAIN_CONTAINER(e);
+    if (c->drain && e != dll_first(r->parked)) break;
+    if (c->busy || c->pass == pass) {
+      if (c->drain) break;
+      e = dll_next(r->parked, e);
+      continue;
+    }
+    c->pass = pass;
+    if (UringAdvance(m, r, c)) {
+      dll_remove(&r->parked, e);
+      free(c);
+    } else if (c->drain) {
+      break;
+    }
+    e = dll_first(r->parked);
+  }
+}
+
+static bool UringIsDraining(struct Uring *r) {
+  struct Dll *e;
+  for (e = dll_first(r->parked); e; e = dll_next(r->parked, e)) {
+    if (URING_CHAIN_CONTAINER(e)->drain) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// consumes submission queue entries, returning how many were consumed
+static i64 UringSubmit(struct Machine *m, struct Uring *r, u32 to_submit) {
+  u8 flags;
+  i64 count;
+  u32 i, n, idx, head, tail;
+  struct UringChain *c;
+  const u8 *array;
+  array = r->ring + kUringCqes +
+          r->cqentries * sizeof(struct io_uring_cqe_linux);
+  for (count = 0; count < to_submit;) {
+    // other threads may consume entries while a submission is running
+    head = UringLoad(r, kUringSqHead);
+    tail = UringLoad(r, kUringSqTail);
+    if (head == tail) break;
+    if (UringReady(r) >= r->cqentries) {
+      if (!count) {
+        errno = EBUSY;
+        count = -1;
+      }
+      break;
+    }
+    // count how many entries are linked together
+    n = 0;
+    do {
+      idx = Read32(array + ((head + n) & (r->sqentries - 1)) * 4);
+      flags = idx < r->sqentries ? r->sqes[idx * 64 + 1] : 0;
+      ++n;
+    } while ((flags & (IOSQE_IO_LINK_LINUX | IOSQE_IO_HARDLINK_LINUX)) &&
+             count + n < to_submit && head + n != tail);
+    if (!(c = (struct UringChain *)calloc(
+              1, sizeof(*c) + n * sizeof(struct io_uring_sqe_linux)))) {
+      if (!count) count = -1;
+      break;
+    }
+    dll_init(&c->elem);
+    for (i = 0; i < n; ++i, ++head, ++count) {
+      idx = Read32(array + (head & (r->sqentries - 1)) * 4);
+      if (idx < r->sqentries) {
+        memcpy(c->sqes + c->n++, r->sqes + idx * 64,
+               sizeof(struct io_uring_sqe_linux));
+      } else {
+        UringStore(r, kUringSqDropped, UringLoad(r, kUringSqDropped) + 1);
+      }
+    }
+    UringStore(r, kUringSqHead, head);
+    c->drain = c->n && (c->sqes[0].flags & IOSQE_IO_DRAIN_LINUX);
+    if ((c->drain && !dll_is_empty(r->parked)) || UringIsDraining(r) ||
+        !UringAdvance(m, r, c)) {
+      dll_make_last(&r->parked, &c->elem);
+      UringWake(r);
+    } else {
+      free(c);
+    }
+  }
+  return count;
+}
+
+// creates the pipe through which UringWake() interrupts UringWait()
+static int UringOpenWake(struct Uring *r) {
+  int fds[2];
+  if (pipe(fds)) return -1;
+  r->wake[0] = fcntl(fds[0], F_DUPFD_CLOEXEC, kMinBlinkFd);
+  r->wake[1] = fcntl(fds[1], F_DUPFD_CLOEXEC, kMinBlinkFd);
+  close(fds[0]);
+  close(fds[1]);
+  if (r->wake[0] == -1 || r->wake[1] == -1 ||
+      fcntl(r->wake[0], F_SETFL, O_NONBLOCK) == -1 ||
+      fcntl(r->wake[1], F_SETFL, O_NONBLOCK) == -1) {
+    return -1;
+  }
+  return 0;
+}
+
+// blocks until at least min_complete completions are available
+static int UringWait(struct Machine *m, struct Uring *r, u32 min_complete,
+                     struct timespec deadline) {
+  int rc;
+  nfds_t n;
+  size_t mark;
+  struct Dll *e;
+  struct UringChain *c;
+  struct pollfd *fds, *fds2;
+  struct timespec now, wait;
+  for (fds = 0, rc = 0;;) {
+    UringRun(m, r);
+    if (UringReady(r) >= min_complete) break;
+    now = GetTime();
+    if (CompareTime(now, deadline) >= 0) {
+#ifdef ETIME
+      errno = ETIME;
+#else
+      errno = ETIMEDOUT;
+#endif
+      rc = -1;
+      break;
+    }
+    wait = deadline;
+    for (n = 0, e = dll_first(r->parked); e; e = dll_next(r->parked, e)) {
+      c = URING_CHAIN_CONTAINER(e);
+      if (c->busy) {
+        continue;
+      } else if (c->started) {
+        if (CompareTime(c->deadline, wait) < 0) wait = c->deadline;
+      } else if (c->events) {
+        if (!(fds2 = (struct pollfd *)realloc(fds, (n + 1) * sizeof(*fds)))) {
+          rc = enomem();
+          break;
+        }
+        fds = fds2;
+        fds[n].fd = c->fildes;
+        fds[n].events = c->events;
+        ++n;
+      }
+    }
+    if (rc == -1) break;
+    // other threads may post completions or park submissions meanwhile,
+    // in which case UringWake() ends our wait through the wake pipe
+    ++r->waiters;
+    UNLOCK(&r->lock);
+    mark = m->freelist.n;
+    rc = PollFds(m, fds, n, r->wake[0], wait);
+    CollectGarbage(m, mark);
+    LOCK(&r->lock);
+    --r->waiters;
+    if (rc == -1) break;
+    rc = 0;
+  }
+  free(fds);
+  return rc;
+}
+
+static i32 SysIoUringSetup(struct Machine *m, u32 entries, i64 paramsaddr) {
+  int fildes;
+  u32 flags, cqentries;
+  struct Uring *r;
+  struct stat st;
+  struct io_uring_params_linux p;
+  char path[] = "/tmp/blink.uring.XXXXXX";
+  if (CopyFromUserRead(m, &p, paramsaddr, sizeof(p)) == -1) return -1;
+  flags = Read32(p.flags);
+  if (flags & ~kUringSetupFlags) {
+    LOGF("unsupported %s flags: %#x", "io_uring_setup", flags);
+    return einval();
+  }
+  if (!entries) return einval();
+  if (entries > IORING_MAX_ENTRIES_LINUX) {
+    if (!(flags & IORING_SETUP_CLAMP_LINUX)) return einval();
+    entries = IORING_MAX_ENTRIES_LINUX;
+  }
+  entries = (u32)1 << bsr(entries * 2 - 1);
+  if (flags & IORING_SETUP_CQSIZE_LINUX) {
+    if (!(cqentries = Read32(p.cq_entries))) return einval();
+    if (cqentries > IORING_MAX_CQ_ENTRIES_LINUX) {
+      if (!(flags & IORING_SETUP_CLAMP_LINUX)) return einval();
+      cqentries = IORING_MAX_CQ_ENTRIES_LINUX;
+    }
+    cqentries = (u32)1 << bsr(cqentries * 2 - 1);
+    if (cqentries < entries) return einval();
+  } else {
+    cqentries = entries * 2;
+  }
+  if (!(r = (struct Uring *)calloc(1, sizeof(*r)))) return enomem();
+  dll_init(&r->elem);
+  r->refs = 1;
+  r->eventfd = -1;
+  r->wake[0] = -1;
+  r->wake[1] = -1;
+  r->sqentries = entries;
+  r->cqentries = cqentries;
+  r->ringsize = kUringCqes + cqentries * sizeof(struct io_uring_cqe_linux) +
+                entries * 4;
+  r->sqessize = entries * sizeof(struct io_uring_sqe_linux);
+  r->ring = (u8 *)MAP_FAILED;
+  r->sqes = (u8 *)MAP_FAILED;
+  unassert(!pthread_mutex_init(&r->lock, 0));
+  if (UringOpenWake(r) == -1 || (fildes = mkstemp(path)) == -1) {
+    FreeUring(r);
+    return -1;
+  }
+  unlink(path);
+  if (fcntl(fildes, F_SETFD, FD_CLOEXEC) == -1 ||
+      ftruncate(fildes, IORING_OFF_SQES_LINUX + r->sqessize) == -1 ||
+      fstat(fildes, &st) == -1 ||
+      (r->ring = (u8 *)mmap(0, r->ringsize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fildes, IORING_OFF_SQ_RING_LINUX)) ==
+          MAP_FAILED ||
+      (r->sqes = (u8 *)mmap(0, r->sqessize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fildes, IORING_OFF_SQES_LINUX)) ==
+          MAP_FAILED) {
+    close(fildes);
+    FreeUring(r);
+    return -1;
+  }
+  r->dev = st.st_dev;
+  r->ino = st.st_ino;
+  Write32(r->ring + kUringSqMask, entries - 1);
+  Write32(r->ring + kUringSqEntries, entries);
+  Write32(r->ring + kUringCqMask, cqentries - 1);
+  Write32(r->ring + kUringCqEntries, cqentries);
+  memset(&p, 0, sizeof(p));
+  Write32(p.sq_entries, entries);
+  Write32(p.cq_entries, cqentries);
+  Write32(p.flags, flags);
+  Write32(p.features, IORING_FEAT_SINGLE_MMAP_LINUX |
+                          IORING_FEAT_SUBMIT_STABLE_LINUX |
+                          IORING_FEAT_RW_CUR_POS_LINUX |
+                          IORING_FEAT_EXT_ARG_LINUX);
+  Write32(p.sq_off.head, kUringSqHead);
+  Write32(p.sq_off.tail, kUringSqTail);
+  Write32(p.sq_off.ring_mask, kUringSqMask);
+  Write32(p.sq_off.ring_entries, kUringSqEntries);
+  Write32(p.sq_off.flags, kUringSqFlags);
+  Write32(p.sq_off.dropped, kUringSqDropped);
+  Write32(p.sq_off.array,
+          kUringCqes + cqentries * sizeof(struct io_uring_cqe_linux));
+  Write32(p.cq_off.head, kUringCqHead);
+  Write32(p.cq_off.tail, kUringCqTail);
+  Write32(p.cq_off.ring_mask, kUringCqMask);
+  Write32(p.cq_off.ring_entries, kUringCqEntries);
+  Write32(p.cq_off.overflow, kUringCqOverflow);
+  Write32(p.cq_off.cqes, kUringCqes);
+  Write32(p.cq_off.flags, kUringCqFlags);
+  if (CopyToUserWrite(m, paramsaddr, &p, sizeof(p)) == -1) {
+    close(fildes);
+    FreeUring(r);
+    return -1;
+  }
+  LOCK(&g_uring.lock);
+  dll_make_last(&g_uring.rings, &r->elem);
+  UNLOCK(&g_uring.lock);
+  if ((fildes = AddEventFd(m, fildes, O_RDWR | O_CLOEXEC, &kFdCbUring)) ==
+      -1) {
+    PutUring(r);
+  }
+  return fildes;
+}
+
+static i32 SysIoUringEnter(struct Machine *m, i32 fildes, u32 to_submit,
+                           u32 min_complete, u32 flags, i64 argaddr,
+                           u64 argsize) {
+  i64 rc;
+  struct Uring *r;
+  u64 sigmask = 0, oldmask = 0;
+  struct timespec ts, deadline;
+  const struct io_uring_getevents_arg_linux *arg;
+  const struct sigset_linux *ss;
+  u64 sigmaskaddr, sigmasksize;
+  if (flags & ~(IORING_ENTER_GETEVENTS_LINUX | IORING_ENTER_SQ_WAKEUP_LINUX |
+                IORING_ENTER_SQ_WAIT_LINUX | IORING_ENTER_EXT_ARG_LINUX)) {
+    LOGF("unsupported %s flags: %#x", "io_uring_enter", flags);
+    return einval();
+  }
+  deadline = GetMaxTime();
+  if (flags & IORING_ENTER_EXT_ARG_LINUX) {
+    if (argsize != sizeof(*arg)) return einval();
+    if (!(arg = (const struct io_uring_getevents_arg_linux *)SchlepR(
+              m, argaddr, sizeof(*arg)))) {
+      return -1;
+    }
+    sigmaskaddr = Read64(arg->sigmask);
+    sigmasksize = Read32(arg->sigmask_sz);
+    if (Read64(arg->ts)) {
+      if (LoadTimespecR(m, Read64(arg->ts), &ts) == -1) return -1;
+      deadline = AddTime(GetTime(), ts);
+    }
+  } else {
+    sigmaskaddr = argaddr;
+    sigmasksize = argsize;
+  }
+  if (sigmaskaddr) {
+    if (sigmasksize != 8) return einval();
+    if (!(ss = (const struct sigset_linux *)SchlepR(m, sigmaskaddr,
+                                                     sizeof(*ss)))) {
+      return -1;
+    }
+    sigmask = Read64(ss->sigmask);
+  }
+  if (!(r = GetUring(m, fildes))) return -1;
+  LOCK(&r->lock);
+  rc = UringSubmit(m, r, to_submit);
+  UringRun(m, r);
+  if (rc != -1 && (flags & IORING_ENTER_GETEVENTS_LINUX)) {
+    if (sigmaskaddr) {
+      oldmask = m->sigmask;
+      m->sigmask = sigmask;
+      SIG_LOGF("sigmask push %" PRIx64, m->sigmask);
+    }
+    if (UringWait(m, r, min_complete, deadline) == -1 && !rc) {
+      rc = -1;
+    }
+    if (sigmaskaddr) {
+      m->sigmask = oldmask;
+      SIG_LOGF("sigmask pop %" PRIx64, m->sigmask);
+    }
+  }
+  UNLOCK(&r->lock);
+  PutUring(r);
+  return rc;
+}
+
+// duplicates guest file, so the ring still has it after it's closed
+static struct Fd *UringPinFile(struct Machine *m, i32 fildes) {
+  int newfildes;
+  struct Fd *fd, *fd2 = 0;
+  LOCK(&m->system->fds.lock);
+  if ((fd = GetFd(&m->system->fds, fildes)) && !fd->pinned &&
+      (newfildes = VfsFcntl(fildes, F_DUPFD_CLOEXEC, kMinBlinkFd)) != -1) {
+    if ((fd2 = ForkFd(&m->system->fds, fd, newfildes,
+                      fd->oflags | O_CLOEXEC))) {
+      fd2->pinned = true;
+    } else {
+      VfsClose(newfildes);
+    }
+  }
+  UNLOCK(&m->system->fds.lock);
+  return fd2;
+}
+
+static int UringRegisterFiles(struct Machine *m, struct Uring *r, i64 addr,
+                              u32 offset, u32 count) {
+  u32 i;
+  i32 fildes;
+  const u8 *p;
+  struct Fd **files;
+  if (offset + count < offset || offset + count > r->nfiles) return einval();
+  if (!(p = (const u8 *)SchlepR(m, addr, count * 4))) return -1;
+  if (!(files = (struct Fd **)AddToFreeList(
+            m, calloc(count, sizeof(*files))))) {
+    return -1;
+  }
+  for (i = 0; i < count; ++i) {
+    if ((fildes = Read32(p + i * 4)) == -1) continue;
+    if (!(files[i] = UringPinFile(m, fildes))) {
+      while (i--) {
+        if (files[i]) UringUnpinFile(files[i]);
+      }
+      return ebadf();
+    }
+  }
+  for (i = 0; i < count; ++i) {
+    if (r->files[offset + i]) UringUnpinFile(r->files[offset + i]);
+    r->files[offset + i] = files[i];
+  }
+  return count;
+}
+
+static int UringRegisterProbe(struct Machine *m, i64 addr, u32 count) {
+  u32 i;
+  u8 *buf;
+  struct io_uring_probe_linux *probe;
+  struct io_uring_probe_op_linux *ops;
+  static const u8 kSupported[] = {
+      IORING_OP_NOP_LINUX,         IORING_OP_READV_LINUX,
+      IORING_OP_WRITEV_LINUX,      IORING_OP_FSYNC_LINUX,
+      IORING_OP_READ_FIXED_LINUX,  IORING_OP_WRITE_FIXED_LINUX,
+      IORING_OP_POLL_ADD_LINUX,    IORING_OP_POLL_REMOVE_LINUX,
+      IORING_OP_SENDMSG_LINUX,     IORING_OP_RECVMSG_LINUX,
+      IORING_OP_TIMEOUT_LINUX,     IORING_OP_TIMEOUT_REMOVE_LINUX,
+      IORING_OP_ACCEPT_LINUX,      IORING_OP_ASYNC_CANCEL_LINUX,
+      IORING_OP_CONNECT_LINUX,     IORING_OP_OPENAT_LINUX,
+      IORING_OP_CLOSE_LINUX,       IORING_OP_READ_LINUX,
+      IORING_OP_WRITE_LINUX,       IORING_OP_SEND_LINUX,
+      IORING_OP_RECV_LINUX,        IORING_OP_SHUTDOWN_LINUX,
+  };
+  if (count > 256) count = 256;
+  if (!(buf = (u8 *)AddToFreeList(
+            m, calloc(1, sizeof(*probe) + count * sizeof(*ops))))) {
+    return -1;
+  }
+  probe = (struct io_uring_probe_linux *)buf;
+  ops = (struct io_uring_probe_op_linux *)(buf + sizeof(*probe));
+  probe->last_op = IORING_OP_LAST_LINUX - 1;
+  probe->ops_len = MIN(count, IORING_OP_LAST_LINUX);
+  for (i = 0; i < probe->ops_len; ++i) {
+    ops[i].op = i;
+  }
+  for (i = 0; i < ARRAYLEN(kSupported); ++i) {
+    if (kSupported[i] < probe->ops_len) {
+      Write16(ops[kSupported[i]].flags, IO_URING_OP_SUPPORTED_LINUX);
+    }
+  }
+  return CopyToUserWrite(m, addr, buf, sizeof(*probe) + count * sizeof(*ops));
+}
+
+static int SysIoUringRegister(struct Machine *m, i32 fildes, u32 opcode,
+                              i64 arg, u32 nr_args) {
+  int rc;
+  struct Fd **files;
+  struct Uring *r;
+  const u8 *p;
+  if (!(r = GetUring(m, fildes))) return -1;
+  LOCK(&r->lock);
+  switch (opcode) {
+    case IORING_REGISTER_BUFFERS_LINUX:
+    case IORING_UNREGISTER_BUFFERS_LINUX:
+      // fixed buffers are just normal guest memory
+      rc = 0;
+      break;
+    case IORING_REGISTER_FILES_LINUX:
+      if (r->files) {
+        errno = EBUSY;
+        rc = -1;
+      } else if (!nr_args || nr_args > (u32)GetFileDescriptorLimit(m->system)) {
+        rc = einval();
+      } else if (!(files = (struct Fd **)calloc(nr_args, sizeof(*files)))) {
+        rc = -1;
+      } else {
+        r->files = files;
+        r->nfiles = nr_args;
+        if ((rc = UringRegisterFiles(m, r, arg, 0, nr_args)) != -1) {
+          rc = 0;
+        } else {
+          UringUnpinFiles(r);
+        }
+      }
+      break;
+    case IORING_REGISTER_FILES_UPDATE_LINUX:
+      if (!r->files) {
+        errno = ENXIO;
+        rc = -1;
+      } else if ((p = (const u8 *)SchlepR(
+                      m, arg, sizeof(struct io_uring_files_update_linux)))) {
+        rc = UringRegisterFiles(
+            m, r,
+            Read64(((const struct io_uring_files_update_linux *)p)->fds),
+            Read32(((const struct io_uring_files_update_linux *)p)->offset),
+            nr_args);
+      } else {
+        rc = -1;
+      }
+      break;
+    case IORING_UNREGISTER_FILES_LINUX:
+      if (r->files) {
+        UringUnpinFiles(r);
+        rc = 0;
+      } else {
+        errno = ENXIO;
+        rc = -1;
+      }
+      break;
+    case IORING_REGISTER_EVENTFD_LINUX:
+    case IORING_REGISTER_EVENTFD_ASYNC_LINUX:
+      if (r->eventfd != -1) {
+        errno = EBUSY;
+        rc = -1;
+      } else if (nr_args != 1) {
+        rc = einval();
+      } else if ((p = (const u8 *)SchlepR(m, arg, 4)) &&
+                 CheckFd(m, Read32(p)) != -1 &&
+                 (r->eventfd = fcntl(VfsGetHostFd(Read32(p)),
+                                     F_DUPFD_CLOEXEC, kMinBlinkFd)) != -1) {
+        rc = 0;
+      } else {
+        rc = -1;
+      }
+      break;
+    case IORING_UNREGISTER_EVENTFD_LINUX:
+      if (r->eventfd != -1) {
+        close(r->eventfd);
+        r->eventfd = -1;
+        rc = 0;
+      } else {
+        errno = ENXIO;
+        rc = -1;
+      }
+      break;
+    case IORING_REGISTER_PROBE_LINUX:
+      rc = UringRegisterProbe(m, arg, nr_args);
+      break;
+    default:
+      LOGF("unsupported %s opcode: %d", "io_uring_register", opcode);
+      rc = einval();
+      break;
+  }
+  UNLOCK(&r->lock);
+  PutUring(r);
+  return rc;
+}
+
+#endif /* DISABLE_NONPOSIX */
+
+// Dispatches system calls that never block or reference guest memory,
+// e.g. getpid(), which don't need any of the bookkeeping OpSyscall()
+// does for the others. Returns false if `*rax` isn't one of them.
+static bool OpSyscallFast(struct Machine *m, u64 *rax) {
+  u64 ax, di;
+  di = Get64(m->di);
+  switch (*rax & 0xfff) {
+    SYSCALL(0, 0x018, "sched_yield", SysSchedYield, STRACE_0);
+    SYSCALL(1, 0x025, "alarm", SysAlarm, STRACE_ALARM);
+    SYSCALL(0, 0x027, "getpid", SysGetpid, STRACE_GETPID);
+    SYSCALL(1, 0x05F, "umask", SysUmask, STRACE_UMASK);
+    SYSCALL(0, 0x066, "getuid", SysGetuid, STRACE_GETUID);
+    SYSCALL(0, 0x068, "getgid", SysGetgid, STRACE_GETGID);
+    SYSCALL(0, 0x06B, "geteuid", SysGeteuid, STRACE_GETEUID);
+    SYSCALL(0, 0x06C, "getegid", SysGetegid, STRACE_GETEGID);
+    SYSCALL(0, 0x06E, "getppid", SysGetppid, STRACE_GETPPID);
+    SYSCALL(0, 0x06F, "getpgrp", SysGetpgrp, STRACE_GETPGRP);
+    SYSCALL(1, 0x079, "getpgid", SysGetpgid, STRACE_GETPGID);
+    SYSCALL(1, 0x07C, "getsid", SysGetsid, STRACE_1);
+    SYSCALL(0, 0x0BA, "gettid", SysGettid, STRACE_GETTID);
+    default:
+      return false;
+  }
+  *rax = ax;
+  return true;
+}
+
+void OpSyscall(P) {
+  size_t mark;
+  u64 ax, di, si, dx, r0, r8, r9;
+  unassert(!m->nofault);
+  if (Get64(m->ax) == 0xE4) {
+    // clock_gettime() is
+    //   1) called frequently,
+    //   2) latency sensitive, and
+    //   3) usually implemented as a VDSO.
+    // Therefore we exempt it from system call tracing.
+    ax = SysClockGettime(m, Get64(m->di), Get64(m->si));
+    Put64(m->ax, ax != -1 ? ax : -(XlatErrno(errno) & 0xfff));
+    return;
+  }
+  ax = Get64(m->ax);
+  STATISTIC(++g_stats->syscalls);
+  STATISTIC(++g_stats->syscall[ax & (kStatsSyscalls - 1)]);
+  if (OpSyscallFast(m, &ax)) {
+    Put64(m->ax, ax != -1 ? ax : -(XlatErrno(errno) & 0xfff));
+    return;
+  }
+  // make sure blinkenlights display is up to date before performing any
+  // potentially blocking operations which would otherwise freeze things
+  if (m->system->redraw && m->tid == m->system->pid) {
+    m->system->redraw(true);
+  }
+  // unlike pure opcodes where we'll confidently longjmp out of segfault
+  // handlers, system calls are too complex to do that safely, and it is
+  // therefore of the highest importance that they never crash under any
+  // circumstances. in order to do ensure that we need to lock any pages
+  // the system call accesses, so the user can't munmap() them away from
+  // some other thread. since we don't want to slow down instructions by
+  // adding locking logic to the tranlation lookaside buffer, we need to
+  // ensure any memory references the system call performs will tlb miss
+  m->insyscall = true;
+  if (!m->sysdepth++) {
+    atomic_store_explicit(&m->invalidated, true, memory_order_relaxed);
+  }
+  // to make system calls simpler and safer, any temporary memory that's
+  // allocated will be added to a free list to be collected later. since
+  // OpSyscall() is potentially recursive when SA_RESTART signals happen
+  // we need to save the current mark, so we don't collect parent's data
+  mark = m->freelist.n;
+  m->interrupted = false;
+  di = Get64(m->di);
+  si = Get64(m->si);
+  dx = Get64(m->dx);
+  r0 = Get64(m->r10);
+  r8 = Get64(m->r8);
+  r9 = Get64(m->r9);
+  switch (ax & 0xfff) {
+    SYSCALL(3, 0x000, "read", SysRead, STRACE_READ);
+    SYSCALL(3, 0x001, "write", SysWrite, STRACE_WRITE);
+    SYSCALL(3, 0x002, "open", SysOpen, STRACE_OPEN);
+    SYSCALL(1, 0x003, "close", SysClose, STRACE_CLOSE);
+    SYSCALL(2, 0x004, "stat", SysStat, STRACE_STAT);
+    SYSCALL(2, 0x005, "fstat", SysFstat, STRACE_FSTAT);
+    SYSCALL(2, 0x006, "lstat", SysLstat, STRACE_LSTAT);
+    SYSCALL(3, 0x007, "poll", SysPoll, STRACE_3);
+    SYSCALL(3, 0x008, "lseek", SysLseek, STRACE_LSEEK);
+    SYSCALL(6, 0x009, "mmap", SysMmap, STRACE_MMAP);
+    SYSCALL(4, 0x011, "pread", SysPread, STRACE_PREAD);
+    SYSCALL(4, 0x012, "pwrite", SysPwrite, STRACE_PWRITE);
+    SYSCALL(5, 0x017, "select", SysSelect, STRACE_SELECT);
+    SYSCALL(5, 0x019, "mremap", SysMremap, STRACE_5);
+    SYSCALL(6, 0x10E, "pselect6", SysPselect, STRACE_6);
+    SYSCALL(3, 0x01A, "msync", SysMsync, STRACE_3);
+    SYSCALL(3, 0x00A, "mprotect", SysMprotect, STRACE_MPROTECT);
+    SYSCALL(2, 0x00B, "munmap", SysMunmap, STRACE_MUNMAP);
+    SYSCALL(4, 0x00D, "rt_sigaction", SysSigaction, STRACE_SIGACTION);
+    SYSCALL(4, 0x00E, "rt_sigprocmask", SysSigprocmask, STRACE_SIGPROCMASK);
+    SYSCALL(3, 0x010, "ioctl", SysIoctl, STRACE_3);
+    SYSCALL(3, 0x013, "readv", SysReadv, STRACE_READV);
+    SYSCALL(3, 0x014, "writev", SysWritev, STRACE_WRITEV);
+    SYSCALL(2, 0x015, "access", SysAccess, STRACE_ACCESS);
+    SYSCALL(3, 0x10D, "faccessat", SysFaccessat, STRACE_FACCESSAT);
+    SYSCALL(4, 0x1b7, "faccessat2", SysFaccessat2, STRACE_FACCESSAT2);
+    SYSCALL(3, 0x01C, "madvise", SysMadvise, STRACE_3);
+    SYSCALL(1, 0x020, "dup", SysDup1, STRACE_DUP);
+    SYSCALL(2, 0x021, "dup2", SysDup2, STRACE_DUP2);
+    SYSCALL(0, 0x022, "pause", SysPause, STRACE_PAUSE);
+    SYSCALL(2, 0x023, "nanosleep", SysNanosleep, STRACE_NANOSLEEP);
+    SYSCALL(2, 0x024, "getitimer", SysGetitimer, STRACE_2);
+    SYSCALL(3, 0x026, "setitimer", SysSetitimer, STRACE_3);
+    SYSCALL(1, 0x03F, "uname", SysUname, STRACE_1);
+    SYSCALL(3, 0x048, "fcntl", SysFcntl, STRACE_FCNTL);
+    SYSCALL(2, 0x049, "flock", SysFlock, STRACE_2);
+    SYSCALL(1, 0x04A, "fsync", SysFsync, STRACE_FSYNC);
+    SYSCALL(1, 0x04B, "fdatasync", SysFdatasync, STRACE_FDATASYNC);
+    SYSCALL(2, 0x04C, "truncate", SysTruncate, STRACE_TRUNCATE);
+    SYSCALL(2, 0x04D, "ftruncate", SysFtruncate, STRACE_FTRUNCATE);
+    SYSCALL(2, 0x04F, "getcwd", SysGetcwd, STRACE_GETCWD);
+    SYSCALL(1, 0x050, "chdir", SysChdir, STRACE_CHDIR);
+    SYSCALL(1, 0x051, "fchdir", SysFchdir, STRACE_FCHOWN);
+    SYSCALL(2, 0x052, "rename", SysRename, STRACE_RENAME);
+    SYSCALL(2, 0x053, "mkdir", SysMkdir, STRACE_MKDIR);
+    SYSCALL(1, 0x054, "rmdir", SysRmdir, STRACE_RMDIR);
+    SYSCALL(2, 0x055, "creat", SysCreat, STRACE_CREAT);
+    SYSCALL(2, 0x056, "link", SysLink, STRACE_LINK);
+    SYSCALL(1, 0x057, "unlink", SysUnlink, STRACE_UNLINK);
+    SYSCALL(2, 0x058, "symlink", SysSymlink, STRACE_SYMLINK);
+    SYSCALL(3, 0x059, "readlink", SysReadlink, STRACE_READLINK);
+    SYSCALL(2, 0x05A, "chmod", SysChmod, STRACE_CHMOD);
+    SYSCALL(2, 0x05B, "fchmod", SysFchmod, STRACE_FCHOWN);
+    SYSCALL(3, 0x05C, "chown", SysChown, STRACE_CHOWN);
+    SYSCALL(3, 0x05D, "fchown", SysFchown, STRACE_FCHOWN);
+    SYSCALL(3, 0x05E, "lchown", SysLchown, STRACE_LCHOWN);
+    SYSCALL(5, 0x104, "fchownat", SysFchownat, STRACE_CHOWNAT);
+    SYSCALL(2, 0x060, "gettimeofday", SysGettimeofday, STRACE_2);
+    SYSCALL(2, 0x061, "getrlimit", SysGetrlimit, STRACE_GETRLIMIT);
+    SYSCALL(2, 0x062, "getrusage", SysGetrusage, STRACE_2);
+    SYSCALL(1, 0x064, "times", SysTimes, STRACE_1);
+    SYSCALL(0, 0x070, "setsid", SysSetsid, STRACE_SETSID);
+    SYSCALL(2, 0x073, "getgroups", SysGetgroups, STRACE_2);
+    SYSCALL(1, 0x07F, "rt_sigpending", SysSigpending, STRACE_1);
+    SYSCALL(2, 0x089, "statfs", SysStatfs, STRACE_2);
+    SYSCALL(2, 0x08A, "fstatfs", SysFstatfs, STRACE_2);
+    SYSCALL(2, 0x06D, "setpgid", SysSetpgid, STRACE_2);
+    SYSCALL(1, 0x069, "setuid", SysSetuid, STRACE_SETUID);
+    SYSCALL(1, 0x06A, "setgid", SysSetgid, STRACE_SETGID);
+    SYSCALL(2, 0x071, "setreuid", SysSetreuid, STRACE_SETREUID);
+    SYSCALL(2, 0x072, "setregid", SysSetregid, STRACE_SETREGID);
+    SYSCALL(2, 0x082, "rt_sigsuspend", SysSigsuspend, STRACE_SIGSUSPEND);
+    SYSCALL(2, 0x083, "sigaltstack", SysSigaltstack, STRACE_2);
+    SYSCALL(3, 0x085, "mknod", SysMknod, STRACE_3);
+    SYSCALL(2, 0x09E, "arch_prctl", SysArchPrctl, STRACE_2);
     SYSCALL(2, 0x0A0, "setrlimit", SysSetrlimit, STRACE_SETRLIMIT);
     SYSCALL(0, 0x0A2, "sync", SysSync, STRACE_SYNC);
     SYSCALL(3, 0x0D9, "getdents", SysGetdents, STRACE_3);
     SYSCALL(1, 0x0DA, "set_tid_address", SysSetTidAddress, STRACE_1);
     SYSCALL(4, 0x0DD, "fadvise", SysFadvise, STRACE_4);
+    SYSCALL(3, 0x0BB, "readahead", SysReadahead, STRACE_3);
+    SYSCALL(4, 0x11D, "fallocate", SysFallocate, STRACE_4);
+    SYSCALL(5, 0x14C, "statx", SysStatx, STRACE_5);
 #ifdef HAVE_CLOCK_SETTIME
     SYSCALL(2, 0x0E3, "clock_settime", SysClockSettime, STRACE_2);
 #endif
@@ -5683,6 +7831,11 @@ void OpSyscall(P) {
     SYSCALL(5, 0x147, "preadv2", SysPreadv2, STRACE_PREADV2);
     SYSCALL(5, 0x148, "pwritev2", SysPwritev2, STRACE_PWRITEV2);
     SYSCALL(3, 0x1B4, "close_range", SysCloseRange, STRACE_3);
+    SYSCALL(6, 0x146, "copy_file_range", SysCopyFileRange, STRACE_6);
+    SYSCALL(6, 0x113, "splice", SysSplice, STRACE_6);
+#ifdef HAVE_SPLICE
+    SYSCALL(4, 0x114, "tee", SysTee, STRACE_4);
+#endif
 #ifdef HAVE_EPOLL_PWAIT1
     SYSCALL(1, 0x0D5, "epoll_create", SysEpollCreate, STRACE_1);
     SYSCALL(1, 0x123, "epoll_create1", SysEpollCreate1, STRACE_1);
@@ -5691,6 +7844,21 @@ void OpSyscall(P) {
     SYSCALL(6, 0x119, "epoll_pwait", SysEpollPwait, STRACE_6);
     SYSCALL(6, 0x1B9, "epoll_pwait2", SysEpollPwait2, STRACE_6);
 #endif /* HAVE_EPOLL_PWAIT1 */
+#ifdef HAVE_EVENTFD
+    SYSCALL(1, 0x11C, "eventfd", SysEventfd, STRACE_1);
+    SYSCALL(2, 0x122, "eventfd2", SysEventfd2, STRACE_2);
+#endif
+#ifdef HAVE_TIMERFD
+    SYSCALL(2, 0x11B, "timerfd_create", SysTimerfdCreate, STRACE_2);
+    SYSCALL(4, 0x11E, "timerfd_settime", SysTimerfdSettime, STRACE_4);
+    SYSCALL(2, 0x11F, "timerfd_gettime", SysTimerfdGettime, STRACE_2);
+#endif
+    SYSCALL(3, 0x11A, "signalfd", SysSignalfd, STRACE_3);
+    SYSCALL(4, 0x121, "signalfd4", SysSignalfd4, STRACE_4);
+    SYSCALL(2, 0x1A9, "io_uring_setup", SysIoUringSetup, STRACE_2);
+    SYSCALL(6, 0x1AA, "io_uring_enter", SysIoUringEnter, STRACE_6);
+    SYSCALL(4, 0x1AB, "io_uring_register", SysIoUringRegister, STRACE_4);
+    SYSCALL(2, 0x13F, "memfd_create", SysMemfdCreate, STRACE_2);
 #endif /* DISABLE_NONPOSIX */
     case 0x3C:
       SYS_LOGF("%s(%#" PRIx64 ")", "exit", di);
@@ -5702,8 +7870,10 @@ void OpSyscall(P) {
       SigRestore(m);
       m->interrupted = true;  // preevnt ax clobber
       break;
+#ifdef DISABLE_NONPOSIX
     case 0x146:
       // avoid noisy copy_file_range() feature check in cosmo
+#endif
     case 0x1BC:
       // avoid noisy landlock_create_ruleset() feature check in cosmo
     case 0x500:
@@ -11,6 +11,10 @@
 #define LOCK(x)   unassert(!pthread_mutex_lock(x))
 #define UNLOCK(x) unassert(!pthread_mutex_unlock(x))
 
+#define RDLOCK(x)   unassert(!pthread_rwlock_rdlock(x))
+#define WRLOCK(x)   unassert(!pthread_rwlock_wrlock(x))
+#define RWUNLOCK(x) unassert(!pthread_rwlock_unlock(x))
+
 #ifdef __HAIKU__
 #include <OS.h>
 #undef UNLOCK
@@ -30,6 +34,7 @@
 #define pthread_mutex_t_     pthread_mutex_t
 #define pthread_condattr_t_  pthread_condattr_t
 #define pthread_mutexattr_t_ pthread_mutexattr_t
+#define pthread_rwlock_t_    pthread_rwlock_t
 
 #else /* HAVE_THREADS */
 #include <signal.h>
@@ -42,6 +47,10 @@
 #define LOCK(x)   (void)0
 #define UNLOCK(x) (void)0
 
+#define RDLOCK(x)   (void)0
+#define WRLOCK(x)   (void)0
+#define RWUNLOCK(x) (void)0
+
 #define PTHREAD_ONCE_INIT_         0
 #define PTHREAD_MUTEX_INITIALIZER_ 0
 
@@ -50,6 +59,7 @@
 #define pthread_mutex_t_     char
 #define pthread_condattr_t_  char
 #define pthread_mutexattr_t_ char
+#define pthread_rwlock_t_    char
 
 #define pthread_self()                     0
 #define pthread_sigmask(x, y, z)           sigprocmask(x, y, z)
@@ -65,6 +75,9 @@
 #define pthread_condattr_init(x)           0
 #define pthread_condattr_setpshared(x, y)  0
 #define pthread_condattr_destroy(x)        0
+#define pthread_rwlock_init(x, y)          ((void)(y), 0)
+#define pthread_rwlock_destroy(x)          0
+#define pthread_rwlock_tryrdlock(x)        0
 #define pthread_mutexattr_init(x)          0
 #define pthread_mutexattr_setpshared(x, y) 0
 #define pthread_mutexattr_destroy(x)       0
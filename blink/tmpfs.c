@@ -0,0 +1,3065 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include "blink/tmpfs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "blink/assert.h"
+#include "blink/atomic.h"
+#include "blink/dll.h"
+#include "blink/errno.h"
+#include "blink/flag.h"
+#include "blink/hostfs.h"
+#include "blink/log.h"
+#include "blink/macros.h"
+#include "blink/spin.h"
+#include "blink/thread.h"
+#include "blink/timespec.h"
+#include "blink/tunables.h"
+#include "blink/vfs.h"
+
+#if defined(__APPLE__) || defined(__NetBSD__)
+#define st_atim st_atimespec
+#define st_ctim st_ctimespec
+#define st_mtim st_mtimespec
+#endif
+
+#ifndef DISABLE_VFS
+
+#if defined(HAVE_THREADS) && defined(HAVE_PTHREAD_PROCESS_SHARED)
+#define TMPFS_PSHARED
+#ifdef HAVE_PTHREAD_MUTEX_ROBUST
+#define TMPFS_ROBUST
+#endif
+#endif
+
+#define TMPFS_MAGIC       0x73666d74  // "tmfs"
+#define TMPFS_ROOT_INO    1
+#define TMPFS_DIRENTS     (kTmpfsNodes * 2)
+#define TMPFS_FILES       kTmpfsNodes
+#define TMPFS_HANDLES     (kTmpfsNodes * 2)
+#define TMPFS_DIRENT_SIZE 20  // linux reports directory sizes like this
+#define TMPFS_LOCKSPAN    ((off_t)1 << 40)
+#define TMPFS_SHADOW      "/tmp/blink.tmpfs.XXXXXX"
+
+#if kTmpfsNodes & (kTmpfsNodes - 1)
+#error "kTmpfsNodes must be a power of two"
+#endif
+
+#define TMPFS_INFO_CONTAINER(e) DLL_CONTAINER(struct TmpfsInfo, elem, e)
+
+// A tmpfs mount is a single shared memory arena holding every inode,
+// directory entry, open file description, and data page. Since guest
+// processes are host processes, sharing the arena is what lets files
+// written by one program be read by the next one it spawns. Records
+// refer to each other by index because each process may map the arena
+// at a different address.
+
+struct TmpfsNode {
+  u32 mode;    // zero if slot is free
+  u32 gen;     // bumped when slot is freed, to detect stale infos
+  u32 nlink;   //
+  u32 uid;     //
+  u32 gid;     //
+  u32 opens;   // open file descriptions referencing node
+  u32 parent;  // directories only
+  u32 first;   // directories only, oldest entry
+  u32 last;    // directories only, newest entry
+  u32 next;    // free list
+  u32 map;     // first page of block map holding data page numbers
+  u32 mapcap;  // number of pages in block map
+  u32 pages;   // number of data pages allocated
+  u32 mapped;  // data pages were given to mmap()
+  u64 size;    //
+  u64 serial;  // directories only, serial of newest entry
+  struct timespec atim;
+  struct timespec mtim;
+  struct timespec ctim;
+};
+
+struct TmpfsDirent {
+  u32 ino;      // zero if slot is free
+  u32 parent;   //
+  u32 hnext;    // hash chain, or free list
+  u32 prev;     // sibling list, in order of creation
+  u32 next;     //
+  u32 namelen;  //
+  u64 serial;   // position of entry in directory stream
+  char name[VFS_NAME_MAX];
+};
+
+struct TmpfsFile {
+  u32 refs;    // number of handles
+  u32 ino;     //
+  u32 next;    // free list
+  u32 cursor;  // dirent last returned by readdir(), as a hint
+  int flags;   //
+  u64 offset;  // file position, or directory stream position
+};
+
+// Every process holding an open file description owns a handle on it,
+// so a description outlives a process that was killed without getting
+// to close its files, and only stays alive as long as somebody can use
+// it, which TmpfsSweep() works out by asking the kernel. The start time
+// of the process tells it apart from a later one that reused its pid.
+struct TmpfsHandle {
+  i32 pid;    // zero if slot is free
+  u32 file;   //
+  u32 next;   // free list
+  u64 start;  // when process started, or zero if unknown
+};
+
+struct TmpfsSuper {
+#ifdef TMPFS_PSHARED
+  pthread_mutex_t lock;
+#else
+  _Atomic(u32) lock;
+#endif
+  u32 magic;
+  u32 pagesize;
+  u32 npages;
+  u32 pagebrk;
+  u32 nfreepages;
+  u32 retired;
+  u32 nodebrk, freenode;
+  u32 direntbrk, freedirent;
+  u32 filebrk, freefile;
+  u32 handlebrk, freehandle;
+  u64 nodes, dirents, files, handles, buckets, freepages;
+  char shadow[sizeof(TMPFS_SHADOW)];
+};
+
+struct TmpfsDevice {
+  int fd;
+  u8 *base;
+  size_t size;
+  struct TmpfsSuper *super;
+  struct TmpfsNode *nodes;
+  struct TmpfsDirent *dirents;
+  struct TmpfsFile *files;
+  struct TmpfsHandle *handles;
+  u32 *buckets;
+  u32 *freepages;
+};
+
+struct TmpfsInfo {
+  struct Dll elem;
+  struct TmpfsDevice *device;
+  u32 ino;
+  u32 gen;
+  u32 handle;  // nonzero if this is an open file
+  u32 file;
+  int fdflags;
+  bool locked;
+};
+
+static struct TmpfsState {
+  pthread_once_t_ once;
+  pthread_mutex_t_ lock;
+  struct Dll *opens GUARDED_BY(lock);
+  u64 start;  // start time of this process
+} g_tmpfsstate = {
+    PTHREAD_ONCE_INIT_,
+    PTHREAD_MUTEX_INITIALIZER_,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef TMPFS_ROBUST
+static void TmpfsRepair(struct TmpfsDevice *);
+#endif
+
+static void TmpfsLock(struct TmpfsDevice *device) {
+#if defined(TMPFS_ROBUST)
+  int rc;
+  if ((rc = pthread_mutex_lock(&device->super->lock)) == EOWNERDEAD) {
+    LOGF("tmpfs lock holder died, repairing arena");
+    TmpfsRepair(device);
+    unassert(!pthread_mutex_consistent(&device->super->lock));
+  } else {
+    unassert(!rc);
+  }
+#elif defined(TMPFS_PSHARED)
+  LOCK(&device->super->lock);
+#else
+  SpinLock(&device->super->lock);
+#endif
+}
+
+static void TmpfsUnlock(struct TmpfsDevice *device) {
+#ifdef TMPFS_PSHARED
+  UNLOCK(&device->super->lock);
+#else
+  SpinUnlock(&device->super->lock);
+#endif
+}
+
+static mode_t TmpfsUmask(void) {
+  return atomic_load_explicit(&g_vfs.umask, memory_order_relaxed);
+}
+
+static u8 *TmpfsPage(struct TmpfsDevice *device, u32 page) {
+  return device->base + (size_t)page * device->super->pagesize;
+}
+
+static u32 *TmpfsBlocks(struct TmpfsDevice *device, struct TmpfsNode *node) {
+  return (u32 *)TmpfsPage(device, node->map);
+}
+
+static u64 TmpfsBlockCapacity(struct TmpfsDevice *device,
+                              struct TmpfsNode *node) {
+  return (u64)node->mapcap * (device->super->pagesize / sizeof(u32));
+}
+
+static u32 TmpfsHash(u32 parent, const char *name, size_t namelen) {
+  u32 h = 2166136261u ^ parent;
+  while (namelen--) {
+    h ^= (u8)*name++;
+    h *= 16777619;
+  }
+  return h & (kTmpfsNodes - 1);
+}
+
+static int TmpfsShadowPath(struct TmpfsDevice *device, u32 ino,
+                           char path[VFS_PATH_MAX], bool create) {
+  char tmp[] = TMPFS_SHADOW;
+  if (!device->super->shadow[0]) {
+    if (!create) return enoent();
+    if (!mkdtemp(tmp)) return -1;
+    memcpy(device->super->shadow, tmp, sizeof(tmp));
+  }
+  snprintf(path, VFS_PATH_MAX, "%s/%" PRIu32, device->super->shadow, ino);
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Gives pages back to the host, after which they read as zero.
+static void TmpfsDiscardPages(struct TmpfsDevice *device, u32 page,
+                              u32 count) {
+  size_t pagesize = device->super->pagesize;
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_PUNCH_HOLE)
+  if (!fallocate(device->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                 (off_t)page * pagesize, (off_t)count * pagesize)) {
+    return;
+  }
+#endif
+  memset(TmpfsPage(device, page), 0, count * pagesize);
+}
+
+// Frees pages. Pages that might still be mapped by some process are
+// retired instead, since handing them out again would leak new data
+// into old mappings.
+static void TmpfsFreePages(struct TmpfsDevice *device, u32 page, u32 count,
+                           bool retire) {
+  TmpfsDiscardPages(device, page, count);
+  if (retire) {
+    device->super->retired += count;
+  } else {
+    while (count--) {
+      device->freepages[device->super->nfreepages++] = page++;
+    }
+  }
+}
+
+// Frees data pages of node starting at block index `keep`.
+static void TmpfsTruncateBlocks(struct TmpfsDevice *device,
+                                struct TmpfsNode *node, u64 keep) {
+  u64 i, cap;
+  u32 *blocks, run, count;
+  if (!node->map) return;
+  blocks = TmpfsBlocks(device, node);
+  cap = TmpfsBlockCapacity(device, node);
+  for (run = count = 0, i = keep; i < cap && node->pages; ++i) {
+    if (!blocks[i]) continue;
+    if (count && blocks[i] == run + count) {
+      ++count;
+    } else {
+      if (count) TmpfsFreePages(device, run, count, node->mapped);
+      run = blocks[i];
+      count = 1;
+    }
+    blocks[i] = 0;
+    --node->pages;
+  }
+  if (count) TmpfsFreePages(device, run, count, node->mapped);
+}
+
+static void TmpfsFreeNode(struct TmpfsDevice *device, u32 ino) {
+  int e;
+  char path[VFS_PATH_MAX];
+  struct TmpfsNode *node = device->nodes + ino;
+  e = errno;
+  if ((S_ISSOCK(node->mode) || S_ISFIFO(node->mode)) &&
+      TmpfsShadowPath(device, ino, path, false) != -1) {
+    unlink(path);
+    if (!rmdir(device->super->shadow)) {
+      device->super->shadow[0] = '\0';
+    }
+  }
+  node->mapped = 0;
+  TmpfsTruncateBlocks(device, node, 0);
+  if (node->map) {
+    TmpfsFreePages(device, node->map, node->mapcap, false);
+  }
+  node->map = 0;
+  node->mapcap = 0;
+  node->mode = 0;
+  node->size = 0;
+  ++node->gen;
+  node->next = device->super->freenode;
+  device->super->freenode = ino;
+  errno = e;
+}
+
+static void TmpfsMaybeFreeNode(struct TmpfsDevice *device, u32 ino) {
+  struct TmpfsNode *node = device->nodes + ino;
+  if (node->mode && !node->nlink && !node->opens) {
+    TmpfsFreeNode(device, ino);
+  }
+}
+
+static void TmpfsReleaseFile(struct TmpfsDevice *device, u32 file) {
+  struct TmpfsNode *node;
+  struct TmpfsFile *f = device->files + file;
+  if (--f->refs) return;
+  node = device->nodes + f->ino;
+  if (!--node->opens) node->mapped = 0;
+  TmpfsMaybeFreeNode(device, f->ino);
+  f->ino = 0;
+  f->next = device->super->freefile;
+  device->super->freefile = file;
+}
+
+static void TmpfsReleaseHandle(struct TmpfsDevice *device, u32 handle) {
+  struct TmpfsHandle *h = device->handles + handle;
+  u32 file = h->file;
+  h->pid = 0;
+  h->file = 0;
+  h->next = device->super->freehandle;
+  device->super->freehandle = handle;
+  TmpfsReleaseFile(device, file);
+}
+
+// Returns when process started, in clock ticks since boot, or zero if
+// that can't be known, in which case TmpfsSweep() trusts the pid alone.
+static u64 TmpfsGetStartTime(i32 pid) {
+#ifdef __linux
+  int i, fd;
+  ssize_t n;
+  char *p, path[32], buf[512];
+  snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+  if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) return 0;
+  n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (n <= 0) return 0;
+  buf[n] = '\0';
+  // starttime is the 22nd field, and the 2nd one may contain spaces
+  if (!(p = strrchr(buf, ')'))) return 0;
+  for (i = 0; i < 20 && p; ++i) p = strchr(p + 1, ' ');
+  return p ? strtoull(p + 1, 0, 10) : 0;
+#else
+  return 0;
+#endif
+}
+
+static bool TmpfsIsDead(struct TmpfsHandle *h) {
+  u64 start;
+  if (kill(h->pid, 0) == -1 && errno == ESRCH) return true;
+  return h->start && (start = TmpfsGetStartTime(h->pid)) && start != h->start;
+}
+
+// Releases the handles of processes that died without closing files,
+// e.g. because they were killed or left through _Exit().
+static bool TmpfsSweep(struct TmpfsDevice *device) {
+  u32 i;
+  i32 pid;
+  int e = errno;
+  bool found = false;
+  struct TmpfsHandle *h;
+  pid = getpid();
+  for (i = 1; i < device->super->handlebrk; ++i) {
+    h = device->handles + i;
+    if (h->pid &&
+        (h->pid == pid ? h->start != g_tmpfsstate.start : TmpfsIsDead(h))) {
+      TmpfsReleaseHandle(device, i);
+      found = true;
+    }
+  }
+  errno = e;
+  return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static u32 TmpfsAllocPage(struct TmpfsDevice *device) {
+  struct TmpfsSuper *super = device->super;
+  do {
+    if (super->nfreepages) {
+      return device->freepages[--super->nfreepages];
+    }
+    if (super->pagebrk < super->npages) {
+      return super->pagebrk++;
+    }
+  } while (TmpfsSweep(device));
+  enospc();
+  return 0;
+}
+
+static int TmpfsComparePages(const void *a, const void *b) {
+  u32 x = *(const u32 *)a;
+  u32 y = *(const u32 *)b;
+  return x < y ? -1 : x > y;
+}
+
+// Takes `count` consecutive pages off the free list, if it has them.
+static u32 TmpfsAllocFreeRun(struct TmpfsDevice *device, u32 count) {
+  u32 i, j, n, page;
+  struct TmpfsSuper *super = device->super;
+  if ((n = super->nfreepages) < count) return 0;
+  qsort(device->freepages, n, sizeof(u32), TmpfsComparePages);
+  for (i = j = 0; i < n; ++i) {
+    if (i > j && device->freepages[i] != device->freepages[i - 1] + 1) {
+      j = i;
+    }
+    if (i - j + 1 == count) {
+      page = device->freepages[j];
+      memmove(device->freepages + j, device->freepages + i + 1,
+              (n - i - 1) * sizeof(u32));
+      super->nfreepages -= count;
+      return page;
+    }
+  }
+  return 0;
+}
+
+static u32 TmpfsAllocRun(struct TmpfsDevice *device, u32 count) {
+  u32 page;
+  struct TmpfsSuper *super = device->super;
+  if (count == 1) return TmpfsAllocPage(device);
+  do {
+    if ((page = TmpfsAllocFreeRun(device, count))) {
+      return page;
+    }
+    if (count <= super->npages - super->pagebrk) {
+      page = super->pagebrk;
+      super->pagebrk += count;
+      return page;
+    }
+  } while (TmpfsSweep(device));
+  enospc();
+  return 0;
+}
+
+static u32 TmpfsAllocNode(struct TmpfsDevice *device, u32 mode) {
+  u32 ino, gen;
+  struct TmpfsNode *node;
+  struct TmpfsSuper *super = device->super;
+  for (;;) {
+    if ((ino = super->freenode)) {
+      super->freenode = device->nodes[ino].next;
+      break;
+    }
+    if (super->nodebrk < kTmpfsNodes) {
+      ino = super->nodebrk++;
+      break;
+    }
+    if (!TmpfsSweep(device)) {
+      enospc();
+      return 0;
+    }
+  }
+  node = device->nodes + ino;
+  gen = node->gen;
+  memset(node, 0, sizeof(*node));
+  node->gen = gen;
+  node->mode = mode;
+  node->uid = geteuid();
+  node->gid = getegid();
+  node->atim = node->mtim = node->ctim = GetTime();
+  return ino;
+}
+
+static u32 TmpfsAllocDirent(struct TmpfsDevice *device) {
+  u32 i;
+  struct TmpfsSuper *super = device->super;
+  for (;;) {
+    if ((i = super->freedirent)) {
+      super->freedirent = device->dirents[i].hnext;
+      return i;
+    }
+    if (super->direntbrk < TMPFS_DIRENTS) {
+      return super->direntbrk++;
+    }
+    if (!TmpfsSweep(device)) {
+      enospc();
+      return 0;
+    }
+  }
+}
+
+static u32 TmpfsAllocFile(struct TmpfsDevice *device) {
+  u32 i;
+  struct TmpfsSuper *super = device->super;
+  for (;;) {
+    if ((i = super->freefile)) {
+      super->freefile = device->files[i].next;
+      return i;
+    }
+    if (super->filebrk < TMPFS_FILES) {
+      return super->filebrk++;
+    }
+    if (!TmpfsSweep(device)) {
+      enfile();
+      return 0;
+    }
+  }
+}
+
+static u32 TmpfsAllocHandle(struct TmpfsDevice *device, u32 file) {
+  u32 i;
+  struct TmpfsSuper *super = device->super;
+  for (;;) {
+    if ((i = super->freehandle)) {
+      super->freehandle = device->handles[i].next;
+      break;
+    }
+    if (super->handlebrk < TMPFS_HANDLES) {
+      i = super->handlebrk++;
+      break;
+    }
+    if (!TmpfsSweep(device)) {
+      enfile();
+      return 0;
+    }
+  }
+  device->handles[i].pid = getpid();
+  device->handles[i].start = g_tmpfsstate.start;
+  device->handles[i].file = file;
+  ++device->files[file].refs;
+  return i;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Grows the block map of node so it can hold `count` entries.
+static int TmpfsReserveBlocks(struct TmpfsDevice *device,
+                              struct TmpfsNode *node, u64 count) {
+  u32 map, mapcap;
+  u64 perpage = device->super->pagesize / sizeof(u32);
+  if (count <= TmpfsBlockCapacity(device, node)) return 0;
+  if (count > device->super->npages) return enospc();
+  for (mapcap = node->mapcap ? node->mapcap : 1; mapcap * perpage < count;
+       mapcap *= 2) {
+  }
+  if (!(map = TmpfsAllocRun(device, mapcap))) return -1;
+  if (node->map) {
+    memcpy(TmpfsPage(device, map), TmpfsPage(device, node->map),
+           (size_t)node->mapcap * device->super->pagesize);
+    TmpfsFreePages(device, node->map, node->mapcap, false);
+  }
+  node->map = map;
+  node->mapcap = mapcap;
+  return 0;
+}
+
+// Returns data page number for block index `i` of node, or zero if
+// it's a hole and `create` is false, or zero w/ errno on failure.
+static u32 TmpfsGetBlock(struct TmpfsDevice *device, struct TmpfsNode *node,
+                         u64 i, bool create) {
+  u32 page;
+  if (i < TmpfsBlockCapacity(device, node) &&
+      (page = TmpfsBlocks(device, node)[i])) {
+    return page;
+  }
+  if (!create) return 0;
+  if (TmpfsReserveBlocks(device, node, i + 1) == -1) return 0;
+  if (!(page = TmpfsAllocPage(device))) return 0;
+  TmpfsBlocks(device, node)[i] = page;
+  ++node->pages;
+  return page;
+}
+
+static void TmpfsCopyOut(struct TmpfsDevice *device, struct TmpfsNode *node,
+                         u8 *buf, u64 off, size_t len) {
+  u32 page;
+  size_t n, skew, pagesize = device->super->pagesize;
+  for (; len; buf += n, off += n, len -= n) {
+    skew = off % pagesize;
+    n = MIN(len, pagesize - skew);
+    if ((page = TmpfsGetBlock(device, node, off / pagesize, false))) {
+      memcpy(buf, TmpfsPage(device, page) + skew, n);
+    } else {
+      memset(buf, 0, n);
+    }
+  }
+}
+
+static size_t TmpfsCopyIn(struct TmpfsDevice *device, struct TmpfsNode *node,
+                          const u8 *buf, u64 off, size_t len) {
+  u32 page;
+  size_t n, skew, done, pagesize = device->super->pagesize;
+  for (done = 0; len; buf += n, off += n, len -= n, done += n) {
+    skew = off % pagesize;
+    n = MIN(len, pagesize - skew);
+    if (!(page = TmpfsGetBlock(device, node, off / pagesize, true))) break;
+    memcpy(TmpfsPage(device, page) + skew, buf, n);
+  }
+  return done;
+}
+
+// Zeroes a byte range of node, giving whole pages back to the arena.
+static void TmpfsZeroRange(struct TmpfsDevice *device, struct TmpfsNode *node,
+                           u64 off, u64 len) {
+  u32 page, *blocks;
+  u64 n, skew, pagesize = device->super->pagesize;
+  for (; len; off += n, len -= n) {
+    skew = off % pagesize;
+    n = MIN(len, pagesize - skew);
+    if (!(page = TmpfsGetBlock(device, node, off / pagesize, false))) continue;
+    if (n == pagesize) {
+      blocks = TmpfsBlocks(device, node);
+      blocks[off / pagesize] = 0;
+      --node->pages;
+      TmpfsFreePages(device, page, 1, node->mapped);
+    } else {
+      memset(TmpfsPage(device, page) + skew, 0, n);
+    }
+  }
+}
+
+static void TmpfsResize(struct TmpfsDevice *device, struct TmpfsNode *node,
+                        u64 size) {
+  u64 pagesize = device->super->pagesize;
+  if (size < node->size) {
+    TmpfsTruncateBlocks(device, node, (size + pagesize - 1) / pagesize);
+    if (size % pagesize) {
+      TmpfsZeroRange(device, node, size, pagesize - size % pagesize);
+    }
+  }
+  node->size = size;
+  node->mtim = node->ctim = GetTime();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static u32 TmpfsLookup(struct TmpfsDevice *device, u32 dir, const char *name,
+                       size_t namelen) {
+  u32 i;
+  struct TmpfsDirent *d;
+  for (i = device->buckets[TmpfsHash(dir, name, namelen)]; i; i = d->hnext) {
+    d = device->dirents + i;
+    if (d->parent == dir && d->namelen == namelen &&
+        !memcmp(d->name, name, namelen)) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+static int TmpfsAddEntry(struct TmpfsDevice *device, u32 dir,
+                         const char *name, size_t namelen, u32 ino) {
+  u32 i, *bucket;
+  struct TmpfsDirent *d;
+  struct TmpfsNode *parent = device->nodes + dir;
+  if (!(i = TmpfsAllocDirent(device))) return -1;
+  d = device->dirents + i;
+  d->ino = ino;
+  d->parent = dir;
+  d->namelen = namelen;
+  memcpy(d->name, name, namelen);
+  d->name[namelen] = '\0';
+  d->serial = ++parent->serial;
+  bucket = device->buckets + TmpfsHash(dir, name, namelen);
+  d->hnext = *bucket;
+  *bucket = i;
+  d->next = 0;
+  d->prev = parent->last;
+  if (parent->last) {
+    device->dirents[parent->last].next = i;
+  } else {
+    parent->first = i;
+  }
+  parent->last = i;
+  parent->size += TMPFS_DIRENT_SIZE;
+  parent->mtim = parent->ctim = GetTime();
+  return 0;
+}
+
+static void TmpfsRemoveEntry(struct TmpfsDevice *device, u32 i) {
+  u32 *p;
+  struct TmpfsDirent *d = device->dirents + i;
+  struct TmpfsNode *parent = device->nodes + d->parent;
+  for (p = device->buckets + TmpfsHash(d->parent, d->name, d->namelen);
+       *p != i; p = &device->dirents[*p].hnext) {
+  }
+  *p = d->hnext;
+  if (d->prev) {
+    device->dirents[d->prev].next = d->next;
+  } else {
+    parent->first = d->next;
+  }
+  if (d->next) {
+    device->dirents[d->next].prev = d->prev;
+  } else {
+    parent->last = d->prev;
+  }
+  parent->size -= TMPFS_DIRENT_SIZE;
+  parent->mtim = parent->ctim = GetTime();
+  d->ino = 0;
+  d->hnext = device->super->freedirent;
+  device->super->freedirent = i;
+}
+
+#ifdef TMPFS_ROBUST
+
+struct TmpfsOrder {
+  u32 parent;
+  u32 dirent;
+  u64 serial;
+};
+
+static int TmpfsCompareOrder(const void *a, const void *b) {
+  const struct TmpfsOrder *x = (const struct TmpfsOrder *)a;
+  const struct TmpfsOrder *y = (const struct TmpfsOrder *)b;
+  if (x->parent != y->parent) return x->parent < y->parent ? -1 : 1;
+  return x->serial < y->serial ? -1 : x->serial > y->serial;
+}
+
+static bool TmpfsIsLiveNode(struct TmpfsDevice *device, u32 ino) {
+  return ino && ino < device->super->nodebrk && device->nodes[ino].mode;
+}
+
+// Links dirent into the sibling list of its parent, by serial.
+static void TmpfsRelinkEntry(struct TmpfsDevice *device, u32 i) {
+  u32 prev;
+  struct TmpfsDirent *d = device->dirents + i;
+  struct TmpfsNode *parent = device->nodes + d->parent;
+  for (prev = parent->last;
+       prev && device->dirents[prev].serial > d->serial;
+       prev = device->dirents[prev].prev) {
+  }
+  d->prev = prev;
+  d->next = prev ? device->dirents[prev].next : parent->first;
+  if (prev) {
+    device->dirents[prev].next = i;
+  } else {
+    parent->first = i;
+  }
+  if (d->next) {
+    device->dirents[d->next].prev = i;
+  } else {
+    parent->last = i;
+  }
+  parent->serial = MAX(parent->serial, d->serial);
+  parent->size += TMPFS_DIRENT_SIZE;
+}
+
+// Recomputes everything derivable in the arena, after a process died
+// while holding the lock, possibly halfway through changing it. Lists
+// and counts are rebuilt from the slots they summarize. Pages nothing
+// owns are retired rather than freed, since a mapping may still hold
+// them, so the worst a crash costs is leaking the pages it touched.
+static void TmpfsRepair(struct TmpfsDevice *device) {
+  u8 *used;
+  u64 i, j, cap;
+  u32 *blocks, page, firstpage, n;
+  struct TmpfsFile *f;
+  struct TmpfsNode *node;
+  struct TmpfsDirent *d;
+  struct TmpfsHandle *h;
+  struct TmpfsOrder *order;
+  struct TmpfsSuper *super = device->super;
+  super->nodebrk = MIN(MAX(super->nodebrk, TMPFS_ROOT_INO + 1), kTmpfsNodes);
+  super->direntbrk = MIN(MAX(super->direntbrk, 1), TMPFS_DIRENTS);
+  super->filebrk = MIN(MAX(super->filebrk, 1), TMPFS_FILES);
+  super->handlebrk = MIN(MAX(super->handlebrk, 1), TMPFS_HANDLES);
+  super->nfreepages = MIN(super->nfreepages, super->npages);
+  firstpage = (super->freepages +
+               ROUNDUP((size_t)super->npages * sizeof(u32), super->pagesize)) /
+              super->pagesize;
+  // drop open file descriptions nobody has a handle on
+  for (i = 1; i < super->filebrk; ++i) {
+    device->files[i].refs = 0;
+  }
+  for (i = 1; i < super->handlebrk; ++i) {
+    h = device->handles + i;
+    if (h->pid && h->file && h->file < super->filebrk &&
+        TmpfsIsLiveNode(device, device->files[h->file].ino)) {
+      ++device->files[h->file].refs;
+    } else {
+      h->pid = 0;
+    }
+  }
+  for (i = 1; i < super->nodebrk; ++i) {
+    device->nodes[i].opens = 0;
+  }
+  for (i = 1; i < super->filebrk; ++i) {
+    f = device->files + i;
+    if (f->refs) {
+      ++device->nodes[f->ino].opens;
+    } else {
+      f->ino = 0;
+    }
+  }
+  // relink directory entries whose inode and parent still exist
+  memset(device->buckets, 0, kTmpfsNodes * sizeof(u32));
+  for (i = 1; i < super->nodebrk; ++i) {
+    node = device->nodes + i;
+    node->nlink = 0;
+    if (S_ISDIR(node->mode)) {
+      node->first = node->last = 0;
+      node->size = 2 * TMPFS_DIRENT_SIZE;
+    }
+  }
+  order = (struct TmpfsOrder *)malloc(TMPFS_DIRENTS * sizeof(*order));
+  for (n = 0, i = 1; i < super->direntbrk; ++i) {
+    d = device->dirents + i;
+    if (TmpfsIsLiveNode(device, d->ino) &&
+        TmpfsIsLiveNode(device, d->parent) &&
+        S_ISDIR(device->nodes[d->parent].mode) && d->namelen &&
+        d->namelen < VFS_NAME_MAX) {
+      d->hnext = device->buckets[TmpfsHash(d->parent, d->name, d->namelen)];
+      device->buckets[TmpfsHash(d->parent, d->name, d->namelen)] = i;
+      node = device->nodes + d->ino;
+      if (S_ISDIR(node->mode)) {
+        node->parent = d->parent;
+        node->nlink += 2;
+        ++device->nodes[d->parent].nlink;
+      } else {
+        ++node->nlink;
+      }
+      if (order) {
+        order[n].parent = d->parent;
+        order[n].dirent = i;
+        order[n].serial = d->serial;
+        ++n;
+      } else {
+        TmpfsRelinkEntry(device, i);
+      }
+    } else {
+      d->ino = 0;
+    }
+  }
+  if (order) {
+    qsort(order, n, sizeof(*order), TmpfsCompareOrder);
+    for (i = 0; i < n; ++i) {
+      TmpfsRelinkEntry(device, order[i].dirent);
+    }
+    free(order);
+  }
+  node = device->nodes + TMPFS_ROOT_INO;
+  node->nlink += 2;
+  node->parent = TMPFS_ROOT_INO;
+  // forget block maps pointing outside the arena
+  for (i = 1; i < super->nodebrk; ++i) {
+    node = device->nodes + i;
+    if (!node->mode) continue;
+    if (node->map && (node->map < firstpage || node->mapcap > super->npages ||
+                      node->map + node->mapcap > super->pagebrk)) {
+      node->map = node->mapcap = 0;
+    }
+    node->pages = 0;
+    if (!node->map) continue;
+    blocks = TmpfsBlocks(device, node);
+    cap = TmpfsBlockCapacity(device, node);
+    for (j = 0; j < cap; ++j) {
+      if (blocks[j] && (blocks[j] < firstpage || blocks[j] >= super->pagebrk)) {
+        blocks[j] = 0;
+      }
+      node->pages += !!blocks[j];
+    }
+  }
+  // free inodes that were unlinked by whoever died
+  for (i = TMPFS_ROOT_INO + 1; i < super->nodebrk; ++i) {
+    node = device->nodes + i;
+    if (node->mode && !node->nlink && !node->opens &&
+        (!S_ISDIR(node->mode) || !node->first)) {
+      TmpfsFreeNode(device, i);
+    }
+  }
+  super->freenode = 0;
+  for (i = super->nodebrk; i-- > TMPFS_ROOT_INO + 1;) {
+    if (!device->nodes[i].mode) {
+      device->nodes[i].next = super->freenode;
+      super->freenode = i;
+    }
+  }
+  super->freedirent = 0;
+  for (i = super->direntbrk; i-- > 1;) {
+    if (!device->dirents[i].ino) {
+      device->dirents[i].hnext = super->freedirent;
+      super->freedirent = i;
+    }
+  }
+  super->freefile = 0;
+  for (i = super->filebrk; i-- > 1;) {
+    if (!device->files[i].refs) {
+      device->files[i].next = super->freefile;
+      super->freefile = i;
+    }
+  }
+  super->freehandle = 0;
+  for (i = super->handlebrk; i-- > 1;) {
+    if (!device->handles[i].pid) {
+      device->handles[i].next = super->freehandle;
+      super->freehandle = i;
+    }
+  }
+  // keep free pages nobody owns, and retire the ones nobody tracks
+  if ((used = (u8 *)calloc(super->npages, 1))) {
+    for (i = 1; i < super->nodebrk; ++i) {
+      node = device->nodes + i;
+      if (!node->mode || !node->map) continue;
+      memset(used + node->map, 1, node->mapcap);
+      blocks = TmpfsBlocks(device, node);
+      cap = TmpfsBlockCapacity(device, node);
+      for (j = 0; j < cap; ++j) {
+        used[blocks[j]] = 1;
+      }
+    }
+    for (n = i = 0; i < super->nfreepages; ++i) {
+      page = device->freepages[i];
+      if (page >= firstpage && page < super->pagebrk && !used[page]) {
+        device->freepages[n++] = page;
+        used[page] = 1;
+      }
+    }
+    super->nfreepages = n;
+    for (super->retired = 0, i = firstpage; i < super->pagebrk; ++i) {
+      super->retired += !used[i];
+    }
+    free(used);
+  }
+  TmpfsSweep(device);
+}
+
+#endif /* TMPFS_ROBUST */
+
+////////////////////////////////////////////////////////////////////////////////
+
+static bool TmpfsIsOwner(struct TmpfsNode *node) {
+  uid_t uid = geteuid();
+  return !uid || uid == node->uid;
+}
+
+static int TmpfsCheckAccess(struct TmpfsNode *node, int want) {
+  uid_t uid;
+  int mode = node->mode;
+  if ((mode & want) == want) return 0;  // others are permitted
+  if (!(uid = geteuid())) {
+    if ((want & X_OK) && !S_ISDIR(mode) && !(mode & 0111)) return eacces();
+    return 0;
+  }
+  if (uid == node->uid) {
+    mode >>= 6;
+  } else if (getegid() == node->gid) {
+    mode >>= 3;
+  }
+  if ((mode & want) != want) return eacces();
+  return 0;
+}
+
+static int TmpfsCheckSticky(struct TmpfsNode *dir, struct TmpfsNode *node) {
+  uid_t uid;
+  if (!(dir->mode & S_ISVTX)) return 0;
+  uid = geteuid();
+  if (!uid || uid == node->uid || uid == dir->uid) return 0;
+  return eperm();
+}
+
+// Returns length of name handed over by the vfs, where an empty name,
+// "." or ".." mean the directory itself and trailing slashes mean the
+// name must be a directory.
+static ssize_t TmpfsLeaf(const char *name, bool *isdir) {
+  size_t len = strlen(name);
+  *isdir = false;
+  while (len && name[len - 1] == '/') {
+    *isdir = true;
+    --len;
+  }
+  if (!len || (len == 1 && name[0] == '.') ||
+      (len == 2 && name[0] == '.' && name[1] == '.')) {
+    return 0;
+  }
+  if (len >= VFS_NAME_MAX) return enametoolong();
+  return len;
+}
+
+// @assume device locked
+static struct TmpfsNode *TmpfsGetNode(struct VfsInfo *info) {
+  struct TmpfsInfo *tmpfsinfo = (struct TmpfsInfo *)info->data;
+  struct TmpfsNode *node = tmpfsinfo->device->nodes + tmpfsinfo->ino;
+  if (!node->mode || node->gen != tmpfsinfo->gen) {
+    enoent();
+    return NULL;
+  }
+  return node;
+}
+
+// Looks up name inside parent directory.
+// @return inode number, or 0 w/ errno
+// @assume device locked
+static u32 TmpfsFind(struct VfsInfo *parent, const char *name) {
+  u32 i, ino;
+  bool isdir;
+  ssize_t len;
+  struct TmpfsNode *dir;
+  struct TmpfsInfo *dirinfo = (struct TmpfsInfo *)parent->data;
+  struct TmpfsDevice *device = dirinfo->device;
+  if (!(dir = TmpfsGetNode(parent))) return 0;
+  if ((len = TmpfsLeaf(name, &isdir)) == -1) return 0;
+  if (!len) return dirinfo->ino;
+  if (!S_ISDIR(dir->mode)) {
+    enotdir();
+    return 0;
+  }
+  if (TmpfsCheckAccess(dir, X_OK) == -1) return 0;
+  if (!(i = TmpfsLookup(device, dirinfo->ino, name, len))) {
+    enoent();
+    return 0;
+  }
+  ino = device->dirents[i].ino;
+  if (isdir && !S_ISDIR(device->nodes[ino].mode)) {
+    enotdir();
+    return 0;
+  }
+  return ino;
+}
+
+// Creates a new inode and links it into parent directory, optionally
+// filling it with `size` bytes of `data`.
+// @return inode number, or 0 w/ errno
+// @assume device locked
+static u32 TmpfsCreate(struct VfsInfo *parent, const char *name, u32 mode,
+                       const void *data, size_t size) {
+  u32 ino;
+  bool isdir;
+  ssize_t len;
+  struct TmpfsNode *dir, *node;
+  struct TmpfsInfo *dirinfo = (struct TmpfsInfo *)parent->data;
+  struct TmpfsDevice *device = dirinfo->device;
+  if ((len = TmpfsLeaf(name, &isdir)) == -1) return 0;
+  if (!(dir = TmpfsGetNode(parent))) return 0;
+  if (!len) {
+    eexist();
+    return 0;
+  }
+  if (!S_ISDIR(dir->mode)) {
+    enotdir();
+    return 0;
+  }
+  if (TmpfsCheckAccess(dir, X_OK) == -1) return 0;
+  if (TmpfsLookup(device, dirinfo->ino, name, len)) {
+    eexist();
+    return 0;
+  }
+  if (isdir && !S_ISDIR(mode)) {
+    enoent();
+    return 0;
+  }
+  if (TmpfsCheckAccess(dir, W_OK) == -1) return 0;
+  if (!dir->nlink) {
+    enoent();
+    return 0;
+  }
+  if (!(ino = TmpfsAllocNode(device, mode))) return 0;
+  node = device->nodes + ino;
+  if (size) {
+    if (TmpfsCopyIn(device, node, (const u8 *)data, 0, size) != size) {
+      TmpfsFreeNode(device, ino);
+      return 0;
+    }
+    node->size = size;
+  }
+  if (TmpfsAddEntry(device, dirinfo->ino, name, len, ino) == -1) {
+    TmpfsFreeNode(device, ino);
+    return 0;
+  }
+  if (S_ISDIR(mode)) {
+    node->nlink = 2;
+    node->parent = dirinfo->ino;
+    node->size = 2 * TMPFS_DIRENT_SIZE;
+    ++dir->nlink;
+  } else {
+    node->nlink = 1;
+  }
+  return ino;
+}
+
+static void TmpfsFillStat(struct TmpfsDevice *device, u32 ino, u64 dev,
+                          struct stat *st) {
+  struct TmpfsNode *node = device->nodes + ino;
+  memset(st, 0, sizeof(*st));
+  st->st_dev = dev;
+  st->st_ino = ino;
+  st->st_mode = node->mode;
+  st->st_nlink = node->nlink;
+  st->st_uid = node->uid;
+  st->st_gid = node->gid;
+  st->st_size = node->size;
+  st->st_blksize = device->super->pagesize;
+  st->st_blocks = (u64)node->pages * (device->super->pagesize / 512);
+  st->st_atim = node->atim;
+  st->st_mtim = node->mtim;
+  st->st_ctim = node->ctim;
+}
+
+// Creates an info for a node on the same device as `like`, which the
+// caller fills in.
+static int TmpfsNewInfo(struct VfsInfo *like, struct VfsInfo *parent,
+                        const char *name, size_t namelen,
+                        struct VfsInfo **output) {
+  struct TmpfsInfo *tmpfsinfo;
+  *output = NULL;
+  if (!(tmpfsinfo = (struct TmpfsInfo *)calloc(1, sizeof(*tmpfsinfo)))) {
+    return enomem();
+  }
+  dll_init(&tmpfsinfo->elem);
+  tmpfsinfo->device = ((struct TmpfsInfo *)like->data)->device;
+  if (VfsCreateInfo(output) == -1) {
+    free(tmpfsinfo);
+    return -1;
+  }
+  (*output)->data = tmpfsinfo;
+  unassert(!VfsAcquireDevice(like->device, &(*output)->device));
+  if (name) {
+    if (!((*output)->name = strndup(name, namelen))) {
+      unassert(!VfsFreeInfo(*output));
+      *output = NULL;
+      return enomem();
+    }
+    (*output)->namelen = namelen;
+  }
+  unassert(!VfsAcquireInfo(parent, &(*output)->parent));
+  (*output)->dev = like->dev;
+  return 0;
+}
+
+// Turns info into an open file, holding a handle on a new description.
+// @assume device locked and g_tmpfsstate.lock held
+static int TmpfsOpenFile(struct TmpfsInfo *tmpfsinfo, u32 ino, int flags) {
+  int e;
+  u32 file, handle;
+  struct TmpfsFile *f;
+  struct TmpfsDevice *device = tmpfsinfo->device;
+  if (!(file = TmpfsAllocFile(device))) return -1;
+  f = device->files + file;
+  f->refs = 0;
+  f->ino = ino;
+  f->cursor = 0;
+  f->offset = 0;
+  f->flags = flags & ~(O_CREAT | O_EXCL | O_TRUNC | O_NOCTTY);
+  ++device->nodes[ino].opens;
+  if (!(handle = TmpfsAllocHandle(device, file))) {
+    e = errno;
+    ++f->refs;
+    TmpfsReleaseFile(device, file);
+    errno = e;
+    return -1;
+  }
+  tmpfsinfo->ino = ino;
+  tmpfsinfo->gen = device->nodes[ino].gen;
+  tmpfsinfo->file = file;
+  tmpfsinfo->handle = handle;
+  dll_make_last(&g_tmpfsstate.opens, &tmpfsinfo->elem);
+  return 0;
+}
+
+static void TmpfsReleaseLocks(struct TmpfsInfo *tmpfsinfo) {
+  struct flock lock;
+  memset(&lock, 0, sizeof(lock));
+  lock.l_type = F_UNLCK;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = (off_t)tmpfsinfo->ino * TMPFS_LOCKSPAN * 2;
+  lock.l_len = TMPFS_LOCKSPAN * 2;
+  fcntl(tmpfsinfo->device->fd, F_SETLK, &lock);
+  tmpfsinfo->locked = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void TmpfsBeforeFork(void) {
+  LOCK(&g_tmpfsstate.lock);
+}
+
+static void TmpfsAfterForkParent(void) {
+  UNLOCK(&g_tmpfsstate.lock);
+}
+
+// The child inherits the open files of its parent, so it takes its
+// own handle on each of their descriptions.
+static void TmpfsAfterForkChild(void) {
+  u32 handle;
+  struct Dll *e;
+  struct TmpfsInfo *tmpfsinfo;
+  g_tmpfsstate.start = TmpfsGetStartTime(getpid());
+  for (e = dll_first(g_tmpfsstate.opens); e;
+       e = dll_next(g_tmpfsstate.opens, e)) {
+    tmpfsinfo = TMPFS_INFO_CONTAINER(e);
+    TmpfsLock(tmpfsinfo->device);
+    if ((handle = TmpfsAllocHandle(tmpfsinfo->device, tmpfsinfo->file))) {
+      tmpfsinfo->handle = handle;
+    } else {
+      LOGF("tmpfs ran out of handles during fork");
+    }
+    TmpfsUnlock(tmpfsinfo->device);
+    tmpfsinfo->locked = false;
+  }
+  UNLOCK(&g_tmpfsstate.lock);
+}
+
+static void TmpfsSetup(void) {
+  g_tmpfsstate.start = TmpfsGetStartTime(getpid());
+  unassert(!pthread_atfork(TmpfsBeforeFork, TmpfsAfterForkParent,
+                           TmpfsAfterForkChild));
+}
+
+static struct TmpfsDevice *TmpfsCreateArena(void) {
+  int fd;
+  size_t off, pagesize;
+  struct TmpfsNode *root;
+  struct TmpfsSuper *super;
+  struct TmpfsDevice *device;
+#ifdef TMPFS_PSHARED
+  pthread_mutexattr_t attr;
+#endif
+#ifndef HAVE_MEMFD_CREATE
+  char tmp[] = TMPFS_SHADOW;
+#endif
+  pagesize = FLAG_pagesize;
+  if (!(device = (struct TmpfsDevice *)calloc(1, sizeof(*device)))) {
+    enomem();
+    return NULL;
+  }
+  device->fd = -1;
+  device->base = (u8 *)MAP_FAILED;
+#ifdef HAVE_MEMFD_CREATE
+  fd = memfd_create("blink-tmpfs", MFD_CLOEXEC);
+#else
+  if ((fd = mkstemp(tmp)) != -1) unlink(tmp);
+#endif
+  if (fd == -1) goto cleananddie;
+  device->fd = fcntl(fd, F_DUPFD_CLOEXEC, kMinBlinkFd);
+  close(fd);
+  if (device->fd == -1) goto cleananddie;
+  device->size = kTmpfsSize / pagesize * pagesize;
+  if (ftruncate(device->fd, device->size) == -1) goto cleananddie;
+  device->base = (u8 *)mmap(NULL, device->size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, device->fd, 0);
+  if (device->base == MAP_FAILED) goto cleananddie;
+  super = (struct TmpfsSuper *)device->base;
+  off = ROUNDUP(sizeof(*super), pagesize);
+  super->nodes = off;
+  off += ROUNDUP(kTmpfsNodes * sizeof(struct TmpfsNode), pagesize);
+  super->dirents = off;
+  off += ROUNDUP(TMPFS_DIRENTS * sizeof(struct TmpfsDirent), pagesize);
+  super->files = off;
+  off += ROUNDUP(TMPFS_FILES * sizeof(struct TmpfsFile), pagesize);
+  super->handles = off;
+  off += ROUNDUP(TMPFS_HANDLES * sizeof(struct TmpfsHandle), pagesize);
+  super->buckets = off;
+  off += ROUNDUP(kTmpfsNodes * sizeof(u32), pagesize);
+  super->freepages = off;
+  off += ROUNDUP(device->size / pagesize * sizeof(u32), pagesize);
+  if (off >= device->size) {
+    ERRF("kTmpfsSize is too small");
+    einval();
+    goto cleananddie;
+  }
+  super->magic = TMPFS_MAGIC;
+  super->pagesize = pagesize;
+  super->npages = device->size / pagesize;
+  super->pagebrk = off / pagesize;
+  super->nodebrk = TMPFS_ROOT_INO + 1;
+  super->direntbrk = 1;
+  super->filebrk = 1;
+  super->handlebrk = 1;
+#ifdef TMPFS_PSHARED
+  unassert(!pthread_mutexattr_init(&attr));
+  unassert(!pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED));
+#ifdef TMPFS_ROBUST
+  unassert(!pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST));
+#endif
+  unassert(!pthread_mutex_init(&super->lock, &attr));
+  unassert(!pthread_mutexattr_destroy(&attr));
+#endif
+  device->super = super;
+  device->nodes = (struct TmpfsNode *)(device->base + super->nodes);
+  device->dirents = (struct TmpfsDirent *)(device->base + super->dirents);
+  device->files = (struct TmpfsFile *)(device->base + super->files);
+  device->handles = (struct TmpfsHandle *)(device->base + super->handles);
+  device->buckets = (u32 *)(device->base + super->buckets);
+  device->freepages = (u32 *)(device->base + super->freepages);
+  root = device->nodes + TMPFS_ROOT_INO;
+  root->mode = S_IFDIR | 01777;
+  root->nlink = 2;
+  root->uid = geteuid();
+  root->gid = getegid();
+  root->parent = TMPFS_ROOT_INO;
+  root->size = 2 * TMPFS_DIRENT_SIZE;
+  root->atim = root->mtim = root->ctim = GetTime();
+  return device;
+cleananddie:
+  if (device->base != MAP_FAILED) munmap(device->base, device->size);
+  if (device->fd != -1) close(device->fd);
+  free(device);
+  return NULL;
+}
+
+static int TmpfsInit(const char *source, u64 flags, const void *data,
+                     struct VfsDevice **device, struct VfsMount **mount) {
+  struct TmpfsDevice *tmpfsdevice;
+  struct TmpfsInfo *rootinfo = NULL;
+  unassert(!pthread_once_(&g_tmpfsstate.once, TmpfsSetup));
+  *device = NULL;
+  *mount = NULL;
+  if (!(tmpfsdevice = TmpfsCreateArena())) {
+    return -1;
+  }
+  if (VfsCreateDevice(device) == -1) {
+    goto cleananddie;
+  }
+  (*device)->data = tmpfsdevice;
+  (*device)->ops = &g_tmpfs.ops;
+  if (!(*mount = (struct VfsMount *)calloc(1, sizeof(struct VfsMount)))) {
+    enomem();
+    goto cleananddie;
+  }
+  if (!(rootinfo = (struct TmpfsInfo *)calloc(1, sizeof(*rootinfo)))) {
+    enomem();
+    goto cleananddie;
+  }
+  dll_init(&rootinfo->elem);
+  rootinfo->device = tmpfsdevice;
+  rootinfo->ino = TMPFS_ROOT_INO;
+  rootinfo->gen = tmpfsdevice->nodes[TMPFS_ROOT_INO].gen;
+  if (VfsCreateInfo(&(*mount)->root) == -1) {
+    goto cleananddie;
+  }
+  unassert(!VfsAcquireDevice(*device, &(*mount)->root->device));
+  (*mount)->root->data = rootinfo;
+  (*mount)->root->mode = S_IFDIR | 01777;
+  (*mount)->root->ino = TMPFS_ROOT_INO;
+  // Weak reference.
+  (*device)->root = (*mount)->root;
+  VFS_LOGF("Mounted a tmpfs device");
+  return 0;
+cleananddie:
+  if (*device) {
+    unassert(!VfsFreeDevice(*device));
+  } else {
+    munmap(tmpfsdevice->base, tmpfsdevice->size);
+    close(tmpfsdevice->fd);
+    free(tmpfsdevice);
+  }
+  if (*mount) {
+    if ((*mount)->root) {
+      unassert(!VfsFreeInfo((*mount)->root));
+    } else {
+      free(rootinfo);
+    }
+    free(*mount);
+  }
+  return -1;
+}
+
+static int TmpfsFreeInfo(void *data) {
+  struct TmpfsDevice *device;
+  struct TmpfsInfo *tmpfsinfo = (struct TmpfsInfo *)data;
+  if (!tmpfsinfo) return 0;
+  if (tmpfsinfo->handle) {
+    device = tmpfsinfo->device;
+    LOCK(&g_tmpfsstate.lock);
+    dll_remove(&g_tmpfsstate.opens, &tmpfsinfo->elem);
+    TmpfsLock(device);
+    if (device->handles[tmpfsinfo->handle].pid == getpid()) {
+      TmpfsReleaseHandle(device, tmpfsinfo->handle);
+    }
+    TmpfsUnlock(device);
+    UNLOCK(&g_tmpfsstate.lock);
+  }
+  free(tmpfsinfo);
+  return 0;
+}
+
+static int TmpfsFreeDevice(void *data) {
+  struct TmpfsDevice *device = (struct TmpfsDevice *)data;
+  if (!device) return 0;
+  munmap(device->base, device->size);
+  close(device->fd);
+  free(device);
+  return 0;
+}
+
+static int TmpfsReadmountentry(struct VfsDevice *device, char **spec,
+                               char **type, char **mntops) {
+  if (!(*spec = strdup("tmpfs"))) {
+    return enomem();
+  }
+  if (!(*type = strdup("tmpfs"))) {
+    free(*spec);
+    return enomem();
+  }
+  *mntops = NULL;
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int TmpfsFinddir(struct VfsInfo *parent, const char *name,
+                        struct VfsInfo **output) {
+  u32 ino;
+  bool isdir;
+  ssize_t len;
+  struct TmpfsInfo *tmpfsinfo;
+  struct TmpfsDevice *device;
+  VFS_LOGF("TmpfsFinddir(%p, \"%s\", %p)", parent, name, output);
+  if (parent == NULL || name == NULL || output == NULL) {
+    return efault();
+  }
+  if ((len = TmpfsLeaf(name, &isdir)) == -1) return -1;
+  if (!len) {
+    unassert(!VfsAcquireInfo(parent, output));
+    return 0;
+  }
+  if (TmpfsNewInfo(parent, parent, name, len, output) == -1) return -1;
+  tmpfsinfo = (struct TmpfsInfo *)(*output)->data;
+  device = tmpfsinfo->device;
+  TmpfsLock(device);
+  if ((ino = TmpfsFind(parent, name))) {
+    tmpfsinfo->ino = ino;
+    tmpfsinfo->gen = device->nodes[ino].gen;
+    (*output)->ino = ino;
+    (*output)->mode = device->nodes[ino].mode;
+  }
+  TmpfsUnlock(device);
+  if (!ino) {
+    unassert(!VfsFreeInfo(*output));
+    *output = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+static ssize_t TmpfsReadlink(struct VfsInfo *info, char **output) {
+  ssize_t rc;
+  struct TmpfsNode *node;
+  struct TmpfsDevice *device;
+  if (info == NULL || output == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)info->data)->device;
+  TmpfsLock(device);
+  if (!(node = TmpfsGetNode(info))) {
+    rc = -1;
+  } else if (!S_ISLNK(node->mode)) {
+    rc = einval();
+  } else if (!(*output = (char *)malloc(node->size + 1))) {
+    rc = enomem();
+  } else {
+    TmpfsCopyOut(device, node, (u8 *)*output, 0, node->size);
+    (*output)[node->size] = '\0';
+    rc = node->size;
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsMkdir(struct VfsInfo *parent, const char *name, mode_t mode) {
+  u32 ino;
+  struct TmpfsDevice *device;
+  VFS_LOGF("TmpfsMkdir(%p, \"%s\", %o)", parent, name, mode);
+  if (parent == NULL || name == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)parent->data)->device;
+  TmpfsLock(device);
+  ino = TmpfsCreate(parent, name, S_IFDIR | (mode & 07777 & ~TmpfsUmask()),
+                    NULL, 0);
+  TmpfsUnlock(device);
+  return ino ? 0 : -1;
+}
+
+// FIFOs are backed by a named pipe in a host directory, since readers
+// and writers need to block on each other.
+static int TmpfsMkfifo(struct VfsInfo *parent, const char *name,
+                       mode_t mode) {
+  u32 ino;
+  struct TmpfsDevice *device;
+  VFS_LOGF("TmpfsMkfifo(%p, \"%s\", %o)", parent, name, mode);
+  if (parent == NULL || name == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)parent->data)->device;
+  TmpfsLock(device);
+  ino = TmpfsCreate(parent, name, S_IFIFO | (mode & 07777 & ~TmpfsUmask()),
+                    NULL, 0);
+  TmpfsUnlock(device);
+  return ino ? 0 : -1;
+}
+
+static int TmpfsOpenFifo(const char *path, int flags,
+                         struct VfsInfo **output) {
+  int fd;
+  struct VfsInfo *info;
+  fd = open(path, flags & ~(O_CREAT | O_EXCL | O_TRUNC | O_DIRECTORY));
+  if (fd == -1 || HostfsWrapFd(fd, false, &info) == -1) {
+    if (fd != -1) close(fd);
+    unassert(!VfsFreeInfo(*output));
+    *output = NULL;
+    return -1;
+  }
+  info->parent = (*output)->parent;
+  info->name = (*output)->name;
+  info->namelen = (*output)->namelen;
+  info->dev = (*output)->dev;
+  info->ino = (*output)->ino;
+  (*output)->parent = NULL;
+  (*output)->name = NULL;
+  unassert(!VfsFreeInfo(*output));
+  *output = info;
+  return 0;
+}
+
+static int TmpfsOpen(struct VfsInfo *parent, const char *name, int flags,
+                     int mode, struct VfsInfo **output) {
+  u32 i, ino;
+  ssize_t len;
+  int accmode;
+  bool isdir, created;
+  struct TmpfsNode *dir, *node;
+  struct TmpfsDevice *device;
+  struct TmpfsInfo *dirinfo, *tmpfsinfo;
+  char path[VFS_PATH_MAX];
+  VFS_LOGF("TmpfsOpen(%p, \"%s\", %d, %o, %p)", parent, name, flags, mode,
+           output);
+  if (parent == NULL || name == NULL || output == NULL) {
+    return efault();
+  }
+  if ((len = TmpfsLeaf(name, &isdir)) == -1) return -1;
+  if (len) {
+    if (TmpfsNewInfo(parent, parent, name, len, output) == -1) return -1;
+  } else {
+    if (TmpfsNewInfo(parent, parent->parent, parent->name, parent->namelen,
+                     output) == -1) {
+      return -1;
+    }
+  }
+  dirinfo = (struct TmpfsInfo *)parent->data;
+  tmpfsinfo = (struct TmpfsInfo *)(*output)->data;
+  device = dirinfo->device;
+  accmode = flags & O_ACCMODE;
+  created = false;
+  LOCK(&g_tmpfsstate.lock);
+  TmpfsLock(device);
+  if (!(dir = TmpfsGetNode(parent))) goto unlockanddie;
+  if (!len) {
+    if (flags & O_CREAT) {
+      eisdir();
+      goto unlockanddie;
+    }
+    ino = dirinfo->ino;
+  } else {
+    if (!S_ISDIR(dir->mode)) {
+      enotdir();
+      goto unlockanddie;
+    }
+    if (TmpfsCheckAccess(dir, X_OK) == -1) goto unlockanddie;
+    if ((i = TmpfsLookup(device, dirinfo->ino, name, len))) {
+      if ((flags & O_CREAT) && (flags & O_EXCL)) {
+        eexist();
+        goto unlockanddie;
+      }
+      ino = device->dirents[i].ino;
+    } else {
+      if (!(flags & O_CREAT)) {
+        enoent();
+        goto unlockanddie;
+      }
+      if (isdir) {
+        eisdir();
+        goto unlockanddie;
+      }
+      if (!(ino = TmpfsCreate(parent, name,
+                              S_IFREG | (mode & 07777 & ~TmpfsUmask()), NULL,
+                              0))) {
+        goto unlockanddie;
+      }
+      created = true;
+    }
+  }
+  node = device->nodes + ino;
+  if (S_ISLNK(node->mode)) {
+    eloop();
+    goto unlockanddie;
+  }
+  if ((isdir || (flags & O_DIRECTORY)) && !S_ISDIR(node->mode)) {
+    enotdir();
+    goto unlockanddie;
+  }
+  if (S_ISDIR(node->mode) && (accmode != O_RDONLY || (flags & O_TRUNC))) {
+    eisdir();
+    goto unlockanddie;
+  }
+  if (S_ISSOCK(node->mode)) {
+    enxio();
+    goto unlockanddie;
+  }
+  if (!created && ((accmode != O_WRONLY &&
+                    TmpfsCheckAccess(node, R_OK) == -1) ||
+                   (accmode != O_RDONLY &&
+                    TmpfsCheckAccess(node, W_OK) == -1))) {
+    goto unlockanddie;
+  }
+  (*output)->ino = ino;
+  (*output)->mode = node->mode;
+  if (S_ISFIFO(node->mode)) {
+    if (TmpfsShadowPath(device, ino, path, true) == -1 ||
+        (mkfifo(path, 0600) == -1 && errno != EEXIST)) {
+      goto unlockanddie;
+    }
+    TmpfsUnlock(device);
+    UNLOCK(&g_tmpfsstate.lock);
+    return TmpfsOpenFifo(path, flags, output);
+  }
+  if ((flags & O_TRUNC) && accmode != O_RDONLY && S_ISREG(node->mode) &&
+      node->size) {
+    TmpfsResize(device, node, 0);
+  }
+  if (TmpfsOpenFile(tmpfsinfo, ino, flags) == -1) goto unlockanddie;
+  TmpfsUnlock(device);
+  UNLOCK(&g_tmpfsstate.lock);
+  return 0;
+unlockanddie:
+  TmpfsUnlock(device);
+  UNLOCK(&g_tmpfsstate.lock);
+  unassert(!VfsFreeInfo(*output));
+  *output = NULL;
+  return -1;
+}
+
+static int TmpfsAccess(struct VfsInfo *parent, const char *name, mode_t mode,
+                       int flags) {
+  u32 ino;
+  int rc = -1;
+  struct TmpfsDevice *device;
+  if (parent == NULL || name == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)parent->data)->device;
+  TmpfsLock(device);
+  if ((ino = TmpfsFind(parent, name))) {
+    rc = TmpfsCheckAccess(device->nodes + ino, mode & (R_OK | W_OK | X_OK));
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsStat(struct VfsInfo *parent, const char *name, struct stat *st,
+                     int flags) {
+  u32 ino;
+  struct TmpfsDevice *device;
+  if (parent == NULL || name == NULL || st == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)parent->data)->device;
+  TmpfsLock(device);
+  if ((ino = TmpfsFind(parent, name))) {
+    TmpfsFillStat(device, ino, parent->dev, st);
+  }
+  TmpfsUnlock(device);
+  return ino ? 0 : -1;
+}
+
+static int TmpfsFstat(struct VfsInfo *info, struct stat *st) {
+  struct TmpfsInfo *tmpfsinfo;
+  struct TmpfsNode *node;
+  if (info == NULL || st == NULL) {
+    return efault();
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  TmpfsLock(tmpfsinfo->device);
+  if ((node = TmpfsGetNode(info))) {
+    TmpfsFillStat(tmpfsinfo->device, tmpfsinfo->ino, info->dev, st);
+  }
+  TmpfsUnlock(tmpfsinfo->device);
+  return node ? 0 : -1;
+}
+
+static int TmpfsChmodNode(struct TmpfsNode *node, mode_t mode) {
+  if (!TmpfsIsOwner(node)) return eperm();
+  node->mode = (node->mode & S_IFMT) | (mode & 07777);
+  node->ctim = GetTime();
+  return 0;
+}
+
+static int TmpfsChmod(struct VfsInfo *parent, const char *name, mode_t mode,
+                      int flags) {
+  u32 ino;
+  int rc = -1;
+  struct TmpfsDevice *device;
+  if (parent == NULL || name == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)parent->data)->device;
+  TmpfsLock(device);
+  if ((ino = TmpfsFind(parent, name))) {
+    rc = TmpfsChmodNode(device->nodes + ino, mode);
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsFchmod(struct VfsInfo *info, mode_t mode) {
+  int rc = -1;
+  struct TmpfsNode *node;
+  struct TmpfsDevice *device;
+  if (info == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)info->data)->device;
+  TmpfsLock(device);
+  if ((node = TmpfsGetNode(info))) {
+    rc = TmpfsChmodNode(node, mode);
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsChownNode(struct TmpfsNode *node, uid_t uid, gid_t gid) {
+  uid_t euid = geteuid();
+  if (euid) {
+    if (euid != node->uid) return eperm();
+    if (uid != (uid_t)-1 && uid != node->uid) return eperm();
+    if (gid != (gid_t)-1 && gid != node->gid && gid != getegid()) {
+      return eperm();
+    }
+  }
+  if (uid != (uid_t)-1) node->uid = uid;
+  if (gid != (gid_t)-1) node->gid = gid;
+  if ((uid != (uid_t)-1 || gid != (gid_t)-1) && !S_ISDIR(node->mode)) {
+    node->mode &= ~S_ISUID;
+    if (node->mode & S_IXGRP) node->mode &= ~S_ISGID;
+  }
+  node->ctim = GetTime();
+  return 0;
+}
+
+static int TmpfsChown(struct VfsInfo *parent, const char *name, uid_t uid,
+                      gid_t gid, int flags) {
+  u32 ino;
+  int rc = -1;
+  struct TmpfsDevice *device;
+  if (parent == NULL || name == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)parent->data)->device;
+  TmpfsLock(device);
+  if ((ino = TmpfsFind(parent, name))) {
+    rc = TmpfsChownNode(device->nodes + ino, uid, gid);
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsFchown(struct VfsInfo *info, uid_t uid, gid_t gid) {
+  int rc = -1;
+  struct TmpfsNode *node;
+  struct TmpfsDevice *device;
+  if (info == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)info->data)->device;
+  TmpfsLock(device);
+  if ((node = TmpfsGetNode(info))) {
+    rc = TmpfsChownNode(node, uid, gid);
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsFtruncate(struct VfsInfo *info, off_t length) {
+  int rc;
+  struct TmpfsFile *file;
+  struct TmpfsNode *node;
+  struct TmpfsInfo *tmpfsinfo;
+  struct TmpfsDevice *device;
+  if (info == NULL) {
+    return efault();
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  if (!tmpfsinfo->handle) {
+    return ebadf();
+  }
+  if (length < 0) {
+    return einval();
+  }
+  device = tmpfsinfo->device;
+  TmpfsLock(device);
+  file = device->files + tmpfsinfo->file;
+  node = device->nodes + file->ino;
+  if ((file->flags & O_ACCMODE) == O_RDONLY || !S_ISREG(node->mode)) {
+    rc = einval();
+  } else if ((u64)length >
+             (u64)device->super->npages * device->super->pagesize * 1024) {
+    rc = efbig();
+  } else {
+    TmpfsResize(device, node, length);
+    rc = 0;
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsClose(struct VfsInfo *info) {
+  struct TmpfsInfo *tmpfsinfo;
+  if (info == NULL) {
+    return efault();
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  if (tmpfsinfo->locked) {
+    TmpfsReleaseLocks(tmpfsinfo);
+  }
+  return 0;
+}
+
+static int TmpfsLink(struct VfsInfo *oldparent, const char *oldname,
+                     struct VfsInfo *newparent, const char *newname,
+                     int flags) {
+  u32 ino;
+  bool isdir;
+  int rc = -1;
+  ssize_t len;
+  struct TmpfsNode *dir, *node;
+  struct TmpfsInfo *dirinfo;
+  struct TmpfsDevice *device;
+  if (oldparent == NULL || oldname == NULL || newparent == NULL ||
+      newname == NULL) {
+    return efault();
+  }
+  if (oldparent->device != newparent->device) {
+    return exdev();
+  }
+  if ((len = TmpfsLeaf(newname, &isdir)) == -1) return -1;
+  if (!len) return eexist();
+  dirinfo = (struct TmpfsInfo *)newparent->data;
+  device = dirinfo->device;
+  TmpfsLock(device);
+  if (!(ino = TmpfsFind(oldparent, oldname))) goto unlock;
+  node = device->nodes + ino;
+  if (S_ISDIR(node->mode)) {
+    eperm();
+    goto unlock;
+  }
+  if (!(dir = TmpfsGetNode(newparent))) goto unlock;
+  if (!S_ISDIR(dir->mode)) {
+    enotdir();
+    goto unlock;
+  }
+  if (TmpfsCheckAccess(dir, W_OK | X_OK) == -1) goto unlock;
+  if (!dir->nlink) {
+    enoent();
+    goto unlock;
+  }
+  if (TmpfsLookup(device, dirinfo->ino, newname, len)) {
+    eexist();
+    goto unlock;
+  }
+  if (isdir) {
+    enoent();
+    goto unlock;
+  }
+  if (TmpfsAddEntry(device, dirinfo->ino, newname, len, ino) == -1) {
+    goto unlock;
+  }
+  ++node->nlink;
+  node->ctim = GetTime();
+  rc = 0;
+unlock:
+  TmpfsUnlock(device);
+  return rc;
+}
+
+// Drops a link to node whose directory entry was removed.
+// @assume device locked
+static void TmpfsDropLink(struct TmpfsDevice *device, struct TmpfsNode *dir,
+                          u32 ino) {
+  struct TmpfsNode *node = device->nodes + ino;
+  if (S_ISDIR(node->mode)) {
+    node->nlink = 0;
+    --dir->nlink;
+  } else {
+    --node->nlink;
+  }
+  node->ctim = GetTime();
+  if (!node->nlink && node->opens) {
+    TmpfsSweep(device);
+  }
+  TmpfsMaybeFreeNode(device, ino);
+}
+
+static int TmpfsUnlink(struct VfsInfo *parent, const char *name, int flags) {
+  u32 i, ino;
+  bool isdir;
+  int rc = -1;
+  ssize_t len;
+  struct TmpfsNode *dir, *node;
+  struct TmpfsInfo *dirinfo;
+  struct TmpfsDevice *device;
+  VFS_LOGF("TmpfsUnlink(%p, \"%s\", %d)", parent, name, flags);
+  if (parent == NULL || name == NULL) {
+    return efault();
+  }
+  if ((len = TmpfsLeaf(name, &isdir)) == -1) return -1;
+  if (!len) return (flags & AT_REMOVEDIR) ? ebusy() : eisdir();
+  dirinfo = (struct TmpfsInfo *)parent->data;
+  device = dirinfo->device;
+  TmpfsLock(device);
+  if (!(dir = TmpfsGetNode(parent))) goto unlock;
+  if (!S_ISDIR(dir->mode)) {
+    enotdir();
+    goto unlock;
+  }
+  if (TmpfsCheckAccess(dir, X_OK) == -1) goto unlock;
+  if (!(i = TmpfsLookup(device, dirinfo->ino, name, len))) {
+    enoent();
+    goto unlock;
+  }
+  ino = device->dirents[i].ino;
+  node = device->nodes + ino;
+  if (flags & AT_REMOVEDIR) {
+    if (!S_ISDIR(node->mode)) {
+      enotdir();
+      goto unlock;
+    }
+    if (node->first) {
+      enotempty();
+      goto unlock;
+    }
+  } else if (S_ISDIR(node->mode)) {
+    eisdir();
+    goto unlock;
+  } else if (isdir) {
+    enotdir();
+    goto unlock;
+  }
+  if (TmpfsCheckAccess(dir, W_OK) == -1) goto unlock;
+  if (TmpfsCheckSticky(dir, node) == -1) goto unlock;
+  TmpfsRemoveEntry(device, i);
+  TmpfsDropLink(device, dir, ino);
+  rc = 0;
+unlock:
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsRename(struct VfsInfo *oldparent, const char *oldname,
+                       struct VfsInfo *newparent, const char *newname) {
+  int rc = -1;
+  bool oldisdir, newisdir;
+  ssize_t oldlen, newlen;
+  u32 p, oi, ni, ino, victim;
+  struct TmpfsNode *od, *nd, *node, *target;
+  struct TmpfsInfo *olddirinfo, *newdirinfo;
+  struct TmpfsDevice *device;
+  VFS_LOGF("TmpfsRename(%p, \"%s\", %p, \"%s\")", oldparent, oldname,
+           newparent, newname);
+  if (oldparent == NULL || oldname == NULL || newparent == NULL ||
+      newname == NULL) {
+    return efault();
+  }
+  if (oldparent->device != newparent->device) {
+    return exdev();
+  }
+  if ((oldlen = TmpfsLeaf(oldname, &oldisdir)) == -1) return -1;
+  if ((newlen = TmpfsLeaf(newname, &newisdir)) == -1) return -1;
+  if (!oldlen || !newlen) return ebusy();
+  olddirinfo = (struct TmpfsInfo *)oldparent->data;
+  newdirinfo = (struct TmpfsInfo *)newparent->data;
+  device = olddirinfo->device;
+  TmpfsLock(device);
+  if (!(od = TmpfsGetNode(oldparent)) || !(nd = TmpfsGetNode(newparent))) {
+    goto unlock;
+  }
+  if (!S_ISDIR(od->mode) || !S_ISDIR(nd->mode)) {
+    enotdir();
+    goto unlock;
+  }
+  if (TmpfsCheckAccess(od, W_OK | X_OK) == -1 ||
+      TmpfsCheckAccess(nd, W_OK | X_OK) == -1) {
+    goto unlock;
+  }
+  if (!(oi = TmpfsLookup(device, olddirinfo->ino, oldname, oldlen))) {
+    enoent();
+    goto unlock;
+  }
+  ino = device->dirents[oi].ino;
+  node = device->nodes + ino;
+  if ((oldisdir || newisdir) && !S_ISDIR(node->mode)) {
+    enotdir();
+    goto unlock;
+  }
+  ni = TmpfsLookup(device, newdirinfo->ino, newname, newlen);
+  if (ni && device->dirents[ni].ino == ino) {
+    rc = 0;
+    goto unlock;
+  }
+  if (TmpfsCheckSticky(od, node) == -1) goto unlock;
+  if (S_ISDIR(node->mode)) {
+    for (p = newdirinfo->ino;; p = device->nodes[p].parent) {
+      if (p == ino) {
+        einval();
+        goto unlock;
+      }
+      if (p == TMPFS_ROOT_INO) break;
+    }
+  }
+  victim = 0;
+  target = NULL;
+  if (ni) {
+    victim = device->dirents[ni].ino;
+    target = device->nodes + victim;
+    if (TmpfsCheckSticky(nd, target) == -1) goto unlock;
+    if (S_ISDIR(node->mode)) {
+      if (!S_ISDIR(target->mode)) {
+        enotdir();
+        goto unlock;
+      }
+      if (target->first) {
+        enotempty();
+        goto unlock;
+      }
+    } else if (S_ISDIR(target->mode)) {
+      eisdir();
+      goto unlock;
+    }
+  }
+  if (!nd->nlink) {
+    enoent();
+    goto unlock;
+  }
+  if (ni) {
+    // removing the old entry first guarantees the new one fits
+    TmpfsRemoveEntry(device, ni);
+    unassert(!TmpfsAddEntry(device, newdirinfo->ino, newname, newlen, ino));
+  } else if (TmpfsAddEntry(device, newdirinfo->ino, newname, newlen, ino) ==
+             -1) {
+    goto unlock;
+  }
+  TmpfsRemoveEntry(device, oi);
+  if (S_ISDIR(node->mode) && olddirinfo->ino != newdirinfo->ino) {
+    node->parent = newdirinfo->ino;
+    --od->nlink;
+    ++nd->nlink;
+  }
+  node->ctim = GetTime();
+  if (victim) {
+    TmpfsDropLink(device, nd, victim);
+  }
+  rc = 0;
+unlock:
+  TmpfsUnlock(device);
+  return rc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Reads or writes at offset, or at the file position if offset is -1.
+static ssize_t TmpfsTransfer(struct VfsInfo *info, const struct iovec *iov,
+                             int iovcnt, off_t offset, bool write) {
+  int i;
+  u64 pos;
+  size_t n;
+  ssize_t total;
+  struct TmpfsFile *file;
+  struct TmpfsNode *node;
+  struct TmpfsInfo *tmpfsinfo;
+  struct TmpfsDevice *device;
+  if (info == NULL || (iovcnt && iov == NULL)) {
+    return efault();
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  if (!tmpfsinfo->handle) {
+    return ebadf();
+  }
+  if (iovcnt < 0) {
+    return einval();
+  }
+  device = tmpfsinfo->device;
+  TmpfsLock(device);
+  file = device->files + tmpfsinfo->file;
+  node = device->nodes + file->ino;
+  if (S_ISDIR(node->mode)) {
+    TmpfsUnlock(device);
+    return eisdir();
+  }
+  if ((file->flags & O_ACCMODE) == (write ? O_RDONLY : O_WRONLY)) {
+    TmpfsUnlock(device);
+    return ebadf();
+  }
+  pos = offset == -1 ? file->offset : (u64)offset;
+  if (write && (file->flags & O_APPEND)) {
+    pos = node->size;
+  }
+  for (total = i = 0; i < iovcnt; ++i) {
+    if (!iov[i].iov_len) continue;
+    if (write) {
+      n = TmpfsCopyIn(device, node, (const u8 *)iov[i].iov_base, pos,
+                      iov[i].iov_len);
+      pos += n;
+      total += n;
+      if (pos > node->size) node->size = pos;
+      if (n < iov[i].iov_len) {
+        if (!total) total = -1;
+        break;
+      }
+    } else {
+      if (pos >= node->size) break;
+      n = MIN(iov[i].iov_len, node->size - pos);
+      TmpfsCopyOut(device, node, (u8 *)iov[i].iov_base, pos, n);
+      pos += n;
+      total += n;
+      if (n < iov[i].iov_len) break;
+    }
+  }
+  if (total > 0) {
+    if (write) {
+      node->mtim = node->ctim = GetTime();
+    } else if (node->atim.tv_sec <= node->mtim.tv_sec) {
+      node->atim = GetTime();
+    }
+    if (offset == -1) {
+      file->offset = pos;
+    }
+  }
+  TmpfsUnlock(device);
+  return total;
+}
+
+static ssize_t TmpfsRead(struct VfsInfo *info, void *buf, size_t size) {
+  struct iovec iov = {buf, size};
+  return TmpfsTransfer(info, &iov, 1, -1, false);
+}
+
+static ssize_t TmpfsWrite(struct VfsInfo *info, const void *buf, size_t size) {
+  struct iovec iov = {(void *)buf, size};
+  return TmpfsTransfer(info, &iov, 1, -1, true);
+}
+
+static ssize_t TmpfsPread(struct VfsInfo *info, void *buf, size_t size,
+                          off_t offset) {
+  struct iovec iov = {buf, size};
+  if (offset < 0) return einval();
+  return TmpfsTransfer(info, &iov, 1, offset, false);
+}
+
+static ssize_t TmpfsPwrite(struct VfsInfo *info, const void *buf, size_t size,
+                           off_t offset) {
+  struct iovec iov = {(void *)buf, size};
+  if (offset < 0) return einval();
+  return TmpfsTransfer(info, &iov, 1, offset, true);
+}
+
+static ssize_t TmpfsReadv(struct VfsInfo *info, const struct iovec *iov,
+                          int iovcnt) {
+  return TmpfsTransfer(info, iov, iovcnt, -1, false);
+}
+
+static ssize_t TmpfsWritev(struct VfsInfo *info, const struct iovec *iov,
+                           int iovcnt) {
+  return TmpfsTransfer(info, iov, iovcnt, -1, true);
+}
+
+static ssize_t TmpfsPreadv(struct VfsInfo *info, const struct iovec *iov,
+                           int iovcnt, off_t offset) {
+  if (offset < 0) return einval();
+  return TmpfsTransfer(info, iov, iovcnt, offset, false);
+}
+
+static ssize_t TmpfsPwritev(struct VfsInfo *info, const struct iovec *iov,
+                            int iovcnt, off_t offset) {
+  if (offset < 0) return einval();
+  return TmpfsTransfer(info, iov, iovcnt, offset, true);
+}
+
+static off_t TmpfsSeek(struct VfsInfo *info, off_t offset, int whence) {
+  i64 base;
+  off_t rc;
+  struct TmpfsFile *file;
+  struct TmpfsNode *node;
+  struct TmpfsInfo *tmpfsinfo;
+  struct TmpfsDevice *device;
+  if (info == NULL) {
+    return efault();
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  if (!tmpfsinfo->handle) {
+    return ebadf();
+  }
+  device = tmpfsinfo->device;
+  TmpfsLock(device);
+  file = device->files + tmpfsinfo->file;
+  node = device->nodes + file->ino;
+  switch (whence) {
+    case SEEK_SET:
+      base = 0;
+      break;
+    case SEEK_CUR:
+      base = file->offset;
+      break;
+    case SEEK_END:
+      base = node->size;
+      break;
+#ifdef SEEK_DATA
+    case SEEK_DATA:
+    case SEEK_HOLE:
+      if (offset < 0 || (u64)offset >= node->size) {
+        TmpfsUnlock(device);
+        return enxio();
+      }
+      base = 0;
+      if (whence == SEEK_HOLE) offset = node->size;
+      break;
+#endif
+    default:
+      TmpfsUnlock(device);
+      return einval();
+  }
+  if ((offset > 0 && base > INT64_MAX - offset) || base + offset < 0) {
+    rc = einval();
+  } else {
+    rc = file->offset = base + offset;
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsFsync(struct VfsInfo *info) {
+  if (info == NULL) {
+    return efault();
+  }
+  return 0;
+}
+
+static int TmpfsFdatasync(struct VfsInfo *info) {
+  if (info == NULL) {
+    return efault();
+  }
+  return 0;
+}
+
+#ifdef HAVE_FALLOCATE
+static int TmpfsFallocate(struct VfsInfo *info, int mode, off_t offset,
+                          off_t len) {
+  u64 i, pagesize;
+  int rc = 0;
+  struct TmpfsFile *file;
+  struct TmpfsNode *node;
+  struct TmpfsInfo *tmpfsinfo;
+  struct TmpfsDevice *device;
+  if (info == NULL) {
+    return efault();
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  if (!tmpfsinfo->handle) {
+    return ebadf();
+  }
+  if (offset < 0 || len <= 0 || offset > INT64_MAX - len) {
+    return einval();
+  }
+#ifdef FALLOC_FL_PUNCH_HOLE
+  if (mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE)) {
+    return eopnotsupp();
+  }
+  if ((mode & FALLOC_FL_PUNCH_HOLE) && !(mode & FALLOC_FL_KEEP_SIZE)) {
+    return einval();
+  }
+#else
+  if (mode) {
+    return eopnotsupp();
+  }
+#endif
+  device = tmpfsinfo->device;
+  pagesize = device->super->pagesize;
+  TmpfsLock(device);
+  file = device->files + tmpfsinfo->file;
+  node = device->nodes + file->ino;
+  if ((file->flags & O_ACCMODE) == O_RDONLY) {
+    rc = ebadf();
+  } else if (!S_ISREG(node->mode)) {
+    rc = S_ISDIR(node->mode) ? eisdir() : enodev();
+#ifdef FALLOC_FL_PUNCH_HOLE
+  } else if (mode & FALLOC_FL_PUNCH_HOLE) {
+    if ((u64)offset < node->size) {
+      TmpfsZeroRange(device, node, offset, MIN(len, node->size - offset));
+    }
+#endif
+  } else {
+    for (i = offset / pagesize; i <= (u64)(offset + len - 1) / pagesize; ++i) {
+      if (!TmpfsGetBlock(device, node, i, true)) {
+        rc = -1;
+        break;
+      }
+    }
+    if (!rc && !(mode & FALLOC_FL_KEEP_SIZE) &&
+        (u64)(offset + len) > node->size) {
+      node->size = offset + len;
+    }
+  }
+  if (!rc) {
+    node->mtim = node->ctim = GetTime();
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+#endif
+
+#ifdef HAVE_POSIX_FADVISE
+static int TmpfsFadvise(struct VfsInfo *info, off_t offset, off_t len,
+                        int advice) {
+  if (info == NULL) {
+    return efault();
+  }
+  return 0;
+}
+#endif
+
+// Advisory locks are delegated to the host kernel by locking a range of
+// the arena file reserved for the inode, which gives them the expected
+// per-process semantics across every blink process sharing the mount.
+static int TmpfsRecordLock(struct VfsInfo *info, int cmd,
+                           struct flock *lock) {
+  int rc;
+  off_t start, base;
+  struct flock hostlock;
+  struct TmpfsInfo *tmpfsinfo = (struct TmpfsInfo *)info->data;
+  struct TmpfsDevice *device = tmpfsinfo->device;
+  if (lock == NULL) {
+    return efault();
+  }
+  TmpfsLock(device);
+  switch (lock->l_whence) {
+    case SEEK_SET:
+      start = lock->l_start;
+      break;
+    case SEEK_CUR:
+      start = device->files[tmpfsinfo->file].offset + lock->l_start;
+      break;
+    case SEEK_END:
+      start = device->nodes[tmpfsinfo->ino].size + lock->l_start;
+      break;
+    default:
+      start = -1;
+      break;
+  }
+  TmpfsUnlock(device);
+  if (start < 0 || start >= TMPFS_LOCKSPAN || lock->l_len < 0 ||
+      lock->l_len > TMPFS_LOCKSPAN - start) {
+    return einval();
+  }
+  base = (off_t)tmpfsinfo->ino * TMPFS_LOCKSPAN * 2;
+  hostlock = *lock;
+  hostlock.l_whence = SEEK_SET;
+  hostlock.l_start = base + start;
+  hostlock.l_len = lock->l_len ? lock->l_len : TMPFS_LOCKSPAN - start;
+  if ((rc = fcntl(device->fd, cmd, &hostlock)) != -1) {
+    if (cmd == F_GETLK) {
+      lock->l_type = hostlock.l_type;
+      if (hostlock.l_type != F_UNLCK) {
+        lock->l_whence = SEEK_SET;
+        lock->l_start = hostlock.l_start - base;
+        lock->l_len = hostlock.l_start + hostlock.l_len == base + TMPFS_LOCKSPAN
+                          ? 0
+                          : hostlock.l_len;
+        lock->l_pid = hostlock.l_pid;
+      }
+    } else if (lock->l_type != F_UNLCK) {
+      tmpfsinfo->locked = true;
+    }
+  }
+  return rc;
+}
+
+static int TmpfsFlock(struct VfsInfo *info, int operation) {
+  int rc;
+  struct flock lock;
+  struct TmpfsInfo *tmpfsinfo;
+  if (info == NULL) {
+    return efault();
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  if (!tmpfsinfo->handle) {
+    return ebadf();
+  }
+  memset(&lock, 0, sizeof(lock));
+  switch (operation & ~LOCK_NB) {
+    case LOCK_SH:
+      lock.l_type = F_RDLCK;
+      break;
+    case LOCK_EX:
+      lock.l_type = F_WRLCK;
+      break;
+    case LOCK_UN:
+      lock.l_type = F_UNLCK;
+      break;
+    default:
+      return einval();
+  }
+  lock.l_whence = SEEK_SET;
+  lock.l_start = (off_t)tmpfsinfo->ino * TMPFS_LOCKSPAN * 2 + TMPFS_LOCKSPAN;
+  lock.l_len = 1;
+  rc = fcntl(tmpfsinfo->device->fd, (operation & LOCK_NB) ? F_SETLK : F_SETLKW,
+             &lock);
+  if (rc == -1 && errno == EACCES) {
+    errno = EWOULDBLOCK;
+  } else if (rc != -1 && lock.l_type != F_UNLCK) {
+    tmpfsinfo->locked = true;
+  }
+  return rc;
+}
+
+static int TmpfsFcntl(struct VfsInfo *info, int cmd, va_list args) {
+  int rc, flags;
+  struct TmpfsFile *file;
+  struct TmpfsInfo *tmpfsinfo;
+  if (info == NULL) {
+    return efault();
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  if (!tmpfsinfo->handle) {
+    return ebadf();
+  }
+  if (cmd == F_GETFD) {
+    return tmpfsinfo->fdflags;
+  } else if (cmd == F_SETFD) {
+    tmpfsinfo->fdflags = va_arg(args, int);
+    return 0;
+  } else if (cmd == F_GETFL) {
+    TmpfsLock(tmpfsinfo->device);
+    rc = tmpfsinfo->device->files[tmpfsinfo->file].flags;
+    TmpfsUnlock(tmpfsinfo->device);
+    return rc;
+  } else if (cmd == F_SETFL) {
+    flags = va_arg(args, int) & (O_APPEND | O_NONBLOCK);
+    TmpfsLock(tmpfsinfo->device);
+    file = tmpfsinfo->device->files + tmpfsinfo->file;
+    file->flags = (file->flags & ~(O_APPEND | O_NONBLOCK)) | flags;
+    TmpfsUnlock(tmpfsinfo->device);
+    return 0;
+  } else if (cmd == F_SETLK || cmd == F_SETLKW || cmd == F_GETLK) {
+    return TmpfsRecordLock(info, cmd, va_arg(args, struct flock *));
+  } else {
+    return einval();
+  }
+}
+
+static int TmpfsDup(struct VfsInfo *info, struct VfsInfo **newinfo) {
+  u32 handle;
+  struct TmpfsInfo *tmpfsinfo, *newtmpfsinfo;
+  if (info == NULL || newinfo == NULL) {
+    return efault();
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  if (TmpfsNewInfo(info, info->parent, info->name, info->namelen, newinfo) ==
+      -1) {
+    return -1;
+  }
+  newtmpfsinfo = (struct TmpfsInfo *)(*newinfo)->data;
+  newtmpfsinfo->ino = tmpfsinfo->ino;
+  newtmpfsinfo->gen = tmpfsinfo->gen;
+  (*newinfo)->ino = info->ino;
+  (*newinfo)->mode = info->mode;
+  if (tmpfsinfo->handle) {
+    LOCK(&g_tmpfsstate.lock);
+    TmpfsLock(tmpfsinfo->device);
+    if ((handle = TmpfsAllocHandle(tmpfsinfo->device, tmpfsinfo->file))) {
+      newtmpfsinfo->file = tmpfsinfo->file;
+      newtmpfsinfo->handle = handle;
+      newtmpfsinfo->locked = tmpfsinfo->locked;
+      dll_make_last(&g_tmpfsstate.opens, &newtmpfsinfo->elem);
+    }
+    TmpfsUnlock(tmpfsinfo->device);
+    UNLOCK(&g_tmpfsstate.lock);
+    if (!handle) {
+      unassert(!VfsFreeInfo(*newinfo));
+      *newinfo = NULL;
+      return -1;
+    }
+  }
+  return 0;
+}
+
+#ifdef HAVE_DUP3
+static int TmpfsDup3(struct VfsInfo *info, struct VfsInfo **newinfo,
+                     int flags) {
+  if (TmpfsDup(info, newinfo) == -1) return -1;
+  if (flags & O_CLOEXEC) {
+    ((struct TmpfsInfo *)(*newinfo)->data)->fdflags = FD_CLOEXEC;
+  }
+  return 0;
+}
+#endif
+
+// Files in memory never block.
+static int TmpfsPoll(struct VfsInfo **infos, struct pollfd *fds, nfds_t nfds,
+                     int timeout) {
+  nfds_t i;
+  int rc = 0;
+  for (i = 0; i < nfds; ++i) {
+    fds[i].revents = fds[i].events & (POLLIN | POLLOUT | POLLRDNORM |
+                                      POLLWRNORM);
+    rc += !!fds[i].revents;
+  }
+  return rc;
+}
+
+static int TmpfsOpendir(struct VfsInfo *info, struct VfsInfo **output) {
+  if (info == NULL || output == NULL) {
+    return efault();
+  }
+  if (!S_ISDIR(info->mode)) {
+    return enotdir();
+  }
+  if (!((struct TmpfsInfo *)info->data)->handle) {
+    return ebadf();
+  }
+  unassert(!VfsAcquireInfo(info, output));
+  return 0;
+}
+
+#ifdef HAVE_SEEKDIR
+static void TmpfsSeekdir(struct VfsInfo *info, long loc) {
+  struct TmpfsInfo *tmpfsinfo = (struct TmpfsInfo *)info->data;
+  TmpfsLock(tmpfsinfo->device);
+  tmpfsinfo->device->files[tmpfsinfo->file].offset = loc;
+  TmpfsUnlock(tmpfsinfo->device);
+}
+
+static long TmpfsTelldir(struct VfsInfo *info) {
+  long rc;
+  struct TmpfsInfo *tmpfsinfo = (struct TmpfsInfo *)info->data;
+  TmpfsLock(tmpfsinfo->device);
+  rc = tmpfsinfo->device->files[tmpfsinfo->file].offset;
+  TmpfsUnlock(tmpfsinfo->device);
+  return rc;
+}
+#endif
+
+static u8 TmpfsDirentType(u32 mode) {
+  switch (mode & S_IFMT) {
+    case S_IFDIR:
+      return DT_DIR;
+    case S_IFREG:
+      return DT_REG;
+    case S_IFLNK:
+      return DT_LNK;
+    case S_IFIFO:
+      return DT_FIFO;
+    case S_IFSOCK:
+      return DT_SOCK;
+    default:
+      return DT_UNKNOWN;
+  }
+}
+
+// Directory stream positions 0 and 1 are "." and "..", after which
+// entry serials are used, so positions stay valid as entries change.
+static struct dirent *TmpfsReaddir(struct VfsInfo *info) {
+  static _Thread_local char buf[sizeof(struct dirent) + VFS_NAME_MAX];
+  u64 pos;
+  u32 i, ino;
+  const char *name;
+  struct TmpfsFile *file;
+  struct TmpfsNode *dir;
+  struct TmpfsDirent *d;
+  struct TmpfsInfo *tmpfsinfo;
+  struct TmpfsDevice *device;
+  struct dirent *de = (struct dirent *)buf;
+  if (info == NULL) {
+    efault();
+    return NULL;
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  device = tmpfsinfo->device;
+  TmpfsLock(device);
+  file = device->files + tmpfsinfo->file;
+  dir = device->nodes + file->ino;
+  pos = file->offset;
+  if (pos == 0) {
+    ino = file->ino;
+    name = ".";
+    pos = 1;
+  } else if (pos == 1) {
+    ino = dir->parent;
+    name = "..";
+    pos = 2;
+  } else {
+    i = file->cursor;
+    d = device->dirents + i;
+    if (i && d->ino && d->parent == file->ino && d->serial == pos - 2) {
+      i = d->next;
+    } else {
+      for (i = dir->first; i && device->dirents[i].serial <= pos - 2;
+           i = device->dirents[i].next) {
+      }
+    }
+    if (!i) {
+      TmpfsUnlock(device);
+      return NULL;
+    }
+    d = device->dirents + i;
+    ino = d->ino;
+    name = d->name;
+    pos = d->serial + 2;
+    file->cursor = i;
+  }
+  de->d_ino = ino;
+  de->d_type = TmpfsDirentType(device->nodes[ino].mode);
+  strcpy(de->d_name, name);
+  file->offset = pos;
+  TmpfsUnlock(device);
+  return de;
+}
+
+static void TmpfsRewinddir(struct VfsInfo *info) {
+  struct TmpfsInfo *tmpfsinfo = (struct TmpfsInfo *)info->data;
+  TmpfsLock(tmpfsinfo->device);
+  tmpfsinfo->device->files[tmpfsinfo->file].offset = 0;
+  TmpfsUnlock(tmpfsinfo->device);
+}
+
+static int TmpfsClosedir(struct VfsInfo *info) {
+  if (info == NULL) {
+    return efault();
+  }
+  unassert(!VfsFreeInfo(info));
+  return 0;
+}
+
+// Unix sockets are bound to a path in a host directory, so the host
+// kernel does the connecting, while the name lives in the tmpfs.
+static int TmpfsBind(struct VfsInfo *info, const struct sockaddr *addr,
+                     socklen_t addrlen) {
+  u32 ino;
+  bool isdir;
+  int rc = -1;
+  ssize_t len;
+  struct VfsDevice *anon;
+  struct sockaddr_un hostun;
+  struct TmpfsNode *dir;
+  struct HostfsInfo *hostinfo;
+  struct TmpfsInfo *dirinfo;
+  struct TmpfsDevice *device;
+  char path[VFS_PATH_MAX];
+  if (info == NULL || addr == NULL || info->parent == NULL) {
+    return efault();
+  }
+  hostinfo = (struct HostfsInfo *)info->data;
+  dirinfo = (struct TmpfsInfo *)info->parent->data;
+  device = dirinfo->device;
+  if ((len = TmpfsLeaf(info->name, &isdir)) == -1) return -1;
+  if (!len || isdir) return einval();
+  TmpfsLock(device);
+  if (!(dir = TmpfsGetNode(info->parent))) goto unlock;
+  if (!S_ISDIR(dir->mode)) {
+    enotdir();
+    goto unlock;
+  }
+  if (TmpfsCheckAccess(dir, W_OK | X_OK) == -1) goto unlock;
+  if (!dir->nlink) {
+    enoent();
+    goto unlock;
+  }
+  if (TmpfsLookup(device, dirinfo->ino, info->name, len)) {
+    errno = EADDRINUSE;
+    goto unlock;
+  }
+  if (!(ino = TmpfsAllocNode(device, S_IFSOCK | (0777 & ~TmpfsUmask())))) {
+    goto unlock;
+  }
+  memset(&hostun, 0, sizeof(hostun));
+  hostun.sun_family = AF_UNIX;
+  if (TmpfsShadowPath(device, ino, path, true) == -1 ||
+      (strlen(path) >= sizeof(hostun.sun_path) && enametoolong())) {
+    TmpfsFreeNode(device, ino);
+    goto unlock;
+  }
+  strcpy(hostun.sun_path, path);
+  if (bind(hostinfo->filefd, (struct sockaddr *)&hostun, sizeof(hostun)) ==
+          -1 ||
+      TmpfsAddEntry(device, dirinfo->ino, info->name, len, ino) == -1) {
+    TmpfsFreeNode(device, ino);
+    goto unlock;
+  }
+  device->nodes[ino].nlink = 1;
+  info->ino = ino;
+  info->mode = device->nodes[ino].mode;
+  info->dev = info->parent->dev;
+  rc = 0;
+unlock:
+  TmpfsUnlock(device);
+  if (rc == -1) return -1;
+  hostinfo->socketfamily = AF_UNIX;
+  if ((hostinfo->socketaddr = (struct sockaddr *)malloc(addrlen))) {
+    memcpy(hostinfo->socketaddr, addr, addrlen);
+    hostinfo->socketaddrlen = addrlen;
+  }
+  // the socket itself remains a host socket
+  unassert(!VfsAcquireDevice(&g_anondevice, &anon));
+  unassert(!VfsFreeDevice(info->device));
+  info->device = anon;
+  return 0;
+}
+
+ssize_t TmpfsGetHostPath(struct VfsInfo *info, char output[VFS_PATH_MAX]) {
+  int rc = -1;
+  struct TmpfsNode *node;
+  struct TmpfsInfo *tmpfsinfo;
+  if (info == NULL) {
+    return efault();
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  TmpfsLock(tmpfsinfo->device);
+  if ((node = TmpfsGetNode(info))) {
+    if (S_ISSOCK(node->mode) || S_ISFIFO(node->mode)) {
+      rc = TmpfsShadowPath(tmpfsinfo->device, tmpfsinfo->ino, output, false);
+    } else {
+      errno = ECONNREFUSED;
+    }
+  }
+  TmpfsUnlock(tmpfsinfo->device);
+  return rc == -1 ? -1 : (ssize_t)strlen(output);
+}
+
+static int TmpfsUtimeNode(struct TmpfsNode *node,
+                          const struct timespec times[2]) {
+  struct timespec now;
+  bool setnow = !times || (times[0].tv_nsec == UTIME_NOW &&
+                           times[1].tv_nsec == UTIME_NOW);
+  if (times && times[0].tv_nsec == UTIME_OMIT &&
+      times[1].tv_nsec == UTIME_OMIT) {
+    return 0;
+  }
+  if (!TmpfsIsOwner(node)) {
+    if (!setnow) return eperm();
+    if (TmpfsCheckAccess(node, W_OK) == -1) return -1;
+  }
+  now = GetTime();
+  if (!times || times[0].tv_nsec == UTIME_NOW) {
+    node->atim = now;
+  } else if (times[0].tv_nsec != UTIME_OMIT) {
+    node->atim = times[0];
+  }
+  if (!times || times[1].tv_nsec == UTIME_NOW) {
+    node->mtim = now;
+  } else if (times[1].tv_nsec != UTIME_OMIT) {
+    node->mtim = times[1];
+  }
+  node->ctim = now;
+  return 0;
+}
+
+static int TmpfsUtime(struct VfsInfo *parent, const char *name,
+                      const struct timespec times[2], int flags) {
+  u32 ino;
+  int rc = -1;
+  struct TmpfsDevice *device;
+  if (parent == NULL || name == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)parent->data)->device;
+  TmpfsLock(device);
+  if ((ino = TmpfsFind(parent, name))) {
+    rc = TmpfsUtimeNode(device->nodes + ino, times);
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsFutime(struct VfsInfo *info, const struct timespec times[2]) {
+  int rc = -1;
+  struct TmpfsNode *node;
+  struct TmpfsDevice *device;
+  if (info == NULL) {
+    return efault();
+  }
+  device = ((struct TmpfsInfo *)info->data)->device;
+  TmpfsLock(device);
+  if ((node = TmpfsGetNode(info))) {
+    rc = TmpfsUtimeNode(node, times);
+  }
+  TmpfsUnlock(device);
+  return rc;
+}
+
+static int TmpfsSymlink(const char *target, struct VfsInfo *parent,
+                        const char *name) {
+  u32 ino;
+  struct TmpfsDevice *device;
+  VFS_LOGF("TmpfsSymlink(\"%s\", %p, \"%s\")", target, parent, name);
+  if (target == NULL || parent == NULL || name == NULL) {
+    return efault();
+  }
+  if (strlen(target) >= VFS_PATH_MAX) {
+    return enametoolong();
+  }
+  device = ((struct TmpfsInfo *)parent->data)->device;
+  TmpfsLock(device);
+  ino = TmpfsCreate(parent, name, S_IFLNK | 0777, target, strlen(target));
+  TmpfsUnlock(device);
+  return ino ? 0 : -1;
+}
+
+// Maps pages of the arena into memory, so shared mappings see writes
+// from every process, and private mappings are copy-on-write. Blocks
+// that don't exist get allocated for shared mappings. For private ones
+// holes and the space past the end of file are anonymous zero pages.
+static void *TmpfsMmap(struct VfsInfo *info, void *addr, size_t len, int prot,
+                       int flags, off_t offset) {
+  u8 *base;
+  int accmode;
+  u32 page, *blocks;
+  u64 i, n, run, first, count, pagesize;
+  struct TmpfsFile *file;
+  struct TmpfsNode *node;
+  struct TmpfsInfo *tmpfsinfo;
+  struct TmpfsDevice *device;
+  if (info == NULL) {
+    efault();
+    return MAP_FAILED;
+  }
+  tmpfsinfo = (struct TmpfsInfo *)info->data;
+  if (!tmpfsinfo->handle) {
+    ebadf();
+    return MAP_FAILED;
+  }
+  device = tmpfsinfo->device;
+  pagesize = device->super->pagesize;
+  if (offset < 0 || offset % pagesize || !len) {
+    einval();
+    return MAP_FAILED;
+  }
+  TmpfsLock(device);
+  file = device->files + tmpfsinfo->file;
+  node = device->nodes + file->ino;
+  accmode = file->flags & O_ACCMODE;
+  base = (u8 *)MAP_FAILED;
+  if (!S_ISREG(node->mode)) {
+    enodev();
+    goto unlock;
+  }
+  if (accmode == O_WRONLY ||
+      ((flags & MAP_SHARED) && (prot & PROT_WRITE) && accmode != O_RDWR)) {
+    eacces();
+    goto unlock;
+  }
+  first = offset / pagesize;
+  count = (len + pagesize - 1) / pagesize;
+  if (flags & MAP_SHARED) {
+    n = count;
+  } else if ((node->size + pagesize - 1) / pagesize > first) {
+    n = MIN(count, (node->size + pagesize - 1) / pagesize - first);
+  } else {
+    n = 0;
+  }
+  for (i = 0; i < n; ++i) {
+    if (!TmpfsGetBlock(device, node, first + i, flags & MAP_SHARED)) {
+      if (flags & MAP_SHARED) goto unlock;
+    }
+  }
+  base = (u8 *)mmap(addr, len, prot,
+                    (flags & ~(MAP_SHARED | MAP_PRIVATE)) | MAP_PRIVATE |
+                        MAP_ANONYMOUS,
+                    -1, 0);
+  if (base == MAP_FAILED) goto unlock;
+  for (i = 0; i < n; i += run) {
+    blocks = TmpfsBlocks(device, node);
+    if (!(page = blocks[first + i])) {
+      run = 1;
+      continue;
+    }
+    for (run = 1; i + run < n && blocks[first + i + run] == page + run;
+         ++run) {
+    }
+    if (mmap(base + i * pagesize, run * pagesize, prot,
+             MAP_FIXED | (flags & (MAP_SHARED | MAP_PRIVATE)), device->fd,
+             (off_t)page * pagesize) == MAP_FAILED) {
+      munmap(base, len);
+      base = (u8 *)MAP_FAILED;
+      goto unlock;
+    }
+  }
+  if (n) node->mapped = 1;
+unlock:
+  TmpfsUnlock(device);
+  return base;
+}
+
+static int TmpfsMunmap(struct VfsInfo *info, void *addr, size_t len) {
+  return 0;
+}
+
+static int TmpfsMprotect(struct VfsInfo *info, void *addr, size_t len,
+                         int prot) {
+  return 0;
+}
+
+static int TmpfsMsync(struct VfsInfo *info, void *addr, size_t len,
+                      int flags) {
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Mounts a tmpfs at each path in a colon separated list, which comes
+// from the $BLINK_TMPFS environment variable, e.g. "/tmp:/dev/shm".
+int TmpfsMountPoints(const char *paths) {
+  char *list, *path, *state;
+  if (!paths || !*paths) return 0;
+  if (!(list = strdup(paths))) return enomem();
+  for (path = strtok_r(list, ":", &state); path;
+       path = strtok_r(NULL, ":", &state)) {
+    if (VfsMkdir(AT_FDCWD, path, 01777) == -1 && errno != EEXIST) {
+      ERRF("failed to create tmpfs mount point %s: %s", path, strerror(errno));
+      break;
+    }
+    if (VfsMount("tmpfs", path, "tmpfs", 0, NULL) == -1) {
+      ERRF("failed to mount tmpfs on %s: %s", path, strerror(errno));
+      break;
+    }
+  }
+  free(list);
+  return path ? -1 : 0;
+}
+
+struct VfsSystem g_tmpfs = {.name = "tmpfs",
+                            .nodev = true,
+                            .ops = {
+                                .Init = TmpfsInit,
+                                .Freeinfo = TmpfsFreeInfo,
+                                .Freedevice = TmpfsFreeDevice,
+                                .Readmountentry = TmpfsReadmountentry,
+                                .Finddir = TmpfsFinddir,
+                                .Traverse = NULL,
+                                .Readlink = TmpfsReadlink,
+                                .Mkdir = TmpfsMkdir,
+                                .Mkfifo = TmpfsMkfifo,
+                                .Open = TmpfsOpen,
+                                .Access = TmpfsAccess,
+                                .Stat = TmpfsStat,
+                                .Fstat = TmpfsFstat,
+                                .Chmod = TmpfsChmod,
+                                .Fchmod = TmpfsFchmod,
+                                .Chown = TmpfsChown,
+                                .Fchown = TmpfsFchown,
+                                .Ftruncate = TmpfsFtruncate,
+                                .Close = TmpfsClose,
+                                .Link = TmpfsLink,
+                                .Unlink = TmpfsUnlink,
+                                .Read = TmpfsRead,
+                                .Write = TmpfsWrite,
+                                .Pread = TmpfsPread,
+                                .Pwrite = TmpfsPwrite,
+                                .Readv = TmpfsReadv,
+                                .Writev = TmpfsWritev,
+                                .Preadv = TmpfsPreadv,
+                                .Pwritev = TmpfsPwritev,
+                                .Seek = TmpfsSeek,
+                                .Fsync = TmpfsFsync,
+                                .Fdatasync = TmpfsFdatasync,
+#ifdef HAVE_FALLOCATE
+                                .Fallocate = TmpfsFallocate,
+#endif
+#ifdef HAVE_POSIX_FADVISE
+                                .Fadvise = TmpfsFadvise,
+#endif
+                                .Flock = TmpfsFlock,
+                                .Fcntl = TmpfsFcntl,
+                                .Ioctl = NULL,
+                                .Dup = TmpfsDup,
+#ifdef HAVE_DUP3
+                                .Dup3 = TmpfsDup3,
+#endif
+                                .Poll = TmpfsPoll,
+                                .Opendir = TmpfsOpendir,
+#ifdef HAVE_SEEKDIR
+                                .Seekdir = TmpfsSeekdir,
+                                .Telldir = TmpfsTelldir,
+#endif
+                                .Readdir = TmpfsReaddir,
+                                .Rewinddir = TmpfsRewinddir,
+                                .Closedir = TmpfsClosedir,
+                                .Bind = TmpfsBind,
+                                .Connect = NULL,
+                                .Connectunix = NULL,
+                                .Accept = NULL,
+                                .Listen = NULL,
+                                .Shutdown = NULL,
+                                .Recvmsg = NULL,
+                                .Sendmsg = NULL,
+                                .Recvmsgunix = HostfsRecvmsgUnix,
+                                .Sendmsgunix = HostfsSendmsgUnix,
+                                .Getsockopt = NULL,
+                                .Setsockopt = NULL,
+                                .Getsockname = NULL,
+                                .Getpeername = NULL,
+                                .Rename = TmpfsRename,
+                                .Utime = TmpfsUtime,
+                                .Futime = TmpfsFutime,
+                                .Symlink = TmpfsSymlink,
+                                .Mmap = TmpfsMmap,
+                                .Munmap = TmpfsMunmap,
+                                .Mprotect = TmpfsMprotect,
+                                .Msync = TmpfsMsync,
+                                .Pipe = NULL,
+#ifdef HAVE_PIPE2
+                                .Pipe2 = NULL,
+#endif
+                                .Socket = NULL,
+                                .Socketpair = NULL,
+                                .Tcgetattr = NULL,
+                                .Tcsetattr = NULL,
+                                .Tcflush = NULL,
+                                .Tcdrain = NULL,
+                                .Tcsendbreak = NULL,
+                                .Tcflow = NULL,
+                                .Tcgetsid = NULL,
+                                .Tcgetpgrp = NULL,
+                                .Tcsetpgrp = NULL,
+#ifdef HAVE_SOCKATMARK
+                                .Sockatmark = NULL,
+#endif
+                                .Fexecve = NULL,
+                            }};
+
+#endif /* DISABLE_VFS */
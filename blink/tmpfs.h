@@ -0,0 +1,11 @@
+#ifndef BLINK_TMPFS_H_
+#define BLINK_TMPFS_H_
+
+#include "blink/vfs.h"
+
+extern struct VfsSystem g_tmpfs;
+
+ssize_t TmpfsGetHostPath(struct VfsInfo *, char[VFS_PATH_MAX]);
+int TmpfsMountPoints(const char *);
+
+#endif  // BLINK_TMPFS_H_
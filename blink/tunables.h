@@ -48,8 +48,25 @@
 #define kMaxAncillary 1000
 #define kMaxShebang   512
 #define kMaxSigDepth  8
+#define kCopyFdChunk   (1024 * 1024)  // bounce buffer for vfs sendfile() etc.
+#define kMaxCopyFd     0x7ffff000     // linux caps file transfers at this
+#define kMaxGetdents   65536          // bounce buffer size for getdents()
+#define kOverlayMisses 1024           // lookup cache for overlays
+#define kOverlayMissMs 100            // how long overlay lookups are cached
+#define kOverlayDirs   256            // hash buckets for union directories
+#define kCopyUpChunk   65536          // bounce buffer for overlay copy-up
+#define kTmpfsNodes    65536          // inodes per tmpfs mount (power of 2)
+#define kHostfsDirFds  64             // directory handles hostfs keeps open
+#if CAN_64BIT
+#define kTmpfsSize (UINT64_C(1) * 1024 * 1024 * 1024)  // tmpfs arena size
+#else
+#define kTmpfsSize (256 * 1024 * 1024)  // tmpfs arena size
+#endif
 
 #define kStraceArgMax 256
 #define kStraceBufMax 32
 
+#define kStatsShards   16   // copies of statistics threads are spread over
+#define kStatsSyscalls 512  // system call ordinals with their own counter
+
 #endif /* BLINK_TUNABLES_H_ */
@@ -1658,6 +1658,134 @@ static void PutReg(P, unsigned log2sz, unsigned reg, unsigned breg) {
   }
 }
 
+#if defined(__x86_64__) && !defined(__CYGWIN__)
+static void PatchJitBranch(struct JitBlock *jb, long at) {
+  if (jb->index > kJitBlockSize) return;  // oom
+  Write32(jb->addr + at, jb->index - (at + 4));
+}
+#endif
+
+// turns virtual address in res0 into a host pointer in res0
+//
+// when linear memory is disabled, every memory operand in a jit path
+// needs to be translated. for the common case of a user mode program
+// that's accessing a page that's already in the tlb, we inline a tlb
+// probe into the generated code, which avoids the function call into
+// ReserveAddress(). that function remains the slow path, which takes
+// care of tlb misses, page faults, page overlap, and smc protection.
+static void ReserveAddressJit(P, u64 bytes, bool writable) {
+#if defined(__x86_64__) && !defined(__CYGWIN__)
+  _Static_assert(sizeof(struct MachineTlb) == 16, "");
+  _Static_assert(ARRAYLEN(m->tlb) <= 128, "");
+  _Static_assert(IS2POW(ARRAYLEN(m->tlb)), "");
+  if (!m->metal) {
+    int j, n;
+    u8 code[192];
+    long at, slow[4];
+    struct JitBlock *jb = m->path.jb;
+    u32 tlb = offsetof(struct Machine, tlb);
+    u32 inv = offsetof(struct Machine, invalidated);
+    u32 addr = writable ? offsetof(struct Machine, writeaddr)
+                        : offsetof(struct Machine, readaddr);
+    u32 size = writable ? offsetof(struct Machine, writesize)
+                        : offsetof(struct Machine, readsize);
+    u64 need = PAGE_V | PAGE_HOST | PAGE_U;
+    if (writable) need |= PAGE_RW | PAGE_XD;
+    unassert(0 < bytes && bytes <= 4096);
+    n = 0;
+    // cmpb $0,inv(%rbx)
+    code[n++] = 0x80, code[n++] = 0xbb;
+    Write32(code + n, inv), n += 4;
+    code[n++] = 0x00;
+    // jne slow
+    code[n++] = 0x0f, code[n++] = 0x85, slow[0] = n, n += 4;
+    // mov %eax,%ecx
+    code[n++] = 0x89, code[n++] = 0xc1;
+    // and $4095,%ecx
+    code[n++] = 0x81, code[n++] = 0xe1;
+    Write32(code + n, 4095), n += 4;
+    // cmp $4096-bytes,%ecx
+    code[n++] = 0x81, code[n++] = 0xf9;
+    Write32(code + n, 4096 - bytes), n += 4;
+    // ja slow
+    code[n++] = 0x0f, code[n++] = 0x87, slow[1] = n, n += 4;
+    // mov %rax,%rcx
+    code[n++] = 0x48, code[n++] = 0x89, code[n++] = 0xc1;
+    // shr $12,%rcx
+    code[n++] = 0x48, code[n++] = 0xc1, code[n++] = 0xe9, code[n++] = 12;
+    // and $ARRAYLEN(tlb)-1,%ecx
+    code[n++] = 0x83, code[n++] = 0xe1, code[n++] = ARRAYLEN(m->tlb) - 1;
+    // shl $4,%ecx
+    code[n++] = 0xc1, code[n++] = 0xe1, code[n++] = 4;
+    // mov %rax,%rdx
+    code[n++] = 0x48, code[n++] = 0x89, code[n++] = 0xc2;
+    // and $-4096,%rdx
+    code[n++] = 0x48, code[n++] = 0x81, code[n++] = 0xe2;
+    Write32(code + n, -4096), n += 4;
+    // cmp tlb(%rbx,%rcx),%rdx
+    code[n++] = 0x48, code[n++] = 0x3b, code[n++] = 0x94, code[n++] = 0x0b;
+    Write32(code + n, tlb + offsetof(struct MachineTlb, page)), n += 4;
+    // jne slow
+    code[n++] = 0x0f, code[n++] = 0x85, slow[2] = n, n += 4;
+    // mov tlb+8(%rbx,%rcx),%rdx
+    code[n++] = 0x48, code[n++] = 0x8b, code[n++] = 0x94, code[n++] = 0x0b;
+    Write32(code + n, tlb + offsetof(struct MachineTlb, entry)), n += 4;
+    // mov %rdx,%rsi
+    code[n++] = 0x48, code[n++] = 0x89, code[n++] = 0xd6;
+    // not %rsi
+    code[n++] = 0x48, code[n++] = 0xf7, code[n++] = 0xd6;
+    // movabs $need,%rdi
+    code[n++] = 0x48, code[n++] = 0xbf;
+    Write64(code + n, need), n += 8;
+    // test %rdi,%rsi
+    code[n++] = 0x48, code[n++] = 0x85, code[n++] = 0xfe;
+    // jne slow
+    code[n++] = 0x0f, code[n++] = 0x85, slow[3] = n, n += 4;
+    // movabs $PAGE_TA,%rdi
+    code[n++] = 0x48, code[n++] = 0xbf;
+    Write64(code + n, PAGE_TA), n += 8;
+    // and %rdi,%rdx
+    code[n++] = 0x48, code[n++] = 0x21, code[n++] = 0xfa;
+    // mov %rax,addr(%rbx)
+    code[n++] = 0x48, code[n++] = 0x89, code[n++] = 0x83;
+    Write32(code + n, addr), n += 4;
+    // movq $bytes,size(%rbx)
+    code[n++] = 0x48, code[n++] = 0xc7, code[n++] = 0x83;
+    Write32(code + n, size), n += 4;
+    Write32(code + n, bytes), n += 4;
+    // and $4095,%eax
+    code[n++] = 0x25;
+    Write32(code + n, 4095), n += 4;
+    // add %rdx,%rax
+    code[n++] = 0x48, code[n++] = 0x01, code[n++] = 0xd0;
+    // jmp done
+    code[n++] = 0xe9, at = n, n += 4;
+    unassert(n <= sizeof(code));
+    at += jb->index;
+    for (j = 0; j < ARRAYLEN(slow); ++j) slow[j] += jb->index;
+    if (!AppendJit(jb, code, n)) return;
+    for (j = 0; j < ARRAYLEN(slow); ++j) PatchJitBranch(jb, slow[j]);
+    Jitter(A,
+           "a3i"    // arg3 = writable
+           "a2i"    // arg2 = bytes
+           "r0a1="  // arg1 = virtual address
+           "q"      // arg0 = machine
+           "c",     // call function (turn virtual into pointer)
+           (u64)writable, bytes, ReserveAddress);
+    PatchJitBranch(jb, at);
+    jb->lastaction = 0;  // fast path didn't do the slow path's moves
+    return;
+  }
+#endif
+  Jitter(A,
+         "a3i"    // arg3 = writable
+         "a2i"    // arg2 = bytes
+         "r0a1="  // arg1 = virtual address
+         "q"      // arg0 = machine
+         "c",     // call function (turn virtual into pointer)
+         (u64)writable, bytes, ReserveAddress);
+}
+
 static unsigned JitterImpl(P, const char *fmt, va_list va, unsigned k,
                            unsigned depth) {
   unsigned c, log2sz;
@@ -1763,16 +1891,12 @@ static unsigned JitterImpl(P, const char *fmt, va_list va, unsigned k,
                    ResolveHost, kLoad[log2sz]);
           }
         } else {
+          Jitter(A, "L");  // load effective address
+          ReserveAddressJit(A, 1 << log2sz, false);
           Jitter(A,
-                 "L"         // load effective address
-                 "a3i"       // arg3 = false
-                 "a2i"       // arg2 = bytes to read
-                 "r0a1="     // arg1 = virtual address
-                 "q"         // arg0 = machine
-                 "c"         // call function (turn virtual into pointer)
                  "t"         // arg0 = pointer
                  LOADSTORE,  // call micro-op (read vector shared memory)
-                 (u64)0, (u64)(1 << log2sz), ReserveAddress, kLoad[log2sz]);
+                 kLoad[log2sz]);
         }
         break;
 
@@ -1803,17 +1927,14 @@ static unsigned JitterImpl(P, const char *fmt, va_list va, unsigned k,
             }
           } else {
             Jitter(A,
-                   "s3="       // sav3 = <pop>
-                   "L"         // load effective address
-                   "a3i"       // arg3 = true
-                   "a2i"       // arg2 = byte width of write operation
-                   "r0a1="     // arg1 = res0
-                   "q"         // arg0 = machine
-                   "c"         // call function (turn virtual into pointer)
+                   "s3="  // sav3 = <pop>
+                   "L");  // load effective address
+            ReserveAddressJit(A, 1 << log2sz, true);
+            Jitter(A,
                    "s3a1="     // arg1 = sav3
                    "t"         // arg0 = res0
                    LOADSTORE,  // call function (write word to shared memory)
-                   (u64)1, (u64)(1 << log2sz), ReserveAddress, kStore[log2sz]);
+                   kStore[log2sz]);
           }
         } else {
           if (IsModrmRegister(rde)) {
@@ -1856,19 +1977,16 @@ static unsigned JitterImpl(P, const char *fmt, va_list va, unsigned k,
             }
           } else {
             Jitter(A,
-                   "r1s4="     // sav4 = res1
-                   "r0s3="     // sav3 = res0
-                   "L"         // load effective address
-                   "a3i"       // arg3 = true
-                   "a2i"       // arg2 = bytes to write
-                   "r0a1="     // arg1 = res0
-                   "q"         // arg0 = machine
-                   "c"         // call function (turn virtual into pointer)
+                   "r1s4="  // sav4 = res1
+                   "r0s3="  // sav3 = res0
+                   "L");    // load effective address
+            ReserveAddressJit(A, 1 << log2sz, true);
+            Jitter(A,
                    "s4a2="     // arg2 = sav4
                    "s3a1="     // arg1 = sav3
                    "t"         // arg0 = res0
                    LOADSTORE,  // call micro-op (store vector to shared memory)
-                   (u64)1, (u64)(1 << log2sz), ReserveAddress, kStore[log2sz]);
+                   kStore[log2sz]);
           }
         }
         break;
@@ -1970,14 +2088,8 @@ static unsigned JitterImpl(P, const char *fmt, va_list va, unsigned k,
                    ResolveHost);
           }
         } else {
-          Jitter(A,
-                 "L"      // load effective address
-                 "a3i"    // arg3 = false
-                 "a2i"    // arg2 = bytes to read
-                 "r0a1="  // arg1 = virtual address
-                 "q"      // arg0 = machine
-                 "c",     // res0 = call function (turn virtual into pointer)
-                 (u64)0, (u64)(1 << log2sz), ReserveAddress);
+          Jitter(A, "L");  // load effective address
+          ReserveAddressJit(A, 1 << log2sz, false);
         }
         break;
 
@@ -20,6 +20,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,8 +35,10 @@
 #include "blink/linux.h"
 #include "blink/log.h"
 #include "blink/macros.h"
+#include "blink/packfs.h"
 #include "blink/procfs.h"
 #include "blink/thread.h"
+#include "blink/tmpfs.h"
 #include "blink/tunables.h"
 
 #ifndef DISABLE_VFS
@@ -43,10 +46,15 @@
 #define VFS_UNREACHABLE        "(unreachable)"
 #define VFS_TRAVERSE_MAX_LINKS 40
 
+// slot of emulated file descriptor table, or the cwd and root
+//
+// lookups don't take any lock. a reader announces itself in readers
+// before loading data, and holds it until it has acquired a reference
+// on the info. writers swap data and then wait for readers to drain,
+// before dropping the old info.
 struct VfsFd {
-  struct Dll elem;
-  struct VfsInfo *data;
-  int fd;
+  _Atomic(struct VfsInfo *) data;
+  _Atomic(int) readers;
 };
 
 struct VfsMap {
@@ -59,7 +67,6 @@ struct VfsMap {
   int flags;
 };
 
-#define VFS_FD_CONTAINER(e)  DLL_CONTAINER(struct VfsFd, elem, (e))
 #define VFS_MAP_CONTAINER(e) DLL_CONTAINER(struct VfsMap, elem, (e))
 
 static struct VfsDevice g_rootdevice = {
@@ -80,36 +87,67 @@ static struct VfsInfo g_initialrootinfo = {
     .refcount = 1u,
 };
 
-struct VfsInfo *g_cwdinfo;
-struct VfsInfo *g_rootinfo;
+static struct VfsFd g_cwd;
+static struct VfsFd g_root;
 struct VfsInfo *g_actualrootinfo;
 
 struct Vfs g_vfs = {
     .devices = NULL,
     .systems = NULL,
-    .fds = NULL,
     .maps = NULL,
     .lock = PTHREAD_MUTEX_INITIALIZER_,
+    .fdslock = PTHREAD_MUTEX_INITIALIZER_,
     .mapslock = PTHREAD_MUTEX_INITIALIZER_,
 };
 
+// returns new reference to info in slot, or null if it's empty
+static struct VfsInfo *VfsAcquireSlot(struct VfsFd *slot) {
+  struct VfsInfo *info;
+  atomic_fetch_add(&slot->readers, 1);
+  unassert(!VfsAcquireInfo(atomic_load(&slot->data), &info));
+  atomic_fetch_sub_explicit(&slot->readers, 1, memory_order_release);
+  return info;
+}
+
+// publishes data to slot and returns the previous data, once no reader
+// could still be in the middle of acquiring it
+static struct VfsInfo *VfsExchangeSlot(struct VfsFd *slot,
+                                       struct VfsInfo *data) {
+  struct VfsInfo *old;
+  old = atomic_exchange(&slot->data, data);
+  if (old) {
+    while (atomic_load(&slot->readers)) {
+      sched_yield();
+    }
+  }
+  return old;
+}
+
 int VfsInit(const char *prefix) {
   struct stat st;
   char *cwd, hostcwd[PATH_MAX], *bprefix = NULL;
-  struct VfsInfo *info;
+  struct VfsInfo *info, *root;
   size_t hostcwdlen, prefixlen;
+  bool packed = false;
   int fd;
 
   // Register built-in filesystems
   unassert(!VfsRegister(&g_hostfs));
   unassert(!VfsRegister(&g_devfs));
   unassert(!VfsRegister(&g_procfs));
+  unassert(!VfsRegister(&g_tmpfs));
+  unassert(!VfsRegister(&g_packfs));
+
+  // Remember the umask, which in-memory file systems apply themselves
+  g_vfs.umask = umask(0);
+  umask(g_vfs.umask);
 
   dll_init(&g_rootdevice.elem);
   dll_make_first(&g_vfs.devices, &g_rootdevice.elem);
 
   // Initialize the root directory
-  unassert(!VfsAcquireInfo(&g_initialrootinfo, &g_rootinfo));
+  unassert(!VfsAcquireInfo(&g_initialrootinfo, &root));
+  unassert(!VfsExchangeSlot(&g_root, root));
   unassert(!VfsAcquireInfo(&g_initialrootinfo, &g_actualrootinfo));
   if (prefix) {
     bprefix = realpath(prefix, NULL);
@@ -119,19 +157,27 @@ int VfsInit(const char *prefix) {
       ERRF("Failed to stat BLINK_PREFIX %s, %s", bprefix, strerror(errno));
       free(bprefix);
       bprefix = NULL;
+    } else if (S_ISREG(st.st_mode)) {
+      packed = true;
     } else if (!S_ISDIR(st.st_mode)) {
-      ERRF("BLINK_PREFIX %s is not a directory", bprefix);
+      ERRF("BLINK_PREFIX %s is not a directory or image", bprefix);
       free(bprefix);
       bprefix = NULL;
     }
   }
-  if (bprefix) {
+  if (packed) {
+    // An image made by blinkpack becomes the whole root filesystem.
+    if (VfsMount(bprefix, "/", "packfs", 0, NULL) == -1) {
+      ERRF("Failed to mount BLINK_PREFIX %s, %s", bprefix, strerror(errno));
+      goto cleananddie;
+    }
+  } else if (bprefix) {
     unassert(!VfsMount(bprefix, "/", "hostfs", 0, NULL));
   } else {
     unassert(!VfsMount("/", "/", "hostfs", 0, NULL));
   }
-  unassert(!VfsFreeInfo(g_rootinfo));
-  unassert(!VfsTraverse("/", &g_rootinfo, false));
+  unassert(!VfsTraverse("/", &root, false));
+  unassert(!VfsFreeInfo(VfsExchangeSlot(&g_root, root)));
 
   // Temporary cwd for syscalls to work during initialization
   unassert(!VfsChdir("/"));
@@ -159,7 +205,8 @@ int VfsInit(const char *prefix) {
 
   // Initialize the current working directory
   unassert(getcwd(hostcwd, sizeof(hostcwd)));
-  if (bprefix && !strncmp(hostcwd, bprefix, (prefixlen = strlen(bprefix)))) {
+  if (bprefix && !packed &&
+      !strncmp(hostcwd, bprefix, (prefixlen = strlen(bprefix)))) {
     hostcwdlen = strlen(hostcwd);
     if (hostcwdlen == prefixlen) {
       cwd = strdup("/");
@@ -193,6 +240,13 @@ int VfsInit(const char *prefix) {
   unassert(!HostfsWrapFd(2, false, &info));
   unassert(VfsAddFd(info) == 2);
 
+  // the other descriptors blink.c lets the guest inherit
+  for (fd = 3; fd < 10; ++fd) {
+    if (!HostfsWrapFd(fd, false, &info)) {
+      unassert(!VfsSetFd(fd, info));
+    }
+  }
+
   // Some Linux tests require that when EMFILE occurs,
   // the fd returned before it must be the maximum possible.
 
@@ -223,6 +277,25 @@ int VfsRegister(struct VfsSystem *system) {
   return 0;
 }
 
+// publishes a copy of the device's mount table with mount added
+// @assume g_vfs.lock
+static int VfsAddMount(struct VfsDevice *device, struct VfsMount *mount) {
+  int n;
+  struct VfsMounts *old, *mounts;
+  old = atomic_load_explicit(&device->mounts, memory_order_relaxed);
+  n = old ? old->n : 0;
+  if (!(mounts = (struct VfsMounts *)malloc(sizeof(*mounts) +
+                                             (n + 1) * sizeof(*mounts->p)))) {
+    return enomem();
+  }
+  if (n) memcpy(mounts->p, old->p, n * sizeof(*mounts->p));
+  mounts->p[n] = mount;
+  mounts->n = n + 1;
+  mounts->prev = old;
+  atomic_store_explicit(&device->mounts, mounts, memory_order_release);
+  return 0;
+}
+
 int VfsMount(const char *source, const char *target, const char *fstype,
              u64 flags, const void *data) {
   struct VfsInfo *targetinfo;
@@ -264,11 +337,27 @@ int VfsMount(const char *source, const char *target, const char *fstype,
       break;
     }
   }
+  UNLOCK(&g_vfs.lock);
   if (newsystem == NULL) {
     VFS_LOGF("Unknown filesystem type: %s", fstype);
-    UNLOCK(&g_vfs.lock);
+    unassert(!VfsFreeInfo(targetinfo));
     return enodev();
   }
+  if (targetinfo->name != NULL) {
+    newname = strdup(targetinfo->name);
+    if (newname == NULL) {
+      unassert(!VfsFreeInfo(targetinfo));
+      return enomem();
+    }
+  }
+  // initializing the new filesystem may touch the host, so it happens
+  // without holding the lock that guards the device and system lists
+  if (newsystem->ops.Init(source, flags, data, &newdevice, &newmount) == -1) {
+    unassert(!VfsFreeInfo(targetinfo));
+    free(newname);
+    return -1;
+  }
+  LOCK(&g_vfs.lock);
   for (e = dll_first(g_vfs.devices); e; e = dll_next(g_vfs.devices, e)) {
     d = VFS_DEVICE_CONTAINER(e);
     if (d->dev == targetinfo->dev) {
@@ -279,18 +368,8 @@ int VfsMount(const char *source, const char *target, const char *fstype,
   if (targetdevice == NULL) {
     // Might have been unmounted after VfsTraverse by another thread
     UNLOCK(&g_vfs.lock);
-    return enoent();
-  }
-  if (targetinfo->name != NULL) {
-    newname = strdup(targetinfo->name);
-    if (newname == NULL) {
-      UNLOCK(&g_vfs.lock);
-      return enomem();
-    }
-  }
-  if (newsystem->ops.Init(source, flags, data, &newdevice, &newmount) == -1) {
-    UNLOCK(&g_vfs.lock);
-    return -1;
+    errno = ENOENT;
+    goto undo;
   }
   nextdev = 0;
   for (e = dll_first(g_vfs.devices); e; e = dll_next(g_vfs.devices, e)) {
@@ -302,23 +381,33 @@ int VfsMount(const char *source, const char *target, const char *fstype,
     }
   }
   newdevice->dev = nextdev;
-  if (e == NULL) {
-    dll_make_last(&g_vfs.devices, &newdevice->elem);
-  } else {
-    dll_splice_after(dll_prev(g_vfs.devices, e), &newdevice->elem);
-  }
   newdevice->flags = flags;
   newmount->baseino = targetinfo->ino;
   newmount->root->dev = nextdev;
   newmount->root->name = newname;
   newmount->root->namelen = targetinfo->namelen;
   unassert(!VfsAcquireInfo(targetinfo->parent, &newmount->root->parent));
-  dll_init(&newmount->elem);
-  dll_make_last(&targetdevice->mounts, &newmount->elem);
+  if (VfsAddMount(targetdevice, newmount) == -1) {
+    UNLOCK(&g_vfs.lock);
+    newname = NULL;
+    goto undo;
+  }
+  if (e == NULL) {
+    dll_make_last(&g_vfs.devices, &newdevice->elem);
+  } else {
+    dll_splice_after(dll_prev(g_vfs.devices, e), &newdevice->elem);
+  }
   UNLOCK(&g_vfs.lock);
   unassert(!VfsFreeInfo(targetinfo));
   VFS_LOGF("Mounted a new device at %s, dev=%ld", target, nextdev);
   return 0;
+undo:
+  free(newname);
+  unassert(!VfsFreeInfo(newmount->root));
+  unassert(!VfsFreeDevice(newdevice));
+  free(newmount);
+  unassert(!VfsFreeInfo(targetinfo));
+  return -1;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -345,9 +434,8 @@ int VfsCreateDevice(struct VfsDevice **output) {
 }
 
 int VfsFreeDevice(struct VfsDevice *device) {
-  struct Dll *e;
-  struct VfsMount *mount;
-  int rc;
+  struct VfsMounts *mounts, *prev;
+  int i, rc;
   if (device == NULL) {
     return 0;
   }
@@ -365,12 +453,20 @@ int VfsFreeDevice(struct VfsDevice *device) {
   device->ops = NULL;
   // Don't free root, it's a weak reference.
   device->root = NULL;
-  for (e = dll_first(device->mounts); e; e = dll_next(device->mounts, e)) {
-    mount = VFS_MOUNT_CONTAINER(e);
-    unassert(!VfsFreeInfo(mount->root));
-    mount->root = NULL;
-    free(mount);
+  // each snapshot extends the one before it, so the latest one holds
+  // every mount, and the older ones only need their arrays released
+  if ((mounts = atomic_load_explicit(&device->mounts, memory_order_relaxed))) {
+    for (i = 0; i < mounts->n; ++i) {
+      unassert(!VfsFreeInfo(mounts->p[i]->root));
+      mounts->p[i]->root = NULL;
+      free(mounts->p[i]);
+    }
   }
+  for (; mounts; mounts = prev) {
+    prev = mounts->prev;
+    free(mounts);
+  }
+  device->mounts = NULL;
   UNLOCK(&device->lock);
   unassert(!pthread_mutex_destroy(&device->lock));
   free(device);
@@ -464,18 +560,21 @@ int VfsFreeInfo(struct VfsInfo *info) {
 
 static int VfsTraverseMount(struct VfsInfo **info,
                             char childname[VFS_NAME_MAX]) {
+  int i;
   struct VfsMount *mount;
-  struct Dll *e;
+  struct VfsMounts *mounts;
   if (info == NULL) {
     return efault();
   }
   if (!S_ISDIR((*info)->mode)) {
     return 0;
   }
-  LOCK(&g_vfs.lock);
-  for (e = dll_first((*info)->device->mounts); e;
-       e = dll_next((*info)->device->mounts, e)) {
-    mount = VFS_MOUNT_CONTAINER(e);
+  if (!(mounts = atomic_load_explicit(&(*info)->device->mounts,
+                                      memory_order_acquire))) {
+    return 0;
+  }
+  for (i = 0; i < mounts->n; ++i) {
+    mount = mounts->p[i];
     if (!childname) {
       // Checking info itself.
       if (mount->baseino == (*info)->ino) {
@@ -500,7 +599,6 @@ static int VfsTraverseMount(struct VfsInfo **info,
       }
     }
   }
-  UNLOCK(&g_vfs.lock);
   return 0;
 }
 
@@ -612,9 +710,9 @@ int VfsTraverse(const char *path, struct VfsInfo **output, bool follow) {
   }
   root = NULL;
   if (path[0] != '/') {
-    unassert(!VfsAcquireInfo(g_cwdinfo, output));
+    unassert(!VfsAcquireCwd(output));
   } else {
-    unassert(!VfsAcquireInfo(g_rootinfo, output));
+    unassert(!VfsAcquireRoot(output));
   }
   if (VfsTraverseStackBuild(output, path, root, follow, 0) == -1) {
     unassert(!VfsFreeInfo(*output));
@@ -623,15 +721,12 @@ int VfsTraverse(const char *path, struct VfsInfo **output, bool follow) {
   return 0;
 }
 
-ssize_t VfsPathBuildFull(struct VfsInfo *info, struct VfsInfo *root,
-                         char **output) {
+static ssize_t VfsPathBuildFullAt(struct VfsInfo *info, struct VfsInfo *root,
+                                  char **output) {
   struct VfsInfo *current;
   size_t len, currentlen;
   len = 0;
   current = info;
-  if (root == NULL) {
-    root = g_rootinfo;
-  }
   if (current->dev == root->dev && current->ino == root->ino) {
     *output = strdup("/");
     if (*output == NULL) {
@@ -669,16 +764,22 @@ ssize_t VfsPathBuildFull(struct VfsInfo *info, struct VfsInfo *root,
   return len;
 }
 
-ssize_t VfsPathBuild(struct VfsInfo *info, struct VfsInfo *root, bool absolute,
-                     char output[PATH_MAX]) {
+ssize_t VfsPathBuildFull(struct VfsInfo *info, struct VfsInfo *root,
+                         char **output) {
+  ssize_t len;
+  if (root) return VfsPathBuildFullAt(info, root, output);
+  unassert(!VfsAcquireRoot(&root));
+  len = VfsPathBuildFullAt(info, root, output);
+  unassert(!VfsFreeInfo(root));
+  return len;
+}
+
+static ssize_t VfsPathBuildAt(struct VfsInfo *info, struct VfsInfo *root,
+                              bool absolute, char output[PATH_MAX]) {
   struct VfsInfo *current;
   size_t len, currentlen;
   len = 0;
   current = info;
-  VFS_LOGF("VfsPathBuild(%p, %p, %d, %p)", info, root, absolute, output);
-  if (root == NULL) {
-    root = g_rootinfo;
-  }
   if (current->dev == root->dev && current->ino == root->ino) {
     if (absolute) {
       memcpy(output, "/", 2);
@@ -715,40 +816,65 @@ ssize_t VfsPathBuild(struct VfsInfo *info, struct VfsInfo *root, bool absolute,
   return len;
 }
 
+ssize_t VfsPathBuild(struct VfsInfo *info, struct VfsInfo *root, bool absolute,
+                     char output[PATH_MAX]) {
+  ssize_t len;
+  VFS_LOGF("VfsPathBuild(%p, %p, %d, %p)", info, root, absolute, output);
+  if (root) return VfsPathBuildAt(info, root, absolute, output);
+  unassert(!VfsAcquireRoot(&root));
+  len = VfsPathBuildAt(info, root, absolute, output);
+  unassert(!VfsFreeInfo(root));
+  return len;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
-int VfsAddFdAtOrAfter(struct VfsInfo *data, int minfd) {
-  struct VfsFd *vfsfd;
-  struct Dll *e;
-  vfsfd = (struct VfsFd *)malloc(sizeof(*vfsfd));
-  if (vfsfd == NULL) {
-    return -1;
+// returns slot of fd, or null if its chunk was never allocated
+static struct VfsFd *VfsGetFdSlot(int fd) {
+  struct VfsFd *chunk;
+  if (fd < 0 || fd >= VFS_FD_CHUNK * VFS_FD_CHUNKS) return NULL;
+  chunk = atomic_load_explicit(g_vfs.fds + fd / VFS_FD_CHUNK,
+                               memory_order_acquire);
+  if (!chunk) return NULL;
+  return chunk + fd % VFS_FD_CHUNK;
+}
+
+// returns slot of fd, allocating its chunk if needed
+// @assume g_vfs.fdslock
+static struct VfsFd *VfsCreateFdSlot(int fd) {
+  struct VfsFd *chunk;
+  if (fd < 0 || fd >= VFS_FD_CHUNK * VFS_FD_CHUNKS) {
+    emfile();
+    return NULL;
   }
-  vfsfd->data = data;
-  LOCK(&g_vfs.lock);
-  for (e = dll_first(g_vfs.fds); e; e = dll_next(g_vfs.fds, e)) {
-    if (VFS_FD_CONTAINER(e)->fd < minfd) {
-      continue;
-    } else if (VFS_FD_CONTAINER(e)->fd == minfd) {
-      ++minfd;
-    } else {
-      break;
+  if (!(chunk = atomic_load_explicit(g_vfs.fds + fd / VFS_FD_CHUNK,
+                                     memory_order_relaxed))) {
+    // chunks are never freed, so lock-free readers can't use after free
+    if (!(chunk = (struct VfsFd *)calloc(VFS_FD_CHUNK, sizeof(*chunk)))) {
+      return NULL;
     }
+    atomic_store_explicit(g_vfs.fds + fd / VFS_FD_CHUNK, chunk,
+                          memory_order_release);
   }
-  vfsfd->fd = minfd;
-  dll_init(&vfsfd->elem);
-  if (e == NULL) {
-    dll_make_last(&g_vfs.fds, &vfsfd->elem);
-  } else {
-    e = dll_prev(g_vfs.fds, e);
-    if (e == NULL) {
-      dll_make_first(&g_vfs.fds, &vfsfd->elem);
-    } else {
-      dll_splice_after(e, &vfsfd->elem);
+  return chunk + fd % VFS_FD_CHUNK;
+}
+
+int VfsAddFdAtOrAfter(struct VfsInfo *data, int minfd) {
+  int fd;
+  struct VfsFd *slot;
+  LOCK(&g_vfs.fdslock);
+  for (fd = MAX(minfd, 0);; ++fd) {
+    if (!(slot = VfsCreateFdSlot(fd))) {
+      UNLOCK(&g_vfs.fdslock);
+      return -1;
+    }
+    if (!atomic_load_explicit(&slot->data, memory_order_relaxed)) {
+      break;
     }
   }
-  UNLOCK(&g_vfs.lock);
-  return vfsfd->fd;
+  atomic_store_explicit(&slot->data, data, memory_order_release);
+  UNLOCK(&g_vfs.fdslock);
+  return fd;
 }
 
 int VfsAddFd(struct VfsInfo *data) {
@@ -760,76 +886,91 @@ int VfsAddFd(struct VfsInfo *data) {
  * it.
  */
 int VfsFreeFd(int fd, struct VfsInfo **data) {
-  struct Dll *e;
-  struct VfsFd *vfsfd;
-  LOCK(&g_vfs.lock);
-  for (e = dll_first(g_vfs.fds); e;) {
-    vfsfd = VFS_FD_CONTAINER(e);
-    if (VFS_FD_CONTAINER(e)->fd == fd) {
-      *data = vfsfd->data;
-      dll_remove(&g_vfs.fds, &vfsfd->elem);
-      free(vfsfd);
-      VFS_LOGF("VfsFreeFd(%d)", fd);
-      UNLOCK(&g_vfs.lock);
-      return 0;
-    }
-    e = dll_next(g_vfs.fds, e);
+  struct VfsFd *slot;
+  struct VfsInfo *old;
+  LOCK(&g_vfs.fdslock);
+  if ((slot = VfsGetFdSlot(fd)) && (old = VfsExchangeSlot(slot, NULL))) {
+    UNLOCK(&g_vfs.fdslock);
+    VFS_LOGF("VfsFreeFd(%d)", fd);
+    *data = old;
+    return 0;
   }
-  UNLOCK(&g_vfs.lock);
+  UNLOCK(&g_vfs.fdslock);
   return ebadf();
 }
 
 int VfsGetFd(int fd, struct VfsInfo **output) {
-  struct Dll *e;
-  LOCK(&g_vfs.lock);
-  for (e = dll_first(g_vfs.fds); e; e = dll_next(g_vfs.fds, e)) {
-    if (VFS_FD_CONTAINER(e)->fd == fd) {
-      UNLOCK(&g_vfs.lock);
-      unassert(!VfsAcquireInfo(VFS_FD_CONTAINER(e)->data, output));
-      return 0;
-    }
+  struct VfsFd *slot;
+  if (!(slot = VfsGetFdSlot(fd))) return ebadf();
+  if (!(*output = VfsAcquireSlot(slot))) return ebadf();
+  return 0;
+}
+
+// returns host fd backing `fd` if it's on hostfs, otherwise -1
+int VfsGetHostFd(int fd) {
+  int res = -1;
+  struct VfsInfo *info;
+  if (VfsGetFd(fd, &info) == -1) return -1;
+  if (info->device->ops == &g_hostfs.ops && info->data) {
+    res = ((struct HostfsInfo *)info->data)->filefd;
   }
-  UNLOCK(&g_vfs.lock);
-  return ebadf();
+  unassert(!VfsFreeInfo(info));
+  return res;
 }
 
-int VfsSetFd(int fd, struct VfsInfo *data) {
-  struct Dll *e;
-  struct VfsFd *vfsfd;
-  LOCK(&g_vfs.lock);
-  for (e = dll_first(g_vfs.fds); e; e = dll_next(g_vfs.fds, e)) {
-    if (VFS_FD_CONTAINER(e)->fd == fd) {
-      unassert(!VfsFreeInfo(VFS_FD_CONTAINER(e)->data));
-      VFS_FD_CONTAINER(e)->data = data;
-      UNLOCK(&g_vfs.lock);
-      return 0;
-    } else if (VFS_FD_CONTAINER(e)->fd > fd) {
-      break;
-    }
+// adopts host descriptor `hostfd`, e.g. from eventfd(), as an emulated
+// descriptor; hostfd is closed on failure
+int VfsWrapFd(int hostfd) {
+  int fd;
+  struct VfsInfo *info;
+  VFS_LOGF("VfsWrapFd(%d)", hostfd);
+  if (HostfsWrapFd(hostfd, false, &info) == -1) {
+    close(hostfd);
+    return -1;
   }
-  vfsfd = (struct VfsFd *)malloc(sizeof(*vfsfd));
-  if (vfsfd == NULL) {
-    UNLOCK(&g_vfs.lock);
-    return enomem();
+  if ((fd = VfsAddFd(info)) == -1) {
+    unassert(!VfsFreeInfo(info));
+    return -1;
   }
-  vfsfd->data = data;
-  vfsfd->fd = fd;
-  dll_init(&vfsfd->elem);
-  if (e == NULL) {
-    dll_make_last(&g_vfs.fds, &vfsfd->elem);
-  } else if ((e = dll_prev(g_vfs.fds, e))) {
-    dll_splice_after(e, &vfsfd->elem);
-  } else {
-    dll_make_first(&g_vfs.fds, &vfsfd->elem);
+  return fd;
+}
+
+// returns true if `fd` is devfs's /dev/zero, which maps like anonymous
+int VfsIsDevZero(int fd) {
+  int res;
+  struct VfsInfo *info;
+  if (VfsGetFd(fd, &info) == -1) return 0;
+  res = DevfsIsZero(info);
+  unassert(!VfsFreeInfo(info));
+  return res;
+}
+
+int VfsSetFd(int fd, struct VfsInfo *data) {
+  struct VfsFd *slot;
+  LOCK(&g_vfs.fdslock);
+  if (!(slot = VfsCreateFdSlot(fd))) {
+    UNLOCK(&g_vfs.fdslock);
+    return -1;
   }
-  UNLOCK(&g_vfs.lock);
+  unassert(!VfsFreeInfo(VfsExchangeSlot(slot, data)));
+  UNLOCK(&g_vfs.fdslock);
   return 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
+int VfsAcquireCwd(struct VfsInfo **output) {
+  *output = VfsAcquireSlot(&g_cwd);
+  return 0;
+}
+
+int VfsAcquireRoot(struct VfsInfo **output) {
+  *output = VfsAcquireSlot(&g_root);
+  return 0;
+}
+
 int VfsChdir(const char *path) {
-  struct VfsInfo *info, *tmp;
+  struct VfsInfo *info;
   int ret = 0;
   VFS_LOGF("VfsChdir(\"%s\")", path);
   if (path == NULL) {
@@ -844,16 +985,14 @@ int VfsChdir(const char *path) {
   if (!S_ISDIR(info->mode)) {
     ret = enotdir();
   } else {
-    tmp = g_cwdinfo;
-    g_cwdinfo = info;
-    info = tmp;
+    info = VfsExchangeSlot(&g_cwd, info);
   }
   unassert(!VfsFreeInfo(info));
   return ret;
 }
 
 int VfsFchdir(int fd) {
-  struct VfsInfo *info, *tmp;
+  struct VfsInfo *info;
   int ret = 0;
   VFS_LOGF("VfsFchdir(%d)", fd);
   if (VfsGetFd(fd, &info) != 0) {
@@ -862,16 +1001,14 @@ int VfsFchdir(int fd) {
   if (!S_ISDIR(info->mode)) {
     ret = enotdir();
   } else {
-    tmp = g_cwdinfo;
-    g_cwdinfo = info;
-    info = tmp;
+    info = VfsExchangeSlot(&g_cwd, info);
   }
   unassert(!VfsFreeInfo(info));
   return ret;
 }
 
 int VfsChroot(const char *path) {
-  struct VfsInfo *info, *tmp;
+  struct VfsInfo *info;
   int ret = 0;
   VFS_LOGF("VfsChroot(\"%s\")", path);
   if (path == NULL) {
@@ -886,9 +1023,7 @@ int VfsChroot(const char *path) {
   if (!S_ISDIR(info->mode)) {
     ret = enotdir();
   } else {
-    tmp = g_rootinfo;
-    g_rootinfo = info;
-    info = tmp;
+    info = VfsExchangeSlot(&g_root, info);
   }
   unassert(!VfsFreeInfo(info));
   return ret;
@@ -896,6 +1031,8 @@ int VfsChroot(const char *path) {
 
 char *VfsGetcwd(char *buf, size_t size) {
   char cwd[VFS_PATH_MAX];
+  struct VfsInfo *info;
+  ssize_t rc;
   if (buf == NULL) {
     efault();
     return NULL;
@@ -903,7 +1040,10 @@ char *VfsGetcwd(char *buf, size_t size) {
   if (size == 0) {
     return buf;
   }
-  if (VfsPathBuild(g_cwdinfo, NULL, true, cwd) == -1) {
+  unassert(!VfsAcquireCwd(&info));
+  rc = VfsPathBuild(info, NULL, true, cwd);
+  unassert(!VfsFreeInfo(info));
+  if (rc == -1) {
     return NULL;
   }
   strncpy(buf, cwd, size);
@@ -914,13 +1054,13 @@ char *VfsGetcwd(char *buf, size_t size) {
 static int VfsHandleDirfdName(int dirfd, const char *name,
                               struct VfsInfo **parent,
                               char leaf[VFS_NAME_MAX]) {
-  struct VfsInfo *dir = NULL, *tmp = NULL;
+  struct VfsInfo *dir = NULL, *tmp = NULL, *root = NULL;
   const char *p, *q;
   char *parentname = NULL;
   if (name[0] == '/') {
-    unassert(!VfsAcquireInfo(g_rootinfo, &dir));
+    unassert(!VfsAcquireRoot(&dir));
   } else if (dirfd == AT_FDCWD) {
-    unassert(!VfsAcquireInfo(g_cwdinfo, &dir));
+    unassert(!VfsAcquireCwd(&dir));
   } else {
     if (VfsGetFd(dirfd, &dir) == -1) {
       goto cleananddie;
@@ -948,7 +1088,8 @@ static int VfsHandleDirfdName(int dirfd, const char *name,
   if (parentname == NULL) {
     goto cleananddie;
   }
-  if (VfsTraverseStackBuild(&dir, parentname, g_rootinfo, true, 0) == -1) {
+  unassert(!VfsAcquireRoot(&root));
+  if (VfsTraverseStackBuild(&dir, parentname, root, true, 0) == -1) {
     goto cleananddie;
   }
   if (!strcmp(q, "..") && dir->parent) {
@@ -960,9 +1101,11 @@ static int VfsHandleDirfdName(int dirfd, const char *name,
     memcpy(leaf, q, p - q + 1);
   }
   *parent = dir;
+  unassert(!VfsFreeInfo(root));
   free(parentname);
   return 0;
 cleananddie:
+  unassert(!VfsFreeInfo(root));
   free(parentname);
   unassert(!VfsFreeInfo(dir));
   return -1;
@@ -1083,6 +1226,13 @@ int VfsMkdir(int dirfd, const char *name, mode_t mode) {
   return ret;
 }
 
+mode_t VfsUmask(mode_t mask) {
+  mode_t old;
+  old = umask(mask);
+  atomic_store_explicit(&g_vfs.umask, mask & 0777, memory_order_relaxed);
+  return old;
+}
+
 int VfsMkfifo(int dirfd, const char *name, mode_t mode) {
   struct VfsInfo *dir;
   char newname[VFS_NAME_MAX];
@@ -1707,6 +1857,44 @@ int VfsFdatasync(int fd) {
   return ret;
 }
 
+#ifdef HAVE_FALLOCATE
+int VfsFallocate(int fd, int mode, off_t offset, off_t len) {
+  struct VfsInfo *info;
+  int ret;
+  VFS_LOGF("VfsFallocate(%d, %d, %ld, %ld)", fd, mode, offset, len);
+  if (VfsGetFd(fd, &info) == -1) {
+    return -1;
+  }
+  if (info->device->ops->Fallocate) {
+    ret = info->device->ops->Fallocate(info, mode, offset, len);
+  } else {
+    ret = eopnotsupp();
+  }
+  unassert(!VfsFreeInfo(info));
+  return ret;
+}
+#endif
+
+#ifdef HAVE_POSIX_FADVISE
+// returns an error number rather than setting errno, like the function
+// posix_fadvise() which this replaces when the vfs is disabled
+int VfsFadvise(int fd, off_t offset, off_t len, int advice) {
+  struct VfsInfo *info;
+  int ret;
+  VFS_LOGF("VfsFadvise(%d, %ld, %ld, %d)", fd, offset, len, advice);
+  if (VfsGetFd(fd, &info) == -1) {
+    return errno;
+  }
+  if (info->device->ops->Fadvise) {
+    ret = info->device->ops->Fadvise(info, offset, len, advice);
+  } else {
+    ret = 0;
+  }
+  unassert(!VfsFreeInfo(info));
+  return ret;
+}
+#endif
+
 int VfsFlock(int fd, int operation) {
   struct VfsInfo *info;
   int ret;
@@ -1952,26 +2140,24 @@ void VfsRewinddir(DIR *dir) {
 
 int VfsClosedir(DIR *dir) {
   struct VfsInfo *info;
-  struct Dll *e;
-  struct VfsFd *vfsfd;
-  int ret;
+  struct VfsFd *slot;
+  int ret, fd, chunk;
   VFS_LOGF("VfsClosedir(%p)", dir);
   info = (struct VfsInfo *)dir;
   if (info->device->ops->Closedir) {
     ret = info->device->ops->Closedir(info);
     if (ret != -1) {
-      LOCK(&g_vfs.lock);
-      for (e = dll_first(g_vfs.fds); e;) {
-        vfsfd = VFS_FD_CONTAINER(e);
-        e = dll_next(g_vfs.fds, e);
-        if (vfsfd->data == info) {
-          unassert(!VfsFreeInfo(vfsfd->data));
-          dll_remove(&g_vfs.fds, &vfsfd->elem);
-          free(vfsfd);
+      LOCK(&g_vfs.fdslock);
+      for (fd = 0; (chunk = fd / VFS_FD_CHUNK) < VFS_FD_CHUNKS; ++fd) {
+        if (!atomic_load_explicit(g_vfs.fds + chunk, memory_order_relaxed)) {
+          fd += VFS_FD_CHUNK - 1;
+        } else if (atomic_load_explicit(&(slot = VfsGetFdSlot(fd))->data,
+                                        memory_order_relaxed) == info) {
+          unassert(!VfsFreeInfo(VfsExchangeSlot(slot, NULL)));
           break;
         }
       }
-      UNLOCK(&g_vfs.lock);
+      UNLOCK(&g_vfs.fdslock);
     }
   } else {
     ret = eperm();
@@ -13,6 +13,7 @@
 #include <termios.h>
 #include <unistd.h>
 
+#include "blink/atomic.h"
 #include "blink/dll.h"
 #include "blink/macros.h"
 #include "blink/overlays.h"
@@ -24,6 +25,8 @@
 #define VFS_SYSTEM_ROOT_MOUNT "/SystemRoot"
 #define VFS_PATH_MAX          MAX(PATH_MAX, 4096)
 #define VFS_NAME_MAX          256
+#define VFS_FD_CHUNK          256   // slots allocated at once in fd table
+#define VFS_FD_CHUNKS         4096  // fd table holds up to 1048576 fds
 
 struct VfsDevice;
 struct VfsMount;
@@ -35,9 +38,11 @@ struct VfsMap;
 struct Vfs {
   struct Dll *devices GUARDED_BY(lock);
   struct Dll *systems GUARDED_BY(lock);
-  struct Dll *fds GUARDED_BY(lock);
+  _Atomic(struct VfsFd *) fds[VFS_FD_CHUNKS];  // written under fdslock
   struct Dll *maps GUARDED_BY(mapslock);
+  _Atomic(u32) umask;  // mirrors host umask for in-memory file systems
   pthread_mutex_t_ lock;
+  pthread_mutex_t_ fdslock;
   pthread_mutex_t_ mapslock;
 };
 
@@ -76,6 +81,12 @@ struct VfsOps {
   off_t (*Seek)(struct VfsInfo *, off_t, int);
   int (*Fsync)(struct VfsInfo *);
   int (*Fdatasync)(struct VfsInfo *);
+#ifdef HAVE_FALLOCATE
+  int (*Fallocate)(struct VfsInfo *, int, off_t, off_t);
+#endif
+#ifdef HAVE_POSIX_FADVISE
+  int (*Fadvise)(struct VfsInfo *, off_t, off_t, int);
+#endif
   int (*Flock)(struct VfsInfo *, int);
   int (*Fcntl)(struct VfsInfo *, int, va_list);
   int (*Ioctl)(struct VfsInfo *, unsigned long, const void *);
@@ -151,12 +162,20 @@ struct VfsSystem {
 struct VfsMount {
   u64 baseino;
   struct VfsInfo *root;
-  struct Dll elem;
+};
+
+// immutable snapshot of the mounts on a device, which path traversal
+// reads without locking. VfsMount() publishes a copy with an extra
+// entry, and keeps the old snapshot around until the device is freed
+struct VfsMounts {
+  int n;
+  struct VfsMounts *prev;
+  struct VfsMount *p[];
 };
 
 struct VfsDevice {
   pthread_mutex_t_ lock;
-  struct Dll *mounts;
+  _Atomic(struct VfsMounts *) mounts;
   struct VfsOps *ops;
   struct VfsInfo *root;
   void *data;
@@ -179,12 +198,9 @@ struct VfsInfo {
 };
 
 extern struct Vfs g_vfs;
-extern struct VfsInfo *g_cwdinfo;
-extern struct VfsInfo *g_rootinfo;
 extern struct VfsInfo *g_actualrootinfo;
 
 #define VFS_SYSTEM_CONTAINER(e) DLL_CONTAINER(struct VfsSystem, elem, (e))
-#define VFS_MOUNT_CONTAINER(e)  DLL_CONTAINER(struct VfsMount, elem, (e))
 #define VFS_DEVICE_CONTAINER(e) DLL_CONTAINER(struct VfsDevice, elem, (e))
 
 #if !defined(DISABLE_VFS)
@@ -195,6 +211,7 @@ int VfsMount(const char *, const char *, const char *, u64, const void *);
 int VfsUnlink(int, const char *, int);
 int VfsMkdir(int, const char *, mode_t);
 int VfsMkfifo(int, const char *, mode_t);
+mode_t VfsUmask(mode_t);
 int VfsOpen(int, const char *, int, int);
 int VfsChmod(int, const char *, mode_t, int);
 int VfsAccess(int, const char *, mode_t, int);
@@ -223,6 +240,8 @@ int VfsFchmod(int, mode_t);
 int VfsFchdir(int);
 int VfsFsync(int);
 int VfsFdatasync(int);
+int VfsFallocate(int, int, off_t, off_t);
+int VfsFadvise(int, off_t, off_t, int);
 int VfsFlock(int, int);
 int VfsFcntl(int, int, ...);
 int VfsIoctl(int, unsigned long, void *);
@@ -258,6 +277,9 @@ int VfsPipe2(int[2], int);
 #endif
 int VfsSocket(int, int, int);
 int VfsSocketpair(int, int, int, int[2]);
+int VfsGetHostFd(int);
+int VfsWrapFd(int);
+int VfsIsDevZero(int);
 
 int VfsTcgetattr(int, struct termios *);
 int VfsTcsetattr(int, int, const struct termios *);
@@ -281,6 +303,8 @@ int VfsRegister(struct VfsSystem *);
 int VfsTraverse(const char *, struct VfsInfo **, bool);
 int VfsCreateInfo(struct VfsInfo **);
 int VfsAcquireInfo(struct VfsInfo *, struct VfsInfo **);
+int VfsAcquireCwd(struct VfsInfo **);
+int VfsAcquireRoot(struct VfsInfo **);
 int VfsCreateDevice(struct VfsDevice **output);
 int VfsAcquireDevice(struct VfsDevice *, struct VfsDevice **);
 int VfsFreeDevice(struct VfsDevice *);
@@ -303,14 +327,15 @@ ssize_t VfsPathBuild(struct VfsInfo *, struct VfsInfo *, bool,
 #define VfsOpen        OverlaysOpen
 #define VfsSymlink     OverlaysSymlink
 #define VfsMkfifo      OverlaysMkfifo
+#define VfsUmask       umask
 #define VfsUnlink      OverlaysUnlink
 #define VfsRename      OverlaysRename
 #define VfsLink        OverlaysLink
 #define VfsUtime       OverlaysUtime
-#define VfsFchown      fchown
-#define VfsFchdir      fchdir
-#define VfsFchmod      fchmod
-#define VfsFutime      futimens
+#define VfsFchown      OverlaysFchown
+#define VfsFchdir      OverlaysFchdir
+#define VfsFchmod      OverlaysFchmod
+#define VfsFutime      OverlaysFutime
 #define VfsFstat       fstat
 #define VfsFtruncate   ftruncate
 #define VfsClose       close
@@ -325,6 +350,8 @@ ssize_t VfsPathBuild(struct VfsInfo *, struct VfsInfo *, bool,
 #define VfsSeek        lseek
 #define VfsFsync       fsync
 #define VfsFdatasync   fdatasync
+#define VfsFallocate   fallocate
+#define VfsFadvise     posix_fadvise
 #define VfsFlock       flock
 #define VfsFcntl       fcntl
 #define VfsDup         dup
@@ -332,12 +359,12 @@ ssize_t VfsPathBuild(struct VfsInfo *, struct VfsInfo *, bool,
 #define VfsDup3        dup3
 #define VfsPoll        poll
 #define VfsSelect      pselect
-#define VfsOpendir     fdopendir
-#define VfsSeekdir     seekdir
-#define VfsTelldir     telldir
-#define VfsReaddir     readdir
-#define VfsRewinddir   rewinddir
-#define VfsClosedir    closedir
+#define VfsOpendir     OverlaysOpendir
+#define VfsSeekdir     OverlaysSeekdir
+#define VfsTelldir     OverlaysTelldir
+#define VfsReaddir     OverlaysReaddir
+#define VfsRewinddir   OverlaysRewinddir
+#define VfsClosedir    OverlaysClosedir
 #define VfsPipe        pipe
 #define VfsPipe2       pipe2
 #define VfsSocket      socket
@@ -369,6 +396,9 @@ ssize_t VfsPathBuild(struct VfsInfo *, struct VfsInfo *, bool,
 #define VfsMunmap      munmap
 #define VfsMprotect    mprotect
 #define VfsMsync       msync
+#define VfsGetHostFd(fd) (fd)
+#define VfsWrapFd(fd)    (fd)
+#define VfsIsDevZero(fd) 0
 #else
 #define VfsChown       fchownat
 #define VfsAccess      faccessat
@@ -381,6 +411,7 @@ ssize_t VfsPathBuild(struct VfsInfo *, struct VfsInfo *, bool,
 #define VfsOpen        openat
 #define VfsSymlink     symlinkat
 #define VfsMkfifo      mkfifoat
+#define VfsUmask       umask
 #define VfsUnlink      unlinkat
 #define VfsRename      renameat
 #define VfsLink        linkat
@@ -403,6 +434,8 @@ ssize_t VfsPathBuild(struct VfsInfo *, struct VfsInfo *, bool,
 #define VfsSeek        lseek
 #define VfsFsync       fsync
 #define VfsFdatasync   fdatasync
+#define VfsFallocate   fallocate
+#define VfsFadvise     posix_fadvise
 #define VfsFlock       flock
 #define VfsFcntl       fcntl
 #define VfsDup         dup
@@ -447,6 +480,9 @@ ssize_t VfsPathBuild(struct VfsInfo *, struct VfsInfo *, bool,
 #define VfsMunmap      munmap
 #define VfsMprotect    mprotect
 #define VfsMsync       msync
+#define VfsGetHostFd(fd) (fd)
+#define VfsWrapFd(fd)    (fd)
+#define VfsIsDevZero(fd) 0
 #endif
 
 #endif /* BLINK_VFS_H_ */
@@ -49,6 +49,10 @@
 #include "blink/sigwinch.h"
 #include "blink/util.h"
 
+#ifdef HAVE_SYS_SYSMACROS_H
+#include <sys/sysmacros.h>
+#endif
+
 #if defined(__APPLE__) || defined(__NetBSD__)
 #define st_atim st_atimespec
 #define st_ctim st_ctimespec
@@ -753,6 +757,54 @@ int XlatWait(int x) {
   return r;
 }
 
+#ifdef HAVE_MEMFD_CREATE
+#if !defined(F_SEAL_EXEC) && defined(__linux)
+#define F_SEAL_EXEC 0x0020  // linux 6.3+
+#endif
+
+static const struct {
+  int guest, host;
+} kSeals[] = {
+    {F_SEAL_SEAL_LINUX, F_SEAL_SEAL},
+    {F_SEAL_SHRINK_LINUX, F_SEAL_SHRINK},
+    {F_SEAL_GROW_LINUX, F_SEAL_GROW},
+    {F_SEAL_WRITE_LINUX, F_SEAL_WRITE},
+#ifdef F_SEAL_FUTURE_WRITE
+    {F_SEAL_FUTURE_WRITE_LINUX, F_SEAL_FUTURE_WRITE},
+#endif
+#ifdef F_SEAL_EXEC
+    {F_SEAL_EXEC_LINUX, F_SEAL_EXEC},
+#endif
+};
+
+int XlatSeals(int x) {
+  int r = 0;
+  unsigned i;
+  for (i = 0; i < ARRAYLEN(kSeals); ++i) {
+    if (x & kSeals[i].guest) {
+      r |= kSeals[i].host;
+      x &= ~kSeals[i].guest;
+    }
+  }
+  if (x) {
+    LOGF("%s %d not supported yet", "seals", x);
+    return einval();
+  }
+  return r;
+}
+
+int UnXlatSeals(int x) {
+  int r = 0;
+  unsigned i;
+  for (i = 0; i < ARRAYLEN(kSeals); ++i) {
+    if (x & kSeals[i].host) {
+      r |= kSeals[i].guest;
+    }
+  }
+  return r;
+}
+#endif
+
 int XlatClock(int x, clock_t *clock) {
   // Haiku defines CLOCK_REALTIME as -1
   clock_t res;
@@ -1166,6 +1218,31 @@ void XlatStatToLinux(struct stat_linux *dst, const struct stat *src) {
   Write64(dst->ctim.nsec, src->st_ctim.tv_nsec);
 }
 
+// statx() reports device numbers split into major and minor parts, so
+// we decode st_dev the same way the guest would decode stat() results
+void XlatStatxToLinux(struct statx_linux *dst, const struct stat *src) {
+  memset(dst, 0, sizeof(*dst));
+  Write32(dst->mask, STATX_BASIC_STATS_LINUX);
+  Write32(dst->blksize, src->st_blksize);
+  Write32(dst->nlink, src->st_nlink);
+  Write32(dst->uid, src->st_uid);
+  Write32(dst->gid, src->st_gid);
+  Write16(dst->mode, src->st_mode);
+  Write64(dst->ino, src->st_ino);
+  Write64(dst->size, src->st_size);
+  Write64(dst->blocks, src->st_blocks);
+  Write64(dst->atime.sec, src->st_atim.tv_sec);
+  Write32(dst->atime.nsec, src->st_atim.tv_nsec);
+  Write64(dst->mtime.sec, src->st_mtim.tv_sec);
+  Write32(dst->mtime.nsec, src->st_mtim.tv_nsec);
+  Write64(dst->ctime.sec, src->st_ctim.tv_sec);
+  Write32(dst->ctime.nsec, src->st_ctim.tv_nsec);
+  Write32(dst->rdev_major, major(src->st_rdev));
+  Write32(dst->rdev_minor, minor(src->st_rdev));
+  Write32(dst->dev_major, major(src->st_dev));
+  Write32(dst->dev_minor, minor(src->st_dev));
+}
+
 void XlatRusageToLinux(struct rusage_linux *dst, const struct rusage *src) {
   Write64(dst->utime.sec, src->ru_utime.tv_sec);
   Write64(dst->utime.usec, src->ru_utime.tv_usec);
@@ -1238,6 +1315,24 @@ void XlatLinuxToItimerval(struct itimerval *dst,
   dst->it_value.tv_usec = Read64(src->value.usec);
 }
 
+#ifdef HAVE_TIMERFD
+void XlatItimerspecToLinux(struct itimerspec_linux *dst,
+                           const struct itimerspec *src) {
+  Write64(dst->interval.sec, src->it_interval.tv_sec);
+  Write64(dst->interval.nsec, src->it_interval.tv_nsec);
+  Write64(dst->value.sec, src->it_value.tv_sec);
+  Write64(dst->value.nsec, src->it_value.tv_nsec);
+}
+
+void XlatLinuxToItimerspec(struct itimerspec *dst,
+                           const struct itimerspec_linux *src) {
+  dst->it_interval.tv_sec = Read64(src->interval.sec);
+  dst->it_interval.tv_nsec = Read64(src->interval.nsec);
+  dst->it_value.tv_sec = Read64(src->value.sec);
+  dst->it_value.tv_nsec = Read64(src->value.nsec);
+}
+#endif
+
 void XlatWinsizeToLinux(struct winsize_linux *dst, const struct winsize *src) {
   memset(dst, 0, sizeof(*dst));
   Write16(dst->row, src->ws_row);
@@ -1923,6 +2018,22 @@ void XlatTermiosToLinux(struct termios_linux *dst, const struct termios *src) {
   UnXlatTermiosCc(dst, src);
 }
 
+#ifdef HAVE_POSIX_FADVISE
+int XlatFadvise(int x) {
+  switch (x) {
+    XLAT(POSIX_FADV_NORMAL_LINUX, POSIX_FADV_NORMAL);
+    XLAT(POSIX_FADV_RANDOM_LINUX, POSIX_FADV_RANDOM);
+    XLAT(POSIX_FADV_SEQUENTIAL_LINUX, POSIX_FADV_SEQUENTIAL);
+    XLAT(POSIX_FADV_WILLNEED_LINUX, POSIX_FADV_WILLNEED);
+    XLAT(POSIX_FADV_DONTNEED_LINUX, POSIX_FADV_DONTNEED);
+    XLAT(POSIX_FADV_NOREUSE_LINUX, POSIX_FADV_NOREUSE);
+    default:
+      LOGF("unrecognized fadvise advice: %d", x);
+      return einval();
+  }
+}
+#endif
+
 int XlatWhence(int x) {
   switch (x) {
     XLAT(SEEK_SET_LINUX, SEEK_SET);
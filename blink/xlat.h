@@ -9,7 +9,9 @@
 #include <sys/statvfs.h>
 #include <sys/time.h>
 #include <termios.h>
+#include <time.h>
 
+#include "blink/builtin.h"
 #include "blink/linux.h"
 
 int UnXlatSiCode(int, int);
@@ -17,13 +19,16 @@ int UnXlatOpenFlags(int);
 int UnXlatAccMode(int);
 int UnXlatSignal(int);
 int UnXlatItimer(int);
+int UnXlatSeals(int);
 int XlatAccess(int);
 int XlatClock(int, clock_t *);
 int XlatErrno(int);
+int XlatFadvise(int);
 int XlatOpenFlags(int);
 int XlatAccMode(int);
 int XlatResource(int);
 int XlatRusage(int);
+int XlatSeals(int);
 int XlatShutdown(int);
 int XlatSignal(int);
 int XlatSocketFamily(int);
@@ -39,9 +44,16 @@ int XlatSockaddrToHost(struct sockaddr_storage *, const struct sockaddr_linux *,
 int XlatSockaddrToLinux(struct sockaddr_storage_linux *,
                         const struct sockaddr *, socklen_t);
 void XlatStatToLinux(struct stat_linux *, const struct stat *);
+void XlatStatxToLinux(struct statx_linux *, const struct stat *);
 void XlatRusageToLinux(struct rusage_linux *, const struct rusage *);
 void XlatItimervalToLinux(struct itimerval_linux *, const struct itimerval *);
 void XlatLinuxToItimerval(struct itimerval *, const struct itimerval_linux *);
+#ifdef HAVE_TIMERFD
+void XlatItimerspecToLinux(struct itimerspec_linux *,
+                           const struct itimerspec *);
+void XlatLinuxToItimerspec(struct itimerspec *,
+                           const struct itimerspec_linux *);
+#endif
 void XlatLinuxToTermios(struct termios *, const struct termios_linux *);
 void XlatTermiosToLinux(struct termios_linux *, const struct termios *);
 void XlatWinsizeToLinux(struct winsize_linux *, const struct winsize *);
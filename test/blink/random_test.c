@@ -0,0 +1,58 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2022 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <string.h>
+
+#include "blink/random.h"
+#include "test/test.h"
+
+void SetUp(void) {
+}
+
+void TearDown(void) {
+}
+
+// RFC 8439 §2.3.2
+TEST(ChaCha20, testBlockFunction) {
+  int i;
+  u8 key[32], out[64];
+  static const u8 kNonce[12] = {0, 0, 0, 9, 0, 0, 0, 0x4a};
+  static const u8 kWant[64] = {
+      0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15,  //
+      0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,  //
+      0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03,  //
+      0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,  //
+      0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09,  //
+      0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,  //
+      0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9,  //
+      0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e,  //
+  };
+  for (i = 0; i < 32; ++i) key[i] = i;
+  ChaCha20(out, key, 1, kNonce);
+  EXPECT_EQ(0, memcmp(kWant, out, 64));
+}
+
+TEST(GetFastRandom, testOutputDiffers) {
+  int i, n;
+  u8 a[4096], b[4096];
+  GetFastRandom(a, sizeof(a));
+  GetFastRandom(b, sizeof(b));
+  EXPECT_NE(0, memcmp(a, b, sizeof(a)));
+  for (n = i = 0; i < sizeof(a); ++i) n += !a[i];
+  EXPECT_LT(n, 64);
+}
@@ -0,0 +1,150 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+// checks the format of the statistics blink exposes in /proc/blink,
+// which only exists under blink builds with the vfs and procfs.
+
+char buf[256 * 1024];
+
+void SetUp(void) {
+  struct utsname u;
+  ASSERT_EQ(0, uname(&u));
+  if (!strstr(u.release, "-blink-")) {
+    fprintf(stderr, "blinkstats_test: skipped since it needs blink\n");
+    exit(77);
+  }
+  if (access("/proc/blink", F_OK)) {
+    fprintf(stderr, "blinkstats_test: skipped since blink has no procfs\n");
+    exit(77);
+  }
+}
+
+void TearDown(void) {
+}
+
+// reads file in chunks of `chunk` bytes
+const char *Slurp(const char *path, size_t chunk) {
+  int fd;
+  ssize_t rc;
+  size_t n = 0;
+  ASSERT_NE(-1, (fd = open(path, O_RDONLY)));
+  while ((rc = read(fd, buf + n, chunk)) > 0) {
+    n += rc;
+    ASSERT_LT(n + chunk, sizeof(buf));
+  }
+  ASSERT_EQ(0, rc);
+  ASSERT_EQ(0, read(fd, buf + n, chunk));
+  ASSERT_EQ(0, close(fd));
+  buf[n] = 0;
+  return buf;
+}
+
+// returns value of `name` in a rendering of stats, or -1 if absent
+double GetStat(const char *p, const char *name) {
+  size_t n = strlen(name);
+  for (; *p; p = strchr(p, '\n') + 1) {
+    if (!strncmp(p, name, n) && p[n] == ' ') {
+      return strtod(strchr(p, '=') + 1, 0);
+    }
+  }
+  return -1;
+}
+
+// returns count for system call `ordinal`, or zero if absent
+long GetSyscall(const char *p, int ordinal) {
+  int i;
+  long count;
+  for (; *p; p = strchr(p, '\n') + 1) {
+    ASSERT_EQ(2, sscanf(p, "%d %ld", &i, &count));
+    if (i == ordinal) return count;
+  }
+  return 0;
+}
+
+// checks every line is `name = value` with a nonzero value
+void CheckStats(const char *p, int *lines) {
+  int n;
+  double x;
+  char name[64];
+  ASSERT_EQ('\n', p[strlen(p) - 1]);
+  for (*lines = 0; *p; p = strchr(p, '\n') + 1, ++*lines) {
+    ASSERT_EQ(2, sscanf(p, "%63s = %lf%n", name, &x, &n));
+    ASSERT_EQ('\n', p[n]);
+    ASSERT_NE(0, x);
+    for (n = 0; name[n]; ++n) {
+      ASSERT_TRUE(isalnum(name[n]) || name[n] == '_');
+    }
+  }
+}
+
+TEST(stats, nonzeroCountersByName) {
+  int lines;
+  double syscalls;
+  CheckStats(Slurp("/proc/blink/stats", 4096), &lines);
+  ASSERT_LT(0, lines);
+  ASSERT_LT(0, (syscalls = GetStat(buf, "syscalls")));
+  ASSERT_EQ(-1, GetStat(buf, "syscall"));
+  // every open, read, and close since is counted
+  CheckStats(Slurp("/proc/blink/stats", 4096), &lines);
+  ASSERT_LE(syscalls + 4, GetStat(buf, "syscalls"));
+}
+
+TEST(stats, smallReadsSeeWholeLines) {
+  int lines;
+  CheckStats(Slurp("/proc/blink/stats", 7), &lines);
+  ASSERT_LT(0, lines);
+}
+
+TEST(jit, onlyPathAndJitCounters) {
+  int lines;
+  const char *p;
+  CheckStats(Slurp("/proc/blink/jit", 4096), &lines);
+  for (p = buf; *p; p = strchr(p, '\n') + 1) {
+    ASSERT_TRUE(!strncmp(p, "path_", 5) || !strncmp(p, "jit_", 4));
+  }
+}
+
+TEST(syscalls, countsByOrdinal) {
+  int i, last, ordinal;
+  long count, before;
+  const char *p;
+  before = GetSyscall(Slurp("/proc/blink/syscalls", 4096), SYS_getppid);
+  for (i = 0; i < 100; ++i) syscall(SYS_getppid);
+  ASSERT_LE(before + 100, GetSyscall(Slurp("/proc/blink/syscalls", 4096),
+                                     SYS_getppid));
+  ASSERT_LT(0, GetSyscall(buf, SYS_openat));
+  for (last = -1, p = buf; *p; p = strchr(p, '\n') + 1) {
+    ASSERT_EQ(2, sscanf(p, "%d %ld", &ordinal, &count));
+    ASSERT_LT(last, ordinal);
+    ASSERT_LT(0, count);
+    last = ordinal;
+  }
+  ASSERT_LE(0, last);
+}
@@ -0,0 +1,253 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+// tests the system calls that copy between file descriptors, which are
+// passed to the host when both fds have host fds, and bounced through a
+// buffer otherwise, e.g. for files that only exist in blink's own vfs.
+
+int in, out, p[2];
+char buf[64];
+
+// returns new temporary file holding `data`, at file position zero
+int Temp(const char *data) {
+  int fd;
+  ASSERT_NE(-1, (fd = open("/tmp", O_RDWR | O_TMPFILE, 0644)));
+  ASSERT_EQ(strlen(data), pwrite(fd, data, strlen(data), 0));
+  return fd;
+}
+
+// opens a regular file twice, read-only and write-only
+void OpenBoth(int *ro, int *wo) {
+  int fd;
+  char path[32];
+  strcpy(path, "/tmp/blink.copyfd.XXXXXX");
+  ASSERT_NE(-1, (fd = mkstemp(path)));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_NE(-1, (*ro = open(path, O_RDONLY)));
+  ASSERT_NE(-1, (*wo = open(path, O_WRONLY)));
+  ASSERT_EQ(0, unlink(path));
+}
+
+// asserts `fd` holds exactly `want` at offset zero
+void ExpectFile(int fd, const char *want) {
+  ssize_t n;
+  ASSERT_NE(-1, (n = pread(fd, buf, sizeof(buf) - 1, 0)));
+  buf[n] = 0;
+  ASSERT_STREQ(want, buf);
+}
+
+// asserts the pipe `fd` has exactly `want` ready to be read
+void ExpectPipe(int fd, const char *want) {
+  ssize_t n;
+  ASSERT_NE(-1, (n = read(fd, buf, sizeof(buf) - 1)));
+  buf[n] = 0;
+  ASSERT_STREQ(want, buf);
+}
+
+void SetUp(void) {
+  in = Temp("hello world");
+  out = Temp("");
+  ASSERT_EQ(0, pipe2(p, O_NONBLOCK));
+}
+
+void TearDown(void) {
+  ASSERT_EQ(0, close(p[1]));
+  ASSERT_EQ(0, close(p[0]));
+  ASSERT_EQ(0, close(out));
+  ASSERT_EQ(0, close(in));
+}
+
+TEST(sendfile, withOffset_leavesFilePositionAlone) {
+  off_t off = 6;
+  ASSERT_EQ(5, sendfile(out, in, &off, 100));
+  EXPECT_EQ(11, off);
+  EXPECT_EQ(0, lseek(in, 0, SEEK_CUR));
+  EXPECT_EQ(5, lseek(out, 0, SEEK_CUR));
+  ExpectFile(out, "world");
+  ASSERT_EQ(0, sendfile(out, in, &off, 100));
+  EXPECT_EQ(11, off);
+}
+
+TEST(sendfile, withoutOffset_advancesFilePosition) {
+  ASSERT_EQ(6, lseek(in, 6, SEEK_SET));
+  ASSERT_EQ(3, sendfile(out, in, 0, 3));
+  EXPECT_EQ(9, lseek(in, 0, SEEK_CUR));
+  ASSERT_EQ(2, sendfile(out, in, 0, 100));
+  ASSERT_EQ(0, sendfile(out, in, 0, 100));
+  ExpectFile(out, "world");
+}
+
+TEST(sendfile, toPipe) {
+  off_t off = 0;
+  ASSERT_EQ(5, sendfile(p[1], in, &off, 5));
+  ExpectPipe(p[0], "hello");
+}
+
+// blink emulates /dev/zero itself when it's built with its vfs, so it
+// has no host fd and the data has to be bounced
+TEST(sendfile, fromDevZero) {
+  int fd;
+  ASSERT_NE(-1, (fd = open("/dev/zero", O_RDONLY)));
+  ASSERT_EQ(10, sendfile(p[1], fd, 0, 10));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(10, read(p[0], buf, sizeof(buf)));
+  EXPECT_EQ(0, memcmp(buf, "\0\0\0\0\0\0\0\0\0\0", 10));
+}
+
+TEST(sendfile, errors) {
+  int ro, wo;
+  off_t off = -1;
+  OpenBoth(&ro, &wo);
+  ASSERT_EQ(-1, sendfile(out, in, &off, 5));
+  EXPECT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, sendfile(out, -1, 0, 5));
+  EXPECT_EQ(EBADF, errno);
+  ASSERT_EQ(-1, sendfile(-1, in, 0, 5));
+  EXPECT_EQ(EBADF, errno);
+  ASSERT_EQ(-1, sendfile(out, wo, 0, 5));
+  EXPECT_EQ(EBADF, errno);
+  ASSERT_EQ(-1, sendfile(ro, in, 0, 5));
+  EXPECT_EQ(EBADF, errno);
+  EXPECT_EQ(0, lseek(in, 0, SEEK_CUR));
+  ASSERT_EQ(0, close(wo));
+  ASSERT_EQ(0, close(ro));
+}
+
+TEST(copy_file_range, withOffsets_leavesFilePositionsAlone) {
+  loff_t inoff = 6, outoff = 2;
+  ASSERT_EQ(2, pwrite(out, "..", 2, 0));
+  ASSERT_EQ(5, copy_file_range(in, &inoff, out, &outoff, 100, 0));
+  EXPECT_EQ(11, inoff);
+  EXPECT_EQ(7, outoff);
+  EXPECT_EQ(0, lseek(in, 0, SEEK_CUR));
+  EXPECT_EQ(0, lseek(out, 0, SEEK_CUR));
+  ExpectFile(out, "..world");
+  ASSERT_EQ(0, copy_file_range(in, &inoff, out, &outoff, 100, 0));
+}
+
+TEST(copy_file_range, withoutOffsets_advancesFilePositions) {
+  ASSERT_EQ(1, lseek(out, 1, SEEK_SET));
+  ASSERT_EQ(5, copy_file_range(in, 0, out, 0, 5, 0));
+  EXPECT_EQ(5, lseek(in, 0, SEEK_CUR));
+  EXPECT_EQ(6, lseek(out, 0, SEEK_CUR));
+  ASSERT_EQ(6, copy_file_range(in, 0, out, 0, 100, 0));
+  EXPECT_EQ(11, lseek(in, 0, SEEK_CUR));
+  ASSERT_EQ(12, pread(out, buf, sizeof(buf), 0));
+  EXPECT_EQ(0, buf[0]);
+  EXPECT_EQ(0, memcmp(buf + 1, "hello world", 11));
+}
+
+TEST(copy_file_range, errors) {
+  int ro, wo;
+  loff_t off = -1;
+  OpenBoth(&ro, &wo);
+  ASSERT_EQ(-1, copy_file_range(in, 0, out, 0, 5, 1));
+  EXPECT_EQ(EINVAL, errno);
+  // linux checks for wraparound first, which negative offsets cause
+  ASSERT_EQ(-1, copy_file_range(in, &off, out, 0, 5, 0));
+  EXPECT_EQ(EOVERFLOW, errno);
+  ASSERT_EQ(-1, copy_file_range(in, 0, out, &off, 5, 0));
+  EXPECT_EQ(EOVERFLOW, errno);
+  ASSERT_EQ(-1, copy_file_range(in, 0, p[1], 0, 5, 0));
+  EXPECT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, copy_file_range(-1, 0, out, 0, 5, 0));
+  EXPECT_EQ(EBADF, errno);
+  ASSERT_EQ(-1, copy_file_range(in, 0, -1, 0, 5, 0));
+  EXPECT_EQ(EBADF, errno);
+  ASSERT_EQ(-1, copy_file_range(wo, 0, out, 0, 5, 0));
+  EXPECT_EQ(EBADF, errno);
+  ASSERT_EQ(-1, copy_file_range(in, 0, ro, 0, 5, 0));
+  EXPECT_EQ(EBADF, errno);
+  ASSERT_EQ(0, close(wo));
+  ASSERT_EQ(0, close(ro));
+}
+
+TEST(splice, fileToPipe_withOffset) {
+  loff_t off = 6;
+  ASSERT_EQ(5, splice(in, &off, p[1], 0, 100, 0));
+  EXPECT_EQ(11, off);
+  EXPECT_EQ(0, lseek(in, 0, SEEK_CUR));
+  ExpectPipe(p[0], "world");
+}
+
+TEST(splice, pipeToFile_shortCount) {
+  loff_t off = 3;
+  ASSERT_EQ(5, write(p[1], "hello", 5));
+  ASSERT_EQ(2, splice(p[0], 0, out, 0, 2, 0));
+  EXPECT_EQ(2, lseek(out, 0, SEEK_CUR));
+  ASSERT_EQ(3, splice(p[0], 0, out, &off, 100, 0));
+  EXPECT_EQ(6, off);
+  EXPECT_EQ(2, lseek(out, 0, SEEK_CUR));
+  ASSERT_EQ(6, pread(out, buf, sizeof(buf), 0));
+  EXPECT_EQ(0, memcmp(buf, "he\0llo", 6));
+  // the pipe is now empty
+  ASSERT_EQ(-1, splice(p[0], 0, out, 0, 100, SPLICE_F_NONBLOCK));
+  EXPECT_EQ(EAGAIN, errno);
+}
+
+TEST(splice, errors) {
+  loff_t off = 0;
+  ASSERT_EQ(-1, splice(in, 0, p[1], 0, 5, 0x100));
+  EXPECT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, splice(p[0], &off, out, 0, 5, SPLICE_F_NONBLOCK));
+  EXPECT_EQ(ESPIPE, errno);
+  ASSERT_EQ(-1, splice(in, 0, out, 0, 5, 0));
+  EXPECT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, splice(-1, 0, p[1], 0, 5, 0));
+  EXPECT_EQ(EBADF, errno);
+  ASSERT_EQ(-1, splice(in, 0, -1, 0, 5, 0));
+  EXPECT_EQ(EBADF, errno);
+  ASSERT_EQ(-1, splice(p[1], 0, out, 0, 5, 0));
+  EXPECT_EQ(EBADF, errno);
+}
+
+TEST(tee, duplicatesPipeData) {
+  int q[2];
+  ASSERT_EQ(0, pipe2(q, O_NONBLOCK));
+  ASSERT_EQ(5, write(p[1], "hello", 5));
+  ASSERT_EQ(3, tee(p[0], q[1], 3, 0));
+  ExpectPipe(q[0], "hel");
+  ASSERT_EQ(5, tee(p[0], q[1], 100, 0));
+  ExpectPipe(q[0], "hello");
+  ExpectPipe(p[0], "hello");
+  ASSERT_EQ(-1, tee(p[0], q[1], 100, SPLICE_F_NONBLOCK));
+  EXPECT_EQ(EAGAIN, errno);
+  ASSERT_EQ(0, close(q[1]));
+  ASSERT_EQ(0, close(q[0]));
+}
+
+TEST(tee, errors) {
+  ASSERT_EQ(-1, tee(in, p[1], 5, 0));
+  EXPECT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, tee(p[0], out, 5, 0));
+  EXPECT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, tee(p[0], p[1], 5, 0x100));
+  EXPECT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, tee(-1, p[1], 5, 0));
+  EXPECT_EQ(EBADF, errno);
+  ASSERT_EQ(-1, tee(p[1], p[1], 5, 0));
+  EXPECT_EQ(EBADF, errno);
+}
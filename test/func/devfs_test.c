@@ -0,0 +1,181 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+// blink serves reads and writes of these devices itself when it's built
+// with its vfs, so they're checked to behave like they do on linux.
+
+#define N (3 * 4096 + 123)
+
+int fd;
+unsigned char buf[N], buf2[N];
+
+void SetUp(void) {
+  fd = -1;
+  memset(buf, 0x55, sizeof(buf));
+}
+
+void TearDown(void) {
+  if (fd != -1) ASSERT_EQ(0, close(fd));
+}
+
+void ExpectDevice(const char *path, int minor) {
+  struct stat st;
+  ASSERT_NE(-1, (fd = open(path, O_RDWR)));
+  ASSERT_EQ(0, fstat(fd, &st));
+  EXPECT_TRUE(S_ISCHR(st.st_mode));
+  EXPECT_EQ(1, major(st.st_rdev));
+  EXPECT_EQ(minor, minor(st.st_rdev));
+}
+
+int CountZeros(const unsigned char *p, size_t n) {
+  int i, z;
+  for (z = i = 0; i < n; ++i) z += !p[i];
+  return z;
+}
+
+TEST(null, readIsEofAndWriteSucceeds) {
+  ExpectDevice("/dev/null", 3);
+  ASSERT_EQ(0, read(fd, buf, N));
+  ASSERT_EQ(0, pread(fd, buf, N, 100));
+  EXPECT_EQ(0x55, buf[0]);
+  ASSERT_EQ(N, write(fd, buf, N));
+  ASSERT_EQ(N, pwrite(fd, buf, N, 100));
+  ASSERT_EQ(N + 1, writev(fd, (struct iovec[]){{buf, N}, {buf, 1}}, 2));
+}
+
+TEST(null, cantBeMapped) {
+  ExpectDevice("/dev/null", 3);
+  ASSERT_EQ((intptr_t)MAP_FAILED,
+            (intptr_t)mmap(0, 4096, PROT_READ, MAP_PRIVATE, fd, 0));
+  EXPECT_EQ(ENODEV, errno);
+}
+
+TEST(zero, readFillsBuffer) {
+  ExpectDevice("/dev/zero", 5);
+  ASSERT_EQ(N, read(fd, buf, N));
+  EXPECT_EQ(N, CountZeros(buf, N));
+  memset(buf, 0x55, N);
+  ASSERT_EQ(N - 93,
+            readv(fd, (struct iovec[]){{buf, 7}, {buf + 100, N - 100}}, 2));
+  EXPECT_EQ(0, buf[6]);
+  EXPECT_EQ(0x55, buf[7]);
+  EXPECT_EQ(N - 100, CountZeros(buf + 100, N - 100));
+  ASSERT_EQ(N, write(fd, buf, N));
+}
+
+TEST(zero, readIntoUnmappedMemoryFails) {
+  char *p;
+  ExpectDevice("/dev/zero", 5);
+  p = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  ASSERT_NE((intptr_t)MAP_FAILED, (intptr_t)p);
+  ASSERT_EQ(0, munmap(p, 4096));
+  ASSERT_EQ(-1, read(fd, p, 16));
+  EXPECT_EQ(EFAULT, errno);
+}
+
+TEST(zero, privateMappingIsZeroedAndWritable) {
+  char *p;
+  ExpectDevice("/dev/zero", 5);
+  p = mmap(0, N, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ASSERT_NE((intptr_t)MAP_FAILED, (intptr_t)p);
+  EXPECT_EQ(N, CountZeros((unsigned char *)p, N));
+  p[N - 1] = 1;
+  ASSERT_EQ(0, munmap(p, N));
+}
+
+TEST(zero, sharedMappingIsSharedWithChildren) {
+  int ws, pid;
+  volatile char *p;
+  ExpectDevice("/dev/zero", 5);
+  p = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ASSERT_NE((intptr_t)MAP_FAILED, (intptr_t)p);
+  EXPECT_EQ(0, p[0]);
+  ASSERT_NE(-1, (pid = fork()));
+  if (!pid) {
+    p[0] = 42;
+    _exit(0);
+  }
+  ASSERT_EQ(pid, waitpid(pid, &ws, 0));
+  ASSERT_EQ(0, ws);
+  EXPECT_EQ(42, p[0]);
+  ASSERT_EQ(0, munmap((void *)p, 4096));
+}
+
+TEST(urandom, readsDiffer) {
+  ExpectDevice("/dev/urandom", 9);
+  ASSERT_EQ(N, read(fd, buf, N));
+  ASSERT_EQ(N, pread(fd, buf2, N, 0));
+  EXPECT_NE(0, memcmp(buf, buf2, N));
+  EXPECT_LT(CountZeros(buf, N), N / 128);
+  ASSERT_EQ(N, write(fd, buf, N));
+}
+
+TEST(urandom, largeReadsAreFilled) {
+  int i;
+  unsigned char *p;
+  ExpectDevice("/dev/urandom", 9);
+  // crosses the point where blink's generator reseeds itself
+  ASSERT_NOTNULL((p = malloc(3 * 1024 * 1024)));
+  memset(p, 0, 3 * 1024 * 1024);
+  for (i = 0; i < 3; ++i) {
+    ASSERT_EQ(1024 * 1024, read(fd, p + i * 1024 * 1024, 1024 * 1024));
+  }
+  EXPECT_LT(CountZeros(p, 3 * 1024 * 1024), 3 * 1024 * 1024 / 128);
+  EXPECT_NE(0, memcmp(p, p + 2 * 1024 * 1024, 1024 * 1024));
+  free(p);
+}
+
+TEST(urandom, childrenDontRepeatTheirParent) {
+  int ws, pid, pfds[2];
+  ExpectDevice("/dev/urandom", 9);
+  ASSERT_EQ(0, pipe(pfds));
+  ASSERT_NE(-1, (pid = fork()));
+  if (!pid) {
+    if (read(fd, buf2, 64) != 64) _exit(1);
+    if (write(pfds[1], buf2, 64) != 64) _exit(2);
+    _exit(0);
+  }
+  ASSERT_EQ(64, read(fd, buf, 64));
+  ASSERT_EQ(64, read(pfds[0], buf2, 64));
+  ASSERT_EQ(pid, waitpid(pid, &ws, 0));
+  ASSERT_EQ(0, ws);
+  EXPECT_NE(0, memcmp(buf, buf2, 64));
+  ASSERT_EQ(0, close(pfds[1]));
+  ASSERT_EQ(0, close(pfds[0]));
+}
+
+TEST(urandom, cantBeMapped) {
+  ExpectDevice("/dev/urandom", 9);
+  ASSERT_EQ((intptr_t)MAP_FAILED,
+            (intptr_t)mmap(0, 4096, PROT_READ, MAP_PRIVATE, fd, 0));
+  EXPECT_EQ(ENODEV, errno);
+}
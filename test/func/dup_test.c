@@ -0,0 +1,127 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+int a[2], b[2];
+
+void SetUp(void) {
+  ASSERT_EQ(0, pipe(a));
+  ASSERT_EQ(0, pipe(b));
+}
+
+void TearDown(void) {
+  close(a[0]);
+  close(a[1]);
+  close(b[0]);
+  close(b[1]);
+}
+
+// asserts `fd` is the read end of the pipe `p`
+void ExpectReadsFrom(int fd, int p[2]) {
+  char c;
+  ASSERT_EQ(1, write(p[1], "x", 1));
+  ASSERT_EQ(1, read(fd, &c, 1));
+  ASSERT_EQ('x', c);
+}
+
+TEST(dup2, overLiveFd_replacesIt) {
+  struct stat st1, st2;
+  ASSERT_EQ(b[0], dup2(a[0], b[0]));
+  ASSERT_EQ(0, fstat(a[0], &st1));
+  ASSERT_EQ(0, fstat(b[0], &st2));
+  EXPECT_EQ(st1.st_ino, st2.st_ino);
+  ExpectReadsFrom(b[0], a);
+  // the original stays open and still works after the copy is closed
+  ASSERT_EQ(0, close(b[0]));
+  ASSERT_EQ(-1, fcntl(b[0], F_GETFD));
+  ASSERT_EQ(EBADF, errno);
+  ExpectReadsFrom(a[0], a);
+}
+
+TEST(dup2, closeOriginal_copySurvives) {
+  ASSERT_EQ(b[0], dup2(a[0], b[0]));
+  ASSERT_EQ(0, close(a[0]));
+  ASSERT_EQ(-1, fcntl(a[0], F_GETFD));
+  ASSERT_EQ(EBADF, errno);
+  ExpectReadsFrom(b[0], a);
+}
+
+TEST(dup2, repeatedlyOverSameFd) {
+  int i;
+  for (i = 0; i < 10; ++i) {
+    ASSERT_EQ(b[0], dup2(i & 1 ? a[0] : a[1], b[0]));
+  }
+  ExpectReadsFrom(b[0], a);
+  ASSERT_EQ(0, close(b[0]));
+  ASSERT_EQ(-1, close(b[0]));
+  ASSERT_EQ(EBADF, errno);
+  ExpectReadsFrom(a[0], a);
+}
+
+TEST(dup3, cloexecIsPerDescriptor) {
+  ASSERT_EQ(b[0], dup3(a[0], b[0], O_CLOEXEC));
+  EXPECT_EQ(FD_CLOEXEC, fcntl(b[0], F_GETFD));
+  EXPECT_EQ(0, fcntl(a[0], F_GETFD));
+  ASSERT_EQ(b[0], dup2(a[0], b[0]));
+  EXPECT_EQ(0, fcntl(b[0], F_GETFD));
+}
+
+TEST(dup2, highNumberedFd) {
+  ASSERT_EQ(300, dup2(a[0], 300));
+  ExpectReadsFrom(300, a);
+  ASSERT_EQ(301, fcntl(a[0], F_DUPFD, 301));
+  ExpectReadsFrom(301, a);
+  ASSERT_EQ(0, close(300));
+  ASSERT_EQ(-1, fcntl(300, F_GETFD));
+  ASSERT_EQ(EBADF, errno);
+  ASSERT_EQ(0, close(301));
+  ExpectReadsFrom(a[0], a);
+}
+
+TEST(dup2, inheritedByFork) {
+  char c;
+  int ws, pid;
+  ASSERT_EQ(b[0], dup2(a[0], b[0]));
+  ASSERT_EQ(300, dup2(a[1], 300));
+  ASSERT_NE(-1, (pid = fork()));
+  if (!pid) {
+    if (write(300, "y", 1) != 1) _exit(1);
+    if (read(b[0], &c, 1) != 1 || c != 'y') _exit(2);
+    if (close(300) || close(b[0])) _exit(3);
+    if (fcntl(b[0], F_GETFD) != -1 || errno != EBADF) _exit(4);
+    if (write(a[1], "z", 1) != 1) _exit(5);
+    _exit(0);
+  }
+  ASSERT_EQ(pid, waitpid(pid, &ws, 0));
+  ASSERT_TRUE(WIFEXITED(ws));
+  ASSERT_EQ(0, WEXITSTATUS(ws));
+  // the child closing its copies doesn't close the parent's
+  ASSERT_EQ(1, read(b[0], &c, 1));
+  ASSERT_EQ('z', c);
+  ExpectReadsFrom(b[0], a);
+  ASSERT_EQ(0, close(300));
+}
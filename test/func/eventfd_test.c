@@ -0,0 +1,150 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "test/test.h"
+
+void SetUp(void) {
+}
+
+void TearDown(void) {
+}
+
+TEST(eventfd, counter) {
+  int fd, fd2;
+  uint64_t x;
+  ASSERT_NE(-1, (fd = eventfd(3, EFD_NONBLOCK)));
+  x = 4;
+  ASSERT_EQ(8, write(fd, &x, 8));
+  ASSERT_EQ(8, read(fd, &x, 8));
+  ASSERT_EQ(7, x);
+  ASSERT_EQ(-1, read(fd, &x, 8));
+  ASSERT_EQ(EAGAIN, errno);
+  ASSERT_EQ(-1, read(fd, &x, 4));
+  ASSERT_EQ(EINVAL, errno);
+  ASSERT_NE(-1, (fd2 = dup(fd)));
+  x = 1;
+  ASSERT_EQ(8, write(fd2, &x, 8));
+  ASSERT_EQ(8, read(fd, &x, 8));
+  ASSERT_EQ(1, x);
+  ASSERT_EQ(0, close(fd2));
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(eventfd, semaphore) {
+  int fd;
+  uint64_t x;
+  ASSERT_NE(-1, (fd = eventfd(2, EFD_SEMAPHORE | EFD_NONBLOCK)));
+  ASSERT_EQ(8, read(fd, &x, 8));
+  ASSERT_EQ(1, x);
+  ASSERT_EQ(8, read(fd, &x, 8));
+  ASSERT_EQ(1, x);
+  ASSERT_EQ(-1, read(fd, &x, 8));
+  ASSERT_EQ(EAGAIN, errno);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(eventfd, fcntl) {
+  int fd;
+  ASSERT_NE(-1, (fd = eventfd(0, EFD_CLOEXEC)));
+  ASSERT_EQ(FD_CLOEXEC, fcntl(fd, F_GETFD));
+  ASSERT_EQ(0, fcntl(fd, F_GETFL) & O_NONBLOCK);
+  ASSERT_EQ(0, fcntl(fd, F_SETFL, O_NONBLOCK));
+  ASSERT_EQ(O_NONBLOCK, fcntl(fd, F_GETFL) & O_NONBLOCK);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(eventfd, poll) {
+  int fd;
+  uint64_t x = 1;
+  struct pollfd pfd;
+  ASSERT_NE(-1, (fd = eventfd(0, 0)));
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  ASSERT_EQ(0, poll(&pfd, 1, 0));
+  ASSERT_EQ(8, write(fd, &x, 8));
+  ASSERT_EQ(1, poll(&pfd, 1, -1));
+  ASSERT_EQ(POLLIN, pfd.revents);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(timerfd, expire) {
+  int fd;
+  uint64_t x;
+  struct pollfd pfd;
+  struct itimerspec its = {{0, 0}, {0, 10000000}}, cur;
+  ASSERT_NE(-1, (fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)));
+  ASSERT_EQ(-1, read(fd, &x, 8));
+  ASSERT_EQ(EAGAIN, errno);
+  ASSERT_EQ(0, timerfd_settime(fd, 0, &its, 0));
+  ASSERT_EQ(0, timerfd_gettime(fd, &cur));
+  ASSERT_EQ(0, cur.it_interval.tv_sec);
+  ASSERT_EQ(0, cur.it_value.tv_sec);
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  ASSERT_EQ(1, poll(&pfd, 1, 5000));
+  ASSERT_EQ(8, read(fd, &x, 8));
+  ASSERT_EQ(1, x);
+  ASSERT_EQ(0, timerfd_gettime(fd, &cur));
+  ASSERT_EQ(0, cur.it_value.tv_sec);
+  ASSERT_EQ(0, cur.it_value.tv_nsec);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(signalfd, read) {
+  int fd;
+  sigset_t mask, old;
+  struct pollfd pfd;
+  struct signalfd_siginfo si;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  sigaddset(&mask, SIGUSR2);
+  ASSERT_EQ(0, sigprocmask(SIG_BLOCK, &mask, &old));
+  ASSERT_NE(-1, (fd = signalfd(-1, &mask, SFD_NONBLOCK)));
+  ASSERT_EQ(-1, read(fd, &si, sizeof(si)));
+  ASSERT_EQ(EAGAIN, errno);
+  ASSERT_EQ(0, raise(SIGUSR2));
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  ASSERT_EQ(1, poll(&pfd, 1, 5000));
+  ASSERT_EQ(POLLIN, pfd.revents);
+  ASSERT_EQ(sizeof(si), read(fd, &si, sizeof(si)));
+  ASSERT_EQ(SIGUSR2, si.ssi_signo);
+  ASSERT_EQ(SI_TKILL, si.ssi_code);
+  ASSERT_EQ(getpid(), si.ssi_pid);
+  ASSERT_EQ(getuid(), si.ssi_uid);
+  ASSERT_EQ(-1, read(fd, &si, sizeof(si)));
+  ASSERT_EQ(EAGAIN, errno);
+  sigdelset(&mask, SIGUSR2);
+  ASSERT_EQ(fd, signalfd(fd, &mask, 0));
+  ASSERT_EQ(0, kill(getpid(), SIGUSR1));
+  ASSERT_EQ(sizeof(si), read(fd, &si, sizeof(si)));
+  ASSERT_EQ(SIGUSR1, si.ssi_signo);
+  ASSERT_EQ(SI_USER, si.ssi_code);
+  ASSERT_EQ(getpid(), si.ssi_pid);
+  ASSERT_EQ(getuid(), si.ssi_uid);
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, sigprocmask(SIG_SETMASK, &old, 0));
+}
@@ -0,0 +1,129 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// checks that jit paths which survive execve() are only reused for code
+// that's still the same. the program warms up the jit on Answer(), then
+// execs a copy of itself where only the constant Answer() returns has
+// been changed, so it's loaded at the same address with the same layout
+// and any stale translation would make it return the old constant. the
+// unmodified program is exec'd too, to check reused paths still work.
+
+#define CHECK(x)                                          \
+  do {                                                    \
+    if (!(x)) {                                           \
+      fprintf(stderr, "%s:%d: %s failed: %s\n", __FILE__, \
+              __LINE__, #x, strerror(errno));             \
+      exit(1);                                            \
+    }                                                     \
+  } while (0)
+
+#define OLD 0x5eed1111
+#define NEW 0x5eed2222
+
+extern char **environ;
+int Answer(void);
+
+asm(".text\n"
+    "Answer:\n\t"
+    "mov\t$0x5eed1111,%eax\n\t"
+    "ret");
+
+int Warm(void) {
+  int i, x = 0;
+  for (i = 0; i < 100000; ++i) x |= Answer() ^ OLD;
+  return x;
+}
+
+// execs `path` in a subprocess, which must see `want`
+void Exec(const char *path, int want) {
+  int ws, pid;
+  char arg[16];
+  snprintf(arg, sizeof(arg), "%d", want);
+  CHECK((pid = fork()) != -1);
+  if (!pid) {
+    execve(path, (char *[]){(char *)path, arg, 0}, environ);
+    _exit(127);
+  }
+  CHECK(waitpid(pid, &ws, 0) == pid);
+  if (!WIFEXITED(ws) || WEXITSTATUS(ws)) {
+    fprintf(stderr, "exec_test: %s %s failed with status %#x\n", path, arg,
+            ws);
+    exit(1);
+  }
+}
+
+// copies this program to `path`, with Answer() returning `NEW` instead
+void Patch(const char *self, const char *path) {
+  int fd;
+  char *p, *q;
+  size_t i, n, hits;
+  struct stat st;
+  unsigned char insn[5] = {0xb8, OLD & 255, OLD >> 8 & 255, OLD >> 16 & 255,
+                           OLD >> 24 & 255};
+  CHECK((fd = open(self, O_RDONLY)) != -1);
+  CHECK(!fstat(fd, &st));
+  n = st.st_size;
+  CHECK((p = malloc(n)));
+  CHECK(read(fd, p, n) == n);
+  CHECK(!close(fd));
+  for (hits = i = 0; i + sizeof(insn) <= n; ++i) {
+    if (!memcmp(p + i, insn, sizeof(insn))) {
+      q = p + i + 1;
+      ++hits;
+    }
+  }
+  CHECK(hits == 1);
+  q[0] = NEW & 255;
+  q[1] = NEW >> 8 & 255;
+  CHECK((fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0755)) != -1);
+  CHECK(write(fd, p, n) == n);
+  CHECK(!close(fd));
+  free(p);
+}
+
+int main(int argc, char *argv[]) {
+  int i, want;
+  char dir[32], path[64];
+  if (argc > 1) {
+    want = atoi(argv[1]);
+    for (i = 0; i < 100000; ++i) {
+      if (Answer() != want) return 1;
+    }
+    return 0;
+  }
+  CHECK(!Warm());
+  strcpy(dir, "/tmp/blink.exec.XXXXXX");
+  CHECK(mkdtemp(dir));
+  snprintf(path, sizeof(path), "%s/patched", dir);
+  Patch(argv[0], path);
+  Exec(argv[0], OLD);
+  Exec(path, NEW);
+  Exec(argv[0], OLD);
+  CHECK(!unlink(path));
+  CHECK(!rmdir(dir));
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+#define FALLOC_FL_KEEP_SIZE_  1
+#define FALLOC_FL_PUNCH_HOLE_ 2
+#define STATX_BASIC_STATS_    0x7ff
+#define STATX_RESERVED_       0x80000000u
+#define AT_EMPTY_PATH_        0x1000
+
+struct Statx {
+  uint32_t mask, blksize;
+  uint64_t attributes;
+  uint32_t nlink, uid, gid;
+  uint16_t mode, pad1;
+  uint64_t ino, size, blocks, attributes_mask;
+  struct {
+    int64_t sec;
+    uint32_t nsec;
+    int32_t pad;
+  } atime, btime, ctime, mtime;
+  uint32_t rdev_major, rdev_minor, dev_major, dev_minor;
+  uint64_t spare[14];
+};
+
+int fd;
+char path[32];
+
+void SetUp(void) {
+  strcpy(path, "/tmp/blink.fallocate.XXXXXX");
+  ASSERT_NE(-1, (fd = mkstemp(path)));
+}
+
+void TearDown(void) {
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, unlink(path));
+}
+
+int Fallocate(int fd, int mode, off_t offset, off_t len) {
+  return syscall(SYS_fallocate, fd, mode, offset, len);
+}
+
+TEST(fallocate, extends) {
+  struct stat st;
+  ASSERT_EQ(0, Fallocate(fd, 0, 0, 10000));
+  ASSERT_EQ(0, fstat(fd, &st));
+  ASSERT_EQ(10000, st.st_size);
+  ASSERT_EQ(0, Fallocate(fd, FALLOC_FL_KEEP_SIZE_, 0, 20000));
+  ASSERT_EQ(0, fstat(fd, &st));
+  ASSERT_EQ(10000, st.st_size);
+}
+
+TEST(fallocate, punchHole) {
+  char buf[8];
+  struct stat st;
+  ASSERT_EQ(8, pwrite(fd, "abcdefgh", 8, 0));
+  ASSERT_EQ(-1, Fallocate(fd, FALLOC_FL_PUNCH_HOLE_, 0, 4));
+  ASSERT_EQ(EOPNOTSUPP, errno);
+  if (Fallocate(fd, FALLOC_FL_PUNCH_HOLE_ | FALLOC_FL_KEEP_SIZE_, 2, 4)) {
+    ASSERT_EQ(EOPNOTSUPP, errno);  // filesystem can't punch holes
+    return;
+  }
+  ASSERT_EQ(0, fstat(fd, &st));
+  ASSERT_EQ(8, st.st_size);
+  ASSERT_EQ(8, pread(fd, buf, 8, 0));
+  ASSERT_EQ(0, memcmp(buf, "ab\0\0\0\0gh", 8));
+}
+
+TEST(fallocate, errors) {
+  int rfd;
+  ASSERT_EQ(-1, Fallocate(fd, 0, 0, 0));
+  ASSERT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, Fallocate(fd, 0, -1, 1));
+  ASSERT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, Fallocate(-1, 0, 0, 1));
+  ASSERT_EQ(EBADF, errno);
+  ASSERT_NE(-1, (rfd = open(path, O_RDONLY)));
+  ASSERT_EQ(-1, Fallocate(rfd, 0, 0, 1));
+  ASSERT_EQ(EBADF, errno);
+  ASSERT_EQ(0, close(rfd));
+}
+
+TEST(readahead, test) {
+  int p[2];
+  ASSERT_EQ(0, syscall(SYS_readahead, fd, 0, 4096));
+  ASSERT_EQ(0, pipe(p));
+  ASSERT_EQ(-1, syscall(SYS_readahead, p[0], 0, 4096));
+  ASSERT_EQ(EINVAL, errno);
+  ASSERT_EQ(0, close(p[0]));
+  ASSERT_EQ(0, close(p[1]));
+  ASSERT_EQ(-1, syscall(SYS_readahead, -1, 0, 4096));
+  ASSERT_EQ(EBADF, errno);
+}
+
+TEST(statx, test) {
+  struct stat st;
+  struct Statx stx;
+  ASSERT_EQ(5, pwrite(fd, "hello", 5, 0));
+  ASSERT_EQ(0, fstat(fd, &st));
+  memset(&stx, -1, sizeof(stx));
+  ASSERT_EQ(0, syscall(SYS_statx, AT_FDCWD, path, 0, STATX_BASIC_STATS_,
+                       &stx));
+  ASSERT_EQ(STATX_BASIC_STATS_, stx.mask & STATX_BASIC_STATS_);
+  ASSERT_EQ(5, stx.size);
+  ASSERT_EQ(st.st_ino, stx.ino);
+  ASSERT_EQ(st.st_mode, stx.mode);
+  ASSERT_EQ(st.st_nlink, stx.nlink);
+  ASSERT_EQ(st.st_uid, stx.uid);
+  ASSERT_EQ(st.st_mtim.tv_sec, stx.mtime.sec);
+  ASSERT_EQ(st.st_mtim.tv_nsec, stx.mtime.nsec);
+  ASSERT_EQ(major(st.st_dev), stx.dev_major);
+  ASSERT_EQ(minor(st.st_dev), stx.dev_minor);
+  ASSERT_EQ(0, stat("/dev/null", &st));
+  ASSERT_EQ(0, syscall(SYS_statx, AT_FDCWD, "/dev/null", 0,
+                       STATX_BASIC_STATS_, &stx));
+  ASSERT_EQ(major(st.st_rdev), stx.rdev_major);
+  ASSERT_EQ(minor(st.st_rdev), stx.rdev_minor);
+  memset(&stx, -1, sizeof(stx));
+  ASSERT_EQ(0, syscall(SYS_statx, fd, "", AT_EMPTY_PATH_, STATX_BASIC_STATS_,
+                       &stx));
+  ASSERT_EQ(5, stx.size);
+  ASSERT_EQ(-1, syscall(SYS_statx, AT_FDCWD, path, 0, STATX_RESERVED_, &stx));
+  ASSERT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, syscall(SYS_statx, AT_FDCWD, "/nonexistent/x", 0,
+                        STATX_BASIC_STATS_, &stx));
+  ASSERT_EQ(ENOENT, errno);
+}
@@ -0,0 +1,159 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+// blink's vfs looks up descriptors without a lock, and these tests try
+// to catch lookups that see a slot mid-update, or chunks of the table
+// that weren't allocated, by racing reads against close() and dup2()
+
+#define N 100
+
+int fa, fb;
+char path[2][64];
+atomic_int done;
+atomic_int hits;
+
+int Create(char name[64], const char *data) {
+  int fd;
+  strcpy(name, "/tmp/blink.fdtable.XXXXXX");
+  ASSERT_NE(-1, (fd = mkstemp(name)));
+  ASSERT_EQ(1, write(fd, data, 1));
+  return fd;
+}
+
+void SetUp(void) {
+  fa = Create(path[0], "a");
+  fb = Create(path[1], "b");
+  done = 0;
+  hits = 0;
+}
+
+void TearDown(void) {
+  ASSERT_EQ(0, close(fa));
+  ASSERT_EQ(0, close(fb));
+  ASSERT_EQ(0, unlink(path[0]));
+  ASSERT_EQ(0, unlink(path[1]));
+}
+
+void *Reader(void *arg) {
+  char c;
+  ssize_t rc;
+  int fd = (intptr_t)arg;
+  while (!done) {
+    if ((rc = pread(fd, &c, 1, 0)) == 1) {
+      ASSERT_TRUE(c == 'a' || c == 'b');
+      ++hits;
+    } else {
+      ASSERT_EQ(-1, rc);
+      ASSERT_EQ(EBADF, errno);
+    }
+  }
+  return 0;
+}
+
+void StartReader(pthread_t *th, int fd) {
+  ASSERT_EQ(0, pthread_create(th, 0, Reader, (void *)(intptr_t)fd));
+  while (!hits) sched_yield();
+}
+
+TEST(fdtable, readRacesCloseAndDup2) {
+  int i;
+  pthread_t th;
+  ASSERT_EQ(N, dup2(fa, N));
+  StartReader(&th, N);
+  for (i = 0; i < 20000; ++i) {
+    ASSERT_EQ(N, dup2(fa, N));
+    ASSERT_EQ(N, dup2(fb, N));
+    ASSERT_EQ(0, close(N));
+  }
+  done = 1;
+  ASSERT_EQ(0, pthread_join(th, 0));
+}
+
+TEST(fdtable, readRacesCloseAndReopen) {
+  int i, fd;
+  pthread_t th;
+  // the reader's descriptor number keeps getting handed out again
+  ASSERT_NE(-1, (fd = dup(fa)));
+  StartReader(&th, fd);
+  for (i = 0; i < 10000; ++i) {
+    ASSERT_EQ(0, close(fd));
+    ASSERT_EQ(fd, open(path[i & 1], O_RDONLY));
+  }
+  done = 1;
+  ASSERT_EQ(0, pthread_join(th, 0));
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(fdtable, highDescriptors) {
+  char c;
+  struct rlimit rl;
+  int i, n, fds[] = {255, 256, 257, 511, 512, 1000, 0};
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &rl));
+  fds[6] = rl.rlim_cur - 1;
+  for (n = 0, i = 0; i < sizeof(fds) / sizeof(*fds); ++i) {
+    if (fds[i] >= rl.rlim_cur) continue;
+    ASSERT_EQ(fds[i], dup2(i & 1 ? fb : fa, fds[i]));
+    ++n;
+  }
+  ASSERT_LT(3, n);
+  for (i = 0; i < sizeof(fds) / sizeof(*fds); ++i) {
+    if (fds[i] >= rl.rlim_cur) continue;
+    ASSERT_EQ(1, pread(fds[i], &c, 1, 0));
+    ASSERT_EQ(i & 1 ? 'b' : 'a', c);
+  }
+  // the lowest free descriptor is found across chunk boundaries
+  ASSERT_EQ(258, fcntl(fa, F_DUPFD, 255));
+  ASSERT_EQ(0, close(258));
+  ASSERT_EQ(0, close(256));
+  ASSERT_EQ(256, fcntl(fb, F_DUPFD, 255));
+  ASSERT_EQ(1, pread(256, &c, 1, 0));
+  ASSERT_EQ('b', c);
+  for (i = 0; i < sizeof(fds) / sizeof(*fds); ++i) {
+    if (fds[i] >= rl.rlim_cur) continue;
+    ASSERT_EQ(0, close(fds[i]));
+    ASSERT_EQ(-1, fcntl(fds[i], F_GETFD));
+    ASSERT_EQ(EBADF, errno);
+  }
+}
+
+TEST(fdtable, manyDescriptors) {
+  int i, fds[600];
+  for (i = 0; i < 600; ++i) {
+    ASSERT_NE(-1, (fds[i] = dup(i & 1 ? fb : fa)));
+  }
+  for (i = 0; i < 600; ++i) {
+    ASSERT_EQ(0, close(fds[i]));
+  }
+  for (i = 0; i < 600; ++i) {
+    ASSERT_EQ(-1, fcntl(fds[i], F_GETFD));
+    ASSERT_EQ(EBADF, errno);
+  }
+}
@@ -0,0 +1,185 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// drives `blink -F SOCK -f 3 THIS serve`, where this same program is
+// the guest, in each memory and jit mode, and checks every connection
+// gets its own fork of the snapshot taken at the first read of fd 3.
+// $BLINK may name the blink binary, otherwise it's o//blink/blink in
+// the source tree like the test runner uses. only the host run of the
+// test does this, since blink running blink is a different test.
+
+#define CHECK(x)                                          \
+  do {                                                    \
+    if (!(x)) {                                           \
+      fprintf(stderr, "%s:%d: %s failed: %s\n", __FILE__, \
+              __LINE__, #x, strerror(errno));             \
+      exit(1);                                            \
+    }                                                     \
+  } while (0)
+
+int counter;
+char blink[PATH_MAX];
+char dir[32], sock[64];
+
+int Serve(void) {
+  ssize_t n;
+  char buf[64], msg[96];
+  counter = 42;
+  // the server snapshots here, so every request sees counter == 42
+  if ((n = read(3, buf, sizeof(buf) - 1)) <= 0) return 1;
+  buf[n] = 0;
+  snprintf(msg, sizeof(msg), "%d %s", counter++, buf);
+  if (write(1, msg, strlen(msg)) != strlen(msg)) return 2;
+  return 0;
+}
+
+void FindBlink(void) {
+  char *p;
+  struct utsname u;
+  CHECK(!uname(&u));
+  if (strstr(u.release, "-blink-")) {
+    fprintf(stderr, "forkserver_test: skipped under blink\n");
+    exit(77);
+  }
+  if ((p = getenv("BLINK"))) {
+    snprintf(blink, sizeof(blink), "%s", p);
+  } else {
+    strcpy(blink, "o//blink/blink");
+  }
+  if (access(blink, X_OK)) {
+    fprintf(stderr, "forkserver_test: %s: %s\n", blink, strerror(errno));
+    exit(1);
+  }
+}
+
+int Spawn(const char *mode, const char *fdarg, const char *self) {
+  int i, pid, pfds[2];
+  char *args[9];
+  i = 0;
+  args[i++] = blink;
+  if (*mode) args[i++] = (char *)mode;
+  args[i++] = "-F";
+  args[i++] = sock;
+  args[i++] = "-f";
+  args[i++] = (char *)fdarg;
+  args[i++] = (char *)self;
+  args[i++] = "serve";
+  args[i] = 0;
+  CHECK(!pipe(pfds));
+  CHECK((pid = fork()) != -1);
+  if (!pid) {
+    dup2(pfds[0], 3);
+    if (pfds[0] != 3) close(pfds[0]);
+    execv(blink, args);
+    _exit(127);
+  }
+  // the write end stays open so the server's read() can't see eof
+  CHECK(!close(pfds[0]));
+  return pid;
+}
+
+int Connect(void) {
+  int i, fd;
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, sock);
+  for (i = 0; i < 3000; ++i) {
+    CHECK((fd = socket(AF_UNIX, SOCK_STREAM, 0)) != -1);
+    if (!connect(fd, (struct sockaddr *)&addr, sizeof(addr))) return fd;
+    CHECK(errno == ENOENT || errno == ECONNREFUSED);
+    CHECK(!close(fd));
+    usleep(10000);
+  }
+  fprintf(stderr, "fork server never came up on %s\n", sock);
+  exit(1);
+}
+
+void Expect(int fd, const char *want) {
+  ssize_t n;
+  size_t got;
+  char buf[96];
+  for (got = 0; (n = read(fd, buf + got, sizeof(buf) - 1 - got)) > 0;) {
+    got += n;
+  }
+  CHECK(n != -1);
+  buf[got] = 0;
+  if (strcmp(buf, want)) {
+    fprintf(stderr, "want %s\ngot  %s\n", want, buf);
+    exit(1);
+  }
+  CHECK(!close(fd));
+}
+
+void TestForkServer(const char *mode, const char *self) {
+  int ws, pid, c1, c2;
+
+  // bad -f arguments are refused up front
+  pid = Spawn(mode, "x", self);
+  CHECK(waitpid(pid, &ws, 0) == pid);
+  CHECK(WIFEXITED(ws) && WEXITSTATUS(ws) == 48);
+  pid = Spawn(mode, "-1", self);
+  CHECK(waitpid(pid, &ws, 0) == pid);
+  CHECK(WIFEXITED(ws) && WEXITSTATUS(ws) == 48);
+
+  // each connection is served from the same snapshot, concurrently
+  pid = Spawn(mode, "3", self);
+  c1 = Connect();
+  c2 = Connect();
+  CHECK(write(c2, "two\n", 4) == 4);
+  CHECK(!shutdown(c2, SHUT_WR));
+  CHECK(write(c1, "one\n", 4) == 4);
+  CHECK(!shutdown(c1, SHUT_WR));
+  Expect(c2, "42 two\n");
+  Expect(c1, "42 one\n");
+  c1 = Connect();
+  CHECK(write(c1, "three\n", 6) == 6);
+  CHECK(!shutdown(c1, SHUT_WR));
+  Expect(c1, "42 three\n");
+
+  CHECK(!kill(pid, SIGTERM));
+  CHECK(waitpid(pid, &ws, 0) == pid);
+  CHECK(WIFSIGNALED(ws) && WTERMSIG(ws) == SIGTERM);
+  CHECK(!unlink(sock));
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && !strcmp(argv[1], "serve")) return Serve();
+  FindBlink();
+  strcpy(dir, "/tmp/blink.forkserver.XXXXXX");
+  CHECK(mkdtemp(dir));
+  snprintf(sock, sizeof(sock), "%s/sock", dir);
+  TestForkServer("", argv[0]);
+  TestForkServer("-m", argv[0]);
+  TestForkServer("-j", argv[0]);
+  TestForkServer("-jm", argv[0]);
+  CHECK(!rmdir(dir));
+  return 0;
+}
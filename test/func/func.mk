@@ -56,19 +56,19 @@ o/$(MODE)/test/func/%.com:						\
 	@mkdir -p $(@D)
 	@echo "#!/bin/sh" >$@
 	@echo "echo [test] $(VM) $< >&2" >>$@
-	@echo "$(VM) $< || exit" >>$@
+	@echo "$(VM) $< || [ \$$? -eq 77 ] || exit" >>$@
 	@echo "echo [test] o/$(MODE)/blink/blink $< >&2" >>$@
-	@echo "o/$(MODE)/blink/blink $< || exit" >>$@
+	@echo "o/$(MODE)/blink/blink $< || [ \$$? -eq 77 ] || exit" >>$@
 	@echo "echo [test] o/$(MODE)/blink/blink -jm $< >&2" >>$@
-	@echo "o/$(MODE)/blink/blink -jm $< || exit" >>$@
+	@echo "o/$(MODE)/blink/blink -jm $< || [ \$$? -eq 77 ] || exit" >>$@
 	@echo "echo [test] o/$(MODE)/blink/blink -m $< >&2" >>$@
-	@echo "o/$(MODE)/blink/blink -m $< || exit" >>$@
+	@echo "o/$(MODE)/blink/blink -m $< || [ \$$? -eq 77 ] || exit" >>$@
 	@echo "echo [test] o/$(MODE)/blink/blink -j $< >&2" >>$@
-	@echo "o/$(MODE)/blink/blink -j $< || exit" >>$@
+	@echo "o/$(MODE)/blink/blink -j $< || [ \$$? -eq 77 ] || exit" >>$@
 	@echo "echo [test] o/$(MODE)/blink/blink -L/dev/null -sss $< >&2" >>$@
-	@echo "o/$(MODE)/blink/blink -L/dev/null -sss $< || exit" >>$@
+	@echo "o/$(MODE)/blink/blink -L/dev/null -sss $< || [ \$$? -eq 77 ] || exit" >>$@
 	@echo "echo [test] o/$(MODE)/blink/blink -L/dev/null -msss $< >&2" >>$@
-	@echo "o/$(MODE)/blink/blink -L/dev/null -msss $< || exit" >>$@
+	@echo "o/$(MODE)/blink/blink -L/dev/null -msss $< || [ \$$? -eq 77 ] || exit" >>$@
 	@chmod +x $@
 
 .PHONY: o/$(MODE)/test/func
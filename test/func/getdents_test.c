@@ -0,0 +1,184 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+// enough files that a directory listing takes many getdents64() calls
+// to read, even when the buffer is larger than the one blink bounces
+// records through, and names of every length up to the 255 byte limit
+
+#define N 1500
+
+struct dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+char dir[64];
+char seen[N];
+char buf[256 * 1024];
+
+char *Name(char path[300], int i) {
+  int n;
+  n = snprintf(path, 300, "%d.", i);
+  memset(path + n, 'x', i % 250);
+  path[n + i % 250] = 0;
+  return path;
+}
+
+int Index(const char *name) {
+  int i;
+  char path[300];
+  if (!isdigit(*name)) return -1;
+  i = atoi(name);
+  ASSERT_LE(0, i);
+  ASSERT_LT(i, N);
+  ASSERT_STREQ(Name(path, i), name);
+  return i;
+}
+
+void SetUp(void) {
+  int i, fd;
+  char path[300];
+  strcpy(dir, "/tmp/blink.getdents.XXXXXX");
+  ASSERT_NOTNULL(mkdtemp(dir));
+  ASSERT_EQ(0, chdir(dir));
+  for (i = 0; i < N; ++i) {
+    ASSERT_NE(-1, (fd = creat(Name(path, i), 0644)));
+    ASSERT_EQ(0, close(fd));
+  }
+  memset(path, 'y', 255);
+  path[255] = 0;
+  ASSERT_NE(-1, (fd = creat(path, 0644)));
+  ASSERT_EQ(0, close(fd));
+  memset(seen, 0, sizeof(seen));
+}
+
+void TearDown(void) {
+  int i;
+  char path[300];
+  for (i = 0; i < N; ++i) {
+    ASSERT_EQ(0, unlink(Name(path, i)));
+  }
+  memset(path, 'y', 255);
+  path[255] = 0;
+  ASSERT_EQ(0, unlink(path));
+  ASSERT_EQ(0, chdir("/"));
+  ASSERT_EQ(0, rmdir(dir));
+}
+
+// reads directory with getdents64() calls of `size` bytes each
+int ReadAll(int fd, size_t size) {
+  long rc, i;
+  int count = 0;
+  struct dirent64 *ent;
+  while ((rc = syscall(SYS_getdents64, fd, buf, size)) > 0) {
+    ASSERT_LE(rc, size);
+    for (i = 0; i < rc; i += ent->d_reclen) {
+      ent = (struct dirent64 *)(buf + i);
+      ASSERT_EQ(0, ent->d_reclen % 8);
+      ASSERT_LE(i + ent->d_reclen, rc);
+      ASSERT_LE(strlen(ent->d_name) + 20, ent->d_reclen);
+      if (ent->d_name[0] == 'y') {
+        ASSERT_EQ(255, strlen(ent->d_name));
+        ASSERT_EQ(DT_REG, ent->d_type);
+      } else if (Index(ent->d_name) != -1) {
+        ASSERT_EQ(0, seen[Index(ent->d_name)]++);
+        ASSERT_EQ(DT_REG, ent->d_type);
+      } else {
+        ASSERT_EQ(DT_DIR, ent->d_type);
+      }
+      ++count;
+    }
+  }
+  ASSERT_EQ(0, rc);
+  return count;
+}
+
+TEST(getdents, largeBuffer) {
+  int i, fd;
+  ASSERT_NE(-1, (fd = open(".", O_RDONLY | O_DIRECTORY)));
+  ASSERT_EQ(N + 3, ReadAll(fd, sizeof(buf)));
+  for (i = 0; i < N; ++i) ASSERT_EQ(1, seen[i]);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(getdents, smallBuffer) {
+  int i, fd;
+  // room for only one record with the longest name
+  ASSERT_NE(-1, (fd = open(".", O_RDONLY | O_DIRECTORY)));
+  ASSERT_EQ(N + 3, ReadAll(fd, 280));
+  for (i = 0; i < N; ++i) ASSERT_EQ(1, seen[i]);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(getdents, errors) {
+  int fd;
+  ASSERT_NE(-1, (fd = open(".", O_RDONLY | O_DIRECTORY)));
+  ASSERT_EQ(-1, syscall(SYS_getdents64, fd, buf, 8));
+  ASSERT_EQ(EINVAL, errno);
+  ASSERT_EQ(-1, syscall(SYS_getdents64, fd, 0, sizeof(buf)));
+  ASSERT_EQ(EFAULT, errno);
+  ASSERT_EQ(0, close(fd));
+  ASSERT_NE(-1, (fd = open("0.", O_RDONLY)));
+  ASSERT_EQ(-1, syscall(SYS_getdents64, fd, buf, sizeof(buf)));
+  ASSERT_EQ(ENOTDIR, errno);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(readdir, seekdirReturnsToOffset) {
+  DIR *d;
+  int i, n;
+  long pos;
+  struct dirent *ent;
+  char want[300];
+  ASSERT_NOTNULL((d = opendir(".")));
+  for (n = 0; (ent = readdir(d)); ++n) {
+    if ((i = Index(ent->d_name)) != -1) ++seen[i];
+    if (n == N / 2) {
+      // peek at the next entry, then go back to it
+      pos = telldir(d);
+      ASSERT_NOTNULL((ent = readdir(d)));
+      strcpy(want, ent->d_name);
+      seekdir(d, pos);
+    }
+  }
+  ASSERT_EQ(N + 3, n);
+  for (i = 0; i < N; ++i) ASSERT_EQ(1, seen[i]);
+  seekdir(d, pos);
+  ASSERT_NOTNULL((ent = readdir(d)));
+  ASSERT_STREQ(want, ent->d_name);
+  rewinddir(d);
+  for (n = 0; readdir(d);) ++n;
+  ASSERT_EQ(N + 3, n);
+  ASSERT_EQ(0, closedir(d));
+}
@@ -0,0 +1,205 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+// blink builds with the vfs keep handles to host directories that are
+// used more than once and evict the least recently used ones, so these
+// tests use many more directories than it caches (64 by default) and
+// check that lookups inside them keep resolving to the right place.
+
+#define DIRS    200
+#define THREADS 4
+#define ROUNDS  20
+
+char dir[64];
+
+void SetUp(void) {
+  strcpy(dir, "/tmp/blink.hostfs.XXXXXX");
+  ASSERT_NOTNULL(mkdtemp(dir));
+  ASSERT_EQ(0, chdir(dir));
+}
+
+void TearDown(void) {
+  int i;
+  char path[32];
+  ASSERT_EQ(0, chdir(dir));
+  for (i = 0; i < DIRS; ++i) {
+    snprintf(path, sizeof(path), "d%d/f", i);
+    unlink(path);
+    snprintf(path, sizeof(path), "d%d/h", i);
+    unlink(path);
+    snprintf(path, sizeof(path), "d%d", i);
+    rmdir(path);
+    snprintf(path, sizeof(path), "old%d/f", i);
+    unlink(path);
+    snprintf(path, sizeof(path), "old%d", i);
+    rmdir(path);
+  }
+  ASSERT_EQ(0, chdir("/"));
+  ASSERT_EQ(0, rmdir(dir));
+}
+
+void Put(const char *path, int x) {
+  int fd;
+  ASSERT_NE(-1, (fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644)));
+  ASSERT_EQ(sizeof(x), write(fd, &x, sizeof(x)));
+  ASSERT_EQ(0, close(fd));
+}
+
+int Get(const char *path) {
+  int fd, x;
+  ASSERT_NE(-1, (fd = open(path, O_RDONLY)));
+  ASSERT_EQ(sizeof(x), read(fd, &x, sizeof(x)));
+  ASSERT_EQ(0, close(fd));
+  return x;
+}
+
+void MakeDirs(void) {
+  int i;
+  char path[32];
+  for (i = 0; i < DIRS; ++i) {
+    snprintf(path, sizeof(path), "d%d", i);
+    ASSERT_EQ(0, mkdir(path, 0755));
+    snprintf(path, sizeof(path), "d%d/f", i);
+    Put(path, i);
+  }
+}
+
+TEST(hostfs, evictedHandlesStillResolve) {
+  int i, j;
+  struct stat st;
+  char path[32], path2[32], name[16], link[32];
+  MakeDirs();
+  for (j = 0; j < 3; ++j) {
+    for (i = 0; i < DIRS; ++i) {
+      snprintf(path, sizeof(path), "d%d/f", i);
+      ASSERT_EQ(i, Get(path));
+      ASSERT_EQ(0, stat(path, &st));
+      ASSERT_EQ(sizeof(int), st.st_size);
+      // operations relative to the directory's own handle
+      snprintf(name, sizeof(name), "g%d", j);
+      snprintf(path2, sizeof(path2), "d%d/%s", i, name);
+      ASSERT_EQ(0, rename(path, path2));
+      ASSERT_EQ(-1, stat(path, &st));
+      ASSERT_EQ(ENOENT, errno);
+      ASSERT_EQ(0, symlink(name, path));
+      ASSERT_EQ(i, Get(path));
+      ASSERT_EQ(0, unlink(path));
+      ASSERT_EQ(0, rename(path2, path));
+      snprintf(link, sizeof(link), "d%d/../d%d/f", (i + 1) % DIRS, i);
+      ASSERT_EQ(i, Get(link));
+    }
+  }
+}
+
+TEST(hostfs, cwdHandleSurvivesEviction) {
+  int i, fds[DIRS];
+  char path[32];
+  MakeDirs();
+  ASSERT_EQ(0, chdir("d0"));
+  ASSERT_EQ(0, Get("f"));
+  ASSERT_EQ(0, Get("f"));
+  for (i = 1; i < DIRS; ++i) {
+    // open files keep their directories alive, along with their handles
+    snprintf(path, sizeof(path), "../d%d/h", i);
+    ASSERT_NE(-1, (fds[i] = open(path, O_CREAT | O_RDWR, 0644)));
+    snprintf(path, sizeof(path), "../d%d/f", i);
+    ASSERT_EQ(i, Get(path));
+    if (!(i % 70)) ASSERT_EQ(0, Get("f"));
+  }
+  ASSERT_EQ(0, Get("f"));
+  for (i = 1; i < DIRS; ++i) {
+    ASSERT_EQ(0, close(fds[i]));
+  }
+  ASSERT_EQ(0, Get("f"));
+}
+
+TEST(hostfs, replacedDirectoryIsntStale) {
+  int i;
+  struct stat st;
+  char path[32], path2[32];
+  MakeDirs();
+  for (i = 0; i < DIRS; ++i) {
+    snprintf(path, sizeof(path), "d%d/f", i);
+    ASSERT_EQ(i, Get(path));
+    ASSERT_EQ(i, Get(path));
+  }
+  for (i = 0; i < DIRS; ++i) {
+    snprintf(path, sizeof(path), "d%d", i);
+    snprintf(path2, sizeof(path2), "old%d", i);
+    ASSERT_EQ(0, rename(path, path2));
+    ASSERT_EQ(0, mkdir(path, 0755));
+    snprintf(path, sizeof(path), "d%d/f", i);
+    ASSERT_EQ(-1, stat(path, &st));
+    ASSERT_EQ(ENOENT, errno);
+    Put(path, -i);
+    ASSERT_EQ(-i, Get(path));
+    snprintf(path2, sizeof(path2), "old%d/f", i);
+    ASSERT_EQ(i, Get(path2));
+  }
+}
+
+void *Worker(void *arg) {
+  int i, j, k;
+  struct stat st;
+  char path[32];
+  k = (intptr_t)arg;
+  for (j = 0; j < ROUNDS; ++j) {
+    for (i = 0; i < DIRS; ++i) {
+      // each thread walks the directories in a different order
+      snprintf(path, sizeof(path), "d%d/f", (i * (k + 1) * 7 + k) % DIRS);
+      if (Get(path) != (i * (k + 1) * 7 + k) % DIRS) return (void *)1;
+      if (fstatat(AT_FDCWD, path, &st, 0)) return (void *)2;
+    }
+  }
+  return 0;
+}
+
+TEST(hostfs, concurrentLookupsWhileEvicting) {
+  int i, fds[DIRS];
+  void *rc;
+  char path[32];
+  pthread_t th[THREADS];
+  MakeDirs();
+  // fill the cache with handles that can only leave it by eviction
+  for (i = 0; i < DIRS; ++i) {
+    snprintf(path, sizeof(path), "d%d/h", i);
+    ASSERT_NE(-1, (fds[i] = open(path, O_CREAT | O_RDWR, 0644)));
+  }
+  for (i = 0; i < THREADS; ++i) {
+    ASSERT_EQ(0, pthread_create(th + i, 0, Worker, (void *)(intptr_t)i));
+  }
+  for (i = 0; i < THREADS; ++i) {
+    ASSERT_EQ(0, pthread_join(th[i], &rc));
+    ASSERT_EQ(0, (intptr_t)rc);
+  }
+  for (i = 0; i < DIRS; ++i) {
+    ASSERT_EQ(0, close(fds[i]));
+  }
+}
@@ -0,0 +1,291 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+#define IORING_OFF_SQ_RING    0
+#define IORING_OFF_SQES       0x10000000
+#define IORING_ENTER_GETEVENTS 1
+#define IORING_REGISTER_FILES 2
+#define IORING_UNREGISTER_FILES 3
+#define IOSQE_FIXED_FILE      1
+#define IORING_OP_NOP         0
+#define IORING_OP_READ        22
+#define IORING_OP_WRITE       23
+
+struct io_uring_params {
+  uint32_t sq_entries, cq_entries, flags, sq_thread_cpu, sq_thread_idle;
+  uint32_t features, wq_fd, resv[3];
+  struct {
+    uint32_t head, tail, ring_mask, ring_entries, flags, dropped, array;
+    uint32_t resv1;
+    uint64_t user_addr;
+  } sq_off;
+  struct {
+    uint32_t head, tail, ring_mask, ring_entries, overflow, cqes, flags;
+    uint32_t resv1;
+    uint64_t user_addr;
+  } cq_off;
+};
+
+struct io_uring_sqe {
+  uint8_t opcode, flags;
+  uint16_t ioprio;
+  int32_t fd;
+  uint64_t off, addr;
+  uint32_t len, rw_flags;
+  uint64_t user_data;
+  uint64_t pad[3];
+};
+
+struct io_uring_cqe {
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+
+struct Ring {
+  int fd;
+  char *sq, *cq;
+  size_t sqsize, cqsize;
+  struct io_uring_sqe *sqes;
+  struct io_uring_params p;
+} ring;
+
+int pipefds[2];
+
+void SetUp(void) {
+  memset(&ring.p, 0, sizeof(ring.p));
+  ASSERT_NE(-1, (ring.fd = syscall(SYS_io_uring_setup, 8, &ring.p)));
+  ring.sqsize = ring.p.sq_off.array + ring.p.sq_entries * 4;
+  ring.cqsize =
+      ring.p.cq_off.cqes + ring.p.cq_entries * sizeof(struct io_uring_cqe);
+  if (ring.cqsize > ring.sqsize) ring.sqsize = ring.cqsize;
+  ASSERT_NE((intptr_t)MAP_FAILED,
+            (intptr_t)(ring.sq = mmap(0, ring.sqsize, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED, ring.fd,
+                                      IORING_OFF_SQ_RING)));
+  ring.cq = ring.sq;
+  ASSERT_NE((intptr_t)MAP_FAILED,
+            (intptr_t)(ring.sqes = (struct io_uring_sqe *)mmap(
+                           0, ring.p.sq_entries * sizeof(struct io_uring_sqe),
+                           PROT_READ | PROT_WRITE, MAP_SHARED, ring.fd,
+                           IORING_OFF_SQES)));
+  ASSERT_EQ(0, pipe(pipefds));
+}
+
+void TearDown(void) {
+  ASSERT_EQ(0, munmap(ring.sqes,
+                      ring.p.sq_entries * sizeof(struct io_uring_sqe)));
+  ASSERT_EQ(0, munmap(ring.sq, ring.sqsize));
+  ASSERT_EQ(0, close(ring.fd));
+  ASSERT_EQ(0, close(pipefds[0]));
+  ASSERT_EQ(0, close(pipefds[1]));
+}
+
+struct io_uring_sqe *Submit(uint8_t op, int fd, const void *addr, uint32_t len,
+                           uint64_t ud) {
+  uint32_t tail, mask, *array;
+  struct io_uring_sqe *sqe;
+  tail = __atomic_load_n((uint32_t *)(ring.sq + ring.p.sq_off.tail),
+                         __ATOMIC_ACQUIRE);
+  mask = *(uint32_t *)(ring.sq + ring.p.sq_off.ring_mask);
+  array = (uint32_t *)(ring.sq + ring.p.sq_off.array);
+  sqe = ring.sqes + (tail & mask);
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = op;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t)addr;
+  sqe->len = len;
+  sqe->off = -1;
+  sqe->user_data = ud;
+  array[tail & mask] = tail & mask;
+  __atomic_store_n((uint32_t *)(ring.sq + ring.p.sq_off.tail), tail + 1,
+                   __ATOMIC_RELEASE);
+  return sqe;
+}
+
+int Enter(unsigned to_submit, unsigned min_complete) {
+  return syscall(SYS_io_uring_enter, ring.fd, to_submit, min_complete,
+                 min_complete ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+}
+
+int Reap(uint64_t *ud) {
+  int res;
+  uint32_t head, tail, mask;
+  struct io_uring_cqe *cqe;
+  head = __atomic_load_n((uint32_t *)(ring.cq + ring.p.cq_off.head),
+                         __ATOMIC_ACQUIRE);
+  tail = __atomic_load_n((uint32_t *)(ring.cq + ring.p.cq_off.tail),
+                         __ATOMIC_ACQUIRE);
+  if (head == tail) return -9999;
+  mask = *(uint32_t *)(ring.cq + ring.p.cq_off.ring_mask);
+  cqe = (struct io_uring_cqe *)(ring.cq + ring.p.cq_off.cqes) + (head & mask);
+  *ud = cqe->user_data;
+  res = cqe->res;
+  __atomic_store_n((uint32_t *)(ring.cq + ring.p.cq_off.head), head + 1,
+                   __ATOMIC_RELEASE);
+  return res;
+}
+
+TEST(io_uring, nop) {
+  uint64_t ud;
+  Submit(IORING_OP_NOP, -1, 0, 0, 123);
+  ASSERT_EQ(1, Enter(1, 1));
+  ASSERT_EQ(0, Reap(&ud));
+  ASSERT_EQ(123, ud);
+  ASSERT_EQ(-9999, Reap(&ud));
+}
+
+TEST(io_uring, readWrite) {
+  uint64_t ud;
+  char buf[8] = {0};
+  Submit(IORING_OP_WRITE, pipefds[1], "hello", 5, 1);
+  ASSERT_EQ(1, Enter(1, 1));
+  ASSERT_EQ(5, Reap(&ud));
+  ASSERT_EQ(1, ud);
+  Submit(IORING_OP_READ, pipefds[0], buf, sizeof(buf), 2);
+  ASSERT_EQ(1, Enter(1, 1));
+  ASSERT_EQ(5, Reap(&ud));
+  ASSERT_EQ(2, ud);
+  ASSERT_STREQ("hello", buf);
+}
+
+void *Writer(void *arg) {
+  usleep(20000);
+  write(pipefds[1], "x", 1);
+  return 0;
+}
+
+TEST(io_uring, blockingRead) {
+  char c = 0;
+  uint64_t ud;
+  pthread_t th;
+  Submit(IORING_OP_READ, pipefds[0], &c, 1, 3);
+  ASSERT_EQ(0, pthread_create(&th, 0, Writer, 0));
+  ASSERT_EQ(1, Enter(1, 1));
+  ASSERT_EQ(0, pthread_join(th, 0));
+  ASSERT_EQ(1, Reap(&ud));
+  ASSERT_EQ(3, ud);
+  ASSERT_EQ('x', c);
+}
+
+void *Waiter(void *arg) {
+  return (void *)(intptr_t)Enter(0, 1);
+}
+
+TEST(io_uring, completionWakesOtherThread) {
+  void *rc;
+  uint64_t ud;
+  pthread_t th;
+  ASSERT_EQ(0, pthread_create(&th, 0, Waiter, 0));
+  usleep(20000);
+  Submit(IORING_OP_NOP, -1, 0, 0, 4);
+  ASSERT_EQ(1, Enter(1, 0));
+  ASSERT_EQ(0, pthread_join(th, &rc));
+  ASSERT_EQ(0, (intptr_t)rc);
+  ASSERT_EQ(0, Reap(&ud));
+  ASSERT_EQ(4, ud);
+}
+
+TEST(io_uring, fixedFileOutlivesClose) {
+  int fd, fd2;
+  char c = 0;
+  uint64_t ud;
+  ASSERT_NE(-1, (fd = dup(pipefds[0])));
+  ASSERT_EQ(0, syscall(SYS_io_uring_register, ring.fd, IORING_REGISTER_FILES,
+                       &fd, 1));
+  // the registered file must not follow the number to /dev/null
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(fd, (fd2 = open("/dev/null", O_RDONLY)));
+  ASSERT_EQ(1, write(pipefds[1], "y", 1));
+  Submit(IORING_OP_READ, 0, &c, 1, 5)->flags = IOSQE_FIXED_FILE;
+  ASSERT_EQ(1, Enter(1, 1));
+  ASSERT_EQ(1, Reap(&ud));
+  ASSERT_EQ(5, ud);
+  ASSERT_EQ('y', c);
+  ASSERT_EQ(0, syscall(SYS_io_uring_register, ring.fd,
+                       IORING_UNREGISTER_FILES, 0, 0));
+  ASSERT_EQ(0, close(fd2));
+}
+
+#define BIG (1024 * 1024)
+
+void *BigWriter(void *arg) {
+  Submit(IORING_OP_WRITE, pipefds[1], arg, BIG, 6);
+  return (void *)(intptr_t)Enter(1, 1);
+}
+
+TEST(io_uring, blockedSubmissionDoesntBlockRing) {
+  void *rc;
+  char *buf;
+  bool sawnop;
+  char tmp[4096];
+  ssize_t n, got;
+  uint64_t ud;
+  pthread_t th;
+  int res, wrote;
+  ASSERT_NOTNULL((buf = malloc(BIG)));
+  memset(buf, 'z', BIG);
+  // the write is larger than the pipe, so blink blocks once it's begun
+  // writing it, whereas linux is free to complete it as a short write
+  ASSERT_EQ(0, pthread_create(&th, 0, BigWriter, buf));
+  usleep(50000);
+  Submit(IORING_OP_NOP, -1, 0, 0, 7);
+  ASSERT_EQ(1, Enter(1, 1));
+  for (wrote = -1, sawnop = false; (res = Reap(&ud)) != -9999;) {
+    if (ud == 7) {
+      ASSERT_EQ(0, res);
+      sawnop = true;
+    } else {
+      ASSERT_EQ(6, ud);
+      wrote = res;
+    }
+  }
+  ASSERT_TRUE(sawnop);
+  ASSERT_EQ(0, fcntl(pipefds[0], F_SETFL, O_NONBLOCK));
+  for (got = 0; wrote == -1 || got < wrote;) {
+    if ((n = read(pipefds[0], tmp, sizeof(tmp))) > 0) {
+      got += n;
+    } else {
+      ASSERT_EQ(EAGAIN, errno);
+      if (wrote == -1 && (res = Reap(&ud)) != -9999) {
+        ASSERT_EQ(6, ud);
+        wrote = res;
+      } else {
+        usleep(1000);
+      }
+    }
+  }
+  ASSERT_EQ(wrote, got);
+  ASSERT_LT(0, wrote);
+  ASSERT_EQ(0, pthread_join(th, &rc));
+  ASSERT_EQ(1, (intptr_t)rc);
+  free(buf);
+}
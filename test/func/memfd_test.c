@@ -0,0 +1,121 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "test/test.h"
+
+#ifndef MFD_NOEXEC_SEAL
+#define MFD_NOEXEC_SEAL 0x0008
+#endif
+#ifndef F_SEAL_EXEC
+#define F_SEAL_EXEC 0x0020
+#endif
+
+void SetUp(void) {
+}
+
+void TearDown(void) {
+}
+
+TEST(memfd, readWrite) {
+  int fd;
+  char buf[8] = {0};
+  struct stat st;
+  ASSERT_NE(-1, (fd = memfd_create("hello", MFD_CLOEXEC)));
+  ASSERT_EQ(FD_CLOEXEC, fcntl(fd, F_GETFD));
+  ASSERT_EQ(5, write(fd, "hello", 5));
+  ASSERT_EQ(0, fstat(fd, &st));
+  ASSERT_TRUE(S_ISREG(st.st_mode));
+  ASSERT_EQ(5, st.st_size);
+  ASSERT_EQ(5, pread(fd, buf, sizeof(buf), 0));
+  ASSERT_STREQ("hello", buf);
+  ASSERT_EQ(-1, fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE));
+  ASSERT_EQ(EPERM, errno);
+  ASSERT_EQ(F_SEAL_SEAL, fcntl(fd, F_GET_SEALS));
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(memfd, seals) {
+  int fd;
+  ASSERT_NE(-1, (fd = memfd_create("sealed", MFD_ALLOW_SEALING)));
+  ASSERT_EQ(0, fcntl(fd, F_GET_SEALS));
+  ASSERT_EQ(0, ftruncate(fd, 8192));
+  ASSERT_EQ(0, fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW));
+  ASSERT_EQ(F_SEAL_SHRINK | F_SEAL_GROW, fcntl(fd, F_GET_SEALS));
+  ASSERT_EQ(-1, ftruncate(fd, 4096));
+  ASSERT_EQ(EPERM, errno);
+  ASSERT_EQ(-1, ftruncate(fd, 16384));
+  ASSERT_EQ(EPERM, errno);
+  ASSERT_EQ(1, pwrite(fd, "x", 1, 0));
+  ASSERT_EQ(0, fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SEAL));
+  ASSERT_EQ(-1, pwrite(fd, "x", 1, 0));
+  ASSERT_EQ(EPERM, errno);
+  ASSERT_EQ(-1, fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK));
+  ASSERT_EQ(EPERM, errno);
+  ASSERT_EQ((intptr_t)MAP_FAILED,
+            (intptr_t)mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+  ASSERT_EQ(EPERM, errno);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(memfd, noexecSeal) {
+  int fd;
+  struct stat st;
+  if ((fd = memfd_create("noexec", MFD_NOEXEC_SEAL)) == -1) {
+    ASSERT_EQ(EINVAL, errno);  // host kernel older than linux 6.3
+    return;
+  }
+  ASSERT_EQ(F_SEAL_EXEC, fcntl(fd, F_GET_SEALS) & F_SEAL_EXEC);
+  ASSERT_EQ(0, fstat(fd, &st));
+  ASSERT_EQ(0, st.st_mode & 0111);
+  ASSERT_EQ(-1, fchmod(fd, 0755));
+  ASSERT_EQ(EPERM, errno);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(memfd, mmapAliasing) {
+  int fd;
+  char buf[4] = {0};
+  volatile char *p, *q;
+  ASSERT_NE(-1, (fd = memfd_create("alias", 0)));
+  ASSERT_EQ(0, ftruncate(fd, 65536));
+  ASSERT_NE((intptr_t)MAP_FAILED,
+            (intptr_t)(p = (char *)mmap(0, 65536, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED, fd, 0)));
+  ASSERT_NE((intptr_t)MAP_FAILED,
+            (intptr_t)(q = (char *)mmap(0, 65536, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED, fd, 0)));
+  ASSERT_NE((intptr_t)p, (intptr_t)q);
+  p[0] = 'a';
+  ASSERT_EQ('a', q[0]);
+  q[65535] = 'b';
+  ASSERT_EQ('b', p[65535]);
+  ASSERT_EQ(1, pwrite(fd, "c", 1, 100));
+  ASSERT_EQ('c', p[100]);
+  ASSERT_EQ('c', q[100]);
+  ASSERT_EQ(1, pread(fd, buf, 1, 0));
+  ASSERT_EQ('a', buf[0]);
+  ASSERT_EQ(0, munmap((void *)p, 65536));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ('b', q[65535]);
+  ASSERT_EQ(0, munmap((void *)q, 65536));
+}
@@ -0,0 +1,167 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+// blink's vfs publishes each mount table as an immutable snapshot and
+// hands out references to the cwd, so path lookups in one thread don't
+// lock out mount() and chdir() in another. these tests race them. they
+// need mount(), which under blink is only possible when it's built with
+// its vfs, and on the host needs root; they're otherwise skipped.
+
+#define M 16
+
+char dir[64];
+atomic_int mounted;
+atomic_int done;
+
+char *Mountpoint(char path[96], int i) {
+  snprintf(path, 96, "%s/m%d", dir, i);
+  return path;
+}
+
+void SetUp(void) {
+  int i;
+  char path[96];
+  strcpy(dir, "/tmp/blink.mount.XXXXXX");
+  ASSERT_NOTNULL(mkdtemp(dir));
+  for (i = 0; i < M; ++i) {
+    ASSERT_EQ(0, mkdir(Mountpoint(path, i), 0755));
+  }
+  mounted = 0;
+  done = 0;
+}
+
+void TearDown(void) {
+  int i;
+  char path[96];
+  for (i = 0; i < M; ++i) {
+    // blink can't unmount, in which case the directories are left over
+    umount2(Mountpoint(path, i), MNT_DETACH);
+    rmdir(path);
+  }
+  rmdir(dir);
+}
+
+int ReadId(int i) {
+  int fd;
+  char path[96], buf[8] = {0};
+  snprintf(path, sizeof(path), "%s/m%d/id", dir, i);
+  ASSERT_NE(-1, (fd = open(path, O_RDONLY)));
+  ASSERT_LT(0, read(fd, buf, sizeof(buf) - 1));
+  ASSERT_EQ(0, close(fd));
+  return atoi(buf);
+}
+
+void *Walker(void *arg) {
+  int i, n;
+  struct stat st;
+  char path[96];
+  while (!done) {
+    n = mounted;
+    for (i = 0; i < n; ++i) {
+      ASSERT_EQ(i, ReadId(i));
+    }
+    for (; i < M; ++i) {
+      ASSERT_EQ(0, stat(Mountpoint(path, i), &st));
+    }
+  }
+  return 0;
+}
+
+TEST(mount, lookupsRaceMounts) {
+  int i, fd;
+  pthread_t th;
+  char path[96], buf[8];
+  if (mount("tmpfs", Mountpoint(path, 0), "tmpfs", 0, 0)) {
+    fprintf(stderr, "mount_test: skipped since mount() failed: %s\n",
+            strerror(errno));
+    TearDown();
+    exit(77);
+  }
+  ASSERT_EQ(0, pthread_create(&th, 0, Walker, 0));
+  for (i = 0; i < M; ++i) {
+    if (i) ASSERT_EQ(0, mount("tmpfs", Mountpoint(path, i), "tmpfs", 0, 0));
+    // each mount starts out empty, and hides what's underneath
+    snprintf(path, sizeof(path), "%s/m%d/id", dir, i);
+    ASSERT_EQ(-1, access(path, F_OK));
+    ASSERT_EQ(ENOENT, errno);
+    ASSERT_NE(-1, (fd = creat(path, 0644)));
+    snprintf(buf, sizeof(buf), "%d", i);
+    ASSERT_EQ(strlen(buf), write(fd, buf, strlen(buf)));
+    ASSERT_EQ(0, close(fd));
+    mounted = i + 1;
+  }
+  done = 1;
+  ASSERT_EQ(0, pthread_join(th, 0));
+  // the first mounts are still there after the table was copied
+  for (i = 0; i < M; ++i) {
+    ASSERT_EQ(i, ReadId(i));
+  }
+}
+
+void *Opener(void *arg) {
+  int fd;
+  char c;
+  while (!done) {
+    ASSERT_NE(-1, (fd = open("id", O_RDONLY)));
+    ASSERT_EQ(1, read(fd, &c, 1));
+    ASSERT_TRUE(c == 'a' || c == 'b');
+    ASSERT_EQ(0, close(fd));
+  }
+  return 0;
+}
+
+TEST(chdir, relativeLookupsRaceChdir) {
+  int i, fd;
+  pthread_t th;
+  char a[96], b[96], path[96];
+  Mountpoint(a, 0);
+  Mountpoint(b, 1);
+  snprintf(path, sizeof(path), "%s/id", a);
+  ASSERT_NE(-1, (fd = creat(path, 0644)));
+  ASSERT_EQ(1, write(fd, "a", 1));
+  ASSERT_EQ(0, close(fd));
+  snprintf(path, sizeof(path), "%s/id", b);
+  ASSERT_NE(-1, (fd = creat(path, 0644)));
+  ASSERT_EQ(1, write(fd, "b", 1));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, chdir(a));
+  ASSERT_EQ(0, pthread_create(&th, 0, Opener, 0));
+  for (i = 0; i < 5000; ++i) {
+    ASSERT_EQ(0, chdir(i & 1 ? a : b));
+  }
+  done = 1;
+  ASSERT_EQ(0, pthread_join(th, 0));
+  ASSERT_EQ(0, chdir("/"));
+  snprintf(path, sizeof(path), "%s/id", a);
+  ASSERT_EQ(0, unlink(path));
+  snprintf(path, sizeof(path), "%s/id", b);
+  ASSERT_EQ(0, unlink(path));
+}
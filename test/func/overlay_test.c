@@ -0,0 +1,131 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+// blink lets chroot() take an overlay spec, so this makes the guest's
+// root directory a union of a writable upper layer over a lower layer.
+// elsewhere chroot() fails, since "+..." isn't a directory, and blink
+// builds with the vfs don't have overlays, so these tests are skipped.
+
+bool inunion, chrooted;
+int upperfd, lowerfd;
+char dir[32], spec[80], path[64];
+
+void TearDown(void);
+
+void SetUp(void) {
+  int fd;
+  strcpy(dir, "/tmp/blink.overlay.XXXXXX");
+  ASSERT_NE(0, (intptr_t)mkdtemp(dir));
+  snprintf(path, sizeof(path), "%s/upper", dir);
+  ASSERT_EQ(0, mkdir(path, 0755));
+  ASSERT_NE(-1, (upperfd = open(path, O_RDONLY | O_DIRECTORY)));
+  snprintf(path, sizeof(path), "%s/lower", dir);
+  ASSERT_EQ(0, mkdir(path, 0755));
+  ASSERT_NE(-1, (lowerfd = open(path, O_RDONLY | O_DIRECTORY)));
+  ASSERT_NE(-1, (fd = openat(lowerfd, "f", O_WRONLY | O_CREAT, 0644)));
+  ASSERT_EQ(5, write(fd, "hello", 5));
+  ASSERT_EQ(0, fchmod(fd, 0644));
+  ASSERT_EQ(0, close(fd));
+  snprintf(spec, sizeof(spec), "+%s/upper:%s/lower", dir, dir);
+  chrooted = !chroot(spec);
+  inunion = chrooted && !access("/f", F_OK);  // the vfs ignores overlays
+  if (!inunion) {
+    TearDown();
+    fprintf(stderr, "overlay_test: skipped since chroot() has no overlays\n");
+    exit(77);
+  }
+}
+
+void TearDown(void) {
+  if (chrooted) ASSERT_EQ(0, chroot("/"));
+  unlinkat(upperfd, "f", 0);
+  unlinkat(upperfd, ".wh.f", 0);
+  ASSERT_EQ(0, unlinkat(lowerfd, "f", 0));
+  ASSERT_EQ(0, close(upperfd));
+  ASSERT_EQ(0, close(lowerfd));
+  snprintf(path, sizeof(path), "%s/upper", dir);
+  ASSERT_EQ(0, rmdir(path));
+  snprintf(path, sizeof(path), "%s/lower", dir);
+  ASSERT_EQ(0, rmdir(path));
+  ASSERT_EQ(0, rmdir(dir));
+}
+
+TEST(overlay, fchmod_copiesUp) {
+  int fd;
+  char buf[8] = {0};
+  struct stat st;
+  ASSERT_NE(-1, (fd = open("/f", O_RDONLY)));
+  ASSERT_EQ(0, fchmod(fd, 0600));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, stat("/f", &st));
+  ASSERT_EQ(0600, st.st_mode & 0777);
+  ASSERT_EQ(0, fstatat(upperfd, "f", &st, 0));
+  ASSERT_EQ(0600, st.st_mode & 0777);
+  ASSERT_EQ(0, fstatat(lowerfd, "f", &st, 0));
+  ASSERT_EQ(0644, st.st_mode & 0777);
+  ASSERT_NE(-1, (fd = open("/f", O_RDONLY)));
+  ASSERT_EQ(5, read(fd, buf, sizeof(buf)));
+  ASSERT_STREQ("hello", buf);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(overlay, fchown_copiesUp) {
+  int fd;
+  struct stat st;
+  ASSERT_NE(-1, (fd = open("/f", O_RDONLY)));
+  ASSERT_EQ(0, fchown(fd, getuid(), getgid()));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, fstatat(upperfd, "f", &st, 0));
+  ASSERT_EQ(getuid(), st.st_uid);
+}
+
+TEST(overlay, futimens_copiesUp) {
+  int fd;
+  struct stat st;
+  struct timespec ts[2] = {{1, 0}, {2, 0}};
+  ASSERT_NE(-1, (fd = open("/f", O_RDONLY)));
+  ASSERT_EQ(0, futimens(fd, ts));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, stat("/f", &st));
+  ASSERT_EQ(2, st.st_mtime);
+  ASSERT_EQ(0, fstatat(lowerfd, "f", &st, 0));
+  ASSERT_NE(2, st.st_mtime);
+}
+
+TEST(overlay, fchmod_removedLowerFile_isReadOnly) {
+  int fd;
+  struct stat st;
+  ASSERT_NE(-1, (fd = open("/f", O_RDONLY)));
+  ASSERT_EQ(0, unlink("/f"));
+  ASSERT_EQ(-1, fchmod(fd, 0600));
+  ASSERT_EQ(EROFS, errno);
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, fstatat(lowerfd, "f", &st, 0));
+  ASSERT_EQ(0644, st.st_mode & 0777);
+}
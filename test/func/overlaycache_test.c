@@ -0,0 +1,189 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// runs `BLINK_OVERLAYS=DIR:/ blink THIS check NAME` in each memory and
+// jit mode, and creates and removes DIR/NAME behind blink's back while
+// the guest watches /NAME, to check that blink's cache of overlay path
+// lookups notices within a bounded time. the guest also checks that it
+// sees its own creates and removes immediately. $BLINK may name blink,
+// otherwise o//blink/blink is used. builds with the vfs don't support
+// overlays, and running under blink is a different test, so both skip.
+
+#define CHECK(x)                                          \
+  do {                                                    \
+    if (!(x)) {                                           \
+      fprintf(stderr, "%s:%d: %s failed: %s\n", __FILE__, \
+              __LINE__, #x, strerror(errno));             \
+      exit(1);                                            \
+    }                                                     \
+  } while (0)
+
+char blink[PATH_MAX];
+char dir[64], name[64], path[160];
+
+long Millis(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void Send(int fd, char c) {
+  CHECK(write(fd, &c, 1) == 1);
+}
+
+void Expect(int fd, char c) {
+  char got;
+  CHECK(read(fd, &got, 1) == 1);
+  CHECK(got == c);
+}
+
+// waits for stat() of `file` to succeed or fail, returning milliseconds
+long Await(const char *file, int exists) {
+  long start;
+  struct stat st;
+  for (start = Millis(); (stat(file, &st) == 0) != exists;) {
+    CHECK(Millis() - start < 2000);
+    usleep(1000);
+  }
+  return Millis() - start;
+}
+
+// runs inside blink
+int Check(const char *base) {
+  int fd;
+  struct stat st;
+  char file[80], mine[96];
+  snprintf(file, sizeof(file), "/%s", base);
+  snprintf(mine, sizeof(mine), "/%s.mine", base);
+  snprintf(path, sizeof(path), "/%s.marker", base);
+  if (access(path, F_OK)) {
+    fprintf(stderr, "overlaycache_test: skipped since blink has no overlays\n");
+    return 77;
+  }
+
+  // creating and removing files through blink is seen immediately
+  CHECK(stat(mine, &st) == -1 && errno == ENOENT);
+  CHECK((fd = creat(mine, 0644)) != -1);
+  CHECK(!close(fd));
+  CHECK(!stat(mine, &st));
+  CHECK(!unlink(mine));
+  CHECK(stat(mine, &st) == -1 && errno == ENOENT);
+
+  // files created and removed by the host are seen before long
+  CHECK(stat(file, &st) == -1 && errno == ENOENT);
+  CHECK(stat(file, &st) == -1 && errno == ENOENT);
+  Send(1, '1');
+  Expect(0, '2');
+  CHECK(Await(file, 1) < 1000);
+  Send(1, '3');
+  Expect(0, '4');
+  CHECK(Await(file, 0) < 1000);
+  return 0;
+}
+
+void FindBlink(void) {
+  char *p;
+  struct utsname u;
+  CHECK(!uname(&u));
+  if (strstr(u.release, "-blink-")) {
+    fprintf(stderr, "overlaycache_test: skipped under blink\n");
+    exit(77);
+  }
+  snprintf(blink, sizeof(blink), "%s",
+           (p = getenv("BLINK")) ? p : "o//blink/blink");
+  CHECK(!access(blink, X_OK));
+}
+
+int Test(const char *mode, const char *self) {
+  char *args[6], env[96], *envp[2];
+  int i, ws, pid, fd, p2c[2], c2p[2];
+  snprintf(env, sizeof(env), "BLINK_OVERLAYS=%s:/", dir);
+  envp[0] = env;
+  envp[1] = 0;
+  i = 0;
+  args[i++] = blink;
+  if (*mode) args[i++] = (char *)mode;
+  args[i++] = (char *)self;
+  args[i++] = "check";
+  args[i++] = name;
+  args[i] = 0;
+  CHECK(!pipe(p2c));
+  CHECK(!pipe(c2p));
+  CHECK((pid = fork()) != -1);
+  if (!pid) {
+    dup2(p2c[0], 0);
+    dup2(c2p[1], 1);
+    execve(args[0], args, envp);
+    _exit(127);
+  }
+  CHECK(!close(p2c[0]));
+  CHECK(!close(c2p[1]));
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  if (read(c2p[0], &i, 1) == 1) {
+    CHECK((fd = creat(path, 0644)) != -1);
+    CHECK(!close(fd));
+    Send(p2c[1], '2');
+    Expect(c2p[0], '3');
+    CHECK(!unlink(path));
+    Send(p2c[1], '4');
+  }
+  CHECK(!close(p2c[1]));
+  CHECK(!close(c2p[0]));
+  CHECK(waitpid(pid, &ws, 0) == pid);
+  if (WIFEXITED(ws) && WEXITSTATUS(ws) == 77) return 77;
+  if (!WIFEXITED(ws) || WEXITSTATUS(ws)) {
+    fprintf(stderr, "overlaycache_test: %s %s failed with status %#x\n",
+            blink, mode, ws);
+    exit(1);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int fd;
+  if (argc > 2 && !strcmp(argv[1], "check")) return Check(argv[2]);
+  FindBlink();
+  strcpy(dir, "/tmp/blink.overlaycache.XXXXXX");
+  CHECK(mkdtemp(dir));
+  // the name mustn't exist in the host's root directory either
+  snprintf(name, sizeof(name), "%s", strrchr(dir, '/') + 1);
+  snprintf(path, sizeof(path), "%s/%s.marker", dir, name);
+  CHECK((fd = creat(path, 0644)) != -1);
+  CHECK(!close(fd));
+  if ((fd = Test("", argv[0])) != 77) {
+    Test("-m", argv[0]);
+    Test("-j", argv[0]);
+    Test("-jm", argv[0]);
+  }
+  snprintf(path, sizeof(path), "%s/%s.marker", dir, name);
+  CHECK(!unlink(path));
+  CHECK(!rmdir(dir));
+  return fd;
+}
@@ -0,0 +1,286 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+// packs a directory tree holding this same program with blinkpack, then
+// runs `BLINK_PREFIX=IMAGE blink /check check` in each memory and jit
+// mode, so the program checks the files it was packed with from inside
+// the image. $BLINK and $BLINKPACK may name the binaries, otherwise the
+// ones in o// are used. blink builds without the vfs can't mount images
+// and that's reported as an explicit skip, as is running under blink.
+
+#define CHECK(x)                                          \
+  do {                                                    \
+    if (!(x)) {                                           \
+      fprintf(stderr, "%s:%d: %s failed: %s\n", __FILE__, \
+              __LINE__, #x, strerror(errno));             \
+      exit(1);                                            \
+    }                                                     \
+  } while (0)
+
+#define BIGSIZE (3 * 65536 + 123)
+
+char blink[PATH_MAX];
+char blinkpack[PATH_MAX];
+char dir[64], src[96], img[96];
+
+int Pattern(int i) {
+  return (i * 7 + i / 4096) & 255;
+}
+
+// returns path of `name` in the directory that's packed
+char *Src(char path[160], const char *name) {
+  snprintf(path, 160, "%s/%s", src, name);
+  return path;
+}
+
+void Put(const char *name, const char *data, size_t size) {
+  int fd;
+  char path[160];
+  Src(path, name);
+  CHECK((fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644)) != -1);
+  CHECK(write(fd, data, size) == size);
+  CHECK(!close(fd));
+}
+
+void Expect(const char *path, const char *want) {
+  int fd;
+  ssize_t n;
+  char buf[64];
+  CHECK((fd = open(path, O_RDONLY)) != -1);
+  CHECK((n = read(fd, buf, sizeof(buf) - 1)) != -1);
+  buf[n] = 0;
+  CHECK(!strcmp(buf, want));
+  CHECK(!close(fd));
+}
+
+void ExpectRofs(int rc) {
+  CHECK(rc == -1);
+  CHECK(errno == EROFS);
+}
+
+// runs inside the image
+int Check(void) {
+  int i, fd;
+  char *p, buf[16];
+  struct stat st, st2;
+
+  // reads, both of small files and aligned large files
+  Expect("/hello", "hello world\n");
+  CHECK((fd = open("/dir/big", O_RDONLY)) != -1);
+  CHECK(!fstat(fd, &st));
+  CHECK(st.st_size == BIGSIZE);
+  CHECK(pread(fd, buf, 4, 65536 - 2) == 4);
+  for (i = 0; i < 4; ++i) CHECK((buf[i] & 255) == Pattern(65536 - 2 + i));
+  CHECK(pread(fd, buf, 16, BIGSIZE - 2) == 2);
+
+  // mappings of the large file come from the image itself
+  p = mmap(0, BIGSIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+  CHECK(p != MAP_FAILED);
+  for (i = 0; i < BIGSIZE; i += 1000) CHECK((p[i] & 255) == Pattern(i));
+  CHECK(!munmap(p, BIGSIZE));
+  p = mmap(0, 65536, PROT_READ, MAP_SHARED, fd, 65536);
+  CHECK(p != MAP_FAILED);
+  CHECK((p[5] & 255) == Pattern(65536 + 5));
+  CHECK(!munmap(p, 65536));
+  CHECK(!close(fd));
+
+  // mappings of small files are copies, which can be written privately
+  CHECK((fd = open("/hello", O_RDONLY)) != -1);
+  p = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  CHECK(p != MAP_FAILED);
+  CHECK(!memcmp(p, "hello world\n", 12));
+  CHECK(!p[12]);
+  p[0] = 'j';
+  CHECK(!munmap(p, 4096));
+  CHECK(!close(fd));
+  Expect("/hello", "hello world\n");
+
+  // symbolic links
+  CHECK(!lstat("/link", &st));
+  CHECK(S_ISLNK(st.st_mode));
+  CHECK(readlink("/link", buf, sizeof(buf)) == 5);
+  CHECK(!memcmp(buf, "hello", 5));
+  Expect("/link", "hello world\n");
+  CHECK(readlink("/dir/up", buf, sizeof(buf)) == 8);
+  Expect("/dir/up", "hello world\n");
+
+  // hard links share an inode
+  CHECK(!stat("/hello", &st));
+  CHECK(!stat("/dir/hard", &st2));
+  CHECK(st.st_ino == st2.st_ino);
+  CHECK(st.st_nlink == 2);
+  CHECK(st2.st_nlink == 2);
+  CHECK(S_ISREG(st.st_mode));
+
+  // nothing can be changed
+  ExpectRofs(open("/hello", O_WRONLY));
+  ExpectRofs(open("/hello", O_RDWR | O_TRUNC));
+  ExpectRofs(open("/new", O_CREAT | O_WRONLY, 0644));
+  ExpectRofs(mkdir("/newdir", 0755));
+  ExpectRofs(unlink("/hello"));
+  ExpectRofs(rename("/hello", "/dir/hello"));
+  ExpectRofs(symlink("hello", "/link2"));
+  ExpectRofs(chmod("/hello", 0600));
+  CHECK(stat("/new", &st) == -1 && errno == ENOENT);
+  return 0;
+}
+
+void FindBlink(void) {
+  int ws, pfds[2];
+  ssize_t n;
+  size_t got;
+  char *p, help[4096];
+  struct utsname u;
+  CHECK(!uname(&u));
+  if (strstr(u.release, "-blink-")) {
+    fprintf(stderr, "packfs_test: skipped under blink\n");
+    exit(77);
+  }
+  snprintf(blink, sizeof(blink), "%s",
+           (p = getenv("BLINK")) ? p : "o//blink/blink");
+  snprintf(blinkpack, sizeof(blinkpack), "%s",
+           (p = getenv("BLINKPACK")) ? p : "o//blink/blinkpack");
+  CHECK(!access(blink, X_OK));
+  CHECK(!access(blinkpack, X_OK));
+  // only blink builds with the vfs document $BLINK_PREFIX
+  CHECK(!pipe(pfds));
+  if (!fork()) {
+    dup2(pfds[1], 1);
+    execl(blink, blink, "-h", (char *)0);
+    _exit(127);
+  }
+  CHECK(!close(pfds[1]));
+  for (got = 0; (n = read(pfds[0], help + got, sizeof(help) - 1 - got)) > 0;)
+    got += n;
+  help[got] = 0;
+  CHECK(!close(pfds[0]));
+  CHECK(wait(&ws) != -1);
+  if (!strstr(help, "$BLINK_PREFIX")) {
+    fprintf(stderr, "packfs_test: skipped since %s has no vfs\n", blink);
+    exit(77);
+  }
+}
+
+void Run(char *const args[], char *const envp[]) {
+  int ws, pid;
+  CHECK((pid = fork()) != -1);
+  if (!pid) {
+    execve(args[0], args, envp);
+    _exit(127);
+  }
+  CHECK(waitpid(pid, &ws, 0) == pid);
+  if (!WIFEXITED(ws) || WEXITSTATUS(ws)) {
+    fprintf(stderr, "packfs_test: %s %s failed with status %#x\n", args[0],
+            args[1], ws);
+    exit(1);
+  }
+}
+
+void Copy(const char *from, const char *to) {
+  ssize_t n;
+  int in, out;
+  char buf[65536];
+  CHECK((in = open(from, O_RDONLY)) != -1);
+  CHECK((out = open(to, O_CREAT | O_WRONLY, 0755)) != -1);
+  while ((n = read(in, buf, sizeof(buf))) > 0) {
+    CHECK(write(out, buf, n) == n);
+  }
+  CHECK(!n);
+  CHECK(!close(out));
+  CHECK(!close(in));
+}
+
+void Pack(const char *self) {
+  int i;
+  char *big, *args[4];
+  char path[160], path2[160];
+  strcpy(dir, "/tmp/blink.packfs.XXXXXX");
+  CHECK(mkdtemp(dir));
+  snprintf(src, sizeof(src), "%s/src", dir);
+  snprintf(img, sizeof(img), "%s/img", dir);
+  CHECK(!mkdir(src, 0755));
+  CHECK(!mkdir(Src(path, "dir"), 0755));
+  Put("hello", "hello world\n", 12);
+  CHECK((big = malloc(BIGSIZE)));
+  for (i = 0; i < BIGSIZE; ++i) big[i] = Pattern(i);
+  Put("dir/big", big, BIGSIZE);
+  free(big);
+  CHECK(!link(Src(path, "hello"), Src(path2, "dir/hard")));
+  CHECK(!symlink("hello", Src(path, "link")));
+  CHECK(!symlink("../hello", Src(path, "dir/up")));
+  // the guest program has to be inside the image
+  Copy(self, Src(path, "check"));
+  args[0] = blinkpack;
+  args[1] = img;
+  args[2] = src;
+  args[3] = 0;
+  Run(args, environ);
+}
+
+void TestImage(const char *mode) {
+  int i;
+  char *args[5], *envp[2], env[128];
+  snprintf(env, sizeof(env), "BLINK_PREFIX=%s", img);
+  envp[0] = env;
+  envp[1] = 0;
+  i = 0;
+  args[i++] = blink;
+  if (*mode) args[i++] = (char *)mode;
+  args[i++] = "/check";
+  args[i++] = "check";
+  args[i] = 0;
+  Run(args, envp);
+}
+
+void Cleanup(void) {
+  int i;
+  char path[160];
+  const char *names[] = {"dir/big", "dir/hard", "dir/up", "hello",
+                         "link",    "check",    0};
+  for (i = 0; names[i]; ++i) CHECK(!unlink(Src(path, names[i])));
+  CHECK(!rmdir(Src(path, "dir")));
+  CHECK(!rmdir(src));
+  CHECK(!unlink(img));
+  CHECK(!rmdir(dir));
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && !strcmp(argv[1], "check")) return Check();
+  FindBlink();
+  Pack(argv[0]);
+  TestImage("");
+  TestImage("-m");
+  TestImage("-j");
+  TestImage("-jm");
+  Cleanup();
+  return 0;
+}
@@ -0,0 +1,76 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+int pipefds[2];
+
+void SetUp(void) {
+  ASSERT_EQ(0, pipe(pipefds));
+}
+
+void TearDown(void) {
+  ASSERT_EQ(0, close(pipefds[0]));
+  ASSERT_EQ(0, close(pipefds[1]));
+}
+
+void *Writer(void *arg) {
+  usleep(10000);
+  write(pipefds[1], "x", 1);
+  return 0;
+}
+
+TEST(poll, wokenByOtherThread) {
+  pthread_t th;
+  struct pollfd pfd = {pipefds[0], POLLIN};
+  ASSERT_EQ(0, pthread_create(&th, 0, Writer, 0));
+  ASSERT_EQ(1, poll(&pfd, 1, 10000));
+  ASSERT_EQ(POLLIN, pfd.revents);
+  ASSERT_EQ(0, pthread_join(th, 0));
+}
+
+TEST(poll, mixed) {
+  int fd;
+  struct pollfd pfds[4];
+  ASSERT_NE(-1, (fd = open("/dev/null", O_RDONLY)));
+  pfds[0].fd = pipefds[0];
+  pfds[0].events = POLLIN;
+  pfds[1].fd = pipefds[1];
+  pfds[1].events = POLLOUT;
+  pfds[2].fd = fd;
+  pfds[2].events = POLLIN;
+  pfds[3].fd = 1000;
+  pfds[3].events = POLLIN;
+  ASSERT_EQ(3, poll(pfds, 4, 0));
+  ASSERT_EQ(0, pfds[0].revents);
+  ASSERT_EQ(POLLOUT, pfds[1].revents);
+  ASSERT_EQ(POLLIN, pfds[2].revents);
+  ASSERT_EQ(POLLNVAL, pfds[3].revents);
+  ASSERT_EQ(0, close(fd));
+}
+
+TEST(poll, timeout) {
+  struct pollfd pfd = {pipefds[0], POLLIN};
+  ASSERT_EQ(0, poll(&pfd, 1, 10));
+  ASSERT_EQ(0, pfd.revents);
+}
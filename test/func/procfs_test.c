@@ -0,0 +1,155 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+// blink only emulates /proc when it's built with its vfs, otherwise the
+// guest would be reading the host's view of blink's own address space,
+// which is why /proc/blink is checked for before running these tests.
+
+#define MB (1024 * 1024)
+
+char buf[1024 * 1024];
+
+void SetUp(void) {
+  struct utsname u;
+  ASSERT_EQ(0, uname(&u));
+  if (strstr(u.release, "-blink-") && access("/proc/blink", F_OK)) {
+    fprintf(stderr, "procfs_test: skipped since blink has no procfs\n");
+    exit(77);
+  }
+}
+
+void TearDown(void) {
+}
+
+const char *Slurp(const char *path) {
+  int fd;
+  ssize_t rc;
+  size_t n = 0;
+  ASSERT_NE(-1, (fd = open(path, O_RDONLY)));
+  while ((rc = read(fd, buf + n, sizeof(buf) - 1 - n)) > 0) n += rc;
+  ASSERT_EQ(0, rc);
+  ASSERT_EQ(0, close(fd));
+  buf[n] = 0;
+  return buf;
+}
+
+// returns the line of /proc/self/{maps,smaps} describing `addr`
+const char *FindVma(const char *file, void *addr) {
+  const char *p;
+  char want[32];
+  snprintf(want, sizeof(want), "%08lx-", (unsigned long)addr);
+  for (p = Slurp(file); p; (p = strchr(p, '\n')) && ++p) {
+    if (!strncmp(p, want, strlen(want))) return p;
+  }
+  return 0;
+}
+
+long GetField(const char *p, const char *name) {
+  ASSERT_NOTNULL((p = strstr(p, name)));
+  return strtol(p + strlen(name), 0, 10);
+}
+
+long GetRss(void *addr) {
+  const char *p;
+  ASSERT_NOTNULL((p = FindVma("/proc/self/smaps", addr)));
+  return GetField(p, "\nRss:");
+}
+
+TEST(maps, fileMappingHasDeviceInodeAndAbsolutePath) {
+  int fd;
+  char *p;
+  const char *line;
+  struct stat st;
+  char name[32], path[PATH_MAX];
+  unsigned long lo, hi, off, ino;
+  unsigned maj, min;
+  char prot[5], file[PATH_MAX];
+  ASSERT_EQ(0, chdir("/tmp"));
+  strcpy(name, "blink.procfs.XXXXXX");
+  ASSERT_NE(-1, (fd = mkstemp(name)));
+  ASSERT_EQ(0, close(fd));
+  // open by relative name so the vfs has to absolutize it
+  ASSERT_NE(-1, (fd = open(name, O_RDWR)));
+  ASSERT_EQ(0, ftruncate(fd, 3 * 4096));
+  ASSERT_EQ(0, fstat(fd, &st));
+  p = mmap(0, 2 * 4096, PROT_READ, MAP_PRIVATE, fd, 4096);
+  ASSERT_NE((intptr_t)MAP_FAILED, (intptr_t)p);
+  ASSERT_NOTNULL(getcwd(path, sizeof(path)));
+  strcat(path, "/");
+  strcat(path, name);
+  ASSERT_NOTNULL((line = FindVma("/proc/self/maps", p)));
+  ASSERT_EQ(8, sscanf(line, "%lx-%lx %4s %lx %x:%x %lu %s", &lo, &hi, prot,
+                      &off, &maj, &min, &ino, file));
+  EXPECT_STREQ("r--p", prot);
+  EXPECT_EQ(0x1000, off);
+  EXPECT_EQ(major(st.st_dev), maj);
+  EXPECT_EQ(minor(st.st_dev), min);
+  EXPECT_EQ(st.st_ino, ino);
+  EXPECT_STREQ(path, file);
+  ASSERT_EQ(0, munmap(p, 2 * 4096));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, unlink(name));
+}
+
+TEST(smaps, untouchedMemoryIsntResident) {
+  long i;
+  char *p;
+  p = mmap(0, 64 * MB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+           0);
+  ASSERT_NE((intptr_t)MAP_FAILED, (intptr_t)p);
+  // allow for the host kernel to use a transparent huge page
+  EXPECT_LE(GetRss(p), 2048);
+  for (i = 0; i < 16 * MB; i += 4096) p[i] = 1;
+  EXPECT_GE(GetRss(p), 16 * 1024);
+  EXPECT_LE(GetRss(p), 16 * 1024 + 2048);
+  ASSERT_EQ(0, munmap(p, 64 * MB));
+}
+
+TEST(smaps, stackIsntEntirelyResident) {
+  const char *p;
+  ASSERT_NOTNULL((p = strstr(Slurp("/proc/self/smaps"), "[stack]")));
+  EXPECT_LT(GetField(p, "\nRss:"), GetField(p, "\nSize:"));
+}
+
+TEST(status, rssTracksTouchedMemory) {
+  long i, rss1, rss2;
+  char *p;
+  p = mmap(0, 64 * MB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+           0);
+  ASSERT_NE((intptr_t)MAP_FAILED, (intptr_t)p);
+  rss1 = GetField(Slurp("/proc/self/status"), "\nVmRSS:");
+  EXPECT_LT(rss1, GetField(buf, "\nVmSize:") - 64 * 1024);
+  for (i = 0; i < 16 * MB; i += 4096) p[i] = 1;
+  rss2 = GetField(Slurp("/proc/self/status"), "\nVmRSS:");
+  EXPECT_GE(rss2 - rss1, 16 * 1024 - 2048);
+  EXPECT_LE(rss2 - rss1, 16 * 1024 + 4096);
+  ASSERT_EQ(0, munmap(p, 64 * MB));
+}
@@ -0,0 +1,293 @@
+/*-*- mode:c;indent-tabs-mode:nil;c-basic-offset:2;tab-width:8;coding:utf-8 -*-│
+│vi: set net ft=c ts=2 sts=2 sw=2 fenc=utf-8                                :vi│
+╞══════════════════════════════════════════════════════════════════════════════╡
+│ Copyright 2023 Justine Alexandra Roberts Tunney                              │
+│                                                                              │
+│ Permission to use, copy, modify, and/or distribute this software for         │
+│ any purpose with or without fee is hereby granted, provided that the         │
+│ above copyright notice and this permission notice appear in all copies.      │
+│                                                                              │
+│ THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL                │
+│ WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED                │
+│ WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE             │
+│ AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL         │
+│ DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR        │
+│ PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER               │
+│ TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR             │
+│ PERFORMANCE OF THIS SOFTWARE.                                                │
+╚─────────────────────────────────────────────────────────────────────────────*/
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "test/test.h"
+
+// these tests mount a tmpfs of their own, which under blink is only
+// possible when it's built with its vfs, in which case the in-memory
+// file system that's shared by forked processes is what gets tested.
+// on the host they need root, and are otherwise skipped explicitly.
+
+char dir[64];
+
+void Unmount(void) {
+  umount2(dir, MNT_DETACH);
+  rmdir(dir);
+}
+
+void SetUp(void) {
+  if (*dir) {
+    ASSERT_EQ(0, chdir(dir));
+    return;
+  }
+  strcpy(dir, "/tmp/blink.tmpfs.XXXXXX");
+  ASSERT_NOTNULL(mkdtemp(dir));
+  if (mount("tmpfs", dir, "tmpfs", 0, 0)) {
+    fprintf(stderr, "tmpfs_test: skipped since mount() failed: %s\n",
+            strerror(errno));
+    rmdir(dir);
+    exit(77);
+  }
+  atexit(Unmount);
+  ASSERT_EQ(0, chdir(dir));
+}
+
+void TearDown(void) {
+  ASSERT_EQ(0, chdir("/"));
+}
+
+int Slurp(const char *path, char *buf, size_t size) {
+  int fd;
+  ssize_t rc;
+  ASSERT_NE(-1, (fd = open(path, O_RDONLY)));
+  ASSERT_NE(-1, (rc = read(fd, buf, size - 1)));
+  ASSERT_EQ(0, close(fd));
+  buf[rc] = 0;
+  return rc;
+}
+
+TEST(tmpfs, createWriteReadTruncate) {
+  int fd;
+  char buf[16];
+  struct stat st;
+  ASSERT_NE(-1, (fd = open("a", O_CREAT | O_EXCL | O_RDWR, 0644)));
+  ASSERT_EQ(-1, open("a", O_CREAT | O_EXCL | O_RDWR, 0644));
+  ASSERT_EQ(EEXIST, errno);
+  ASSERT_EQ(5, write(fd, "hello", 5));
+  ASSERT_EQ(5, pread(fd, buf, sizeof(buf), 0));
+  ASSERT_EQ(0, memcmp(buf, "hello", 5));
+  ASSERT_EQ(0, ftruncate(fd, 2));
+  ASSERT_EQ(0, fstat(fd, &st));
+  ASSERT_EQ(2, st.st_size);
+  ASSERT_TRUE(S_ISREG(st.st_mode));
+  // growing exposes zeroes rather than the old contents
+  ASSERT_EQ(0, truncate("a", 10000));
+  ASSERT_EQ(4, pread(fd, buf, 4, 0));
+  ASSERT_EQ(0, memcmp(buf, "he\0\0", 4));
+  ASSERT_EQ(4, pread(fd, buf, 4, 9996));
+  ASSERT_EQ(0, memcmp(buf, "\0\0\0\0", 4));
+  ASSERT_EQ(0, pread(fd, buf, 4, 10000));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, unlink("a"));
+  ASSERT_EQ(-1, open("a", O_RDONLY));
+  ASSERT_EQ(ENOENT, errno);
+}
+
+TEST(tmpfs, sharedMappingsAlias) {
+  int fd;
+  char buf[8], *p, *q;
+  ASSERT_NE(-1, (fd = open("m", O_CREAT | O_RDWR, 0644)));
+  ASSERT_EQ(0, ftruncate(fd, 8192));
+  p = mmap(0, 8192, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ASSERT_NE((intptr_t)MAP_FAILED, (intptr_t)p);
+  q = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 4096);
+  ASSERT_NE((intptr_t)MAP_FAILED, (intptr_t)q);
+  // stores through one mapping are seen by the other and by read()
+  p[4096] = 'x';
+  ASSERT_EQ('x', q[0]);
+  q[1] = 'y';
+  ASSERT_EQ(2, pread(fd, buf, 2, 4096));
+  ASSERT_EQ(0, memcmp(buf, "xy", 2));
+  // write() is seen by existing mappings
+  ASSERT_EQ(3, pwrite(fd, "abc", 3, 10));
+  ASSERT_EQ(0, memcmp(p + 10, "abc", 3));
+  ASSERT_EQ(0, munmap(q, 4096));
+  ASSERT_EQ(0, munmap(p, 8192));
+  // private mappings don't write back
+  p = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ASSERT_NE((intptr_t)MAP_FAILED, (intptr_t)p);
+  ASSERT_EQ('a', p[10]);
+  p[10] = 'z';
+  ASSERT_EQ(1, pread(fd, buf, 1, 10));
+  ASSERT_EQ('a', buf[0]);
+  ASSERT_EQ(0, munmap(p, 4096));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, unlink("m"));
+}
+
+TEST(tmpfs, forkSharesOffsetAndData) {
+  int fd, ws;
+  char buf[16];
+  ASSERT_NE(-1, (fd = open("f", O_CREAT | O_RDWR | O_TRUNC, 0644)));
+  ASSERT_EQ(3, write(fd, "abc", 3));
+  if (!fork()) {
+    if (write(fd, "def", 3) != 3) _exit(1);
+    if (lseek(fd, 0, SEEK_CUR) != 6) _exit(2);
+    _exit(0);
+  }
+  ASSERT_NE(-1, wait(&ws));
+  ASSERT_TRUE(WIFEXITED(ws));
+  ASSERT_EQ(0, WEXITSTATUS(ws));
+  // the child advanced the offset of the open file description we share
+  ASSERT_EQ(6, lseek(fd, 0, SEEK_CUR));
+  ASSERT_EQ(3, write(fd, "ghi", 3));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(9, Slurp("f", buf, sizeof(buf)));
+  ASSERT_STREQ("abcdefghi", buf);
+  ASSERT_EQ(0, unlink("f"));
+}
+
+TEST(tmpfs, renameLinkSymlink) {
+  int fd;
+  char buf[16];
+  struct stat st, st2;
+  ASSERT_NE(-1, (fd = open("r1", O_CREAT | O_WRONLY, 0644)));
+  ASSERT_EQ(2, write(fd, "hi", 2));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, rename("r1", "r2"));
+  ASSERT_EQ(-1, stat("r1", &st));
+  ASSERT_EQ(ENOENT, errno);
+  ASSERT_EQ(0, link("r2", "r3"));
+  ASSERT_EQ(0, stat("r2", &st));
+  ASSERT_EQ(0, stat("r3", &st2));
+  ASSERT_EQ(st.st_ino, st2.st_ino);
+  ASSERT_EQ(2, st.st_nlink);
+  ASSERT_EQ(0, symlink("r3", "r4"));
+  ASSERT_EQ(0, lstat("r4", &st2));
+  ASSERT_TRUE(S_ISLNK(st2.st_mode));
+  ASSERT_EQ(2, readlink("r4", buf, sizeof(buf)));
+  ASSERT_EQ(0, memcmp(buf, "r3", 2));
+  ASSERT_EQ(2, Slurp("r4", buf, sizeof(buf)));
+  ASSERT_STREQ("hi", buf);
+  ASSERT_EQ(0, unlink("r3"));
+  ASSERT_EQ(0, stat("r2", &st2));
+  ASSERT_EQ(1, st2.st_nlink);
+  ASSERT_EQ(-1, stat("r4", &st2));
+  ASSERT_EQ(ENOENT, errno);
+  // renaming over an existing name replaces it
+  ASSERT_NE(-1, (fd = open("r5", O_CREAT | O_WRONLY, 0644)));
+  ASSERT_EQ(0, fstat(fd, &st));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(0, rename("r5", "r2"));
+  ASSERT_EQ(0, stat("r2", &st2));
+  ASSERT_EQ(st.st_ino, st2.st_ino);
+  ASSERT_EQ(0, st2.st_size);
+  ASSERT_EQ(0, unlink("r4"));
+  ASSERT_EQ(0, unlink("r2"));
+}
+
+TEST(tmpfs, readdirAndRmdir) {
+  int i, fd, n;
+  DIR *d;
+  char name[16];
+  struct dirent *e;
+  unsigned seen = 0;
+  ASSERT_EQ(0, mkdir("d", 0755));
+  for (i = 0; i < 10; ++i) {
+    snprintf(name, sizeof(name), "d/%d", i);
+    ASSERT_NE(-1, (fd = open(name, O_CREAT | O_WRONLY, 0644)));
+    ASSERT_EQ(0, close(fd));
+  }
+  ASSERT_EQ(-1, rmdir("d"));
+  ASSERT_EQ(ENOTEMPTY, errno);
+  ASSERT_NOTNULL((d = opendir("d")));
+  for (n = 0; (e = readdir(d)); ++n) {
+    if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+    i = atoi(e->d_name);
+    ASSERT_EQ(0, seen & (1u << i));
+    seen |= 1u << i;
+  }
+  ASSERT_EQ(0, closedir(d));
+  ASSERT_EQ(12, n);
+  ASSERT_EQ(0x3ff, seen);
+  for (i = 0; i < 10; ++i) {
+    snprintf(name, sizeof(name), "d/%d", i);
+    ASSERT_EQ(0, unlink(name));
+  }
+  ASSERT_EQ(0, rmdir("d"));
+  ASSERT_EQ(-1, rmdir("d"));
+  ASSERT_EQ(ENOENT, errno);
+}
+
+TEST(tmpfs, mkfifo) {
+  int r, w;
+  char buf[8];
+  struct stat st;
+  ASSERT_EQ(0, mkfifo("p", 0644));
+  ASSERT_EQ(0, stat("p", &st));
+  ASSERT_TRUE(S_ISFIFO(st.st_mode));
+  ASSERT_NE(-1, (r = open("p", O_RDONLY | O_NONBLOCK)));
+  ASSERT_NE(-1, (w = open("p", O_WRONLY)));
+  ASSERT_EQ(4, write(w, "fifo", 4));
+  ASSERT_EQ(4, read(r, buf, sizeof(buf)));
+  ASSERT_EQ(0, memcmp(buf, "fifo", 4));
+  ASSERT_EQ(0, close(w));
+  ASSERT_EQ(0, close(r));
+  ASSERT_EQ(0, unlink("p"));
+}
+
+// processes are killed while they're in the middle of file system
+// operations, which for blink's tmpfs means sometimes while holding
+// the arena lock, so the next locker has to repair the arena first.
+TEST(tmpfs, survivesKilledProcesses) {
+  DIR *d;
+  int i, j, n, fd, pids[4];
+  char name[32], buf[16];
+  struct dirent *e;
+  struct timespec ts = {0, 2000000};
+  ASSERT_EQ(0, mkdir("k", 0755));
+  for (i = 0; i < 20; ++i) {
+    for (j = 0; j < 4; ++j) {
+      ASSERT_NE(-1, (pids[j] = fork()));
+      if (!pids[j]) {
+        for (n = 0;; ++n) {
+          snprintf(name, sizeof(name), "k/%d.%d", j, n % 8);
+          if ((fd = open(name, O_CREAT | O_RDWR | O_TRUNC, 0644)) != -1) {
+            write(fd, name, strlen(name));
+            close(fd);
+          }
+          snprintf(buf, sizeof(buf), "k/%d.x", j);
+          rename(name, buf);
+          unlink(buf);
+        }
+      }
+    }
+    nanosleep(&ts, 0);
+    for (j = 0; j < 4; ++j) {
+      ASSERT_EQ(0, kill(pids[j], SIGKILL));
+      ASSERT_EQ(pids[j], waitpid(pids[j], 0, 0));
+    }
+  }
+  // everything still works and nothing the victims left is corrupt
+  ASSERT_NOTNULL((d = opendir("k")));
+  while ((e = readdir(d))) {
+    if (*e->d_name == '.') continue;
+    snprintf(name, sizeof(name), "k/%s", e->d_name);
+    ASSERT_EQ(0, unlink(name));
+  }
+  ASSERT_EQ(0, closedir(d));
+  ASSERT_NE(-1, (fd = open("k/ok", O_CREAT | O_RDWR, 0644)));
+  ASSERT_EQ(2, write(fd, "ok", 2));
+  ASSERT_EQ(0, close(fd));
+  ASSERT_EQ(2, Slurp("k/ok", buf, sizeof(buf)));
+  ASSERT_STREQ("ok", buf);
+  ASSERT_EQ(0, unlink("k/ok"));
+  ASSERT_EQ(0, rmdir("k"));
+}
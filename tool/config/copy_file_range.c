@@ -0,0 +1,9 @@
+// checks for copy_file_range() system call
+#include <sys/types.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  off_t off = 0;
+  copy_file_range(-1, &off, -1, 0, 0, 0);
+  return 0;
+}
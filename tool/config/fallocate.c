@@ -0,0 +1,21 @@
+// checks for fallocate() system call
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  int fd;
+  char path[128];
+  struct stat st;
+  snprintf(path, 128, "/tmp/blink.config.%d", getpid());
+  fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd == -1) return 1;
+  unlink(path);
+  if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, 4096) == -1) return 2;
+  if (fstat(fd, &st) == -1) return 3;
+  if (st.st_size) return 4;
+  fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, 4096);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,16 @@
+// checks for memfd_create() system call with file sealing
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  int fd;
+  if ((fd = memfd_create("config", MFD_CLOEXEC | MFD_ALLOW_SEALING)) == -1) {
+    return 1;
+  }
+  if (ftruncate(fd, 4096)) return 2;
+  if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW)) return 3;
+  if (fcntl(fd, F_GET_SEALS) != (F_SEAL_SHRINK | F_SEAL_GROW)) return 4;
+  if (!ftruncate(fd, 8192)) return 5;
+  return 0;
+}
@@ -0,0 +1,18 @@
+// checks for mincore() page residency query
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  char *p;
+  unsigned char vec[1];
+  long n = sysconf(_SC_PAGESIZE);
+  if ((p = (char *)mmap(0, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+                        -1, 0)) == MAP_FAILED) {
+    return 1;
+  }
+  *p = 1;
+  if (mincore(p, n, (void *)vec)) return 2;
+  if (!(vec[0] & 1)) return 3;
+  return 0;
+}
@@ -0,0 +1,18 @@
+// checks for posix_fadvise() system call
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  int fd;
+  char path[128];
+  snprintf(path, 128, "/tmp/blink.config.%d", getpid());
+  fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd == -1) return 1;
+  unlink(path);
+  if (posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL)) return 2;
+  if (posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED)) return 3;
+  if (posix_fadvise(-1, 0, 0, POSIX_FADV_NORMAL) == 0) return 4;
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,12 @@
+// checks for ppoll() system call
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+
+int main(int argc, char *argv[]) {
+  sigset_t mask;
+  struct timespec ts = {0};
+  if (sigemptyset(&mask)) return 1;
+  if (ppoll(0, 0, &ts, &mask)) return 2;
+  return 0;
+}
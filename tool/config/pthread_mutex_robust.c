@@ -0,0 +1,35 @@
+// test for interprocess mutexes that survive their owner dying
+// clang-format off
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+int main(int argc, char *argv[]) {
+  int ws;
+  pid_t pid;
+  pthread_mutex_t *lock;
+  pthread_mutexattr_t ma;
+  if ((lock = (pthread_mutex_t *)mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) return 1;
+  if (pthread_mutexattr_init(&ma)) return 2;
+  if (pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED)) return 3;
+  if (pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST)) return 4;
+  if (pthread_mutex_init(lock, &ma)) return 5;
+  if (pthread_mutexattr_destroy(&ma)) return 6;
+  if ((pid = fork()) == -1) return 7;
+  if (!pid) {
+    if (pthread_mutex_lock(lock)) _exit(1);
+    _exit(0);
+  }
+  alarm(2);
+  if (wait(&ws) != pid) return 8;
+  if (!WIFEXITED(ws) || WEXITSTATUS(ws)) return 9;
+  if (pthread_mutex_lock(lock) != EOWNERDEAD) return 10;
+  if (pthread_mutex_consistent(lock)) return 11;
+  if (pthread_mutex_unlock(lock)) return 12;
+  if (pthread_mutex_lock(lock)) return 13;
+  if (pthread_mutex_unlock(lock)) return 14;
+  if (pthread_mutex_destroy(lock)) return 15;
+  return 0;
+}
@@ -0,0 +1,9 @@
+// checks for linux-style sendfile() system call
+#include <sys/sendfile.h>
+#include <sys/types.h>
+
+int main(int argc, char *argv[]) {
+  off_t off = 0;
+  sendfile(-1, -1, &off, 0);
+  return 0;
+}
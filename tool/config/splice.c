@@ -0,0 +1,10 @@
+// checks for splice() and tee() system calls
+#include <fcntl.h>
+#include <sys/types.h>
+
+int main(int argc, char *argv[]) {
+  off_t off = 0;
+  splice(-1, &off, -1, 0, 0, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  tee(-1, -1, 0, SPLICE_F_MORE);
+  return 0;
+}
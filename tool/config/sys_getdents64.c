@@ -0,0 +1,25 @@
+// tests for syscall(SYS_getdents64)
+#include <fcntl.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  long rc;
+  int fd, found;
+  unsigned short reclen;
+  char buf[4096];
+  if ((fd = open(".", O_RDONLY | O_DIRECTORY)) == -1) return 1;
+  for (found = 0;;) {
+    rc = syscall(SYS_getdents64, fd, buf, sizeof(buf));
+    if (rc == -1) return 2;
+    if (!rc) break;
+    for (long i = 0; i < rc; i += reclen) {
+      memcpy(&reclen, buf + i + 16, 2);
+      if (reclen < 20) return 3;
+      if (!strcmp(buf + i + 19, ".")) found = 1;
+    }
+  }
+  close(fd);
+  return found ? 0 : 4;
+}
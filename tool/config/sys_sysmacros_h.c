@@ -0,0 +1,9 @@
+#include <sys/types.h>
+// checks for sys/sysmacros.h header, which is where glibc and musl
+// declare major() and minor(); the bsds have them in sys/types.h
+#include <sys/sysmacros.h>
+
+int main(int argc, char *argv[]) {
+  dev_t dev = makedev(8, 1);
+  return major(dev) == 8 && minor(dev) == 1 ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+// checks for timerfd_create() system call
+#include <sys/timerfd.h>
+#include <time.h>
+
+int main(int argc, char *argv[]) {
+  int fd;
+  struct itimerspec it = {0};
+  if ((fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)) ==
+      -1) {
+    return 1;
+  }
+  if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &it, 0)) return 2;
+  if (timerfd_gettime(fd, &it)) return 3;
+  return 0;
+}